@@ -19,6 +19,7 @@
 //
 #include <webconsole/webconsole.h>
 #include <circle/logger.h>
+#include <circle/memory.h>
 #include <circle/util.h>
 #include <assert.h>
 
@@ -65,6 +66,28 @@ THTTPStatus CWebConsole::GetContent (const char  *pPath,
 	assert (m_pLog != 0);
 
 	assert (pPath != 0);
+	if (strcmp (pPath, "/memory") == 0)
+	{
+		CString Text;
+		GetMemoryStatus (&Text);
+
+		unsigned nLength = Text.GetLength ();
+		assert (pLength != 0);
+		if (*pLength < nLength)
+		{
+			return HTTPInternalServerError;
+		}
+
+		assert (pBuffer != 0);
+		memcpy (pBuffer, (const char *) Text, nLength);
+		*pLength = nLength;
+
+		assert (ppContentType != 0);
+		*ppContentType = "text/plain; charset=iso-8859-1";
+
+		return HTTPOK;
+	}
+
 	if (   strcmp (pPath, "/") != 0
 	    && strcmp (pPath, "/index.html") != 0)
 	{
@@ -93,3 +116,78 @@ THTTPStatus CWebConsole::GetContent (const char  *pPath,
 
 	return HTTPOK;
 }
+
+void CWebConsole::GetMemoryStatus (CString *pText)
+{
+	assert (pText != 0);
+
+	static const struct
+	{
+		int		 nType;
+		const char	*pName;
+	}
+	Heaps[] =
+	{
+		{HEAP_LOW,  "heaplow"},
+		{HEAP_HIGH, "heaphigh"}
+	};
+
+	CString Line;
+
+	for (unsigned i = 0; i < sizeof Heaps / sizeof Heaps[0]; i++)
+	{
+		THeapStatistics Stat;
+		if (!CMemorySystem::GetHeapStatistics (&Stat, Heaps[i].nType))
+		{
+			continue;
+		}
+
+		Line.Format ("%s: size %lu KB, free %lu KB, live %lu KB, peak %lu KB, "
+			     "largest free %lu KB, failed %u\n",
+			     Heaps[i].pName, Stat.nHeapSize / 1024, Stat.nFreeSpace / 1024,
+			     Stat.nLiveBytes / 1024, Stat.nPeakBytes / 1024,
+			     Stat.nLargestFreeBlock / 1024, Stat.nFailedAllocations);
+		pText->Append (Line);
+
+		for (unsigned j = 0; j <= Stat.nBuckets; j++)
+		{
+			const THeapBucketStatistics *pBucket = &Stat.Bucket[j];
+			if (pBucket->nAllocations == 0)
+			{
+				continue;
+			}
+
+			if (pBucket->nBlockSize != 0)
+			{
+				Line.Format ("  %7lu:", pBucket->nBlockSize);
+			}
+			else
+			{
+				Line = "    large:";
+			}
+			pText->Append (Line);
+
+			Line.Format (" %u blocks, %lu bytes, %lu wasted, %lu allocations\n",
+				     pBucket->nAllocatedBlocks, pBucket->nAllocatedBytes,
+				     pBucket->nWastedBytes, (unsigned long) pBucket->nAllocations);
+			pText->Append (Line);
+		}
+	}
+
+	TPageStatistics PageStat;
+	CMemorySystem::GetPageStatistics (&PageStat);
+
+	Line.Format ("pager: size %lu KB, free %lu KB, %u pages (max %u), failed %u\n",
+		     PageStat.nRegionSize / 1024, PageStat.nFreeSpace / 1024,
+		     PageStat.nAllocatedPages, PageStat.nMaxAllocatedPages,
+		     PageStat.nFailedAllocations);
+	pText->Append (Line);
+
+	pText->Append ("  free blocks per order:");
+	for (unsigned i = 0; i <= PAGE_MAX_ORDER; i++)
+	{
+		Line.Format (" %u", PageStat.nFreeBlocks[i]);
+		pText->Append (Line);
+	}
+	pText->Append ("\n");
+}
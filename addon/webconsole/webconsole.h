@@ -22,6 +22,7 @@
 
 #include <circle/net/httpdaemon.h>
 #include <webconsole/logbuffer.h>
+#include <circle/string.h>
 #include <circle/types.h>
 
 class CWebConsole : public CHTTPDaemon
@@ -44,6 +45,10 @@ public:
 			        unsigned    *pLength,		// in: buffer size, out: content length
 			        const char **ppContentType);	// set this if not "text/html"
 
+private:
+	// formats the memory allocator statistics as plain text
+	static void GetMemoryStatus (CString *pText);
+
 private:
 	u16 m_nPort;
 	CLogBuffer *m_pLog;
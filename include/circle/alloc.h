@@ -34,7 +34,8 @@ void *calloc (size_t nBlocks, size_t nSize);
 void *realloc (void *pBlock, size_t nSize);
 
 void *palloc (void);			// returns aligned page (AArch32: 4K, AArch64: 64K)
-void pfree (void *pPage);
+void *palloc_order (unsigned nOrder);	// returns 2^nOrder physically contiguous pages
+void pfree (void *pPage);		// frees a page or a block of contiguous pages
 
 #ifdef __cplusplus
 }
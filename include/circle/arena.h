@@ -0,0 +1,115 @@
+//
+// arena.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_arena_h
+#define _circle_arena_h
+
+#include <circle/new.h>
+#include <circle/types.h>
+
+#define ARENA_ALIGN	16
+#define ARENA_ALIGN_OF(type)	(alignof (type) > ARENA_ALIGN ? alignof (type) : ARENA_ALIGN)
+
+class CArena	/// Region allocator with bump-pointer allocation for scratch memory
+{
+public:
+	/// \param nSize Size of the region, which is allocated from the heap at once
+	CArena (size_t nSize);
+	/// \param pBuffer Caller provided region (e.g. on the stack), not freed by CArena
+	/// \param nSize Size of the region
+	CArena (void *pBuffer, size_t nSize);
+
+	~CArena (void);
+
+	/// \param nSize Size of the memory block
+	/// \param nAlign Alignment of the memory block (power of 2)
+	/// \return Pointer to the memory block, 0 if the region is exhausted
+	/// \note There is no individual free, use Release() or Reset() instead
+	void *Allocate (size_t nSize, size_t nAlign = ARENA_ALIGN);
+
+	/// \brief Allocate an uninitialized array of plain data type T
+	template <class T>
+	T *AllocateArray (size_t nCount)
+	{
+		return static_cast<T *> (Allocate (sizeof (T) * nCount, ARENA_ALIGN_OF (T)));
+	}
+
+	/// \brief Construct an object of type T in the region (placement new)
+	/// \return Pointer to the object, 0 if the region is exhausted
+	/// \note The destructor is not called by Release() or Reset(),
+	///	  call it explicitly, if the type has a non-trivial one.
+	template <class T, typename... TArgs>
+	T *New (TArgs&&... Args)
+	{
+		void *pMem = Allocate (sizeof (T), ARENA_ALIGN_OF (T));
+		if (pMem == 0)
+		{
+			return 0;
+		}
+
+		return ::new (pMem) T (static_cast<TArgs&&> (Args)...);
+	}
+
+	/// \return Current fill level, to be passed to Release() later
+	size_t GetMark (void) const		{ return m_nOffset; }
+	/// \brief Free all memory blocks, which have been allocated after GetMark()
+	void Release (size_t nMark);
+	/// \brief Free all memory blocks
+	void Reset (void)			{ Release (0); }
+
+	/// \return Size of the region (0 if the heap allocation failed)
+	size_t GetSize (void) const		{ return m_nSize; }
+	/// \return Number of free bytes in the region
+	size_t GetFreeSpace (void) const	{ return m_nSize - m_nOffset; }
+	/// \return Maximum fill level since construction (to adjust the region size)
+	size_t GetPeakUsage (void) const	{ return m_nPeakOffset; }
+
+private:
+	CArena (const CArena &);
+	CArena &operator= (const CArena &);
+
+private:
+	u8     *m_pBuffer;
+	size_t  m_nSize;
+	boolean m_bOwnBuffer;
+
+	size_t  m_nOffset;
+	size_t  m_nPeakOffset;
+};
+
+class CArenaScope	/// Releases all arena allocations done during its lifetime
+{
+public:
+	CArenaScope (CArena *pArena)
+	:	m_pArena (pArena),
+		m_nMark (pArena->GetMark ())
+	{
+	}
+
+	~CArenaScope (void)
+	{
+		m_pArena->Release (m_nMark);
+	}
+
+private:
+	CArena *m_pArena;
+	size_t  m_nMark;
+};
+
+#endif
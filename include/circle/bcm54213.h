@@ -8,7 +8,7 @@
 //	Licensed under GPLv2
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2019-2020  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2019-2024  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -38,6 +38,7 @@ struct TGEnetCB				// buffer control block
 {
 	uintptr		bd_addr;	// address of HW buffer descriptor
 	u8		*buffer;	// pointer to frame buffer (DMA address)
+	void		*param;		// Rx: pParam of a buffer of the net stack, 0 for own buffers
 };
 
 struct TGEnetTxRing			// ring of Tx buffers
@@ -82,10 +83,20 @@ public:
 	// returns TRUE if TX ring has currently free buffers
 	boolean IsSendFrameAdvisable (void);
 
+	// checksum offload and scatter-gather are supported
+	unsigned GetFeatures (void);
+
 	boolean SendFrame (const void *pBuffer, unsigned nLength);
+	// the parts are gathered directly into the DMA buffer
+	boolean SendFrameParts (const TNetFramePart *pParts, unsigned nParts);
+	// the producer index is updated once for all frames
+	unsigned SendFrames (const TNetTxFrame *pFrames, unsigned nFrames);
 
 	// pBuffer must have size FRAME_BUFFER_SIZE
 	boolean ReceiveFrame (void *pBuffer, unsigned *pResultLength);
+	// the consumer index is updated once for all frames, the buffers of the
+	// frames are exchanged with the buffers on the Rx ring (zero copy)
+	unsigned ReceiveFrames (TNetRxFrame *pFrames, unsigned nMaxFrames);
 
 	// returns TRUE if PHY link is up
 	boolean IsLinkUp (void);
@@ -131,7 +142,9 @@ private:
 	// Tx queues, rings and buffers
 	void init_tx_queues (bool enable);
 	void init_tx_ring(unsigned index, unsigned size, unsigned start_ptr, unsigned end_ptr);
+	TGEnetTxRing *get_tx_ring(void);
 	TGEnetCB *get_txcb(TGEnetTxRing *ring);
+	void tx_set_buffer(TGEnetTxRing *ring, u8 *buffer, unsigned length);
 	unsigned tx_reclaim(TGEnetTxRing *ring);
 	void free_tx_cb(TGEnetCB *cb);
 
@@ -140,7 +153,7 @@ private:
 	int init_rx_ring(unsigned index, unsigned size, unsigned start_ptr, unsigned end_ptr);
 	int alloc_rx_buffers(TGEnetRxRing *ring);
 	void free_rx_buffers(void);
-	u8 *rx_refill(TGEnetCB *cb);
+	void rx_set_buffer(TGEnetCB *cb, u8 *buffer, void *param);
 	u8 *free_rx_cb(TGEnetCB *cb);
 
 	// Helpers
@@ -182,6 +195,11 @@ private:
 	TGEnetCB *m_rx_cbs;				// Rx control blocks
 	TGEnetRxRing m_rx_rings[GENET_DESC_INDEX+1];	// Rx rings
 
+	// own Rx buffers, which have been passed to the net stack in the last ReceiveFrames()
+#define GENET_RX_RETIRED_MAX	16
+	u8 *m_pRxRetired[GENET_RX_RETIRED_MAX];
+	unsigned m_nRxRetired;
+
 	boolean m_crc_fwd_en;		// has FCS to be removed?
 
 	// PHY status
@@ -4,7 +4,7 @@
 // Class-specific allocator support
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2017-2022  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2017-2024  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -36,6 +36,11 @@
 		static void InitAllocator (unsigned nReservedObjects);		\
 		static void InitProtectedAllocator (unsigned nReservedObjects,	\
 						    unsigned nTargetLevel);	\
+		static void InitLockFreeAllocator (unsigned nReservedObjects);	\
+		static const CClassAllocator *GetClassAllocator (void)		\
+		{								\
+			return s_pAllocator;					\
+		}								\
 	private:								\
 		static CClassAllocator *s_pAllocator;
 
@@ -77,6 +82,19 @@
 		else							\
 			s_pAllocator->Extend (nReservedObjects,		\
 					      nTargetLevel);		\
+	}								\
+	void class::InitLockFreeAllocator (unsigned nReservedObjects)	\
+	{								\
+		if (s_pAllocator == 0)					\
+		{							\
+			s_pAllocator = new CClassAllocator (		\
+						sizeof (class),		\
+						nReservedObjects,	\
+						#class, TRUE);		\
+			assert (s_pAllocator != 0);			\
+		}							\
+		else							\
+			s_pAllocator->Extend (nReservedObjects);	\
 	}
 
 // call this somewhere before the class is instantiated
@@ -85,13 +103,18 @@
 // initializes an allocator which is protected by a spin lock
 #define INIT_PROTECTED_CLASS_ALLOCATOR(class, objects, level) \
 	class::InitProtectedAllocator (objects, level)
+// initializes an allocator with a lock-free free list, which can be used
+// from any execution level (incl. FIQ) without disabling interrupts
+#define INIT_LOCKFREE_CLASS_ALLOCATOR(class, objects) \
+	class::InitLockFreeAllocator (objects)
 
 class CClassAllocator
 {
 public:
 	CClassAllocator (size_t      nObjectSize,
 			 unsigned    nReservedObjects,
-			 const char *pClassName);
+			 const char *pClassName,
+			 boolean     bLockFree = FALSE);
 
 	CClassAllocator (size_t      nObjectSize,
 			 unsigned    nReservedObjects,
@@ -105,10 +128,18 @@ public:
 	void Free (void *pBlock);
 
 	void Extend (unsigned nReservedObjects, unsigned nTargetLevel);
+	void Extend (unsigned nReservedObjects);		// for lock-free allocator
+
+	unsigned GetReservedObjects (void) const	{ return m_nReservedObjects; }
+	unsigned GetAllocatedObjects (void) const;
+	unsigned GetMaxAllocatedObjects (void) const;	// high-water mark
 
 private:
 	void Init (size_t nObjectSize, unsigned nReservedObjects);
 
+	void PushLockFree (struct TBlock *pBlock);
+	struct TBlock *PopLockFree (void);
+
 private:
 	size_t      m_nObjectSize;
 	unsigned    m_nReservedObjects;
@@ -120,6 +151,12 @@ private:
 	boolean   m_bProtected;
 	unsigned  m_nTargetLevel;
 	CSpinLock m_SpinLock;
+
+	boolean   m_bLockFree;
+	volatile u64 m_nTaggedFreeList;		// pointer and ABA tag, if m_bLockFree
+
+	volatile int m_nAllocatedObjects;
+	volatile int m_nMaxAllocatedObjects;
 };
 
 #endif
@@ -23,18 +23,43 @@
 #include <circle/spinlock.h>
 #include <circle/synchronize.h>
 #include <circle/sysconfig.h>
+#include <circle/memorymap.h>
 #include <circle/macros.h>
+#include <circle/string.h>
 #include <circle/types.h>
 #include <assert.h>
 
 //#define HEAP_DEBUG
 
-ASSERT_STATIC (DATA_CACHE_LINE_LENGTH_MAX >= 16);
-
 #define HEAP_BLOCK_ALIGN	DATA_CACHE_LINE_LENGTH_MAX
 #define HEAP_ALIGN_MASK		(HEAP_BLOCK_ALIGN-1)
 
-#define HEAP_BLOCK_MAX_BUCKETS	20
+ASSERT_STATIC (HEAP_BLOCK_ALIGN > 20);		// see THeapBlockHeader::Align[]
+
+#define HEAP_BLOCK_MAX_BUCKETS	64
+
+#define HEAP_BLOCK_MAX_SIZE	0x80000000U	// larger requests fail (block size is u32)
+
+// generated bucket sizes, if HEAP_BLOCK_BUCKET_SIZES is not defined
+#define HEAP_BLOCK_SIZE_STEP	64		// linear steps up to HEAP_BLOCK_LINEAR_MAX
+#define HEAP_BLOCK_LINEAR_MAX	512		// followed by 4 steps per power of 2
+#define HEAP_BLOCK_BUCKET_MAX	0x80000		// up to this size
+
+#if defined (ARM_ALLOW_MULTI_CORE) && defined (HEAP_CORE_CACHE) && !defined (HEAP_DEBUG)
+	#define HEAP_USE_CORE_CACHE
+#endif
+
+#ifdef HEAP_TRACE
+	#define HEAP_CALLER	((uintptr) __builtin_return_address (0))
+#else
+	#define HEAP_CALLER	0
+#endif
+
+#define HEAP_TRACE_MAX_SITES	256		// distinct allocation sites per report (power of 2)
+
+#define HEAP_CACHE_MAX_BLOCK_SIZE	0x1000	// larger blocks are not cached
+#define HEAP_CACHE_MAX_BLOCKS		32	// per core and bucket
+#define HEAP_CACHE_BATCH		16	// blocks moved at once from/to the bucket
 
 struct THeapBlockHeader
 {
@@ -45,11 +70,22 @@ struct THeapBlockHeader
 #if AARCH == 32
 	u32			 nPadding;
 #endif
-	u8			 Align[HEAP_BLOCK_ALIGN-16];
+	u32			 nRequestedSize;	// for statistics
+	u8			 Align[HEAP_BLOCK_ALIGN-20];
 	u8			 Data[0];
 }
 PACKED;
 
+ASSERT_STATIC (sizeof (THeapBlockHeader) == HEAP_BLOCK_ALIGN);
+
+struct THeapBlockCounters
+{
+	unsigned		 nBlocks;		// allocated blocks
+	size_t			 nAllocatedBytes;	// size of allocated blocks
+	size_t			 nRequestedBytes;	// requested size of allocated blocks
+	u64			 nAllocations;		// total number of allocations
+};
+
 struct THeapBlockBucket
 {
 	u32			 nSize;
@@ -58,6 +94,61 @@ struct THeapBlockBucket
 	unsigned		 nMaxCount;
 #endif
 	THeapBlockHeader	*pFreeList;
+	THeapBlockCounters	 Counters;
+};
+
+#ifdef HEAP_USE_CORE_CACHE
+
+struct THeapBlockCache		// free blocks, which are owned by one core
+{
+	THeapBlockHeader	*pFreeList[HEAP_BLOCK_MAX_BUCKETS];
+	unsigned		 nCount[HEAP_BLOCK_MAX_BUCKETS];
+	THeapBlockCounters	 Counters[HEAP_BLOCK_MAX_BUCKETS];	// deltas of this core
+}
+ALIGN (DATA_CACHE_LINE_LENGTH_MAX);
+
+#endif
+
+#ifdef HEAP_TRACE
+
+struct THeapTraceEntry
+{
+	uintptr			 nBlock;		// address of the block data, 0 if unused
+	uintptr			 nCaller;		// return address of the allocation call
+	unsigned		 nTime;			// uptime in seconds at allocation
+};
+
+#endif
+
+struct THeapTraceSite
+{
+	uintptr			 nCaller;		// 0 for the remaining sites
+	unsigned		 nBlocks;		// number of blocks in use from this site
+	size_t			 nBytes;		// size of these blocks
+	unsigned		 nOldestTime;		// allocation time of the oldest block
+};
+
+struct THeapBucketStatistics
+{
+	size_t			 nBlockSize;		// 0 for large blocks (> largest bucket)
+	unsigned		 nAllocatedBlocks;	// currently in use
+	size_t			 nAllocatedBytes;	// size of the blocks in use
+	size_t			 nRequestedBytes;	// requested by the callers for the blocks in use
+	size_t			 nWastedBytes;		// internal fragmentation (allocated - requested)
+	u64			 nAllocations;		// total number of allocations
+};
+
+struct THeapStatistics
+{
+	size_t			 nHeapSize;		// size of the memory region
+	size_t			 nFreeSpace;		// not allocated by blocks (see GetFreeSpace())
+	size_t			 nLiveBytes;		// size of all blocks in use
+	size_t			 nPeakBytes;		// maximum space ever taken from the region
+	size_t			 nLargestFreeBlock;	// largest contiguous free region
+	unsigned		 nFailedAllocations;
+
+	unsigned		 nBuckets;		// number of valid entries in Bucket[]
+	THeapBucketStatistics	 Bucket[HEAP_BLOCK_MAX_BUCKETS+1];	// last one for large blocks
 };
 
 class CHeapAllocator	/// Allocates blocks from a flat memory region
@@ -79,34 +170,98 @@ public:
 	size_t GetFreeSpace (void) const;
 
 	/// \param nSize Block size to be allocated
+	/// \param nCaller Address of the allocation site for HEAP_TRACE (0 for direct caller)
 	/// \return Pointer to new allocated block (0 if heap is full or not set-up)
 	/// \note Resulting block is always 16 bytes aligned
+	/// \note Requests bigger than HEAP_BLOCK_MAX_SIZE are handled like a full heap.
 	/// \note If nReserve in Setup() is non-zero, the system panics if heap is full.
-	void *Allocate (size_t nSize);
+	void *Allocate (size_t nSize, uintptr nCaller = 0);
 
 	/// \param pBlock Memory block to be reallocated
 	/// \param nSize  New block size
+	/// \param nCaller Address of the allocation site for HEAP_TRACE (0 for direct caller)
 	/// \return Pointer to new block (block contents has been copied, if the block has moved)
-	void *ReAllocate (void *pBlock, size_t nSize);
+	void *ReAllocate (void *pBlock, size_t nSize, uintptr nCaller = 0);
 
 	/// \param pBlock Memory block to be freed
-	/// \note Memory space of blocks, which are bigger than the largest bucket size,\n
-	///	  cannot be returned to a free list and is lost.
+	/// \note Blocks, which are bigger than the largest bucket size, are returned to an\n
+	///	  address-ordered free list, where they are merged with adjacent free blocks.
 	void Free (void *pBlock);
 
+	/// \param pStatistics Heap statistics and block statistics per bucket are returned here
+	/// \note Counters of concurrent allocations may be slightly inconsistent.\n
+	///	  This is always available and is cheap enough to be called periodically.
+	void GetStatistics (THeapStatistics *pStatistics);
+
 #ifdef HEAP_DEBUG
 	void DumpStatus (void);
 #endif
 
+#ifdef HEAP_TRACE
+	/// \param pSites Allocation sites with most bytes in use are returned here
+	/// \param nMaxSites Size of the pSites array
+	/// \return Number of valid entries in pSites, sorted by decreasing nBytes
+	/// \note An entry with nCaller == 0 collects sites, which did not fit into the report.
+	unsigned GetTraceSites (THeapTraceSite *pSites, unsigned nMaxSites);
+
+	/// \brief Write report of the top allocation sites to the logger
+	void DumpTrace (unsigned nMaxSites = 20);
+
+	/// \brief Append report of the top allocation sites to a string
+	void FormatTraceReport (CString *pReport, unsigned nMaxSites = 20);
+#endif
+
+private:
+	unsigned GetBucketIndex (size_t nSize) const;	// returns m_nBuckets for large blocks
+	unsigned GetBlockBucket (const THeapBlockHeader *pBlockHeader) const;
+	void CountAllocate (THeapBlockCounters *pCounters, const THeapBlockHeader *pBlockHeader);
+	void CountFree (THeapBlockCounters *pCounters, const THeapBlockHeader *pBlockHeader);
+
+#ifdef HEAP_USE_CORE_CACHE
+	void *CacheAllocate (unsigned nBucket, size_t nRequestedSize);
+	void CacheFree (unsigned nBucket, THeapBlockHeader *pBlockHeader);
+#endif
+
+	void *AllocationFailed (void);				// m_SpinLock must be held, releases it
+
+	THeapBlockHeader *AllocateLarge (size_t nSize);		// m_SpinLock must be held
+	void FreeLarge (THeapBlockHeader *pBlockHeader);	// m_SpinLock must be held
+
+#ifdef HEAP_TRACE
+	void TraceInsert (void *pBlock, uintptr nCaller);
+	void TraceRemove (void *pBlock);
+	static unsigned TraceHash (uintptr nValue, unsigned nMask);
+#endif
+
 private:
 	const char	*m_pHeapName;
+	u8		*m_pBase;
 	u8		*m_pNext;
 	u8		*m_pLimit;
+	u8		*m_pHighWater;
 	size_t	 	 m_nReserve;
+	unsigned	 m_nFailedAllocations;
+	unsigned	 m_nBuckets;
 	THeapBlockBucket m_Bucket[HEAP_BLOCK_MAX_BUCKETS+1];
+	u8		 m_uchBucketIndex[sizeof (unsigned long)*8+1];	// by bit length of size-1
+	THeapBlockHeader *m_pLargeFreeList;		// sorted by address
 	CSpinLock	 m_SpinLock;
 
+#ifdef HEAP_USE_CORE_CACHE
+	THeapBlockCache	 m_Cache[CORES];
+#endif
+
+#ifdef HEAP_TRACE
+	THeapTraceEntry	 m_TraceTable[HEAP_TRACE_ENTRIES];	// open addressing, linear probing
+	unsigned	 m_nTraceEntries;
+	unsigned	 m_nTraceDropped;			// table was full
+	THeapTraceSite	 m_TraceSites[HEAP_TRACE_MAX_SITES];	// work area for reports
+	CSpinLock	 m_TraceSpinLock;
+#endif
+
+#ifdef HEAP_BLOCK_BUCKET_SIZES
 	static u32 s_nBucketSize[];
+#endif
 };
 
 #endif
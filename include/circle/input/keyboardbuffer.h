@@ -22,11 +22,10 @@
 
 #include <circle/device.h>
 #include <circle/usb/usbkeyboard.h>
-#include <circle/spinlock.h>
+#include <circle/ringbuffer.h>
 #include <circle/types.h>
 
 #define KEYB_BUF_SIZE		64			// must be a power of 2
-#define KEYB_BUF_MASK		(KEYB_BUF_SIZE-1)
 
 class CKeyboardBuffer : public CDevice
 {
@@ -37,21 +36,14 @@ public:
 	int Read (void *pBuffer, size_t nCount);
 
 private:
-	void InBuf (char chChar);
-	boolean BufStat (void) const;
-	char OutBuf (void);				// returns '\0' if no key is waiting
-
 	void KeyPressedHandler (const char *pString);
 	static void KeyPressedStub (const char *pString);
 
 private:
 	CUSBKeyboardDevice *m_pKeyboard;
 
-	char 	 m_Buffer[KEYB_BUF_SIZE];
-	unsigned m_nInPtr;
-	unsigned m_nOutPtr;
-
-	CSpinLock m_SpinLock;
+	// filled by the key pressed handler and emptied by Read() without locking
+	TRingBuffer<char, KEYB_BUF_SIZE> m_Buffer;
 
 	static CKeyboardBuffer *s_pThis;
 };
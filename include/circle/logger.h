@@ -24,12 +24,13 @@
 #include <circle/timer.h>
 #include <circle/stdarg.h>
 #include <circle/spinlock.h>
+#include <circle/ringbuffer.h>
 #include <circle/time.h>
 #include <circle/types.h>
 
 #define LOG_MAX_SOURCE		50
 #define LOG_MAX_MESSAGE		200
-#define LOG_QUEUE_SIZE		50
+#define LOG_QUEUE_SIZE		64		// must be a power of 2
 
 #define LOGGER_BUFSIZE		0x4000		///< Size of the text ring buffer
 
@@ -121,10 +122,8 @@ private:
 	unsigned m_nOutPtr;
 	CSpinLock m_SpinLock;
 
-	TLogEvent *m_pEventQueue[LOG_QUEUE_SIZE];
-	unsigned m_nEventInPtr;
-	unsigned m_nEventOutPtr;
-	CSpinLock m_EventSpinLock;
+	// written from any core and execution level, read by ReadEvent() only
+	TMultiProducerRingBuffer<TLogEvent *, LOG_QUEUE_SIZE> m_EventQueue;
 
 	TLogEventNotificationHandler *m_pEventNotificationHandler;
 	TLogPanicHandler *m_pPanicHandler;
@@ -61,7 +61,7 @@ public:
 	static CMemorySystem *Get (void);
 
 public:
-	static void *HeapAllocate (size_t nSize, int nType)
+	static void *HeapAllocate (size_t nSize, int nType, uintptr nCaller = 0)
 #define HEAP_LOW	0		// memory below 1 GB
 #define HEAP_HIGH	1		// memory above 1 GB
 #define HEAP_ANY	2		// high memory (if available) or low memory (otherwise)
@@ -72,36 +72,37 @@ public:
 
 		switch (nType)
 		{
-		case HEAP_LOW:	return s_pThis->m_HeapLow.Allocate (nSize);
-		case HEAP_HIGH: return s_pThis->m_HeapHigh.Allocate (nSize);
-		case HEAP_ANY:	return   (pBlock = s_pThis->m_HeapHigh.Allocate (nSize)) != 0
+		case HEAP_LOW:	return s_pThis->m_HeapLow.Allocate (nSize, nCaller);
+		case HEAP_HIGH: return s_pThis->m_HeapHigh.Allocate (nSize, nCaller);
+		case HEAP_ANY:	return   (pBlock = s_pThis->m_HeapHigh.Allocate (nSize, nCaller)) != 0
 				       ? pBlock
-				       : s_pThis->m_HeapLow.Allocate (nSize);
+				       : s_pThis->m_HeapLow.Allocate (nSize, nCaller);
 		default:	return 0;
 		}
 #else
 		switch (nType)
 		{
 		case HEAP_LOW:
-		case HEAP_ANY:	return s_pThis->m_HeapLow.Allocate (nSize);
+		case HEAP_ANY:	return s_pThis->m_HeapLow.Allocate (nSize, nCaller);
 		default:	return 0;
 		}
 #endif
 	}
 
-	static void *HeapReAllocate (void *pBlock, size_t nSize)	// pBlock may be 0
+	static void *HeapReAllocate (void *pBlock, size_t nSize,	// pBlock may be 0
+				     uintptr nCaller = 0)
 	{
 #if RASPPI >= 4
 		if ((uintptr) pBlock < MEM_HIGHMEM_START)
 		{
-			return s_pThis->m_HeapLow.ReAllocate (pBlock, nSize);
+			return s_pThis->m_HeapLow.ReAllocate (pBlock, nSize, nCaller);
 		}
 		else
 		{
-			return s_pThis->m_HeapHigh.ReAllocate (pBlock, nSize);
+			return s_pThis->m_HeapHigh.ReAllocate (pBlock, nSize, nCaller);
 		}
 #else
-		return s_pThis->m_HeapLow.ReAllocate (pBlock, nSize);
+		return s_pThis->m_HeapLow.ReAllocate (pBlock, nSize, nCaller);
 #endif
 	}
 
@@ -142,9 +143,51 @@ public:
 #endif
 	}
 
+	/// \param pStatistics Statistics of the heap are returned here
+	/// \param nType HEAP_LOW, HEAP_HIGH or HEAP_DMA30
+	/// \return FALSE, if this heap is not available
+	static boolean GetHeapStatistics (THeapStatistics *pStatistics, int nType)
+	{
+		switch (nType)
+		{
+		case HEAP_LOW:
+			s_pThis->m_HeapLow.GetStatistics (pStatistics);
+			return TRUE;
+
+#if RASPPI >= 4
+		case HEAP_HIGH:
+			if (s_pThis->m_nMemSizeHigh == 0)
+			{
+				return FALSE;
+			}
+			s_pThis->m_HeapHigh.GetStatistics (pStatistics);
+			return TRUE;
+#endif
+
+		default:
+			return FALSE;
+		}
+	}
+
+	/// \param pStatistics Statistics of the page allocator are returned here
+	static void GetPageStatistics (TPageStatistics *pStatistics)
+	{
+		s_pThis->m_Pager.GetStatistics (pStatistics);
+	}
+
 	static void *PageAllocate (void)	{ return s_pThis->m_Pager.Allocate (); }
+	static void *PageAllocateBlock (unsigned nOrder)
+						{ return s_pThis->m_Pager.AllocateBlock (nOrder); }
 	static void PageFree (void *pPage)	{ s_pThis->m_Pager.Free (pPage); }
 
+#if AARCH == 64
+	/// \brief Allow or deny any access to a memory page (e.g. a stack guard page)
+	/// \param pPage Address of the page (aligned to PAGE_SIZE)
+	/// \param bAccess FALSE to cause a data abort on each access to this page
+	/// \return Operation successful? (FALSE, if the MMU is not enabled)
+	static boolean SetPageAccess (void *pPage, boolean bAccess);
+#endif
+
 	static void DumpStatus (void)
 	{
 #ifdef HEAP_DEBUG
@@ -159,6 +202,47 @@ public:
 #endif
 	}
 
+#ifdef HEAP_TRACE
+	/// \brief Write the top allocation sites by live bytes of all heaps to the logger
+	static void DumpHeapTrace (unsigned nMaxSites = 20)
+	{
+		s_pThis->m_HeapLow.DumpTrace (nMaxSites);
+#if RASPPI >= 4
+		if (s_pThis->m_nMemSizeHigh > 0)
+		{
+			s_pThis->m_HeapHigh.DumpTrace (nMaxSites);
+		}
+#endif
+	}
+
+	/// \param pReport Report of the top allocation sites by live bytes is appended here
+	/// \param nType HEAP_LOW, HEAP_HIGH or HEAP_DMA30
+	/// \param nMaxSites Maximum number of reported sites
+	/// \return FALSE, if this heap is not available
+	static boolean GetHeapTraceReport (CString *pReport, int nType, unsigned nMaxSites = 20)
+	{
+		switch (nType)
+		{
+		case HEAP_LOW:
+			s_pThis->m_HeapLow.FormatTraceReport (pReport, nMaxSites);
+			return TRUE;
+
+#if RASPPI >= 4
+		case HEAP_HIGH:
+			if (s_pThis->m_nMemSizeHigh == 0)
+			{
+				return FALSE;
+			}
+			s_pThis->m_HeapHigh.FormatTraceReport (pReport, nMaxSites);
+			return TRUE;
+#endif
+
+		default:
+			return FALSE;
+		}
+	}
+#endif
+
 private:
 	void EnableMMU (void);
 
@@ -2,7 +2,7 @@
 // checksumcalculator.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2015-2024  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -48,11 +48,25 @@ public:
 	
 	u16 Calculate (const void *pBuffer, unsigned nLength);
 
+	// returns the folded, not complemented sum of the pseudo header only, which is
+	// stored in the checksum field, when the net device completes the checksum
+	u16 CalculatePseudoHeader (unsigned nLength);
+
 	static u16 SimpleCalculate (const void *pBuffer, unsigned nLength);
 
+	// incremental update of a checksum, when a 16-bit word of the data has been
+	// modified (RFC 1624), all values are in the byte order as stored in memory
+	static u16 Update (u16 nChecksum, u16 nOldWord, u16 nNewWord);
+
+	// the same for a modified field of even length at an even offset (e.g. IP address)
+	static u16 Update (u16 nChecksum, const void *pOldField, const void *pNewField,
+			   unsigned nLength);
+
 private:
 	static u32 CalculateChunk (const void *pBuffer, unsigned nLength, u32 nChecksum);
 
+	static u64 SumWords (const u8 *pBuffer, unsigned nLength);
+
 	static u16 FoldResult (u32 nChecksum);
 	
 private:
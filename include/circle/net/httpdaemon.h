@@ -2,7 +2,7 @@
 // httpdaemon.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015-2021  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2015-2024  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -25,6 +25,7 @@
 #include <circle/net/http.h>
 #include <circle/net/socket.h>
 #include <circle/net/ipaddress.h>
+#include <circle/arena.h>
 #include <circle/types.h>
 
 class CHTTPDaemon : public CTask
@@ -75,13 +76,18 @@ private:
 	void *Search (const void *pBuffer, unsigned nBufLen,
 		      const void *pNeedle, unsigned nNeedleLen);
 
+	// compose text without a heap allocation, truncated at pEnd
+	static void AppendString (char **ppDest, const char *pEnd, const char *pString);
+	static void AppendNumber (char **ppDest, const char *pEnd, unsigned nNumber);
+
 private:
 	CNetSubSystem *m_pNetSubSystem;
 	CSocket	      *m_pSocket;
 	unsigned       m_nMaxContentSize;
 	u16	       m_nPort;
 	unsigned       m_nMaxMultipartSize;
-	
+
+	CArena m_Arena;					// all per-request buffers of a worker
 	u8 *m_pContentBuffer;
 
 	// from request
@@ -98,7 +104,7 @@ private:
 	boolean m_bMultipartFormDataAvailable;		// multipart form data is available
 	char m_MultipartBoundary[HTTP_MAX_MULTIPART_BOUNDARY+1]; // boundary string
 	unsigned m_nMultipartContentLength;		// total length of multipart form data
-	char *m_pMultipartBuffer;			// pointer to allocated multipart buffer
+	char *m_pMultipartBuffer;			// pointer to multipart buffer in m_Arena
 	char *m_pMultipartPointer;			// pointer into allocated multipart buffer
 
 	static unsigned s_nInstanceCount;
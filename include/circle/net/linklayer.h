@@ -26,6 +26,7 @@
 #include <circle/net/ipaddress.h>
 #include <circle/macaddress.h>
 #include <circle/net/netqueue.h>
+#include <circle/net/netbuffer.h>
 #include <circle/macros.h>
 #include <circle/types.h>
 
@@ -59,6 +60,17 @@ public:
 	// pBuffer must have size FRAME_BUFFER_SIZE
 	boolean Receive (void *pBuffer, unsigned *pResultLength);
 
+	// zero-copy interface, Send() takes over the reference of the caller in any case
+	boolean Send (const CIPAddress &rReceiver, CNetBuffer *pIPPacket);
+	// returns 0 if no packet is available, the caller has to Release() the buffer
+	CNetBuffer *Receive (void);
+	// returns the number of packets written to ppBuffers, which have to be released
+	unsigned Receive (CNetBuffer **ppBuffers, unsigned nMaxBuffers);
+
+	unsigned GetRxDropped (void) const;		// frames dropped, because a RX queue was full
+
+	unsigned GetDeviceFeatures (void) const;	// NET_DEVICE_FEATURE_* of the net device
+
 public:
 	boolean SendRaw (const void *pFrame, unsigned nLength);
 
@@ -5,7 +5,7 @@
 //	https://github.com/marvinroger/async-mqtt-client
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2018  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2018-2024  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -29,6 +29,7 @@
 #include <circle/net/mqttreceivepacket.h>
 #include <circle/net/netsubsystem.h>
 #include <circle/net/socket.h>
+#include <circle/arena.h>
 #include <circle/ptrlist.h>
 #include <circle/string.h>
 #include <circle/timer.h>
@@ -167,6 +168,10 @@ private:
 
 	boolean SendPacket (CMQTTSendPacket *pPacket);
 
+	// scratch memory for a non-queued packet, 0 if in use (take the heap then)
+	CArena *ClaimPacketArena (void);
+	void ReleasePacketArena (CArena *pArena);
+
 	// retransmission queue (for sender)
 	void InsertPacketIntoQueue (CMQTTSendPacket *pPacket, unsigned nScheduledTime);
 	CMQTTSendPacket *RemovePacketFromQueue (u16 usPacketIdentifier);
@@ -199,6 +204,9 @@ private:
 
 	CMQTTReceivePacket m_ReceivePacket;
 
+	CArena m_PacketArena;			// for Connect() and Publish() with QoS 0
+	boolean m_bPacketArenaInUse;		// by one task at a time only
+
 	CPtrList m_RetransmissionQueue;		// sorted according to time
 	CPtrList m_PacketIdentifierStore;	// for QoS 2 receiving PUBLISH
 
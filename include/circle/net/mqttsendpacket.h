@@ -2,7 +2,7 @@
 // mqttsendpacket.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2018  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2018-2024  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -22,14 +22,24 @@
 
 #include <circle/net/mqtt.h>
 #include <circle/net/socket.h>
+#include <circle/arena.h>
 #include <circle/types.h>
 
 class CMQTTSendPacket		/// MQTT helper class
 {
 public:
-	CMQTTSendPacket (TMQTTPacketType Type, size_t nMaxPacketSize = 128);
+	// the packet buffer is allocated from pArena, if given and space is left,
+	// from the heap otherwise
+	CMQTTSendPacket (TMQTTPacketType Type, size_t nMaxPacketSize = 128, CArena *pArena = 0);
 	~CMQTTSendPacket (void);
 
+	// allocates the packet and its buffer with a single heap allocation,
+	// the returned packet can be deleted as usual
+	static CMQTTSendPacket *Create (TMQTTPacketType Type, size_t nMaxPacketSize);
+
+	// frees packets from the constructor and from Create() the same way
+	static void operator delete (void *pBlock);
+
 	void SetFlags (u8 uchFlags);
 
 	void AppendByte (u8 uchValue);
@@ -60,6 +70,7 @@ private:
 	boolean m_bError;
 
 	u8 *m_pBuffer;
+	boolean m_bOwnBuffer;
 	unsigned m_nBufPtr;
 
 	u8 m_uchFlags;
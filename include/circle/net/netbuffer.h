@@ -0,0 +1,160 @@
+//
+/// \file netbuffer.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_net_netbuffer_h
+#define _circle_net_netbuffer_h
+
+#include <circle/netdevice.h>
+#include <circle/spinlock.h>
+#include <circle/synchronize.h>
+#include <circle/types.h>
+
+/// \brief Default headroom in front of a transport layer packet
+/// \note The IP and Ethernet headers (34 bytes) are added in front of the packet, so that
+///	  the frame starts 32 bytes into the buffer, aligned for net devices, which use DMA.
+#define NET_BUFFER_HEADROOM	66
+
+#define NET_BUFFER_SIZE		(NET_BUFFER_HEADROOM + FRAME_BUFFER_SIZE)
+
+struct TNetBufferStatistics
+{
+	unsigned nPoolSize;		///< Number of preallocated buffers
+	unsigned nPoolFree;		///< Number of currently free buffers in the pool
+	unsigned nPoolMinFree;		///< Low-water mark of nPoolFree
+	unsigned nHeapAllocations;	///< Number of buffers allocated from the heap (pool empty)
+};
+
+class CNetBuffer	/// Reference counted packet buffer, which is passed through the net stack by pointer
+			/// \details A received frame is written into the buffer by the net device
+			///	     directly (by DMA or USB transfer), if the device supports it.
+			///	     The layers strip their headers with RemoveHeader() and pass the
+			///	     buffer on, until the payload is copied to the user. On transmit the
+			///	     layers add their headers in front of the payload with AddHeader().
+			///	     Buffers are taken from a preallocated pool, if it has been set up
+			///	     with InitPool(). The heap is used, when the pool is empty.
+{
+public:
+	/// \brief Preallocate buffers, call this once before the net stack is started
+	/// \param nBuffers Number of buffers in the pool
+	/// \return Operation successful?
+	static boolean InitPool (unsigned nBuffers);
+
+	/// \param pStatistics Pointer to structure to be filled with the pool statistics
+	static void GetStatistics (TNetBufferStatistics *pStatistics);
+
+	/// \param nHeadroom Number of free bytes in front of the data
+	/// \return Pointer to new buffer with one reference and no data (0 on failure)
+	static CNetBuffer *Allocate (unsigned nHeadroom = NET_BUFFER_HEADROOM);
+
+	/// \param pData Data to be copied into the new buffer
+	/// \param nLength Length of the data (up to FRAME_BUFFER_SIZE)
+	/// \param nHeadroom Number of free bytes in front of the data
+	/// \return Pointer to new buffer with one reference (0 on failure)
+	static CNetBuffer *Allocate (const void *pData, unsigned nLength,
+				     unsigned nHeadroom = NET_BUFFER_HEADROOM);
+
+	/// \brief Take an additional reference to the buffer
+	void AddRef (void);
+	/// \brief Drop a reference, the buffer is freed with the last one
+	void Release (void);
+
+	/// \return Pointer to the first byte of the data
+	u8 *GetData (void)
+	{
+		return m_pData;
+	}
+
+	const u8 *GetData (void) const
+	{
+		return m_pData;
+	}
+
+	/// \return Length of the data in bytes
+	unsigned GetLength (void) const
+	{
+		return m_nLength;
+	}
+
+	/// \brief Set the length of the data (e.g. after writing it or to remove padding)
+	/// \param nLength New length (up to GetLength() + GetTailroom())
+	void SetLength (unsigned nLength);
+
+	/// \return Number of free bytes in front of the data
+	unsigned GetHeadroom (void) const
+	{
+		return m_pData - m_Buffer;
+	}
+
+	/// \return Number of free bytes behind the data
+	unsigned GetTailroom (void) const
+	{
+		return sizeof m_Buffer - GetHeadroom () - m_nLength;
+	}
+
+	/// \brief Extend the data to the front
+	/// \param nLength Length of the header to be added
+	/// \return Pointer to the header, which has to be filled (0 if the headroom is too small)
+	void *AddHeader (unsigned nLength);
+
+	/// \brief Remove a header from the front of the data
+	/// \param nLength Length of the header to be removed
+	/// \return FALSE, if the data is not longer than nLength
+	boolean RemoveHeader (unsigned nLength);
+
+	/// \return TRUE, if the net device has verified the IP header and TCP/UDP checksums
+	boolean IsChecksumVerified (void) const
+	{
+		return m_bChecksumVerified;
+	}
+
+	void SetChecksumVerified (boolean bVerified)
+	{
+		m_bChecksumVerified = bVerified;
+	}
+
+private:
+	CNetBuffer (unsigned nHeadroom);
+	~CNetBuffer (void);			// use Release()
+
+	static boolean IsPooled (const CNetBuffer *pBuffer);
+
+private:
+	volatile int m_nRefCount;
+	u8 *m_pData;
+	unsigned m_nLength;
+	boolean m_bChecksumVerified;
+
+	// used by CNetQueue, the buffer can be in one queue at a time only
+	CNetBuffer *m_pNext;
+	void *m_pParam;
+	friend class CNetQueue;
+
+	// cache-line aligned, so that a net device can receive into it using DMA
+	u8 m_Buffer[CACHE_ALIGN_SIZE (u8, NET_BUFFER_SIZE)] CACHE_ALIGN;
+
+	static CNetBuffer *s_pPool;
+	static unsigned s_nPoolSize;
+	static CNetBuffer *s_pFreeList;		// linked through m_pNext
+	static unsigned s_nPoolFree;
+	static unsigned s_nPoolMinFree;
+	static unsigned s_nHeapAllocations;
+	static CSpinLock s_PoolSpinLock;
+};
+
+#endif
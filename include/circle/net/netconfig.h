@@ -21,8 +21,17 @@
 #define _circle_net_netconfig_h
 
 #include <circle/net/ipaddress.h>
+#include <circle/seqlock.h>
 #include <circle/types.h>
 
+struct TNetConfigAddresses		// consistent copy, see CNetConfig::GetAddresses()
+{
+	CIPAddress IPAddress;
+	CIPAddress NetMask;
+	CIPAddress DefaultGateway;
+	CIPAddress BroadcastAddress;
+};
+
 class CNetConfig
 {
 public:
@@ -51,10 +60,17 @@ public:
 	const CIPAddress *GetDNSServer (void) const;
 	const CIPAddress *GetBroadcastAddress (void) const;		// directed broadcast
 
+	// The single addresses can be read with the methods above, but may change while
+	// another core reads them one after another. This returns a consistent set of
+	// addresses without taking a lock, so that it can be used in the packet path.
+	void GetAddresses (TNetConfigAddresses *pAddresses) const;
+
 private:
 	void UpdateBroadcastAddress (void);
 
 private:
+	CSeqLock m_SeqLock;			// for all addresses
+
 	boolean m_bUseDHCP;
 
 	CIPAddress m_IPAddress;
@@ -2,7 +2,7 @@
 // netconnection.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015-2018  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2015-2024  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -22,6 +22,7 @@
 
 #include <circle/net/netconfig.h>
 #include <circle/net/networklayer.h>
+#include <circle/net/netbuffer.h>
 #include <circle/net/ipaddress.h>
 #include <circle/net/icmphandler.h>
 #include <circle/net/checksumcalculator.h>
@@ -64,7 +65,8 @@ public:
 	virtual void Process (void) = 0;
 
 	// returns: -1: invalid packet, 0: not to me, 1: packet consumed
-	virtual int PacketReceived (const void *pPacket, unsigned nLength,
+	// a consumed packet may be kept with pPacket->AddRef() and modified then
+	virtual int PacketReceived (CNetBuffer *pPacket,
 				    CIPAddress &rSenderIP, CIPAddress &rReceiverIP, int nProtocol) = 0;
 
 	// returns: 0: not to me, 1: notification consumed
@@ -73,6 +75,11 @@ public:
 					  u16 nSendPort, u16 nReceivePort,
 					  int nProtocol) = 0;
 
+protected:
+	// calculates the TCP/UDP checksum of a packet to be sent (checksum field must be 0),
+	// only the pseudo header is summed up, if the net device completes the checksum
+	u16 CalculateTxChecksum (const void *pPacket, unsigned nLength);
+
 protected:
 	CNetConfig    *m_pNetConfig;
 	CNetworkLayer *m_pNetworkLayer;
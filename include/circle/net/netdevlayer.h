@@ -23,7 +23,9 @@
 #include <circle/net/netconfig.h>
 #include <circle/netdevice.h>
 #include <circle/net/netqueue.h>
+#include <circle/net/netbuffer.h>
 #include <circle/bcm54213.h>
+#include <circle/sysconfig.h>
 #include <circle/types.h>
 
 class CNetDeviceLayer
@@ -42,8 +44,24 @@ public:
 	void Send (const void *pBuffer, unsigned nLength);
 	boolean Receive (void *pBuffer, unsigned *pResultLength);
 
+	// zero-copy interface, Send() takes over the reference of the caller
+	void Send (CNetBuffer *pBuffer);
+	// returns 0 if no frame is available, the caller has to Release() the buffer
+	CNetBuffer *Receive (void);
+	// returns the number of frames written to ppBuffers, which have to be released
+	unsigned Receive (CNetBuffer **ppBuffers, unsigned nMaxBuffers);
+
 	boolean IsRunning (void) const;			// is net device available?
 
+	unsigned GetFeatures (void) const;		// NET_DEVICE_FEATURE_* of the net device
+
+	unsigned GetTxDropped (void) const;		// frames dropped, because TX queue was full
+	unsigned GetRxDropped (void) const;		// frames dropped, because RX queue was full
+
+	// the handler is called, when nHighWater received frames are waiting for the stack
+	void SetRxHighWaterHandler (unsigned nHighWater, TNetQueueHighWaterHandler *pHandler,
+				    void *pParam = 0);
+
 private:
 	TNetDeviceType m_DeviceType;
 	CNetConfig *m_pNetConfig;
@@ -52,6 +70,12 @@ private:
 	CNetQueue m_TxQueue;
 	CNetQueue m_RxQueue;
 
+	CNetBuffer *m_pTxBatch[NET_DEVICE_BATCH_SIZE];	// frames to be sent next
+	unsigned m_nTxBatchCount;
+
+	CNetBuffer *m_pRxBatch[NET_DEVICE_BATCH_SIZE];	// the next frames are received into these
+	unsigned m_nRxBatchCount;
+
 #if RASPPI >= 4
 	CBcm54213Device m_Bcm54213;
 #endif
@@ -20,29 +20,64 @@
 #ifndef _circle_net_netqueue_h
 #define _circle_net_netqueue_h
 
+#include <circle/net/netbuffer.h>
 #include <circle/spinlock.h>
 #include <circle/types.h>
 
-struct TNetQueueEntry;
+class CNetQueue;
+
+// called, when the number of queued entries reaches the high-water mark
+typedef void TNetQueueHighWaterHandler (CNetQueue *pQueue, void *pParam);
 
 class CNetQueue
 {
 public:
-	CNetQueue (void);
+	CNetQueue (unsigned nMaxEntries = 0);		// 0 for no limit
 	~CNetQueue (void);
 
 	boolean IsEmpty (void) const;
 	
 	void Flush (void);
 	
-	void Enqueue (const void *pBuffer, unsigned nLength, void *pParam = 0);
+	// returns FALSE, if the queue is full or no buffer is available (the entry is dropped)
+	boolean Enqueue (const void *pBuffer, unsigned nLength, void *pParam = 0);
 
 	// returns length (0 if queue is empty)
 	unsigned Dequeue (void *pBuffer, void **ppParam = 0);
 
+	// zero-copy interface, the queue takes over the reference of the caller
+	// returns FALSE, if the queue is full (the buffer has been released then)
+	boolean EnqueueBuffer (CNetBuffer *pBuffer, void *pParam = 0);
+
+	// returns 0 if queue is empty, the caller has to Release() the buffer
+	CNetBuffer *DequeueBuffer (void **ppParam = 0);
+
+	// batch interface with one lock acquisition for multiple buffers (without pParam)
+	// returns the number of enqueued buffers, the others have been released (queue full)
+	unsigned EnqueueBuffers (CNetBuffer **ppBuffers, unsigned nBuffers);
+	// returns the number of buffers, which have been written to ppBuffers
+	unsigned DequeueBuffers (CNetBuffer **ppBuffers, unsigned nMaxBuffers);
+
+	unsigned GetCount (void) const;
+	unsigned GetMaxCount (void) const;		// maximum number of queued entries so far
+	unsigned GetDropped (void) const;		// number of entries dropped (queue full or no buffer)
+
+	// the handler is called from Enqueue(), when nHighWater entries are queued
+	void SetHighWaterHandler (unsigned nHighWater, TNetQueueHighWaterHandler *pHandler,
+				  void *pParam = 0);
+
 private:
-	volatile TNetQueueEntry *m_pFirst;
-	volatile TNetQueueEntry *m_pLast;
+	CNetBuffer *volatile m_pFirst;
+	CNetBuffer *m_pLast;
+
+	unsigned m_nMaxEntries;
+	volatile unsigned m_nCount;
+	unsigned m_nMaxCount;
+	unsigned m_nDropped;
+
+	unsigned m_nHighWater;
+	TNetQueueHighWaterHandler *m_pHighWaterHandler;
+	void *m_pHighWaterParam;
 
 	CSpinLock m_SpinLock;
 };
@@ -25,11 +25,21 @@
 #include <circle/net/linklayer.h>
 #include <circle/net/networklayer.h>
 #include <circle/net/transportlayer.h>
+#include <circle/net/netbuffer.h>
 #include <circle/string.h>
 #include <circle/types.h>
 
 #define DEFAULT_HOSTNAME	"raspberrypi"
 
+struct TNetStatistics
+{
+	TNetBufferStatistics BufferPool;
+	unsigned nTxDropped;		// frames dropped, because the TX queue was full
+	unsigned nRxDropped;		// frames dropped, because the device RX queue was full
+	unsigned nLinkRxDropped;	// frames dropped, because a link layer RX queue was full
+	unsigned nNetworkRxDropped;	// packets dropped, because a network layer RX queue was full
+};
+
 class CDHCPClient;
 
 class CNetSubSystem
@@ -54,6 +64,8 @@ public:
 
 	boolean IsRunning (void) const;			// is DHCP bound if used?
 
+	void GetStatistics (TNetStatistics *pStatistics) const;
+
 	static CNetSubSystem *Get (void);
 
 private:
@@ -23,6 +23,7 @@
 #include <circle/net/netconfig.h>
 #include <circle/net/linklayer.h>
 #include <circle/net/netqueue.h>
+#include <circle/net/netbuffer.h>
 #include <circle/net/ipaddress.h>
 #include <circle/net/icmphandler.h>
 #include <circle/net/routecache.h>
@@ -79,14 +80,26 @@ public:
 	boolean Receive (void *pBuffer, unsigned *pResultLength,
 			 CIPAddress *pSender, CIPAddress *pReceiver, int *pProtocol);
 
+	// zero-copy interface, Send() takes over the reference of the caller in any case
+	boolean Send (const CIPAddress &rReceiver, CNetBuffer *pPacket, int nProtocol);
+	// returns 0 if no packet is available, the caller has to Release() the buffer
+	CNetBuffer *Receive (CIPAddress *pSender, CIPAddress *pReceiver, int *pProtocol);
+
+	unsigned GetRxDropped (void) const;		// packets dropped, because a RX queue was full
+
+	unsigned GetDeviceFeatures (void) const;	// NET_DEVICE_FEATURE_* of the net device
+
 	boolean ReceiveNotification (TICMPNotificationType *pType,
 				     CIPAddress *pSender, CIPAddress *pReceiver,
 				     u16 *pSendPort, u16 *pReceivePort,
 				     int *pProtocol);
 
 private:
+	// returns FALSE, if the packet has to be dropped by the caller
+	boolean PacketReceived (CNetBuffer *pBuffer);
+
 	void AddRoute (const u8 *pDestIP, const u8 *pGatewayIP);
-	const u8 *GetGateway (const u8 *pDestIP) const;
+	CIPAddress GetGateway (const u8 *pDestIP) const;
 	friend class CICMPHandler;
 
 	// post IP packet to the ICMP handler for notification
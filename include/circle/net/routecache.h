@@ -21,6 +21,7 @@
 #define _circle_net_routecache_h
 
 #include <circle/ptrarray.h>
+#include <circle/rwspinlock.h>
 #include <circle/types.h>
 
 class CRouteCache
@@ -33,10 +34,14 @@ public:
 
 	void AddRoute (const u8 *pDestIP, const u8 *pGatewayIP);
 
-	const u8 *GetRoute (const u8 *pDestIP) const;
+	// copies the gateway IP address to pGatewayIP, returns FALSE if no route is known
+	boolean GetRoute (const u8 *pDestIP, u8 *pGatewayIP) const;
 
-public:
+private:
 	CPtrArray m_Cache;
+
+	// lookups are done in parallel, only changes are exclusive
+	mutable CRWSpinLock m_Lock;
 };
 
 #endif
@@ -88,7 +88,7 @@ public:
 	void Process (void);
 	
 	// returns: -1: invalid packet, 0: not to me, 1: packet consumed
-	int PacketReceived (const void *pPacket, unsigned nLength,
+	int PacketReceived (CNetBuffer *pPacket,
 			    CIPAddress &rSenderIP, CIPAddress &rReceiverIP, int nProtocol);
 
 	// returns: 0: not to me, 1: notification consumed
@@ -102,6 +102,9 @@ private:
 			     const void *pData = 0, unsigned nDataLength = 0);
 
 	void ScanOptions (TTCPHeader *pHeader);
+
+	// queues the data of a received segment, which is kept by reference
+	void QueueData (CNetBuffer *pSegment, unsigned nDataOffset);
 	
 	u32 CalculateISN (void);
 	
@@ -46,6 +46,32 @@ enum TNetDeviceSpeed
 	NetDeviceSpeedUnknown
 };
 
+// Features of a net device, returned by CNetDevice::GetFeatures()
+#define NET_DEVICE_FEATURE_RX_CHECKSUM		(1 << 0)	// verifies IPv4 TCP/UDP checksums
+#define NET_DEVICE_FEATURE_TX_CHECKSUM		(1 << 1)	// completes IPv4 TCP/UDP checksums
+#define NET_DEVICE_FEATURE_SCATTER_GATHER	(1 << 2)	// sends frames from parts w/o copy
+
+struct TNetFramePart
+{
+	const void *pData;
+	unsigned    nLength;
+};
+
+struct TNetTxFrame		// for CNetDevice::SendFrames()
+{
+	const void *pBuffer;
+	unsigned    nLength;
+};
+
+struct TNetRxFrame		// for CNetDevice::ReceiveFrames()
+{
+	void	   *pBuffer;	// set by the caller, must have size FRAME_BUFFER_SIZE
+	void	   *pParam;	// set by the caller, travels with pBuffer (see ReceiveFrames())
+	unsigned    nOffset;	// the frame starts at pBuffer + nOffset
+	unsigned    nLength;
+	boolean	    bChecksumOK;	// see ReceiveFrameChecked()
+};
+
 class CNetDevice	/// Base class (interface) of net devices
 {
 public:
@@ -54,6 +80,13 @@ public:
 	/// \return Type of this net device
 	virtual TNetDeviceType GetType (void)		{ return NetDeviceTypeEthernet; }
 
+	/// \return Bit mask of the NET_DEVICE_FEATURE_* features, supported by this device
+	/// \note With NET_DEVICE_FEATURE_TX_CHECKSUM the TCP/UDP checksum field of a sent IPv4\n
+	///	  frame contains the (not complemented) sum of the pseudo header, which has to be\n
+	///	  completed by the device. The IP header checksum is always valid. This applies\n
+	///	  to all IPv4 TCP/UDP frames sent to such a device, not only to those of the net stack.
+	virtual unsigned GetFeatures (void)		{ return 0; }
+
 	/// \return Pointer to a MAC address object, which holds our own address
 	virtual const CMACAddress *GetMACAddress (void) const = 0;
 
@@ -67,12 +100,54 @@ public:
 	/// \param nLength Frame length in bytes, does not need to be padded
 	virtual boolean SendFrame (const void *pBuffer, unsigned nLength) = 0;
 
+	/// \brief Send a valid Ethernet frame, which is composed of multiple parts
+	/// \param pParts Array of the parts, which are concatenated to the frame
+	/// \param nParts Number of parts
+	/// \note The default implementation copies the parts and calls SendFrame().\n
+	///	  Devices with NET_DEVICE_FEATURE_SCATTER_GATHER send the parts directly.
+	virtual boolean SendFrameParts (const TNetFramePart *pParts, unsigned nParts);
+
+	/// \brief Send multiple valid Ethernet frames at once
+	/// \param pFrames Array of frames
+	/// \param nFrames Number of frames
+	/// \return Number of frames from the start of the array, which have been sent
+	/// \note If not all frames have been sent, either the next frame has failed, or\n
+	///	  IsSendFrameAdvisable() returns FALSE and the remaining frames can be sent later.
+	/// \note The default implementation calls SendFrame() for each frame, until it fails\n
+	///	  or IsSendFrameAdvisable() returns FALSE.
+	virtual unsigned SendFrames (const TNetTxFrame *pFrames, unsigned nFrames);
+
 	/// \brief Poll for a received Ethernet frame
 	/// \param pBuffer Frame will be placed here, buffer must have size FRAME_BUFFER_SIZE
 	/// \param pResultLength Pointer to variable, which receives the valid frame length
 	/// \return TRUE if a frame is returned in buffer, FALSE if nothing has been received
 	virtual boolean ReceiveFrame (void *pBuffer, unsigned *pResultLength) = 0;
 
+	/// \brief Poll for a received Ethernet frame and get its checksum status
+	/// \param pBuffer Frame will be placed here, buffer must have size FRAME_BUFFER_SIZE
+	/// \param pResultLength Pointer to variable, which receives the valid frame length
+	/// \param pChecksumOK Pointer to variable, which is set to TRUE, if the frame is an IPv4\n
+	///	  TCP/UDP frame and the device has verified the IP header and TCP/UDP checksums
+	/// \return TRUE if a frame is returned in buffer, FALSE if nothing has been received
+	/// \note The default implementation calls ReceiveFrame() and sets *pChecksumOK to FALSE.
+	virtual boolean ReceiveFrameChecked (void *pBuffer, unsigned *pResultLength,
+					     boolean *pChecksumOK);
+
+	/// \brief Poll for multiple received Ethernet frames at once
+	/// \param pFrames Array of frames, pBuffer and pParam have to be set by the caller
+	/// \param nMaxFrames Number of entries in the array
+	/// \return Number of received frames (0 if nothing has been received)
+	/// \note The device receives the frames directly into the given buffers, if possible,\n
+	///	  so that a device specific header may be in front of the frame (see nOffset).\n
+	///	  The buffers must be cache-aligned, because they may be used for DMA.
+	/// \note If pParam is not 0, a device with an own DMA ring may exchange pBuffer and\n
+	///	  pParam of a returned frame with a buffer, which has been given to it before.\n
+	///	  A returned buffer with pParam == 0 belongs to the device. It is valid until\n
+	///	  the next call only, and its frame has to be copied. The entries behind the\n
+	///	  returned frames are not modified.
+	/// \note The default implementation calls ReceiveFrameChecked() until it returns FALSE.
+	virtual unsigned ReceiveFrames (TNetRxFrame *pFrames, unsigned nMaxFrames);
+
 	/// \return TRUE if PHY link is up
 	virtual boolean IsLinkUp (void)			{ return TRUE; }
 
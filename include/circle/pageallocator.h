@@ -2,7 +2,7 @@
 // pageallocator.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2020  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2014-2024  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -21,52 +21,98 @@
 #define _circle_pageallocator_h
 
 #include <circle/sysconfig.h>
+#include <circle/memorymap.h>
 #include <circle/spinlock.h>
 #include <circle/macros.h>
 #include <circle/types.h>
 
 //#define PAGE_DEBUG
 
+#define PAGE_MAX_ORDER		10		// largest block has 2^PAGE_MAX_ORDER pages
+#define PAGE_MAX_PAGES		(PAGE_RESERVE / PAGE_SIZE)
+
 struct TFreePage
 {
 	u32		 nMagic;
 #define FREEPAGE_MAGIC	0x50474D43
 	TFreePage	*pNext;
+	TFreePage	*pPrev;
+};
+
+struct TPageStatistics
+{
+	size_t		 nRegionSize;		// size of the memory region
+	size_t		 nFreeSpace;		// not allocated by pages (see GetFreeSpace())
+	unsigned	 nAllocatedPages;	// currently in use
+	unsigned	 nMaxAllocatedPages;	// maximum number of pages in use
+	unsigned	 nFreeBlocks[PAGE_MAX_ORDER+1];	// number of free blocks per order
+	u64		 nAllocations;		// total number of allocations
+	unsigned	 nFailedAllocations;
 };
 
-class CPageAllocator	/// Allocates aligned pages from a flat memory region
+class CPageAllocator	/// Allocates aligned pages and blocks of contiguous pages (buddy system)
 {
 public:
 	CPageAllocator (void);
 	~CPageAllocator (void);
 
 	/// \param nBase Base address of memory region
-	/// \param nSize Size of memory region
+	/// \param nSize Size of memory region (up to PAGE_RESERVE is used)
 	void Setup (uintptr nBase, size_t nSize) NOOPT;
 
 	/// \return Free space of the memory region, which is not allocated by pages
-	/// \note Unused pages on the free list do not count here.
+	/// \note The free space may be fragmented.
 	size_t GetFreeSpace (void) const;
 
 	/// \return Pointer to a page with a size of PAGE_SIZE
 	/// \note Resulting page is always aligned to PAGE_SIZE
 	void *Allocate (void);
 
-	/// \param pPage Memory page to be freed
+	/// \param nOrder Order of the block (0..PAGE_MAX_ORDER)
+	/// \return Pointer to a block of (PAGE_SIZE << nOrder) physically contiguous bytes\n
+	///	    (0 if no block of this size is available)
+	/// \note Resulting block is aligned to its size relative to the start of the region.
+	void *AllocateBlock (unsigned nOrder);
+
+	/// \param pPage Memory page or block to be freed
+	/// \note Freed blocks are merged with their free buddy blocks.
 	void Free (void *pPage);
 
+	/// \param pStatistics Page statistics are returned here
+	void GetStatistics (TPageStatistics *pStatistics);
+
 #ifdef PAGE_DEBUG
 	void DumpStatus (void);
 #endif
 
 private:
-	u8		*m_pNext;
-	u8		*m_pLimit;
-#ifdef PAGE_DEBUG
+	void InsertFree (unsigned nPage, unsigned nOrder);	// m_SpinLock must be held
+	void RemoveFree (unsigned nPage, unsigned nOrder);	// m_SpinLock must be held
+
+	TFreePage *GetPage (unsigned nPage) const
+	{
+		return (TFreePage *) (m_pBase + nPage * PAGE_SIZE);
+	}
+
+private:
+	u8		*m_pBase;
+	unsigned	 m_nPages;
+	unsigned	 m_nFreePages;
 	unsigned	 m_nCount;
 	unsigned	 m_nMaxCount;
-#endif
-	TFreePage	*m_pFreeList;
+	u64		 m_nAllocations;
+	unsigned	 m_nFailedAllocations;
+
+	TFreePage	*m_pFreeList[PAGE_MAX_ORDER+1];
+	unsigned	 m_nFreeBlocks[PAGE_MAX_ORDER+1];
+
+	// state of the first page of each block
+	u8		 m_uchPageState[PAGE_MAX_PAGES];
+#define PAGE_STATE_NONE		0x00			// not the first page of a block
+#define PAGE_STATE_FREE		0x80			// | order
+#define PAGE_STATE_USED		0x40			// | order
+#define PAGE_STATE_ORDER_MASK	0x3F
+
 	CSpinLock	 m_SpinLock;
 };
 
@@ -0,0 +1,401 @@
+//
+// ringbuffer.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_ringbuffer_h
+#define _circle_ringbuffer_h
+
+#include <circle/sysconfig.h>
+#include <circle/synchronize.h>
+#include <circle/types.h>
+
+// Memory ordering of the indices. On a single core, the other side is an interrupt
+// handler, so that it is sufficient to prevent the compiler from reordering.
+#ifdef ARM_ALLOW_MULTI_CORE
+	#define RINGBUFFER_LOAD(ptr)		__atomic_load_n (ptr, __ATOMIC_ACQUIRE)
+	#define RINGBUFFER_STORE(ptr, val)	__atomic_store_n (ptr, val, __ATOMIC_RELEASE)
+	#define RINGBUFFER_CAS(ptr, pexp, val)	__atomic_compare_exchange_n (ptr, pexp, val, TRUE, \
+						__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#else
+	#define RINGBUFFER_LOAD(ptr)		({ __typeof__ (*(ptr) + 0) _val = \
+							__atomic_load_n (ptr, __ATOMIC_RELAXED); \
+						   CompilerBarrier (); _val; })
+	#define RINGBUFFER_STORE(ptr, val)	do { CompilerBarrier (); \
+						     __atomic_store_n (ptr, val, __ATOMIC_RELAXED); } while (0)
+	#define RINGBUFFER_CAS(ptr, pexp, val)	({ CompilerBarrier (); \
+						   boolean _ok = __atomic_compare_exchange_n (ptr, pexp, val, \
+							TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED); \
+						   CompilerBarrier (); _ok; })
+#endif
+
+template <class T, unsigned N>
+class TRingBuffer	/// Lock-free ring buffer for one producer and one consumer
+			/// \details Producer and consumer may run on different cores, or one of
+			///	     them in an interrupt handler. Neither of them ever spins. The
+			///	     indices are kept in separate cache lines. N must be a power of 2.
+			///	     T should be a plain data type, entries are copied with operator=.
+{
+public:
+	TRingBuffer (void)
+	:	m_nIn (0),
+		m_nOut (0)
+	{
+		static_assert (N >= 2 && (N & (N-1)) == 0, "N must be a power of 2");
+	}
+
+	/// \return Number of entries, which can be dequeued
+	unsigned GetCount (void) const
+	{
+		return RINGBUFFER_LOAD (&m_nIn) - RINGBUFFER_LOAD (&m_nOut);
+	}
+
+	/// \return Number of entries, which can be enqueued
+	unsigned GetFree (void) const
+	{
+		return N - GetCount ();
+	}
+
+	boolean IsEmpty (void) const
+	{
+		return GetCount () == 0;
+	}
+
+	/// \brief Discard all entries (consumer side)
+	void Flush (void)
+	{
+		RINGBUFFER_STORE (&m_nOut, RINGBUFFER_LOAD (&m_nIn));
+	}
+
+	// Producer side
+
+	/// \return FALSE, if the buffer is full
+	boolean Enqueue (const T &rEntry)
+	{
+		unsigned nIn = m_nIn;
+		if (nIn - RINGBUFFER_LOAD (&m_nOut) == N)
+		{
+			return FALSE;
+		}
+
+		m_Buffer[nIn & (N-1)] = rEntry;
+
+		RINGBUFFER_STORE (&m_nIn, nIn + 1);
+
+		return TRUE;
+	}
+
+	/// \return Number of entries, which have been enqueued (less than nCount, if full)
+	unsigned EnqueueBatch (const T *pEntries, unsigned nCount)
+	{
+		unsigned nIn = m_nIn;
+		unsigned nFree = N - (nIn - RINGBUFFER_LOAD (&m_nOut));
+		if (nCount > nFree)
+		{
+			nCount = nFree;
+		}
+
+		for (unsigned i = 0; i < nCount; i++)
+		{
+			m_Buffer[(nIn + i) & (N-1)] = pEntries[i];
+		}
+
+		RINGBUFFER_STORE (&m_nIn, nIn + nCount);
+
+		return nCount;
+	}
+
+	/// \brief Get direct access to free entries (zero-copy)
+	/// \param pCount Number of free entries, which follow each other in memory (returned)
+	/// \return Pointer to the first free entry (0 if the buffer is full)
+	/// \note Fill up to *pCount entries and call Commit() afterwards.
+	T *Reserve (unsigned *pCount)
+	{
+		unsigned nIn = m_nIn;
+		unsigned nFree = N - (nIn - RINGBUFFER_LOAD (&m_nOut));
+		unsigned nToEnd = N - (nIn & (N-1));
+
+		*pCount = nFree < nToEnd ? nFree : nToEnd;
+
+		return *pCount > 0 ? &m_Buffer[nIn & (N-1)] : 0;
+	}
+
+	/// \param nCount Number of entries, which have been filled after Reserve()
+	void Commit (unsigned nCount)
+	{
+		RINGBUFFER_STORE (&m_nIn, m_nIn + nCount);
+	}
+
+	// Consumer side
+
+	/// \return FALSE, if the buffer is empty
+	boolean Dequeue (T *pEntry)
+	{
+		unsigned nOut = m_nOut;
+		if (RINGBUFFER_LOAD (&m_nIn) == nOut)
+		{
+			return FALSE;
+		}
+
+		*pEntry = m_Buffer[nOut & (N-1)];
+
+		RINGBUFFER_STORE (&m_nOut, nOut + 1);
+
+		return TRUE;
+	}
+
+	/// \return Number of entries, which have been dequeued (0 if empty)
+	unsigned DequeueBatch (T *pEntries, unsigned nCount)
+	{
+		unsigned nOut = m_nOut;
+		unsigned nAvail = RINGBUFFER_LOAD (&m_nIn) - nOut;
+		if (nCount > nAvail)
+		{
+			nCount = nAvail;
+		}
+
+		for (unsigned i = 0; i < nCount; i++)
+		{
+			pEntries[i] = m_Buffer[(nOut + i) & (N-1)];
+		}
+
+		RINGBUFFER_STORE (&m_nOut, nOut + nCount);
+
+		return nCount;
+	}
+
+	/// \return Pointer to the oldest entry, which is not removed (0 if empty)
+	const T *Peek (void) const
+	{
+		unsigned nOut = m_nOut;
+		if (RINGBUFFER_LOAD (&m_nIn) == nOut)
+		{
+			return 0;
+		}
+
+		return &m_Buffer[nOut & (N-1)];
+	}
+
+	/// \brief Get direct access to filled entries (zero-copy)
+	/// \param pCount Number of entries, which follow each other in memory (returned)
+	/// \return Pointer to the oldest entry (0 if the buffer is empty)
+	/// \note Process up to *pCount entries and call Release() afterwards.
+	const T *Acquire (unsigned *pCount)
+	{
+		unsigned nOut = m_nOut;
+		unsigned nAvail = RINGBUFFER_LOAD (&m_nIn) - nOut;
+		unsigned nToEnd = N - (nOut & (N-1));
+
+		*pCount = nAvail < nToEnd ? nAvail : nToEnd;
+
+		return *pCount > 0 ? &m_Buffer[nOut & (N-1)] : 0;
+	}
+
+	/// \param nCount Number of entries, which have been processed after Acquire()
+	void Release (unsigned nCount)
+	{
+		RINGBUFFER_STORE (&m_nOut, m_nOut + nCount);
+	}
+
+private:
+	volatile unsigned m_nIn CACHE_ALIGN;	// written by producer
+	volatile unsigned m_nOut CACHE_ALIGN;	// written by consumer
+
+	T m_Buffer[N] CACHE_ALIGN;
+};
+
+template <class T, unsigned N>
+class TMultiProducerRingBuffer	/// Lock-free ring buffer for multiple producers and one consumer
+				/// \details Each entry has a sequence number, which tells the
+				///	     consumer, that the entry is complete. A producer, which
+				///	     is interrupted while writing an entry, therefore does not
+				///	     block other producers, but only the consumer, until it has
+				///	     continued. Nobody ever spins. N must be a power of 2.
+{
+public:
+	TMultiProducerRingBuffer (void)
+	:	m_nIn (0),
+		m_nOut (0)
+	{
+		static_assert (N >= 2 && (N & (N-1)) == 0, "N must be a power of 2");
+
+		for (unsigned i = 0; i < N; i++)
+		{
+			m_Slot[i].nSequence = i;
+		}
+	}
+
+	/// \return Number of entries, which are enqueued or in progress
+	unsigned GetCount (void) const
+	{
+		return RINGBUFFER_LOAD (&m_nIn) - RINGBUFFER_LOAD (&m_nOut);
+	}
+
+	boolean IsEmpty (void) const
+	{
+		return Peek () == 0;
+	}
+
+	// Producer side (any number of cores and execution levels)
+
+	/// \return FALSE, if the buffer is full
+	boolean Enqueue (const T &rEntry)
+	{
+		T *pEntry = Reserve ();
+		if (pEntry == 0)
+		{
+			return FALSE;
+		}
+
+		*pEntry = rEntry;
+
+		Commit (pEntry);
+
+		return TRUE;
+	}
+
+	/// \return Number of entries, which have been enqueued (less than nCount, if full)
+	/// \note The entries are enqueued en bloc, entries of other producers are not mixed in.
+	unsigned EnqueueBatch (const T *pEntries, unsigned nCount)
+	{
+		unsigned nIn = RINGBUFFER_LOAD (&m_nIn);
+		do
+		{
+			unsigned nFree = N - (nIn - RINGBUFFER_LOAD (&m_nOut));
+			if (nCount > nFree)
+			{
+				nCount = nFree;
+			}
+
+			if (nCount == 0)
+			{
+				return 0;
+			}
+		}
+		while (!RINGBUFFER_CAS (&m_nIn, &nIn, nIn + nCount));
+
+		for (unsigned i = 0; i < nCount; i++)
+		{
+			TSlot *pSlot = &m_Slot[(nIn + i) & (N-1)];
+
+			pSlot->Entry = pEntries[i];
+
+			RINGBUFFER_STORE (&pSlot->nSequence, nIn + i + 1);
+		}
+
+		return nCount;
+	}
+
+	/// \brief Get direct access to a free entry (zero-copy)
+	/// \return Pointer to the entry (0 if the buffer is full)
+	/// \note Fill the entry and call Commit() with this pointer afterwards.
+	T *Reserve (void)
+	{
+		unsigned nIn = RINGBUFFER_LOAD (&m_nIn);
+		do
+		{
+			if (nIn - RINGBUFFER_LOAD (&m_nOut) == N)
+			{
+				return 0;
+			}
+		}
+		while (!RINGBUFFER_CAS (&m_nIn, &nIn, nIn + 1));
+
+		return &m_Slot[nIn & (N-1)].Entry;
+	}
+
+	void Commit (T *pEntry)
+	{
+		TSlot *pSlot = (TSlot *) pEntry;	// Entry is the first member
+
+		// the slot has the sequence number of the index, at which it has been reserved
+		RINGBUFFER_STORE (&pSlot->nSequence, pSlot->nSequence + 1);
+	}
+
+	// Consumer side
+
+	/// \return FALSE, if the buffer is empty (or the next entry is not complete yet)
+	boolean Dequeue (T *pEntry)
+	{
+		const T *pNext = Peek ();
+		if (pNext == 0)
+		{
+			return FALSE;
+		}
+
+		*pEntry = *pNext;
+
+		Release ();
+
+		return TRUE;
+	}
+
+	/// \return Number of entries, which have been dequeued (0 if empty)
+	unsigned DequeueBatch (T *pEntries, unsigned nCount)
+	{
+		unsigned i;
+		for (i = 0; i < nCount; i++)
+		{
+			if (!Dequeue (&pEntries[i]))
+			{
+				break;
+			}
+		}
+
+		return i;
+	}
+
+	/// \return Pointer to the oldest complete entry, which is not removed (0 if none)
+	/// \note Call Release() to remove it after processing (zero-copy).
+	const T *Peek (void) const
+	{
+		unsigned nOut = m_nOut;
+		const TSlot *pSlot = &m_Slot[nOut & (N-1)];
+
+		if (RINGBUFFER_LOAD (&pSlot->nSequence) != nOut + 1)
+		{
+			return 0;
+		}
+
+		return &pSlot->Entry;
+	}
+
+	/// \brief Remove the oldest entry, which has been returned by Peek()
+	void Release (void)
+	{
+		unsigned nOut = m_nOut;
+
+		// the slot gets free for the producer, which reserves it in the next round
+		RINGBUFFER_STORE (&m_Slot[nOut & (N-1)].nSequence, nOut + N);
+
+		RINGBUFFER_STORE (&m_nOut, nOut + 1);
+	}
+
+private:
+	struct TSlot
+	{
+		T		  Entry;
+		volatile unsigned nSequence;	// == index: free, == index+1: complete
+	};
+
+	volatile unsigned m_nIn CACHE_ALIGN;	// reserved by producers
+	volatile unsigned m_nOut CACHE_ALIGN;	// written by consumer
+
+	TSlot m_Slot[N] CACHE_ALIGN;
+};
+
+#endif
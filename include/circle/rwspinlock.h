@@ -0,0 +1,97 @@
+//
+// rwspinlock.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_rwspinlock_h
+#define _circle_rwspinlock_h
+
+#include <circle/sysconfig.h>
+#include <circle/synchronize.h>
+#include <circle/types.h>
+
+#ifdef ARM_ALLOW_MULTI_CORE
+
+class CRWSpinLock	/// Reader-writer spin lock, multiple readers can hold it at the same time
+			/// \details A waiting writer blocks new readers, so that it cannot starve.
+			///	     The lock is not recursive. Like with CSpinLock, nTargetLevel is the
+			///	     maximum execution level from which the lock is used.
+{
+public:
+	CRWSpinLock (unsigned nTargetLevel = IRQ_LEVEL);
+	~CRWSpinLock (void);
+
+	/// \brief Acquire the lock for reading (shared)
+	void ReadAcquire (void);
+	void ReadRelease (void);
+
+	/// \brief Acquire the lock for writing (exclusive)
+	void WriteAcquire (void);
+	void WriteRelease (void);
+
+private:
+	unsigned m_nTargetLevel;
+
+	volatile u32 m_nState;
+#define RWSPINLOCK_WRITER		0x80000000U	// a writer holds the lock
+#define RWSPINLOCK_WRITER_WAITING	0x40000000U	// no new readers are allowed
+#define RWSPINLOCK_READERS_MASK		0x3FFFFFFFU	// number of readers
+};
+
+#else
+
+class CRWSpinLock
+{
+public:
+	CRWSpinLock (unsigned nTargetLevel = IRQ_LEVEL)
+	:	m_nTargetLevel (nTargetLevel)
+	{
+	}
+
+	void ReadAcquire (void)
+	{
+		if (m_nTargetLevel >= IRQ_LEVEL)
+		{
+			EnterCritical (m_nTargetLevel);
+		}
+	}
+
+	void ReadRelease (void)
+	{
+		if (m_nTargetLevel >= IRQ_LEVEL)
+		{
+			LeaveCritical ();
+		}
+	}
+
+	void WriteAcquire (void)
+	{
+		ReadAcquire ();
+	}
+
+	void WriteRelease (void)
+	{
+		ReadRelease ();
+	}
+
+private:
+	unsigned m_nTargetLevel;
+};
+
+#endif
+
+#endif
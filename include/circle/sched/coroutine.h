@@ -0,0 +1,143 @@
+//
+/// \file coroutine.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_sched_coroutine_h
+#define _circle_sched_coroutine_h
+
+#include <circle/sched/task.h>
+#include <circle/sched/synchronizationevent.h>
+#include <circle/spinlock.h>
+#include <circle/sysconfig.h>
+#include <circle/types.h>
+
+/// \note The body of CCoroutine::Run() has to be enclosed in CO_BEGIN and CO_END. The
+///	  following macros suspend the coroutine there. Only one of them may be used per
+///	  source line. Local variables of Run() are lost, when the coroutine is suspended,
+///	  so that any state must be kept in member variables.
+
+/// \brief Start of the body of CCoroutine::Run()
+#define CO_BEGIN		switch (m_nResumePoint) { case 0:
+/// \brief End of the body of CCoroutine::Run(), the coroutine terminates here
+#define CO_END			}
+
+/// \brief Let the other ready coroutines run
+#define CO_YIELD()		do { m_nResumePoint = __LINE__; SuspendReady (); return;	\
+				     case __LINE__: ; } while (0)
+/// \brief Suspend the coroutine for the given time
+#define CO_SLEEP(us)		do { m_nResumePoint = __LINE__; SuspendSleeping (us); return;	\
+				     case __LINE__: ; } while (0)
+/// \brief Suspend the coroutine, until the CSynchronizationEvent *pEvent is set
+/// \note The event can be set from a kernel timer handler or a DMA completion routine too.
+#define CO_AWAIT(pEvent)	do { m_nResumePoint = __LINE__; case __LINE__:		\
+				     if (SuspendWaiting (pEvent)) return; } while (0)
+/// \brief Check the condition every us microseconds, until it is TRUE
+/// \note This can be used to wait for the readiness of a socket, by calling Receive()\n
+///	  or Send() with MSG_DONTWAIT in the condition.
+#define CO_POLL_UNTIL(cond, us)	do { m_nResumePoint = __LINE__; case __LINE__:		\
+				     if (!(cond)) { SuspendSleeping (us); return; } } while (0)
+
+class CCoroutineExecutor;
+
+class CCoroutine	/// Stackless coroutine, which runs on a CCoroutineExecutor task
+			/// \details Overload this class, define the Run() method using the CO_*
+			///	     macros, and call CCoroutineExecutor::AddCoroutine() with a new
+			///	     object to start it. The object is deleted, when Run() returns
+			///	     after CO_END. A coroutine does not have a stack of its own, so
+			///	     thousands of them can run on one executor task.
+{
+public:
+	CCoroutine (void);
+	virtual ~CCoroutine (void);
+
+	/// \brief Override this method to define the body of your coroutine
+	/// \note It is called from the start each time the coroutine is resumed.\n
+	///	  CO_BEGIN continues at the point, where the coroutine has been suspended.
+	virtual void Run (void) = 0;
+
+protected:
+	// used by the CO_* macros
+	void SuspendReady (void);
+	void SuspendSleeping (unsigned nMicroSeconds);
+	boolean SuspendWaiting (CSynchronizationEvent *pEvent);	// FALSE, if the event is set
+
+	unsigned m_nResumePoint;		// source line or 0 to start
+
+private:
+	static void WakeWaiting (CCoroutine **ppWaitList);	// can be called from interrupt context
+	friend class CSynchronizationEvent;
+
+	friend class CCoroutineExecutor;
+
+private:
+	enum TState
+	{
+		StateRunning,
+		StateYielded,
+		StateReady,
+		StateSleeping,
+		StateWaiting
+	};
+
+	volatile TState	    m_State;
+	CCoroutineExecutor *m_pExecutor;
+	CCoroutine	   *m_pNext;		// in ready list or in wait list of an event
+	unsigned	    m_nWakeTicks;
+
+	static CSpinLock s_SpinLock;		// protects ready lists and wait lists
+};
+
+class CCoroutineExecutor : public CTask	/// Task, which runs any number of coroutines
+{
+public:
+	/// \param nStackSize Stack size of this task (used by all coroutines, while they run)
+	CCoroutineExecutor (unsigned nStackSize = TASK_STACK_SIZE);
+	~CCoroutineExecutor (void);
+
+	/// \param pCoroutine Coroutine object to be started on this executor
+	/// \note Can be called from another task or from a coroutine on any executor.
+	void AddCoroutine (CCoroutine *pCoroutine);
+
+	/// \return Number of coroutines on this executor, which have not terminated yet
+	unsigned GetCoroutineCount (void) const	{ return m_nCoroutines; }
+
+	/// \brief Runs the coroutines, never returns
+	void Run (void);
+
+private:
+	void MakeReady (CCoroutine *pCoroutine);		// can be called from interrupt context
+	friend class CCoroutine;
+
+	// sleep heap, ordered by wake time, only used by this task
+	void AddSleeping (CCoroutine *pCoroutine);
+	void WakeSleeping (void);
+
+private:
+	CCoroutine *m_pReadyHead;		// protected by CCoroutine::s_SpinLock
+	CCoroutine *m_pReadyTail;
+
+	CCoroutine **m_ppSleepHeap;		// entry 0 is unused
+	unsigned m_nSleeping;
+	unsigned m_nSleepHeapSize;
+
+	volatile unsigned m_nCoroutines;
+
+	CSynchronizationEvent m_WakeEvent;	// set, when a coroutine becomes ready
+};
+
+#endif
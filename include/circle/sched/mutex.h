@@ -24,11 +24,12 @@
 #define _circle_sched_mutex_h
 
 #include <circle/types.h>
-#include <circle/sched/synchronizationevent.h>
-
-class CTask;
+#include <circle/sched/task.h>
 
 class CMutex	/// Provides a method to provide mutual exclusion (critical sections) across tasks
+		/// \details Acquiring a free mutex and releasing it without waiting tasks is done
+		///	     with atomic operations and does not enter the scheduler. Tasks, which
+		///	     have to wait, get the mutex in the order they requested it.
 {
 public:
 	CMutex (void);
@@ -38,13 +39,25 @@ public:
 	/// \note This mutex can be acquired multiple times by the same task.
 	void Acquire (void);
 
-	/// \brief Release the mutex; wake another task, which was waiting for the mutex
+	/// \brief Release the mutex; hand it over to the first task, which was waiting for it
 	void Release (void);
 
 private:
+	void AcquireContended (CTask *pTask);
+	void ReleaseContended (void);
+
+private:
+	enum
+	{
+		StateFree,
+		StateAcquired,
+		StateContended		// acquired and tasks may be waiting
+	};
+	volatile int m_nState;
+
 	CTask* m_pOwningTask;
 	int m_iReentrancyCount;
-	CSynchronizationEvent m_event;
+	TTaskWaitQueue m_WaitQueue;	// protected by the lock of the scheduler
 };
 
 #endif
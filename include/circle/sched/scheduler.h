@@ -21,16 +21,29 @@
 #define _circle_sched_scheduler_h
 
 #include <circle/sched/task.h>
+#include <circle/sched/stackpool.h>
 #include <circle/spinlock.h>
 #include <circle/device.h>
 #include <circle/sysconfig.h>
+#include <circle/memorymap.h>
 #include <circle/types.h>
 
-typedef void TSchedulerTaskHandler (CTask *pTask);
+#ifdef ARM_ALLOW_MULTI_CORE
+	#define SCHED_CORES	CORES
+#else
+	#define SCHED_CORES	1
+#endif
 
-/// \note This scheduler uses the round-robin policy, without priorities.
+typedef void TSchedulerTaskHandler (CTask *pTask);
 
 class CScheduler /// Cooperative non-preemtive scheduler, which controls which task runs at a time
+		 /// \details The ready task with the highest priority runs. Tasks with the same
+		 ///	    priority are scheduled round-robin (see CTask::SetPriority()).
+		 ///	    With ARM_ALLOW_MULTI_CORE tasks can run on all CPU cores, which have
+		 ///	    called RunOnThisCore(). Each core has its own run queues. A core takes
+		 ///	    over a ready task from another core, if it would otherwise idle or if
+		 ///	    the task has a higher priority than its own ready tasks, and the task's
+		 ///	    affinity allows it (see CTask::SetAffinity()).
 {
 public:
 	CScheduler (void);
@@ -38,6 +51,8 @@ public:
 
 	/// \brief Switch to the next task
 	/// \note A task should call this from time to time, if it does longer calculations.
+	/// \note If no task is ready to run, the CPU core waits for an interrupt here,\n
+	///	  as long as the next timeout is not due before the next timer tick.
 	void Yield (void);
 
 	/// \param nSeconds Number of seconds, the current task will be sleep
@@ -47,11 +62,12 @@ public:
 	/// \param nMicroSeconds Number of microseconds, the current task will be sleep
 	void usSleep (unsigned nMicroSeconds);
 
-	/// \return Pointer to the CTask object of the currently running task
+	/// \return Pointer to the CTask object of the currently running task (on this core)
 	CTask *GetCurrentTask (void);
 
 	/// \param pTaskName Task name to look for
 	/// \return Pointer to the CTask object of the task with the given name (0 if not found)
+	/// \note The task is looked up in a hash table, independent of the number of tasks.
 	CTask *GetTask (const char *pTaskName);
 
 	/// \param pTask Any pointer
@@ -78,6 +94,32 @@ public:
 	/// \param pTarget Device to be used for output
 	void ListTasks (CDevice *pTarget);
 
+	/// \param pTask Task to be examined
+	/// \param pStatistics Run time statistics of the task are returned here
+	/// \return FALSE, if pTask is not a valid task
+	/// \note The statistics are collected since the last ResetStatistics().
+	boolean GetTaskStatistics (CTask *pTask, TTaskStatistics *pStatistics);
+	/// \brief Restart the collection of statistics for all tasks and cores
+	void ResetStatistics (void);
+	/// \brief Generate top-like listing of CPU usage, run slices and wake latencies
+	/// \param pTarget Device to be used for output
+	/// \param bReset Restart the collection of statistics afterwards?
+	/// \note Call this periodically with bReset = TRUE to see the load in each period.\n
+	///	  The period must not be longer than 200 seconds (32-bit counter wraps).
+	void ListTaskStatistics (CDevice *pTarget, boolean bReset = FALSE);
+
+	/// \param bEnable Write an event to CTracer on each task switch?
+	/// \note The event has the ID TRACER_EVENT_TASK_SWITCH and the parameters: address\n
+	///	  of previous task, address of next task, core, wake latency of next task (us).
+	void EnableSwitchTracing (boolean bEnable = TRUE);
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	/// \brief Run tasks on this secondary CPU core, never returns
+	/// \note Call this from CMultiCoreSupport::Run() on core 1..CORES-1.
+	/// \note Only tasks with this core in their affinity mask run on this core.
+	void RunOnThisCore (void);
+#endif
+
 	/// \return Pointer to the only scheduler object in the system
 	static CScheduler *Get (void);
 
@@ -90,21 +132,102 @@ public:
 
 private:
 	void AddTask (CTask *pTask);
+	void SetTaskName (CTask *pTask, const char *pName);
+	void FinishTaskSwitch (void);		// releases m_SpinLock, acquired in Yield()
+	boolean AddTerminationWaiter (CTask *pTask);	// returns FALSE, if task is not valid
+	void RemoveTerminationWaiter (CTask *pTask);
 	friend class CTask;
 
-	boolean BlockTask (CTask **ppWaitListHead, unsigned nMicroSeconds);
+	// does not block, if *pCondition is TRUE, which is checked with m_SpinLock held
+	boolean BlockTask (CTask **ppWaitListHead, unsigned nMicroSeconds,
+			   const volatile boolean *pCondition);
 	void WakeTasks (CTask **ppWaitListHead); // can be called from interrupt context
 	friend class CSynchronizationEvent;
 
+	// futex-like wait queues for CMutex and CSemaphore, which handle the uncontended
+	// case with atomic operations and use these only on contention
+	void LockWaitQueues (void);		// acquires m_SpinLock
+	void UnlockWaitQueues (void);		// releases m_SpinLock
+	// appends the current task to the queue and blocks it, releases m_SpinLock meanwhile
+	void BlockOnWaitQueue (TTaskWaitQueue *pQueue);
+	// wakes the first task in the queue, returns it (0 if queue is empty)
+	CTask *WakeFromWaitQueue (TTaskWaitQueue *pQueue);	// m_SpinLock must be held
+	friend class CMutex;
+	friend class CSemaphore;
+
 	void RemoveTask (CTask *pTask);
-	unsigned GetNextTask (void); // returns index into m_pTask or MAX_TASKS if no task was found
+	void ReapTasks (void);	// deletes terminated tasks
+	void CheckStack (CTask *pTask);		// panics on stack overflow
+
+	// statistics, m_SpinLock must be held
+	void AccountSwitch (CTask *pCurrent, CTask *pNext, unsigned nCore, unsigned nNow);
+	unsigned CounterToMicroSeconds (u64 nTicks) const;
+
+	// task table, m_SpinLock must be held
+	boolean IsKnownTask (CTask *pTask);
+	void AddToHash (CTask *pTask);
+	void RemoveFromHash (CTask *pTask);
+	void GrowTables (void);			// called with m_nTasks == m_nTableSize
+	static unsigned HashName (const char *pName);
+	static unsigned HashAddress (const CTask *pTask);
+
+	void StartTask (CTask *pTask);
+	void SuspendTask (CTask *pTask);
+	void SetTaskPriority (CTask *pTask, unsigned nPriority);
+	void SetTaskAffinity (CTask *pTask, u32 nAffinity);
+
+	// returns 0 if no task is ready, m_SpinLock must be held
+	CTask *GetNextTask (unsigned nCore);
+#ifdef ARM_ALLOW_MULTI_CORE
+	CTask *FindTaskToSteal (unsigned nFromCore, unsigned nToCore, int nAbovePriority);
+#endif
+	// called with m_SpinLock held, which is released meanwhile
+	void WaitForWakeUp (unsigned nCore);
+#ifdef ARM_ALLOW_MULTI_CORE
+	static void TimerTickHandler (void);	// on core 0 in IRQ context
+#endif
+
+	// run queues and timeout heap, m_SpinLock must be held
+	void EnqueueTask (CTask *pTask);	// only if ready and not suspended
+	void DequeueTask (CTask *pTask);
+	void AddTimedTask (CTask *pTask);
+	void RemoveTimedTask (CTask *pTask);
+	void WakeTimedTasks (void);
+	void SetTimedTask (unsigned nIndex, CTask *pTask);
+	void SiftUpTimedTask (unsigned nIndex);
+	void SiftDownTimedTask (unsigned nIndex);
 
 private:
-	CTask *m_pTask[MAX_TASKS];
+	// all known tasks, with a hash index by address and by name
+	CTask *m_pFirstTask;
+	CTask *m_pLastTask;
 	unsigned m_nTasks;
+	unsigned m_nTableSize;		// grows by doubling, when m_nTasks reaches it
+	CTask **m_ppAddressHash;	// m_nTableSize buckets each
+	CTask **m_ppNameHash;
+
+	CTask *m_pCurrent[SCHED_CORES];
 
-	CTask *m_pCurrent;
-	unsigned m_nCurrent;	// index into m_pTask
+	struct TRunQueue
+	{
+		CTask		*pHead[TASK_PRIORITIES];
+		CTask		*pTail[TASK_PRIORITIES];
+		volatile u32	 nReadyMask;	// bit n is set, if queue of priority n is not empty
+	};
+
+	TRunQueue m_RunQueue[SCHED_CORES];
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	volatile u32 m_nActiveCores;		// bit n is set, if core n runs tasks
+	volatile unsigned m_nEnqueueSerial;	// incremented, when a task becomes ready
+	boolean m_bTickHandlerRegistered;
+#endif
+
+	// min-heap of sleeping tasks and tasks blocked with timeout, ordered by wake time
+	CTask **m_ppTimedHeap;			// m_nTableSize+1 entries, entry 0 is unused
+	volatile unsigned m_nTimedTasks;
+	volatile unsigned m_nNextWakeTicks;	// of m_ppTimedHeap[1], if m_nTimedTasks > 0
+	CTask *m_pTerminatedList;	// terminated tasks, which have to be deleted
 
 	TSchedulerTaskHandler *m_pTaskSwitchHandler;
 	TSchedulerTaskHandler *m_pTaskTerminationHandler;
@@ -113,6 +236,13 @@ private:
 
 	CSpinLock m_SpinLock;
 
+	CTaskStackPool m_StackPool;
+
+	unsigned m_nCounterHz;			// frequency of the counter used for statistics
+	unsigned m_nStatisticsStamp;		// counter at last ResetStatistics()
+	u64 m_nIdleTicks[SCHED_CORES];
+	boolean m_bTraceSwitches;
+
 	static CScheduler *s_pThis;
 };
 
@@ -20,10 +20,13 @@
 #ifndef _circle_sched_semaphore_h
 #define _circle_sched_semaphore_h
 
-#include <circle/sched/synchronizationevent.h>
+#include <circle/sched/task.h>
 #include <circle/types.h>
 
 class CSemaphore	/// Implements a semaphore synchronization class
+			/// \details Down() with a count > 0 and Up() without waiting tasks are done
+			///	     with atomic operations and do not enter the scheduler. Waiting tasks
+			///	     are woken in the order they called Down().
 {
 public:
 	/// \param nInitialCount Initial count of the semaphore
@@ -46,9 +49,15 @@ public:
 	boolean TryDown (void);
 
 private:
-	volatile int m_nCount;
+	void DownContended (void);
+	void UpContended (void);
 
-	CSynchronizationEvent m_Event;
+private:
+	volatile int m_nCount;		// < 0: number of tasks, which are waiting or about to wait
+
+	// protected by the lock of the scheduler
+	TTaskWaitQueue m_WaitQueue;
+	unsigned m_nWakeups;		// Up() calls, which came before the task could wait
 };
 
 #endif
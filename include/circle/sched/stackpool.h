@@ -0,0 +1,81 @@
+//
+/// \file stackpool.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_sched_stackpool_h
+#define _circle_sched_stackpool_h
+
+#include <circle/spinlock.h>
+#include <circle/sysconfig.h>
+#include <circle/types.h>
+
+#define TASK_STACK_MIN_ORDER	10		// 1 KByte
+#define TASK_STACK_MAX_ORDER	24		// 16 MByte
+
+#define TASK_STACK_FILL		0xA5		// unused stack bytes have this value
+
+struct TTaskStack
+{
+	u8		*pStack;		// lowest address of the stack
+	unsigned	 nSize;			// size of the stack (size class)
+	u8		*pBlock;		// allocated memory block
+	boolean		 bGuard;		// guard page below pStack is set?
+	TTaskStack	*pNext;			// in free list of the pool
+};
+
+class CTaskStackPool	/// Recycles task stacks by size class, optionally with guard pages
+			/// \details The stacks of terminated tasks are not returned to the heap,
+			///	     but are reused for new tasks with the same size class.
+{
+public:
+	CTaskStackPool (void);
+	~CTaskStackPool (void);
+
+	/// \param nSize Requested stack size in bytes (rounded up to the next power of two)
+	/// \return Pointer to the stack descriptor (0 if not enough memory is available)
+	/// \note The stack is filled with TASK_STACK_FILL to determine its high-water mark.
+	/// \note With TASK_STACK_GUARD an inaccessible page is placed below the stack (AArch64).
+	/// \note Stacks bigger than 1 << TASK_STACK_MAX_ORDER are not pooled.
+	TTaskStack *Allocate (unsigned nSize);
+
+	/// \param pStack Pointer to the stack descriptor returned from Allocate()
+	void Free (TTaskStack *pStack);
+
+	/// \param pStack Pointer to the stack descriptor
+	/// \return Maximum number of bytes of the stack, which have been used so far
+	static unsigned GetHighWater (const TTaskStack *pStack);
+
+	/// \param pStack Pointer to the stack descriptor
+	/// \return FALSE, if the lowest word of the stack has been overwritten (overflow)
+	static boolean IsIntact (const TTaskStack *pStack)
+	{
+		return *(const u32 *) pStack->pStack == TASK_STACK_FILL * 0x01010101U;
+	}
+
+private:
+	static unsigned GetOrder (unsigned nSize);	// size class of a pooled stack
+	static TTaskStack *NewStack (unsigned nSize);	// allocates from the heap
+	static void DeleteStack (TTaskStack *pStack);
+
+private:
+	TTaskStack *m_pFreeList[TASK_STACK_MAX_ORDER+1];	// per size class (order)
+
+	CSpinLock m_SpinLock;
+};
+
+#endif
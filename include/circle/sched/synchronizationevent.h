@@ -23,6 +23,7 @@
 #include <circle/types.h>
 
 class CTask;
+class CCoroutine;
 
 class CSynchronizationEvent /// Provides a method to synchronize the execution of a task with an event
 {
@@ -37,7 +38,7 @@ public:
 
 	/// \brief Clear the event
 	void Clear (void);
-	/// \brief Set the event; wakes all task(s) currently waiting for the event
+	/// \brief Set the event; wakes all task(s) and coroutine(s) currently waiting for the event
 	/// \note Can be called from interrupt context.
 	void Set (void);
 
@@ -54,13 +55,12 @@ public:
 	/// \note It is possible to have timed out and for the event to be set.
 	boolean WaitWithTimeout (unsigned nMicroSeconds);
 
-private:
-	void Pulse (void);	// wakes all waiting tasks without actually setting the event
-	friend class CMutex;
-
 private:
 	volatile boolean m_bState;
 	CTask	*m_pWaitListHead;	// Linked list of waiting tasks
+	CCoroutine *m_pCoroutineList;	// Linked list of waiting coroutines (see CO_AWAIT())
+
+	friend class CCoroutine;
 };
 
 #endif
@@ -22,6 +22,7 @@
 
 #include <circle/sched/taskswitch.h>
 #include <circle/sched/synchronizationevent.h>
+#include <circle/sched/stackpool.h>
 #include <circle/sysconfig.h>
 #include <circle/string.h>
 #include <circle/types.h>
@@ -37,12 +38,36 @@ enum TTaskState
 	TaskStateUnknown
 };
 
+#define TASK_PRIORITY_LOWEST	0
+#define TASK_PRIORITY_DEFAULT	16
+#define TASK_PRIORITY_HIGHEST	31
+#define TASK_PRIORITIES		32	// must not be greater than 32 (bitmap)
+
+#define TASK_AFFINITY_CORE(core)	(1U << (core))
+#define TASK_AFFINITY_ALL		0xFFFFFFFFU
+
+struct TTaskStatistics		/// see CScheduler::GetTaskStatistics()
+{
+	u64	 nRunTime;		///< Accumulated run time in microseconds
+	unsigned nSwitches;		///< Number of times the task got the CPU
+	unsigned nMaxSlice;		///< Longest time the task ran without a task switch (us)
+	unsigned nAvgLatency;		///< Average time from becoming ready to running (us)
+	unsigned nMaxLatency;		///< Longest time from becoming ready to running (us)
+};
+
+struct TTaskWaitQueue		/// FIFO of tasks blocked in CMutex or CSemaphore (contended case)
+{
+	CTask	*pHead;
+	CTask	*pTail;
+};
+
 class CScheduler;
 
 class CTask	/// Overload this class, define the Run() method, and call new on it to start it.
 {
 public:
 	/// \param nStackSize Stack size for this task (0 used internally for the main task)
+	/// \note The stack size is rounded up to the next power of two.
 	/// \param bCreateSuspended Set to TRUE, if the task is initially not ready to run
 	CTask (unsigned nStackSize = TASK_STACK_SIZE, boolean bCreateSuspended = FALSE);
 
@@ -69,6 +94,32 @@ public:
 	/// \note Callable from other task only
 	void WaitForTermination (void);
 
+	/// \brief Set the scheduling priority of this task
+	/// \param nPriority TASK_PRIORITY_LOWEST..TASK_PRIORITY_HIGHEST
+	/// \note A ready task is only selected to run, if no ready task with a higher priority\n
+	///	  exists. Ready tasks with the same priority are scheduled round-robin.
+	/// \note The new priority takes effect with the next CScheduler::Yield().
+	void SetPriority (unsigned nPriority);
+	/// \return Scheduling priority of this task
+	unsigned GetPriority (void) const	{ return m_nPriority; }
+
+	/// \brief Set the CPU cores, on which this task is allowed to run
+	/// \param nAffinity Bit mask of cores (TASK_AFFINITY_CORE(n) or'ed, or TASK_AFFINITY_ALL)
+	/// \note Tasks run on core 0 only by default. A secondary core runs tasks only after\n
+	///	  it has called CScheduler::RunOnThisCore() (with ARM_ALLOW_MULTI_CORE).
+	/// \note A task with affinity to cores, which do not run tasks, runs on core 0.
+	/// \note A running task moves to another core with the next CScheduler::Yield().
+	void SetAffinity (u32 nAffinity);
+	/// \return Bit mask of CPU cores, on which this task is allowed to run
+	u32 GetAffinity (void) const		{ return m_nAffinity; }
+
+	/// \return Size of the stack of this task in bytes (0 for the main task)
+	unsigned GetStackSize (void) const	{ return m_nStackSize; }
+	/// \return Maximum number of bytes of the stack, which have been used so far\n
+	///	    (0 for the main task)
+	/// \note Use this to find the right stack size for a task.
+	unsigned GetStackHighWater (void) const;
+
 	/// \brief Set a specific name for this task
 	/// \param pName Name string for this task
 	void SetName (const char *pName);
@@ -109,13 +160,36 @@ private:
 	volatile TTaskState m_State;
 	boolean		    m_bSuspended;
 	unsigned	    m_nWakeTicks;
+	unsigned	    m_nPriority;
+	u32		    m_nAffinity;
+	unsigned	    m_nCore;		// core, which runs this task or in whose run queue it is
+	boolean		    m_bRunning;		// current task of core m_nCore?
+	boolean		    m_bQueued;		// in run queue of the scheduler?
+	CTask		   *m_pRunPrev;		// run queue links
+	CTask		   *m_pRunNext;
+	unsigned	    m_nTimedIndex;	// position in timeout heap of the scheduler (0 if none)
 	TTaskRegisters	    m_Regs;
 	unsigned	    m_nStackSize;
-	u8		   *m_pStack;
+	TTaskStack	   *m_pStack;
 	CString		    m_Name;
 	void		   *m_pUserData[TASK_USER_DATA_SLOTS];
 	CSynchronizationEvent m_Event;
 	CTask		   *m_pWaitListNext;	// next in list of tasks waiting on an event
+	unsigned	    m_nTerminationWaiters; // tasks in WaitForTermination() of this task
+	CTask		   *m_pTaskPrev;	// task table links of the scheduler
+	CTask		   *m_pTaskNext;
+	CTask		   *m_pAddressHashNext;
+	CTask		   *m_pNameHashNext;
+	unsigned	    m_nNameHash;
+
+	// statistics in counter ticks, since the last CScheduler::ResetStatistics()
+	u64		    m_nRunTicks;
+	u64		    m_nLatencyTicks;
+	unsigned	    m_nSwitches;
+	unsigned	    m_nMaxSliceTicks;
+	unsigned	    m_nMaxLatencyTicks;
+	unsigned	    m_nRunStamp;	// counter, when the task got the CPU
+	unsigned	    m_nReadyStamp;	// counter, when the task has been enqueued
 };
 
 #endif
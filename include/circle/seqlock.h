@@ -0,0 +1,101 @@
+//
+// seqlock.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_seqlock_h
+#define _circle_seqlock_h
+
+#include <circle/spinlock.h>
+#include <circle/sysconfig.h>
+#include <circle/synchronize.h>
+#include <circle/types.h>
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	#define SEQLOCK_BARRIER()	DataMemBarrier ()
+#else
+	#define SEQLOCK_BARRIER()	CompilerBarrier ()
+#endif
+
+class CSeqLock	/// Sequence lock for small data, which is read often and written rarely
+		/// \details Readers do not write to shared memory and never block a writer.
+		///	     Instead they repeat reading, if a writer was active meanwhile:
+		///
+		///	     do
+		///	     {
+		///		     nSequence = Lock.ReadBegin ();
+		///		     // copy the data
+		///	     }
+		///	     while (Lock.ReadRetry (nSequence));
+		///
+		///	     The data must not contain pointers, which the writer may free.
+		///	     Writers are serialized with a spin lock for nTargetLevel, which
+		///	     must be the maximum execution level of readers and writers.
+{
+public:
+	CSeqLock (unsigned nTargetLevel = IRQ_LEVEL)
+	:	m_nSequence (0),
+		m_WriteLock (nTargetLevel)
+	{
+	}
+
+	/// \return Sequence number to be passed to ReadRetry()
+	unsigned ReadBegin (void) const
+	{
+		unsigned nSequence;
+		while ((nSequence = m_nSequence) & 1)	// a writer is active
+		{
+		}
+
+		SEQLOCK_BARRIER ();
+
+		return nSequence;
+	}
+
+	/// \param nSequence Value returned by ReadBegin()
+	/// \return Has the data been changed meanwhile, so that it has to be read again?
+	boolean ReadRetry (unsigned nSequence) const
+	{
+		SEQLOCK_BARRIER ();
+
+		return m_nSequence != nSequence;
+	}
+
+	void WriteAcquire (void)
+	{
+		m_WriteLock.Acquire ();
+
+		m_nSequence++;
+
+		SEQLOCK_BARRIER ();
+	}
+
+	void WriteRelease (void)
+	{
+		SEQLOCK_BARRIER ();
+
+		m_nSequence++;
+
+		m_WriteLock.Release ();
+	}
+
+private:
+	volatile unsigned m_nSequence;		// odd while a writer is active
+	CSpinLock m_WriteLock;
+};
+
+#endif
@@ -24,6 +24,7 @@
 #include <circle/interrupt.h>
 #include <circle/gpiopin.h>
 #include <circle/spinlock.h>
+#include <circle/ringbuffer.h>
 #include <circle/sysconfig.h>
 #include <circle/types.h>
 
@@ -143,6 +144,8 @@ private:
 	void InterruptHandler (void);
 	static void InterruptStub (void *pParam);
 
+	void SetRxStatus (int nStatus);		// keeps the first error only
+
 private:
 	CInterruptSystem *m_pInterruptSystem;
 	boolean m_bUseFIQ;
@@ -157,10 +160,9 @@ private:
 	CGPIOPin m_TxDPin;
 	CGPIOPin m_RxDPin;
 
-	u8 m_RxBuffer[SERIAL_BUF_SIZE];
-	volatile unsigned m_nRxInPtr;
-	volatile unsigned m_nRxOutPtr;
-	volatile int m_nRxStatus;
+	// filled by the interrupt handler and emptied by Read() without m_SpinLock
+	TRingBuffer<u8, SERIAL_BUF_SIZE> m_RxBuffer;
+	volatile int m_nRxStatus;		// first error since last Read(), set atomically
 
 	u8 m_TxBuffer[SERIAL_BUF_SIZE];
 	volatile unsigned m_nTxInPtr;
@@ -47,6 +47,8 @@ private:
 	u32 m_nLocked;
 
 	static boolean s_bEnabled;
+
+	friend class CRWSpinLock;
 };
 
 #else
@@ -94,6 +94,11 @@ void SyncDataAndInstructionCache (void);
 #define PeripheralEntry()	DataSyncBarrier()
 #define PeripheralExit()	DataMemBarrier()
 
+//
+// Wait for interrupt
+//
+#define WaitForInterrupt()	asm volatile ("mcr p15, 0, %0, c7, c0, 4" : : "r" (0) : "memory")
+
 #else
 
 //
@@ -75,17 +75,36 @@
 // (buckets). Each free list contains blocks of a specific size. On
 // block allocation the requested block size is rounded up to the
 // size of next available bucket size. If the requested size is greater
-// than the largest available bucket size, the block can be allocated,
-// but the memory space is lost, if the block will be freed later.
-// Because the block buckets have to be walked through on each allocate
-// and free operation, it is preferable to have only a few buckets.
-// With this option you can configure the bucket sizes, so that they
-// fit best for your application needs. You have to define a comma
-// separated list of increasing bucket sizes. All sizes must be a
-// multiple of 64. Up to 20 sizes can be defined.
-
-#ifndef HEAP_BLOCK_BUCKET_SIZES
-#define HEAP_BLOCK_BUCKET_SIZES	0x40,0x400,0x1000,0x4000,0x10000,0x40000,0x80000
+// than the largest available bucket size, the block is allocated from
+// a separate, address-ordered free list. Large blocks, which are freed,
+// are merged with adjacent free blocks there and can be reused for
+// allocations of different size. If this option is not defined, the
+// bucket sizes are generated in steps of 64 bytes up to 512 bytes,
+// followed by four steps per power of two (640, 768, 896, 1024, 1280,
+// ...) up to 512 KByte, which keeps the internal fragmentation low.
+// The bucket for a requested size is found in constant time. With this
+// option you can configure your own bucket sizes, so that they fit best
+// for your application needs. You have to define a comma separated list
+// of increasing bucket sizes. All sizes must be a multiple of 64. Up to
+// 64 sizes can be defined. CHeapAllocator::GetStatistics() returns the
+// internal fragmentation per bucket, which may help to find good sizes.
+
+//#define HEAP_BLOCK_BUCKET_SIZES	0x40,0x400,0x1000,0x4000,0x10000,0x40000,0x80000
+
+// HEAP_TRACE enables the heap allocation tracer. It records the caller
+// address and the allocation time (uptime in seconds) of each block in
+// use in a side table with HEAP_TRACE_ENTRIES entries per heap (must be
+// a power of two). CMemorySystem::DumpHeapTrace() writes a report of
+// the allocation sites, sorted by their live bytes, to the logger,
+// CMemorySystem::GetHeapTraceReport() returns it as text (e.g. to be
+// written to a file). This helps to find memory leaks in long running
+// applications. The overhead is a hash table insert or remove per
+// allocation and about 16 (32-bit) or 24 (64-bit) bytes per entry.
+
+//#define HEAP_TRACE
+
+#ifndef HEAP_TRACE_ENTRIES
+#define HEAP_TRACE_ENTRIES	8192
 #endif
 
 ///////////////////////////////////////////////////////////////////////
@@ -159,6 +178,16 @@
 
 #endif
 
+// HEAP_CORE_CACHE enables per-core caches of free heap blocks in front of
+// the shared free lists of the small bucket sizes (up to 4 KByte). Most
+// allocations and frees can be handled without acquiring the heap spin
+// lock then. Blocks are moved between a core cache and the shared free
+// lists in batches. This is only of importance with ARM_ALLOW_MULTI_CORE.
+
+#ifndef NO_HEAP_CORE_CACHE
+#define HEAP_CORE_CACHE
+#endif
+
 // USE_PHYSICAL_COUNTER enables the use of the CPU internal physical
 // counter, which is only available on the Raspberry Pi 2, 3 and 4. Reading
 // this counter is much faster than reading the BCM2835 system timer
@@ -256,18 +285,24 @@
 //
 ///////////////////////////////////////////////////////////////////////
 
-// MAX_TASKS is the maximum number of tasks in the system.
-
-#ifndef MAX_TASKS
-#define MAX_TASKS		20
-#endif
-
 // TASK_STACK_SIZE is the stack size for each task.
 
 #ifndef TASK_STACK_SIZE
 #define TASK_STACK_SIZE		0x8000
 #endif
 
+// TASK_STACK_GUARD places an inaccessible guard page below each task
+// stack, so that a stack overflow causes a data abort immediately.
+// This is supported on AArch64 only, where a page has 64 KByte. Each
+// task stack occupies up to two pages more memory, when this option is
+// enabled (a 32 KByte stack takes 160 KByte then), so it is meant for
+// debugging. TASK_STACK_GUARD has no effect on AArch32, where the memory
+// is mapped in 1 MByte sections only. Without it a stack overflow is
+// detected on the next task switch, if the lowest word of the stack has
+// been overwritten.
+
+//#define TASK_STACK_GUARD
+
 // NO_BUSY_WAIT deactivates busy waiting in the EMMC, SDHOST and USB
 // drivers, while waiting for the completion of a synchronous transfer.
 // This requires the scheduler in the system and transfers must not be
@@ -296,6 +331,44 @@
 
 #endif
 
+///////////////////////////////////////////////////////////////////////
+//
+// Network
+//
+///////////////////////////////////////////////////////////////////////
+
+// NET_BUFFER_POOL_SIZE is the number of packet buffers (about 1.8 KByte
+// each), which are preallocated by the TCP/IP network subsystem. This
+// avoids heap allocations for each frame on the receive and transmit
+// paths. If the pool is exhausted, buffers are taken from the heap.
+// The Ethernet driver of the Raspberry Pi 4 receives frames directly
+// into these buffers and keeps up to 256 of them on its DMA ring.
+
+#ifndef NET_BUFFER_POOL_SIZE
+#if RASPPI >= 4
+#define NET_BUFFER_POOL_SIZE	384
+#else
+#define NET_BUFFER_POOL_SIZE	128
+#endif
+#endif
+
+// NET_QUEUE_DEPTH is the maximum number of frames, which can be queued
+// between the layers of the TCP/IP network subsystem and for a UDP
+// socket. Further frames are dropped, until the queue has been drained.
+
+#ifndef NET_QUEUE_DEPTH
+#define NET_QUEUE_DEPTH		64
+#endif
+
+// NET_DEVICE_BATCH_SIZE is the maximum number of frames, which are
+// passed to or from the net device driver with one call, and which are
+// moved between the lower layers of the TCP/IP network subsystem with
+// one queue lock acquisition.
+
+#ifndef NET_DEVICE_BATCH_SIZE
+#define NET_DEVICE_BATCH_SIZE	8
+#endif
+
 ///////////////////////////////////////////////////////////////////////
 //
 // Other
@@ -27,6 +27,7 @@ struct TTraceEntry
 	unsigned nClockTicks;
 	unsigned nEventID;
 #define TRACER_EVENT_STOP	0
+#define TRACER_EVENT_TASK_SWITCH 0xFFFF		// by CScheduler, see EnableSwitchTracing()
 	unsigned nParam[4];
 };
 
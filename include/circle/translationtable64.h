@@ -37,6 +37,9 @@ public:
 
 	uintptr GetBaseAddress (void) const;
 
+	// nAddress must be aligned to PAGE_SIZE, returns FALSE if not mapped by a page
+	boolean SetPageAccess (uintptr nAddress, boolean bAccess);
+
 private:
 	TARMV8MMU_LEVEL3_DESCRIPTOR *CreateLevel3Table (uintptr nBaseAddress) NOOPT;
 
@@ -2,7 +2,7 @@
 // lan7800.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2018-2019  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2018-2024  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -38,10 +38,21 @@ public:
 
 	const CMACAddress *GetMACAddress (void) const;
 
+	// checksum offload and scatter-gather are supported
+	unsigned GetFeatures (void);
+
 	boolean SendFrame (const void *pBuffer, unsigned nLength);
+	boolean SendFrameParts (const TNetFramePart *pParts, unsigned nParts);
+	// multiple frames are packed into one bulk transfer
+	unsigned SendFrames (const TNetTxFrame *pFrames, unsigned nFrames);
 	
 	// pBuffer must have size FRAME_BUFFER_SIZE
 	boolean ReceiveFrame (void *pBuffer, unsigned *pResultLength);
+	boolean ReceiveFrameChecked (void *pBuffer, unsigned *pResultLength,
+				     boolean *pChecksumOK);
+	// returns the frames of one bulk transfer, which may contain multiple frames,
+	// the frames are copied out of the transfer buffer into the given buffers
+	unsigned ReceiveFrames (TNetRxFrame *pFrames, unsigned nMaxFrames);
 
 	// returns TRUE if PHY link is up
 	boolean IsLinkUp (void);
@@ -49,6 +60,8 @@ public:
 	TNetDeviceSpeed GetLinkSpeed (void);
 
 private:
+	static u32 GetTxCommandA (const u8 *pFrame, unsigned nLength);
+
 	boolean InitMACAddress (void);
 	boolean InitPHY (void);
 
@@ -69,6 +82,12 @@ private:
 	CUSBEndpoint *m_pEndpointBulkOut;
 
 	CMACAddress m_MACAddress;
+
+	u8 *m_pRxBuffer;		// received bulk transfer
+	unsigned m_nRxOffset;		// of the next frame in m_pRxBuffer
+	unsigned m_nRxLength;		// valid bytes in m_pRxBuffer
+
+	u8 *m_pTxBuffer;		// for a bulk transfer with multiple frames
 };
 
 #endif
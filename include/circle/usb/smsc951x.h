@@ -2,7 +2,7 @@
 // smsc951x.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2019  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2014-2024  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -41,6 +41,9 @@ public:
 	
 	// pBuffer must have size FRAME_BUFFER_SIZE
 	boolean ReceiveFrame (void *pBuffer, unsigned *pResultLength);
+	// returns the frames of one bulk transfer, which may contain multiple frames,
+	// the frames are copied out of the transfer buffer into the given buffers
+	unsigned ReceiveFrames (TNetRxFrame *pFrames, unsigned nMaxFrames);
 	
 	// returns TRUE if PHY link is up
 	boolean IsLinkUp (void);
@@ -65,6 +68,10 @@ private:
 	CUSBEndpoint *m_pEndpointBulkOut;
 
 	CMACAddress m_MACAddress;
+
+	u8 *m_pRxBuffer;		// received bulk transfer
+	unsigned m_nRxOffset;		// of the next frame in m_pRxBuffer
+	unsigned m_nRxLength;		// valid bytes in m_pRxBuffer
 };
 
 #endif
@@ -2,7 +2,7 @@
 // usbcdcethernet.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2017-2019  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2017-2024  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -42,6 +42,9 @@ public:
 	// pBuffer must have size FRAME_BUFFER_SIZE
 	boolean ReceiveFrame (void *pBuffer, unsigned *pResultLength);
 
+	// CDC ECM uses one bulk transfer per frame, so that the default implementations of
+	// SendFrames() and ReceiveFrames() are used, which call the functions above
+
 private:
 	boolean InitMACAddress (u8 iMACAddress);
 
@@ -36,6 +36,8 @@ void *memmove (void *pDest, const void *pSrc, size_t nLength);
 
 int memcmp (const void *pBuffer1, const void *pBuffer2, size_t nLength);
 
+void *memchr (const void *pBuffer, int nValue, size_t nLength);
+
 size_t strlen (const char *pString);
 
 int strcmp (const char *pString1, const char *pString2);
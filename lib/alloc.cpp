@@ -25,13 +25,13 @@
 
 void *malloc (size_t nSize)
 {
-	return CMemorySystem::HeapAllocate (nSize, HEAP_DEFAULT_MALLOC);
+	return CMemorySystem::HeapAllocate (nSize, HEAP_DEFAULT_MALLOC, HEAP_CALLER);
 }
 
 void *memalign (size_t nAlign, size_t nSize)
 {
 	assert (nAlign <= HEAP_BLOCK_ALIGN);
-	return CMemorySystem::HeapAllocate (nSize, HEAP_DEFAULT_MALLOC);
+	return CMemorySystem::HeapAllocate (nSize, HEAP_DEFAULT_MALLOC, HEAP_CALLER);
 }
 
 void free (void *pBlock)
@@ -48,7 +48,7 @@ void *calloc (size_t nBlocks, size_t nSize)
 	}
 	assert (nSize >= nBlocks);
 
-	void *pNewBlock = CMemorySystem::HeapAllocate (nSize, HEAP_DEFAULT_MALLOC);
+	void *pNewBlock = CMemorySystem::HeapAllocate (nSize, HEAP_DEFAULT_MALLOC, HEAP_CALLER);
 	if (pNewBlock != 0)
 	{
 		memset (pNewBlock, 0, nSize);
@@ -59,7 +59,7 @@ void *calloc (size_t nBlocks, size_t nSize)
 
 void *realloc (void *pBlock, size_t nSize)
 {
-	return CMemorySystem::HeapReAllocate (pBlock, nSize);
+	return CMemorySystem::HeapReAllocate (pBlock, nSize, HEAP_CALLER);
 }
 
 void *palloc (void)
@@ -67,6 +67,11 @@ void *palloc (void)
 	return CMemorySystem::PageAllocate ();
 }
 
+void *palloc_order (unsigned nOrder)
+{
+	return CMemorySystem::PageAllocateBlock (nOrder);
+}
+
 void pfree (void *pPage)
 {
 	CMemorySystem::PageFree (pPage);
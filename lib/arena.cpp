@@ -0,0 +1,89 @@
+//
+// arena.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/arena.h>
+#include <circle/alloc.h>
+#include <assert.h>
+
+CArena::CArena (size_t nSize)
+:	m_pBuffer (0),
+	m_nSize (0),
+	m_bOwnBuffer (TRUE),
+	m_nOffset (0),
+	m_nPeakOffset (0)
+{
+	if (nSize > 0)
+	{
+		m_pBuffer = (u8 *) malloc (nSize);
+		if (m_pBuffer != 0)
+		{
+			m_nSize = nSize;
+		}
+	}
+}
+
+CArena::CArena (void *pBuffer, size_t nSize)
+:	m_pBuffer ((u8 *) pBuffer),
+	m_nSize (nSize),
+	m_bOwnBuffer (FALSE),
+	m_nOffset (0),
+	m_nPeakOffset (0)
+{
+	assert (m_pBuffer != 0 || m_nSize == 0);
+}
+
+CArena::~CArena (void)
+{
+	if (m_bOwnBuffer)
+	{
+		free (m_pBuffer);
+	}
+
+	m_pBuffer = 0;
+}
+
+void *CArena::Allocate (size_t nSize, size_t nAlign)
+{
+	assert (nAlign > 0 && (nAlign & (nAlign-1)) == 0);
+
+	uintptr nAddress = (uintptr) (m_pBuffer + m_nOffset);
+	size_t nPadding = (nAlign - (nAddress & (nAlign-1))) & (nAlign-1);
+
+	if (   nPadding > m_nSize - m_nOffset
+	    || nSize > m_nSize - m_nOffset - nPadding)
+	{
+		return 0;
+	}
+
+	void *pBlock = m_pBuffer + m_nOffset + nPadding;
+
+	m_nOffset += nPadding + nSize;
+	if (m_nOffset > m_nPeakOffset)
+	{
+		m_nPeakOffset = m_nOffset;
+	}
+
+	return pBlock;
+}
+
+void CArena::Release (size_t nMark)
+{
+	assert (nMark <= m_nOffset);
+	m_nOffset = nMark;
+}
@@ -16,7 +16,7 @@
 //	Licensed under GPLv2
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2019-2021  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2019-2024  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -60,7 +60,7 @@
 #define TDMA_OFFSET			0x4000
 #define WORDS_PER_BD			3	// word per buffer descriptor
 
-#define RX_BUF_LENGTH			2048
+#define RX_BUF_LENGTH			FRAME_BUFFER_SIZE	// buffers of the net stack fit (with status block)
 
 // DMA descriptors
 #define TOTAL_DESC			256	// number of buffer descriptors (same for Rx/Tx)
@@ -220,6 +220,7 @@
 #define  RBUF_FLTR_LEN_SHIFT		8
 
 #define TBUF_CTRL			0x00
+#define  TBUF_64B_EN			(1 << 0)
 #define TBUF_BP_MC			0x0C
 #define TBUF_ENERGY_CTRL		0x14
 #define  TBUF_EEE_EN			(1 << 0)
@@ -281,6 +282,7 @@
 #define GENET_INTRL2_0_OFF		0x0200
 #define GENET_INTRL2_1_OFF		0x0240
 #define GENET_RBUF_OFF			0x0300
+#define GENET_TBUF_OFF			0x0600
 #define GENET_UMAC_OFF			0x0800
 
 // SYS block offsets and register definitions
@@ -429,6 +431,39 @@
 #define DMA_RX_FI_SHIFT			0x0007
 #define DMA_DESC_ALLOC_MASK		0x00FF
 
+// 64 byte status block in front of each Rx/Tx frame (RBUF_64B_EN, TBUF_64B_EN)
+struct TGEnetStatus64
+{
+	u32	length_status;		// length and peripheral status
+	u32	ext_status;		// extended status
+	u32	rx_csum;		// partial rx checksum
+	u32	unused1[9];
+	u32	tx_csum_info;		// Tx checksum info
+	u32	unused2[3];
+}
+PACKED;
+
+#define STATUS_SIZE			sizeof (TGEnetStatus64)
+
+ASSERT_STATIC (STATUS_SIZE == 64);
+
+// Tx status bits
+#define STATUS_TX_CSUM_START_MASK	0x7FFF
+#define STATUS_TX_CSUM_START_SHIFT	16
+#define STATUS_TX_CSUM_PROTO_UDP	0x8000
+#define STATUS_TX_CSUM_LV		0x80000000
+
+// IPv4 frame layout (for checksum offload)
+#define FRAME_ETHER_TYPE		12
+#define FRAME_IP_HEADER			14
+#define FRAME_IP_FRAGMENT		(FRAME_IP_HEADER + 6)
+#define FRAME_IP_PROTOCOL		(FRAME_IP_HEADER + 9)
+#define FRAME_IP_MIN_LENGTH		(FRAME_IP_HEADER + 20)
+#define IP_PROTO_TCP			6
+#define IP_PROTO_UDP			17
+#define TCP_CHECKSUM_OFFSET		16
+#define UDP_CHECKSUM_OFFSET		6
+
 #define DMA_ARBITER_RR			0x00
 #define DMA_ARBITER_WRR			0x01
 #define DMA_ARBITER_SP			0x02
@@ -545,6 +580,9 @@ GENET_IO_MACRO(hfb_reg, HFB_REG_OFFSET);
 // RBUF register accessors
 GENET_IO_MACRO(rbuf, GENET_RBUF_OFF);
 
+// TBUF register accessors
+GENET_IO_MACRO(tbuf, GENET_TBUF_OFF);
+
 // more I/O helper macros
 #define rbuf_ctrl_get()			sys_readl(SYS_RBUF_FLUSH_CTRL)
 #define rbuf_ctrl_set(val)		sys_writel(val, SYS_RBUF_FLUSH_CTRL)
@@ -575,13 +613,64 @@ GENET_IO_MACRO(rbuf, GENET_RBUF_OFF);
 
 #define dmadesc_get_length_status(d)	read32(d + DMA_DESC_LENGTH_STATUS)
 
+// Returns the IP header length, if the frame is a not fragmented IPv4 TCP/UDP frame,
+// whose headers fit into the frame (with valid IP header checksum, if check is set),
+// or 0 otherwise.
+static unsigned ip_header_length(const u8 *frame, unsigned length, boolean check)
+{
+	if (   length < FRAME_IP_MIN_LENGTH
+	    || frame[FRAME_ETHER_TYPE] != 0x08
+	    || frame[FRAME_ETHER_TYPE+1] != 0x00
+	    || (frame[FRAME_IP_HEADER] & 0xF0) != 0x40
+	    || (frame[FRAME_IP_FRAGMENT] & 0x3F) != 0		// MF flag and offset
+	    || frame[FRAME_IP_FRAGMENT+1] != 0)
+	{
+		return 0;
+	}
+
+	unsigned header_length = (frame[FRAME_IP_HEADER] & 0x0F) * 4;
+	unsigned l4_offset = FRAME_IP_HEADER + header_length;
+
+	switch (frame[FRAME_IP_PROTOCOL])
+	{
+	case IP_PROTO_TCP:
+		if (header_length < 20 || l4_offset + TCP_CHECKSUM_OFFSET + 2 > length)
+			return 0;
+		break;
+
+	case IP_PROTO_UDP:
+		if (header_length < 20 || l4_offset + UDP_CHECKSUM_OFFSET + 2 > length)
+			return 0;
+		break;
+
+	default:
+		return 0;
+	}
+
+	if (check)
+	{
+		u32 sum = 0;
+		for (unsigned i = FRAME_IP_HEADER; i < l4_offset; i += 2)
+			sum += (u32) frame[i] << 8 | frame[i+1];
+
+		sum = (sum & 0xFFFF) + (sum >> 16);
+		sum += sum >> 16;
+
+		if ((sum & 0xFFFF) != 0xFFFF)
+			return 0;
+	}
+
+	return header_length;
+}
+
 static const char FromBcm54213[] = "genet";
 
 CBcm54213Device::CBcm54213Device (void)
 :	m_pTimer (CTimer::Get ()),
 	m_bInterruptConnected (FALSE),
 	m_tx_cbs (0),
-	m_rx_cbs (0)
+	m_rx_cbs (0),
+	m_nRxRetired (0)
 {
 	assert (m_pTimer != 0);
 }
@@ -645,6 +734,15 @@ boolean CBcm54213Device::Initialize (void)
 	reg = umac_readl(UMAC_CMD);		// make sure we reflect the value of CRC_CMD_FWD
 	m_crc_fwd_en = !!(reg & CMD_CRC_FWD);
 
+	// enable Rx checksum verification, the FCS has to be skipped to get a valid status
+	reg = rbuf_readl(RBUF_CHK_CTRL);
+	reg |= RBUF_RXCHK_EN;
+	if (m_crc_fwd_en)
+		reg |= RBUF_SKIP_FCS;
+	else
+		reg &= ~RBUF_SKIP_FCS;
+	rbuf_writel(reg, RBUF_CHK_CTRL);
+
 	int ret = set_hw_addr();
 	if (ret)
 	{
@@ -700,86 +798,149 @@ const CMACAddress *CBcm54213Device::GetMACAddress (void) const
 
 boolean CBcm54213Device::IsSendFrameAdvisable (void)
 {
-	unsigned index = TX_RING_INDEX;			// see SendFrame() for mapping strategy
-	if (index == 0)
-		index = GENET_DESC_INDEX;
-	else
-		index -= 1;
+	TGEnetTxRing *ring = get_tx_ring ();
 							// is there room for a frame?
-	return m_tx_rings[index].free_bds >= 2;		// atomic read
+	return ring->free_bds >= 2;			// atomic read
+}
+
+unsigned CBcm54213Device::GetFeatures (void)
+{
+	return   NET_DEVICE_FEATURE_RX_CHECKSUM
+	       | NET_DEVICE_FEATURE_TX_CHECKSUM
+	       | NET_DEVICE_FEATURE_SCATTER_GATHER;
 }
 
 boolean CBcm54213Device::SendFrame (const void *pBuffer, unsigned nLength)
 {
-	assert (pBuffer != 0);
-	assert (nLength > 0);
+	TNetTxFrame Frame = {pBuffer, nLength};
 
-	// Mapping strategy:
-	// index = 0, unclassified, packet xmited through ring16
-	// index = 1, goes to ring 0. (highest priority queue)
-	// index = 2, goes to ring 1.
-	// index = 3, goes to ring 2.
-	// index = 4, goes to ring 3.
-	unsigned index = TX_RING_INDEX;
-	if (index == 0)
-		index = GENET_DESC_INDEX;
-	else
-		index -= 1;
+	if (SendFrames (&Frame, 1) == 0)
+	{
+		CLogger::Get ()->Write (FromBcm54213, LogWarning, "TX frame dropped");
 
-	TGEnetTxRing *ring = &m_tx_rings[index];
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+boolean CBcm54213Device::SendFrameParts (const TNetFramePart *pParts, unsigned nParts)
+{
+	assert (pParts != 0);
+
+	unsigned nLength = 0;
+	for (unsigned i = 0; i < nParts; i++)
+	{
+		nLength += pParts[i].nLength;
+	}
+
+	if (   nLength == 0
+	    || nLength > ENET_MAX_MTU_SIZE)
+	{
+		return FALSE;
+	}
+
+	TGEnetTxRing *ring = get_tx_ring ();
 
 	m_TxSpinLock.Acquire ();
 
 	if (ring->free_bds < 2)				// is there room for this frame?
 	{
-		CLogger::Get ()->Write (FromBcm54213, LogWarning, "TX frame dropped");
-
 		m_TxSpinLock.Release ();
 
+		CLogger::Get ()->Write (FromBcm54213, LogWarning, "TX frame dropped");
+
 		return FALSE;
 	}
 
-	u8 *pTxBuffer = new u8[ENET_MAX_MTU_SIZE];	// allocate and fill DMA buffer
-	memcpy (pTxBuffer, pBuffer, nLength);
-	if (nLength < ETH_ZLEN)				// pad frame if necessary
+	// gather the parts directly into the DMA buffer
+	u8 *pTxBuffer = new u8[STATUS_SIZE + ENET_MAX_MTU_SIZE];
+	u8 *pFrame = pTxBuffer + STATUS_SIZE;
+	for (unsigned i = 0; i < nParts; i++)
 	{
-		memset (pTxBuffer+nLength, 0, ETH_ZLEN-nLength);
-		nLength = ETH_ZLEN;
+		assert (pParts[i].pData != 0);
+		memcpy (pFrame, pParts[i].pData, pParts[i].nLength);
+		pFrame += pParts[i].nLength;
 	}
 
-	TGEnetCB *tx_cb_ptr = get_txcb (ring);		// get Tx control block from ring
-	assert (tx_cb_ptr != 0);
+	tx_set_buffer (ring, pTxBuffer, nLength);
 
-	// prepare for DMA
-	CleanAndInvalidateDataCacheRange ((u32) (uintptr) pTxBuffer, nLength);
+	tdma_ring_writel(ring->index, ring->prod_index, TDMA_PROD_INDEX);
 
-	tx_cb_ptr->buffer = pTxBuffer;			// set DMA buffer in Tx control block
+	m_TxSpinLock.Release ();
 
-	// set DMA descriptor and start transfer
-	dmadesc_set (tx_cb_ptr->bd_addr, pTxBuffer,   (nLength << DMA_BUFLENGTH_SHIFT)
-						    | (QTAG_MASK << DMA_TX_QTAG_SHIFT)
-						    | DMA_TX_APPEND_CRC | DMA_SOP | DMA_EOP);
+	return TRUE;
+}
 
-	// decrement total BD count and advance our write pointer
-	ring->free_bds--;
-	ring->prod_index++;
-	ring->prod_index &= DMA_P_INDEX_MASK;
+unsigned CBcm54213Device::SendFrames (const TNetTxFrame *pFrames, unsigned nFrames)
+{
+	assert (pFrames != 0);
 
-	// packets are ready, update producer index
-	tdma_ring_writel(ring->index, ring->prod_index, TDMA_PROD_INDEX);
+	TGEnetTxRing *ring = get_tx_ring ();
+
+	m_TxSpinLock.Acquire ();
+
+	unsigned i;
+	for (i = 0; i < nFrames; i++)
+	{
+		const void *pBuffer = pFrames[i].pBuffer;
+		unsigned nLength = pFrames[i].nLength;
+		assert (pBuffer != 0);
+		assert (nLength > 0);
+
+		if (   ring->free_bds < 2		// is there room for this frame?
+		    || nLength > ENET_MAX_MTU_SIZE)
+		{
+			break;
+		}
+
+		// allocate and fill DMA buffer, the status block is in front of the frame
+		u8 *pTxBuffer = new u8[STATUS_SIZE + ENET_MAX_MTU_SIZE];
+		memcpy (pTxBuffer + STATUS_SIZE, pBuffer, nLength);
+
+		tx_set_buffer (ring, pTxBuffer, nLength);
+	}
+
+	// packets are ready, update producer index once for all of them
+	if (i > 0)
+	{
+		tdma_ring_writel(ring->index, ring->prod_index, TDMA_PROD_INDEX);
+	}
 
 	m_TxSpinLock.Release ();
 
-	return TRUE;
+	return i;
 }
 
 boolean CBcm54213Device::ReceiveFrame (void *pBuffer, unsigned *pResultLength)
 {
-	assert (pBuffer != 0);
+	TNetRxFrame Frame;
+	Frame.pBuffer = pBuffer;
+	Frame.pParam = 0;			// the frame is copied into pBuffer
+
+	if (ReceiveFrames (&Frame, 1) == 0)
+	{
+		return FALSE;
+	}
+
 	assert (pResultLength != 0);
+	*pResultLength = Frame.nLength;
+
+	return TRUE;
+}
+
+unsigned CBcm54213Device::ReceiveFrames (TNetRxFrame *pFrames, unsigned nMaxFrames)
+{
+	assert (pFrames != 0);
 
 	TGEnetRxRing *ring = &m_rx_rings[GENET_DESC_INDEX];	// the only supported Rx queue
 
+	// our own buffers, which have been returned last time, are not used any more
+	while (m_nRxRetired > 0)
+	{
+		delete [] m_pRxRetired[--m_nRxRetired];
+	}
+
 	// clear status before servicing to reduce spurious interrupts
 	// NOTE: Rx interrupts are not used
 	//intrl2_0_writel (UMAC_IRQ_RXDMA_DONE, INTRL2_CPU_CLEAR);
@@ -803,10 +964,14 @@ boolean CBcm54213Device::ReceiveFrame (void *pBuffer, unsigned *pResultLength)
 
 	p_index &= DMA_P_INDEX_MASK;
 
-	boolean bResult = FALSE;
+	unsigned nFrames = 0;
 
+	// process all descriptors, which are ready (up to nMaxFrames frames)
 	unsigned rxpkttoprocess = (p_index - ring->c_index) & DMA_C_INDEX_MASK;
-	if (rxpkttoprocess > 0)
+	unsigned rxpktprocessed;
+	for (rxpktprocessed = 0;
+	     rxpktprocessed < rxpkttoprocess && nFrames < nMaxFrames;
+	     rxpktprocessed++)
 	{
 		u32 dma_length_status;
 		u32 dma_flag;
@@ -814,15 +979,27 @@ boolean CBcm54213Device::ReceiveFrame (void *pBuffer, unsigned *pResultLength)
 
 		TGEnetCB *cb = &m_rx_cbs[ring->read_ptr];
 
-		u8 *pRxBuffer = rx_refill (cb);
+		if (ring->read_ptr < ring->end_ptr)
+		{
+			ring->read_ptr++;
+		}
+		else
+		{
+			ring->read_ptr = ring->cb_ptr;
+		}
+
+		void *pRxParam = cb->param;
+		u8 *pRxBuffer = free_rx_cb (cb);
 		if (pRxBuffer == 0)
 		{
 			CLogger::Get ()->Write (FromBcm54213, LogWarning, "Missing RX buffer!");
 
-			goto out;
+			continue;
 		}
 
-		dma_length_status = dmadesc_get_length_status (cb->bd_addr);
+		// the Rx status block is in front of the frame
+		const TGEnetStatus64 *status = (const TGEnetStatus64 *) pRxBuffer;
+		dma_length_status = status->length_status;
 		dma_flag = dma_length_status & 0xFFFF;
 		nLength = dma_length_status >> DMA_BUFLENGTH_SHIFT;
 
@@ -832,9 +1009,9 @@ boolean CBcm54213Device::ReceiveFrame (void *pBuffer, unsigned *pResultLength)
 			CLogger::Get ()->Write (FromBcm54213, LogWarning,
 						"Dropping fragmented RX packet!");
 
-			delete [] pRxBuffer;
+			rx_set_buffer (cb, pRxBuffer, pRxParam);
 
-			goto out;
+			continue;
 		}
 
 		// report errors
@@ -843,13 +1020,15 @@ boolean CBcm54213Device::ReceiveFrame (void *pBuffer, unsigned *pResultLength)
 			CLogger::Get ()->Write (FromBcm54213, LogWarning, "RX error (0x%x)",
 						(unsigned) dma_flag);
 
-			delete [] pRxBuffer;
+			rx_set_buffer (cb, pRxBuffer, pRxParam);
 
-			goto out;
+			continue;
 		}
 
 #define LEADING_PAD	2
-		nLength -= LEADING_PAD;		// remove HW 2 bytes added for IP alignment
+		// remove status block and HW 2 bytes added for IP alignment
+		unsigned nOffset = STATUS_SIZE + LEADING_PAD;
+		nLength -= nOffset;
 
 		if (m_crc_fwd_en)
 		{
@@ -858,30 +1037,53 @@ boolean CBcm54213Device::ReceiveFrame (void *pBuffer, unsigned *pResultLength)
 
 
 		assert (nLength > 0);
-		assert (nLength <= FRAME_BUFFER_SIZE);
-		memcpy (pBuffer, pRxBuffer+LEADING_PAD, nLength);
-
-		*pResultLength = nLength;
+		assert (nOffset + nLength <= FRAME_BUFFER_SIZE);
 
-		delete [] pRxBuffer;
+		// the status bit covers the TCP/UDP checksum, the IP header is checked here
+		const u8 *pFrameData = pRxBuffer + nOffset;
+		boolean bChecksumOK =    (dma_flag & DMA_RX_CHK_V3PLUS)
+				      && ip_header_length (pFrameData, nLength, TRUE) != 0;
 
-		bResult = TRUE;
+		TNetRxFrame *pFrame = &pFrames[nFrames];
+		assert (pFrame->pBuffer != 0);
 
-out:
-		if (ring->read_ptr < ring->end_ptr)
+		if (   pFrame->pParam != 0
+		    && (   pRxParam != 0
+		        || m_nRxRetired < GENET_RX_RETIRED_MAX))
 		{
-			ring->read_ptr++;
+			// exchange the buffer of the caller with the received one (zero copy)
+			rx_set_buffer (cb, (u8 *) pFrame->pBuffer, pFrame->pParam);
+
+			if (pRxParam == 0)
+			{
+				m_pRxRetired[m_nRxRetired++] = pRxBuffer;
+			}
+
+			pFrame->pBuffer = pRxBuffer;
+			pFrame->pParam = pRxParam;
+			pFrame->nOffset = nOffset;
 		}
 		else
 		{
-			ring->read_ptr = ring->cb_ptr;
+			memcpy (pFrame->pBuffer, pFrameData, nLength);
+			pFrame->nOffset = 0;
+
+			rx_set_buffer (cb, pRxBuffer, pRxParam);
 		}
 
-		ring->c_index = (ring->c_index + 1) & DMA_C_INDEX_MASK;
+		pFrame->nLength = nLength;
+		pFrame->bChecksumOK = bChecksumOK;
+		nFrames++;
+	}
+
+	// return the processed descriptors to the hardware at once
+	if (rxpktprocessed > 0)
+	{
+		ring->c_index = (ring->c_index + rxpktprocessed) & DMA_C_INDEX_MASK;
 		rdma_ring_writel (ring->index, ring->c_index, RDMA_CONS_INDEX);
 	}
 
-	return bResult;
+	return nFrames;
 }
 
 boolean CBcm54213Device::IsLinkUp (void)
@@ -959,9 +1161,14 @@ void CBcm54213Device::init_umac(void)
 
 	umac_writel(ENET_MAX_MTU_SIZE, UMAC_MAX_FRAME_LEN);
 
-	// init rx registers, enable ip header optimization
-	u32 reg = rbuf_readl(RBUF_CTRL);
-	reg |= RBUF_ALIGN_2B;
+	// init tx registers, enable TSB (Tx status block for checksum offload)
+	u32 reg = tbuf_readl(TBUF_CTRL);
+	reg |= TBUF_64B_EN;
+	tbuf_writel(reg, TBUF_CTRL);
+
+	// init rx registers, enable ip header optimization and RSB (Rx status block)
+	reg = rbuf_readl(RBUF_CTRL);
+	reg |= RBUF_ALIGN_2B | RBUF_64B_EN;
 	rbuf_writel(reg, RBUF_CTRL);
 
 	rbuf_writel(1, RBUF_TBUF_SIZE_CTRL);
@@ -1360,6 +1567,78 @@ struct TGEnetCB *CBcm54213Device::get_txcb(TGEnetTxRing *ring)
 	return tx_cb_ptr;
 }
 
+// Put a Tx buffer on the ring, the frame follows the space for the Tx status block
+void CBcm54213Device::tx_set_buffer(TGEnetTxRing *ring, u8 *buffer, unsigned length)
+{
+	assert (ring->free_bds > 0);
+	assert (buffer);
+
+	u8 *frame = buffer + STATUS_SIZE;
+	if (length < ETH_ZLEN)			// pad frame if necessary
+	{
+		memset (frame+length, 0, ETH_ZLEN-length);
+		length = ETH_ZLEN;
+	}
+
+	u32 len_stat =   ((STATUS_SIZE + length) << DMA_BUFLENGTH_SHIFT)
+		       | (QTAG_MASK << DMA_TX_QTAG_SHIFT)
+		       | DMA_TX_APPEND_CRC | DMA_SOP | DMA_EOP;
+
+	TGEnetStatus64 *status = (TGEnetStatus64 *) buffer;
+	memset (status, 0, STATUS_SIZE);
+
+	// let the device complete the checksums of IPv4 TCP/UDP frames (see GetFeatures())
+	unsigned start = ip_header_length (frame, length, FALSE);
+	if (start != 0)
+	{
+		start += FRAME_IP_HEADER;
+
+		u32 csum_info;
+		if (frame[FRAME_IP_PROTOCOL] == IP_PROTO_TCP)
+			csum_info = start + TCP_CHECKSUM_OFFSET;
+		else
+			csum_info = (start + UDP_CHECKSUM_OFFSET) | STATUS_TX_CSUM_PROTO_UDP;
+
+		status->tx_csum_info =   ((start & STATUS_TX_CSUM_START_MASK) << STATUS_TX_CSUM_START_SHIFT)
+				       | csum_info | STATUS_TX_CSUM_LV;
+
+		len_stat |= DMA_TX_DO_CSUM;
+	}
+
+	TGEnetCB *tx_cb_ptr = get_txcb (ring);	// get Tx control block from ring
+	assert (tx_cb_ptr != 0);
+
+	// prepare for DMA
+	CleanAndInvalidateDataCacheRange ((u32) (uintptr) buffer, STATUS_SIZE + length);
+
+	tx_cb_ptr->buffer = buffer;		// set DMA buffer in Tx control block
+
+	dmadesc_set (tx_cb_ptr->bd_addr, buffer, len_stat);
+
+	// decrement total BD count and advance our write pointer
+	ring->free_bds--;
+	ring->prod_index++;
+	ring->prod_index &= DMA_P_INDEX_MASK;
+}
+
+// Get the Tx ring, which is used for sending
+TGEnetTxRing *CBcm54213Device::get_tx_ring(void)
+{
+	// Mapping strategy:
+	// index = 0, unclassified, packet xmited through ring16
+	// index = 1, goes to ring 0. (highest priority queue)
+	// index = 2, goes to ring 1.
+	// index = 3, goes to ring 2.
+	// index = 4, goes to ring 3.
+	unsigned index = TX_RING_INDEX;
+	if (index == 0)
+		index = GENET_DESC_INDEX;
+	else
+		index -= 1;
+
+	return &m_tx_rings[index];
+}
+
 unsigned CBcm54213Device::tx_reclaim(TGEnetTxRing *ring)
 {
 	// Clear status before servicing to reduce spurious interrupts
@@ -1476,50 +1755,57 @@ int CBcm54213Device::alloc_rx_buffers(TGEnetRxRing *ring)
 	// loop here for each buffer needing assign
 	for (unsigned i = 0; i < ring->size; i++) {
 		TGEnetCB *cb = ring->cbs + i;
-		rx_refill(cb);
-		if (!cb->buffer)
+		u8 *buffer = new u8[RX_BUF_LENGTH];
+		if (!buffer)
 			return -1;
+		rx_set_buffer(cb, buffer, 0);
 	}
 
 	return 0;
 }
 
+// Buffers of the net stack, which are on the Rx ring, are not freed here
 void CBcm54213Device::free_rx_buffers(void)
 {
 	for (unsigned i = 0; i < TOTAL_DESC; i++)
 	{
 		TGEnetCB *cb = &m_rx_cbs[i];
-		u8 *buffer = free_rx_cb(cb);
-		delete [] buffer;
+		if (cb->buffer && !cb->param)
+		{
+			u8 *buffer = free_rx_cb(cb);
+			delete [] buffer;
+		}
+	}
+
+	while (m_nRxRetired > 0)
+	{
+		delete [] m_pRxRetired[--m_nRxRetired];
 	}
 }
 
-u8 *CBcm54213Device::rx_refill(struct TGEnetCB *cb)
+// Put a Rx buffer on the ring
+void CBcm54213Device::rx_set_buffer(struct TGEnetCB *cb, u8 *buffer, void *param)
 {
-	// Allocate a new Rx DMA buffer
-	u8 *buffer = new u8[RX_BUF_LENGTH];
-	if (!buffer)
-		return 0;
+	assert (!cb->buffer);
+	assert (buffer);
 
 	// prepare buffer for DMA
 	CleanAndInvalidateDataCacheRange ((u32) (uintptr) buffer, RX_BUF_LENGTH);
 
-	// Grab the current Rx buffer from the ring and DMA-unmap it
-	u8 *rx_buffer = free_rx_cb(cb);
-
-	// Put the new Rx buffer on the ring
 	cb->buffer = buffer;
+	cb->param = param;
 	dmadesc_set_addr(cb->bd_addr, buffer);
-
-	// Return the current Rx buffer to caller
-	return rx_buffer;
 }
 
 u8 *CBcm54213Device::free_rx_cb(TGEnetCB *cb)
 {
 	u8 *buffer = cb->buffer;
+	if (!buffer)
+		return 0;
+
 	cb->buffer = 0;
 
+	// DMA-unmap the buffer
 	CleanAndInvalidateDataCacheRange ((u32) (uintptr) buffer, RX_BUF_LENGTH);
 
 	return buffer;
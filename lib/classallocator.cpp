@@ -2,7 +2,7 @@
 // classallocator.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2017-2022  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2017-2024  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -20,6 +20,7 @@
 #include <circle/classallocator.h>
 #include <circle/alloc.h>
 #include <circle/logger.h>
+#include <circle/atomic.h>
 
 #define BLOCK_ALIGN	16U
 #define ALIGN_MASK	(~(BLOCK_ALIGN-1))
@@ -36,15 +37,42 @@ struct TBlock
 	unsigned char  Data[0];
 };
 
+// The lock-free free list head holds the block pointer in the low bits and a
+// tag in the high bits, which is incremented on each update to avoid the ABA
+// problem. Blocks are never returned to the heap, so that reading pNext of a
+// block, which has been allocated by another core in the meantime, is harmless.
+#if AARCH == 32
+	#define TAG_SHIFT	32
+#else
+	#define TAG_SHIFT	40			// physical address space is < 1 TB
+#endif
+#define POINTER_MASK	((1ULL << TAG_SHIFT)-1)
+
+#define TAGGED_POINTER(ptr, tag)	(  (u64) reinterpret_cast<uintptr> (ptr)	\
+					 | ((u64) (tag) << TAG_SHIFT))
+#define TAGGED_TO_POINTER(val)		reinterpret_cast<TBlock *> ((uintptr) ((val) & POINTER_MASK))
+#define TAGGED_TO_TAG(val)		((val) >> TAG_SHIFT)
+
 CClassAllocator::CClassAllocator (size_t      nObjectSize,
 				  unsigned    nReservedObjects,
-				  const char *pClassName)
+				  const char *pClassName,
+				  boolean     bLockFree)
 :	m_pClassName (pClassName),
 	m_pMemory (0),
 	m_pFreeList (0),
-	m_bProtected (FALSE)
+	m_bProtected (FALSE),
+	m_bLockFree (bLockFree),
+	m_nTaggedFreeList (0),
+	m_nAllocatedObjects (0),
+	m_nMaxAllocatedObjects (0)
 {
 	Init (nObjectSize, nReservedObjects);
+
+	if (m_bLockFree)
+	{
+		m_nTaggedFreeList = TAGGED_POINTER (m_pFreeList, 0);
+		m_pFreeList = 0;
+	}
 }
 
 CClassAllocator::CClassAllocator (size_t      nObjectSize,
@@ -56,7 +84,11 @@ CClassAllocator::CClassAllocator (size_t      nObjectSize,
 	m_pFreeList (0),
 	m_bProtected (TRUE),
 	m_nTargetLevel (nTargetLevel),
-	m_SpinLock (nTargetLevel)
+	m_SpinLock (nTargetLevel),
+	m_bLockFree (FALSE),
+	m_nTaggedFreeList (0),
+	m_nAllocatedObjects (0),
+	m_nMaxAllocatedObjects (0)
 {
 	Init (nObjectSize, nReservedObjects);
 }
@@ -65,6 +97,7 @@ CClassAllocator::CClassAllocator (size_t      nObjectSize,
 CClassAllocator::~CClassAllocator (void)
 {
 	m_pFreeList = 0;
+	m_nTaggedFreeList = 0;
 
 	if (m_pMemory != 0)
 	{
@@ -138,8 +171,65 @@ void CClassAllocator::Extend (unsigned nReservedObjects, unsigned nTargetLevel)
 	m_SpinLock.Release ();
 }
 
+void CClassAllocator::Extend (unsigned nReservedObjects)
+{
+	assert (m_bLockFree);
+	assert (nReservedObjects > 0);
+
+	unsigned char *pMemory = reinterpret_cast<unsigned char *> (malloc (  m_nObjectSize
+									    * nReservedObjects));
+	if (pMemory == 0)
+	{
+		return;
+	}
+	assert ((reinterpret_cast<uintptr> (pMemory) & ~ALIGN_MASK) == 0);
+
+	for (unsigned i = 0; i < nReservedObjects; i++)
+	{
+		TBlock *pBlock = reinterpret_cast<TBlock *> (pMemory + m_nObjectSize*i);
+
+		pBlock->nMagic = BLOCK_MAGIC;
+		pBlock->pNext = 0;
+
+		PushLockFree (pBlock);
+	}
+
+	AtomicAdd (reinterpret_cast<volatile int *> (&m_nReservedObjects), nReservedObjects);
+}
+
 void *CClassAllocator::Allocate (void)
 {
+	if (m_bLockFree)
+	{
+		TBlock *pBlock = PopLockFree ();
+		if (pBlock == 0)
+		{
+			CLogger::Get ()->Write (m_pClassName, LogPanic,
+						"Trying to allocate more than %u instances",
+						m_nReservedObjects);
+
+			return 0;
+		}
+
+		assert (pBlock->nMagic == BLOCK_MAGIC);
+		pBlock->pNext = 0;
+
+		int nAllocated = AtomicIncrement (&m_nAllocatedObjects);
+		int nMax = AtomicGet (&m_nMaxAllocatedObjects);
+		while (nAllocated > nMax)
+		{
+			int nPrev = AtomicCompareExchange (&m_nMaxAllocatedObjects, nMax, nAllocated);
+			if (nPrev == nMax)
+			{
+				break;
+			}
+
+			nMax = nPrev;
+		}
+
+		return pBlock->Data;
+	}
+
 	if (m_bProtected)
 	{
 		m_SpinLock.Acquire ();
@@ -164,6 +254,11 @@ void *CClassAllocator::Allocate (void)
 	m_pFreeList = pBlock->pNext;
 	pBlock->pNext = 0;
 
+	if (++m_nAllocatedObjects > m_nMaxAllocatedObjects)
+	{
+		m_nMaxAllocatedObjects = m_nAllocatedObjects;
+	}
+
 	if (m_bProtected)
 	{
 		m_SpinLock.Release ();
@@ -181,6 +276,15 @@ void CClassAllocator::Free (void *pBlock)
 	assert (pBlk->nMagic == BLOCK_MAGIC);
 	assert (pBlk->pNext == 0);
 
+	if (m_bLockFree)
+	{
+		AtomicDecrement (&m_nAllocatedObjects);
+
+		PushLockFree (pBlk);
+
+		return;
+	}
+
 	if (m_bProtected)
 	{
 		m_SpinLock.Acquire ();
@@ -189,8 +293,58 @@ void CClassAllocator::Free (void *pBlock)
 	pBlk->pNext = m_pFreeList;
 	m_pFreeList = pBlk;
 
+	m_nAllocatedObjects--;
+
 	if (m_bProtected)
 	{
 		m_SpinLock.Release ();
 	}
 }
+
+unsigned CClassAllocator::GetAllocatedObjects (void) const
+{
+	return AtomicGet (&m_nAllocatedObjects);
+}
+
+unsigned CClassAllocator::GetMaxAllocatedObjects (void) const
+{
+	return AtomicGet (&m_nMaxAllocatedObjects);
+}
+
+void CClassAllocator::PushLockFree (TBlock *pBlock)
+{
+	u64 nOld = __atomic_load_n (&m_nTaggedFreeList, __ATOMIC_RELAXED);
+	u64 nNew;
+	do
+	{
+		pBlock->pNext = TAGGED_TO_POINTER (nOld);
+
+		nNew = TAGGED_POINTER (pBlock, TAGGED_TO_TAG (nOld) + 1);
+		assert (TAGGED_TO_POINTER (nNew) == pBlock);
+	}
+	while (!__atomic_compare_exchange_n (&m_nTaggedFreeList, &nOld, nNew, true,
+					     __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+TBlock *CClassAllocator::PopLockFree (void)
+{
+	u64 nOld = __atomic_load_n (&m_nTaggedFreeList, __ATOMIC_ACQUIRE);
+	u64 nNew;
+	TBlock *pBlock;
+	do
+	{
+		pBlock = TAGGED_TO_POINTER (nOld);
+		if (pBlock == 0)
+		{
+			return 0;
+		}
+
+		// pBlock may have been allocated by someone else in the meantime,
+		// but then the tag has changed and the exchange below will fail
+		nNew = TAGGED_POINTER (pBlock->pNext, TAGGED_TO_TAG (nOld) + 1);
+	}
+	while (!__atomic_compare_exchange_n (&m_nTaggedFreeList, &nOld, nNew, true,
+					     __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+
+	return pBlock;
+}
@@ -18,30 +18,83 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/heapallocator.h>
+#include <circle/multicore.h>
 #include <circle/logger.h>
+#include <circle/timer.h>
 #include <circle/util.h>
 #include <assert.h>
 
+#ifdef HEAP_BLOCK_BUCKET_SIZES
 u32 CHeapAllocator::s_nBucketSize[] = { HEAP_BLOCK_BUCKET_SIZES };
+#endif
 
 CHeapAllocator::CHeapAllocator (const char *pHeapName)
 :	m_pHeapName (pHeapName),
+	m_pBase (0),
 	m_pNext (0),
 	m_pLimit (0),
-	m_nReserve (0)
+	m_pHighWater (0),
+	m_nReserve (0),
+	m_nFailedAllocations (0),
+	m_nBuckets (0),
+	m_pLargeFreeList (0)
 {
 	memset (m_Bucket, 0, sizeof m_Bucket);
 
-	unsigned nBuckets = sizeof s_nBucketSize / sizeof s_nBucketSize[0];
-	if (nBuckets > HEAP_BLOCK_MAX_BUCKETS)
+#ifdef HEAP_BLOCK_BUCKET_SIZES
+	m_nBuckets = sizeof s_nBucketSize / sizeof s_nBucketSize[0];
+	if (m_nBuckets > HEAP_BLOCK_MAX_BUCKETS)
 	{
-		nBuckets = HEAP_BLOCK_MAX_BUCKETS;
+		m_nBuckets = HEAP_BLOCK_MAX_BUCKETS;
 	}
 
-	for (unsigned i = 0; i < nBuckets; i++)
+	for (unsigned i = 0; i < m_nBuckets; i++)
 	{
 		m_Bucket[i].nSize = s_nBucketSize[i];
 	}
+#else
+	u32 nSize;
+	for (nSize = HEAP_BLOCK_SIZE_STEP; nSize <= HEAP_BLOCK_LINEAR_MAX; nSize += HEAP_BLOCK_SIZE_STEP)
+	{
+		m_Bucket[m_nBuckets++].nSize = nSize;
+	}
+
+	for (u32 nBase = HEAP_BLOCK_LINEAR_MAX; nBase < HEAP_BLOCK_BUCKET_MAX; nBase *= 2)
+	{
+		for (nSize = nBase + nBase/4; nSize <= 2*nBase; nSize += nBase/4)
+		{
+			m_Bucket[m_nBuckets++].nSize = nSize;
+		}
+	}
+
+	assert (m_nBuckets <= HEAP_BLOCK_MAX_BUCKETS);
+#endif
+
+	// index of the first bucket, which may fit a size with the given bit length
+	for (unsigned nBits = 0; nBits < sizeof m_uchBucketIndex; nBits++)
+	{
+		size_t nMinSize = nBits > 0 ? ((size_t) 1 << (nBits-1)) + 1 : 0;
+
+		unsigned i;
+		for (i = 0; i < m_nBuckets && m_Bucket[i].nSize < nMinSize; i++)
+		{
+			// just search
+		}
+
+		m_uchBucketIndex[nBits] = (u8) i;
+	}
+
+#ifdef HEAP_USE_CORE_CACHE
+	memset (m_Cache, 0, sizeof m_Cache);
+#endif
+
+#ifdef HEAP_TRACE
+	ASSERT_STATIC ((HEAP_TRACE_ENTRIES & (HEAP_TRACE_ENTRIES-1)) == 0);
+	ASSERT_STATIC ((HEAP_TRACE_MAX_SITES & (HEAP_TRACE_MAX_SITES-1)) == 0);
+	memset (m_TraceTable, 0, sizeof m_TraceTable);
+	m_nTraceEntries = 0;
+	m_nTraceDropped = 0;
+#endif
 }
 
 CHeapAllocator::~CHeapAllocator (void)
@@ -50,8 +103,10 @@ CHeapAllocator::~CHeapAllocator (void)
 
 void CHeapAllocator::Setup (uintptr nBase, size_t nSize, size_t nReserve)
 {
-	m_pNext = (u8 *) nBase;
+	m_pBase = (u8 *) nBase;
+	m_pNext = m_pBase;
 	m_pLimit = (u8 *) (nBase + nSize);
+	m_pHighWater = m_pBase;
 	m_nReserve = nReserve;
 }
 
@@ -60,41 +115,83 @@ size_t CHeapAllocator::GetFreeSpace (void) const
 	return m_pLimit - m_pNext;
 }
 
-void *CHeapAllocator::Allocate (size_t nSize)
+void *CHeapAllocator::Allocate (size_t nSize, uintptr nCaller)
 {
 	if (m_pNext == 0)
 	{
 		return 0;
 	}
 
-	m_SpinLock.Acquire ();
+#ifdef HEAP_TRACE
+	if (nCaller == 0)
+	{
+		nCaller = (uintptr) __builtin_return_address (0);
+	}
+#endif
 
-	THeapBlockBucket *pBucket;
-	for (pBucket = m_Bucket; pBucket->nSize > 0; pBucket++)
+	// the block size must fit into the header and must not wrap, when it is rounded up
+	if (nSize > HEAP_BLOCK_MAX_SIZE)
 	{
-		if (nSize <= pBucket->nSize)
-		{
-			nSize = pBucket->nSize;
+		m_SpinLock.Acquire ();
 
-#ifdef HEAP_DEBUG
-			if (++pBucket->nCount > pBucket->nMaxCount)
-			{
-				pBucket->nMaxCount = pBucket->nCount;
-			}
+		return AllocationFailed ();
+	}
+
+	size_t nRequestedSize = nSize;
+
+	unsigned nBucket = GetBucketIndex (nSize);
+	THeapBlockBucket *pBucket = &m_Bucket[nBucket];
+	if (pBucket->nSize > 0)
+	{
+		nSize = pBucket->nSize;
+	}
+	else
+	{
+		// large blocks are kept aligned, so that they can be merged later
+		nSize = (nSize + HEAP_ALIGN_MASK) & ~HEAP_ALIGN_MASK;
+	}
+
+#ifdef HEAP_USE_CORE_CACHE
+	if (   pBucket->nSize > 0
+	    && pBucket->nSize <= HEAP_CACHE_MAX_BLOCK_SIZE)
+	{
+		void *pResult = CacheAllocate (nBucket, nRequestedSize);
+		if (pResult != 0)
+		{
+#ifdef HEAP_TRACE
+			TraceInsert (pResult, nCaller);
 #endif
 
-			break;
+			return pResult;
 		}
 	}
+#endif
 
-	THeapBlockHeader *pBlockHeader;
+	m_SpinLock.Acquire ();
+
+#ifdef HEAP_DEBUG
 	if (   pBucket->nSize > 0
-	    && (pBlockHeader = pBucket->pFreeList) != 0)
+	    && ++pBucket->nCount > pBucket->nMaxCount)
 	{
-		assert (pBlockHeader->nMagic == HEAP_BLOCK_MAGIC);
-		pBucket->pFreeList = pBlockHeader->pNext;
+		pBucket->nMaxCount = pBucket->nCount;
+	}
+#endif
+
+	THeapBlockHeader *pBlockHeader = 0;
+	if (pBucket->nSize > 0)
+	{
+		if ((pBlockHeader = pBucket->pFreeList) != 0)
+		{
+			assert (pBlockHeader->nMagic == HEAP_BLOCK_MAGIC);
+			pBucket->pFreeList = pBlockHeader->pNext;
+		}
 	}
 	else
+	{
+		pBlockHeader = AllocateLarge (nSize);
+	}
+
+	if (pBlockHeader == 0)
 	{
 		pBlockHeader = (THeapBlockHeader *) m_pNext;
 
@@ -104,35 +201,35 @@ void *CHeapAllocator::Allocate (size_t nSize)
 		if (   pNextBlock <= m_pNext			// may have wrapped
 		    || pNextBlock > m_pLimit-m_nReserve)
 		{
-			if (m_nReserve == 0)
+			// last resort for bucket sizes: split a free large block
+			pBlockHeader = 0;
+			if (pBucket->nSize > 0)
 			{
-				m_SpinLock.Release ();
-
-				return 0;
+				pBlockHeader = AllocateLarge (nSize);
 			}
 
-			m_nReserve = 0;
-
-			m_SpinLock.Release ();
-
-#ifdef HEAP_DEBUG
-			DumpStatus ();
-#endif
-#if STDLIB_SUPPORT == 3
-			// C++ exception should be thrown after returning 0
-			CLogger::Get ()->WriteNoAlloc (m_pHeapName, LogWarning, "Out of memory");
-#else
-			CLogger::Get ()->Write (m_pHeapName, LogPanic, "Out of memory");
-#endif
+			if (pBlockHeader == 0)
+			{
+				return AllocationFailed ();
+			}
+		}
+		else
+		{
+			m_pNext = pNextBlock;
+			if (m_pNext > m_pHighWater)
+			{
+				m_pHighWater = m_pNext;
+			}
 
-			return 0;
+			pBlockHeader->nMagic = HEAP_BLOCK_MAGIC;
+			pBlockHeader->nSize = (u32) nSize;
 		}
+	}
 
-		m_pNext = pNextBlock;
+	pBlockHeader->nRequestedSize = (u32) nRequestedSize;
 
-		pBlockHeader->nMagic = HEAP_BLOCK_MAGIC;
-		pBlockHeader->nSize = (u32) nSize;
-	}
+	// a block from the large free list may be counted as large block here
+	CountAllocate (&m_Bucket[GetBlockBucket (pBlockHeader)].Counters, pBlockHeader);
 
 	m_SpinLock.Release ();
 
@@ -141,14 +238,53 @@ void *CHeapAllocator::Allocate (size_t nSize)
 	void *pResult = pBlockHeader->Data;
 	assert (((uintptr) pResult & HEAP_ALIGN_MASK) == 0);
 
+#ifdef HEAP_TRACE
+	TraceInsert (pResult, nCaller);
+#endif
+
 	return pResult;
 }
 
-void *CHeapAllocator::ReAllocate (void *pBlock, size_t nSize)
+void *CHeapAllocator::AllocationFailed (void)
+{
+	m_nFailedAllocations++;
+
+	if (m_nReserve == 0)
+	{
+		m_SpinLock.Release ();
+
+		return 0;
+	}
+
+	m_nReserve = 0;
+
+	m_SpinLock.Release ();
+
+#ifdef HEAP_DEBUG
+	DumpStatus ();
+#endif
+#if STDLIB_SUPPORT == 3
+	// C++ exception should be thrown after returning 0
+	CLogger::Get ()->WriteNoAlloc (m_pHeapName, LogWarning, "Out of memory");
+#else
+	CLogger::Get ()->Write (m_pHeapName, LogPanic, "Out of memory");
+#endif
+
+	return 0;
+}
+
+void *CHeapAllocator::ReAllocate (void *pBlock, size_t nSize, uintptr nCaller)
 {
+#ifdef HEAP_TRACE
+	if (nCaller == 0)
+	{
+		nCaller = (uintptr) __builtin_return_address (0);
+	}
+#endif
+
 	if (pBlock == 0)
 	{
-		return Allocate (nSize);
+		return Allocate (nSize, nCaller);
 	}
 
 	if (nSize == 0)
@@ -163,10 +299,26 @@ void *CHeapAllocator::ReAllocate (void *pBlock, size_t nSize)
 	assert (pBlockHeader->nMagic == HEAP_BLOCK_MAGIC);
 	if (pBlockHeader->nSize >= nSize)
 	{
+		// the block is kept, but the statistics have to follow the new size
+		m_SpinLock.Acquire ();
+
+		THeapBlockCounters *pCounters = &m_Bucket[GetBlockBucket (pBlockHeader)].Counters;
+		pCounters->nRequestedBytes -= pBlockHeader->nRequestedSize;
+		pBlockHeader->nRequestedSize = (u32) nSize;
+		pCounters->nRequestedBytes += pBlockHeader->nRequestedSize;
+
+		m_SpinLock.Release ();
+
+#ifdef HEAP_TRACE
+		// the block is owned by the caller of ReAllocate() now
+		TraceRemove (pBlock);
+		TraceInsert (pBlock, nCaller);
+#endif
+
 		return pBlock;
 	}
 
-	void *pNewBlock = Allocate (nSize);
+	void *pNewBlock = Allocate (nSize, nCaller);
 	if (pNewBlock == 0)
 	{
 		return 0;
@@ -190,29 +342,369 @@ void CHeapAllocator::Free (void *pBlock)
 		(THeapBlockHeader *) ((uintptr) pBlock - sizeof (THeapBlockHeader));
 	assert (pBlockHeader->nMagic == HEAP_BLOCK_MAGIC);
 
-	for (THeapBlockBucket *pBucket = m_Bucket; pBucket->nSize > 0; pBucket++)
+#ifdef HEAP_TRACE
+	TraceRemove (pBlock);
+#endif
+
+	unsigned nBucket = GetBlockBucket (pBlockHeader);
+	THeapBlockBucket *pBucket = &m_Bucket[nBucket];
+	if (pBucket->nSize > 0)
 	{
-		if (pBlockHeader->nSize == pBucket->nSize)
+#ifdef HEAP_USE_CORE_CACHE
+		if (pBucket->nSize <= HEAP_CACHE_MAX_BLOCK_SIZE)
 		{
-			m_SpinLock.Acquire ();
+			CacheFree (nBucket, pBlockHeader);
+
+			return;
+		}
+#endif
 
-			pBlockHeader->pNext = pBucket->pFreeList;
-			pBucket->pFreeList = pBlockHeader;
+		m_SpinLock.Acquire ();
+
+		CountFree (&pBucket->Counters, pBlockHeader);
+
+		pBlockHeader->pNext = pBucket->pFreeList;
+		pBucket->pFreeList = pBlockHeader;
 
 #ifdef HEAP_DEBUG
-			pBucket->nCount--;
+		pBucket->nCount--;
 #endif
 
-			m_SpinLock.Release ();
+		m_SpinLock.Release ();
 
-			return;
+		return;
+	}
+
+	m_SpinLock.Acquire ();
+
+	CountFree (&pBucket->Counters, pBlockHeader);
+
+	FreeLarge (pBlockHeader);
+
+	m_SpinLock.Release ();
+}
+
+void CHeapAllocator::GetStatistics (THeapStatistics *pStatistics)
+{
+	assert (pStatistics != 0);
+
+	pStatistics->nBuckets = m_nBuckets;
+	pStatistics->nLiveBytes = 0;
+
+	m_SpinLock.Acquire ();
+
+	pStatistics->nHeapSize = m_pLimit - m_pBase;
+	pStatistics->nFreeSpace = m_pLimit - m_pNext;
+	pStatistics->nPeakBytes = m_pHighWater - m_pBase;
+	pStatistics->nFailedAllocations = m_nFailedAllocations;
+
+	pStatistics->nLargestFreeBlock = pStatistics->nFreeSpace;
+	for (THeapBlockHeader *pBlockHeader = m_pLargeFreeList; pBlockHeader != 0;
+	     pBlockHeader = pBlockHeader->pNext)
+	{
+		if (pBlockHeader->nSize > pStatistics->nLargestFreeBlock)
+		{
+			pStatistics->nLargestFreeBlock = pBlockHeader->nSize;
 		}
 	}
 
-#ifdef HEAP_DEBUG
-	CLogger::Get ()->Write (m_pHeapName, LogDebug, "Trying to free large block (size %u)",
-				pBlockHeader->nSize);
+	for (unsigned i = 0; i <= m_nBuckets; i++)
+	{
+		THeapBlockCounters Counters = m_Bucket[i].Counters;
+
+#ifdef HEAP_USE_CORE_CACHE
+		if (i < m_nBuckets)
+		{
+			for (unsigned nCore = 0; nCore < CORES; nCore++)
+			{
+				const THeapBlockCounters *pDelta = &m_Cache[nCore].Counters[i];
+
+				// counters of a core may have wrapped, but the sum is valid
+				Counters.nBlocks += pDelta->nBlocks;
+				Counters.nAllocatedBytes += pDelta->nAllocatedBytes;
+				Counters.nRequestedBytes += pDelta->nRequestedBytes;
+				Counters.nAllocations += pDelta->nAllocations;
+			}
+		}
+#endif
+
+		THeapBucketStatistics *pBucketStat = &pStatistics->Bucket[i];
+
+		pBucketStat->nBlockSize = m_Bucket[i].nSize;
+		pBucketStat->nAllocatedBlocks = Counters.nBlocks;
+		pBucketStat->nAllocatedBytes = Counters.nAllocatedBytes;
+		pBucketStat->nRequestedBytes = Counters.nRequestedBytes;
+		pBucketStat->nWastedBytes = Counters.nAllocatedBytes - Counters.nRequestedBytes;
+		pBucketStat->nAllocations = Counters.nAllocations;
+
+		pStatistics->nLiveBytes += Counters.nAllocatedBytes;
+	}
+
+	m_SpinLock.Release ();
+}
+
+unsigned CHeapAllocator::GetBucketIndex (size_t nSize) const
+{
+	unsigned nBits = 0;
+	if (nSize > 1)
+	{
+		nBits = sizeof (unsigned long)*8 - __builtin_clzl ((unsigned long) (nSize-1));
+	}
+
+	assert (nBits < sizeof m_uchBucketIndex);
+	unsigned nBucket = m_uchBucketIndex[nBits];
+
+	// there are only a few buckets per power of 2
+	while (   nBucket < m_nBuckets
+	       && nSize > m_Bucket[nBucket].nSize)
+	{
+		nBucket++;
+	}
+
+	return nBucket;
+}
+
+unsigned CHeapAllocator::GetBlockBucket (const THeapBlockHeader *pBlockHeader) const
+{
+	unsigned nBucket = GetBucketIndex (pBlockHeader->nSize);
+
+	// blocks split from the large free list may have other sizes
+	if (m_Bucket[nBucket].nSize != pBlockHeader->nSize)
+	{
+		nBucket = m_nBuckets;
+	}
+
+	return nBucket;
+}
+
+void CHeapAllocator::CountAllocate (THeapBlockCounters *pCounters,
+				    const THeapBlockHeader *pBlockHeader)
+{
+	pCounters->nBlocks++;
+	pCounters->nAllocatedBytes += pBlockHeader->nSize;
+	pCounters->nRequestedBytes += pBlockHeader->nRequestedSize;
+	pCounters->nAllocations++;
+}
+
+void CHeapAllocator::CountFree (THeapBlockCounters *pCounters,
+				const THeapBlockHeader *pBlockHeader)
+{
+	pCounters->nBlocks--;
+	pCounters->nAllocatedBytes -= pBlockHeader->nSize;
+	pCounters->nRequestedBytes -= pBlockHeader->nRequestedSize;
+}
+
+#ifdef HEAP_USE_CORE_CACHE
+
+void *CHeapAllocator::CacheAllocate (unsigned nBucket, size_t nRequestedSize)
+{
+	assert (nBucket < HEAP_BLOCK_MAX_BUCKETS);
+
+	// the cache may be used from IRQ handlers on the same core too
+	EnterCritical (IRQ_LEVEL);
+
+	THeapBlockCache *pCache = &m_Cache[CMultiCoreSupport::ThisCore ()];
+
+	THeapBlockHeader *pBlockHeader = pCache->pFreeList[nBucket];
+	if (pBlockHeader == 0)
+	{
+		// refill the cache with a batch of blocks from the shared bucket
+		THeapBlockBucket *pBucket = &m_Bucket[nBucket];
+
+		m_SpinLock.Acquire ();
+
+		for (unsigned i = 0; i < HEAP_CACHE_BATCH && pBucket->pFreeList != 0; i++)
+		{
+			THeapBlockHeader *pBlock = pBucket->pFreeList;
+			assert (pBlock->nMagic == HEAP_BLOCK_MAGIC);
+			pBucket->pFreeList = pBlock->pNext;
+
+			pBlock->pNext = pBlockHeader;
+			pBlockHeader = pBlock;
+
+			pCache->nCount[nBucket]++;
+		}
+
+		m_SpinLock.Release ();
+
+		if (pBlockHeader == 0)
+		{
+			LeaveCritical ();
+
+			return 0;		// allocate a new block from the heap
+		}
+	}
+
+	assert (pBlockHeader->nMagic == HEAP_BLOCK_MAGIC);
+	pCache->pFreeList[nBucket] = pBlockHeader->pNext;
+	assert (pCache->nCount[nBucket] > 0);
+	pCache->nCount[nBucket]--;
+
+	pBlockHeader->nRequestedSize = (u32) nRequestedSize;
+	CountAllocate (&pCache->Counters[nBucket], pBlockHeader);
+
+	LeaveCritical ();
+
+	pBlockHeader->pNext = 0;
+
+	return pBlockHeader->Data;
+}
+
+void CHeapAllocator::CacheFree (unsigned nBucket, THeapBlockHeader *pBlockHeader)
+{
+	assert (nBucket < HEAP_BLOCK_MAX_BUCKETS);
+
+	EnterCritical (IRQ_LEVEL);
+
+	THeapBlockCache *pCache = &m_Cache[CMultiCoreSupport::ThisCore ()];
+
+	CountFree (&pCache->Counters[nBucket], pBlockHeader);
+
+	pBlockHeader->pNext = pCache->pFreeList[nBucket];
+	pCache->pFreeList[nBucket] = pBlockHeader;
+
+	if (++pCache->nCount[nBucket] > HEAP_CACHE_MAX_BLOCKS)
+	{
+		// drain a batch of blocks to the shared bucket
+		THeapBlockBucket *pBucket = &m_Bucket[nBucket];
+
+		m_SpinLock.Acquire ();
+
+		for (unsigned i = 0; i < HEAP_CACHE_BATCH; i++)
+		{
+			THeapBlockHeader *pBlock = pCache->pFreeList[nBucket];
+			assert (pBlock != 0);
+			pCache->pFreeList[nBucket] = pBlock->pNext;
+
+			pBlock->pNext = pBucket->pFreeList;
+			pBucket->pFreeList = pBlock;
+		}
+
+		m_SpinLock.Release ();
+
+		pCache->nCount[nBucket] -= HEAP_CACHE_BATCH;
+	}
+
+	LeaveCritical ();
+}
+
 #endif
+
+THeapBlockHeader *CHeapAllocator::AllocateLarge (size_t nSize)
+{
+	assert ((nSize & HEAP_ALIGN_MASK) == 0);
+
+	// first fit
+	THeapBlockHeader *pPrev = 0;
+	THeapBlockHeader *pBlockHeader;
+	for (pBlockHeader = m_pLargeFreeList; pBlockHeader != 0; pBlockHeader = pBlockHeader->pNext)
+	{
+		assert (pBlockHeader->nMagic == HEAP_BLOCK_MAGIC);
+
+		if (pBlockHeader->nSize >= nSize)
+		{
+			break;
+		}
+
+		pPrev = pBlockHeader;
+	}
+
+	if (pBlockHeader == 0)
+	{
+		return 0;
+	}
+
+	THeapBlockHeader *pNext = pBlockHeader->pNext;
+
+	// split the block, if the remainder can hold a header and some data
+	if (pBlockHeader->nSize >= nSize + sizeof (THeapBlockHeader) + HEAP_BLOCK_ALIGN)
+	{
+		THeapBlockHeader *pRemainder =
+			(THeapBlockHeader *) (pBlockHeader->Data + nSize);
+
+		pRemainder->nMagic = HEAP_BLOCK_MAGIC;
+		pRemainder->nSize = pBlockHeader->nSize - nSize - sizeof (THeapBlockHeader);
+		pRemainder->pNext = pNext;
+
+		pBlockHeader->nSize = (u32) nSize;
+
+		pNext = pRemainder;
+	}
+
+	if (pPrev != 0)
+	{
+		pPrev->pNext = pNext;
+	}
+	else
+	{
+		m_pLargeFreeList = pNext;
+	}
+
+	return pBlockHeader;
+}
+
+void CHeapAllocator::FreeLarge (THeapBlockHeader *pBlockHeader)
+{
+	assert (((uintptr) pBlockHeader & HEAP_ALIGN_MASK) == 0);
+	assert ((pBlockHeader->nSize & HEAP_ALIGN_MASK) == 0);
+
+	THeapBlockHeader *pPrevPrev = 0;
+	THeapBlockHeader *pPrev = 0;
+	THeapBlockHeader *pNext;
+	for (pNext = m_pLargeFreeList; pNext != 0 && pNext < pBlockHeader; pNext = pNext->pNext)
+	{
+		assert (pNext->nMagic == HEAP_BLOCK_MAGIC);
+
+		pPrevPrev = pPrev;
+		pPrev = pNext;
+	}
+
+	assert (pNext != pBlockHeader);		// freed twice?
+
+	// merge with the following free block, if the size still fits into the header
+	if (   pNext != 0
+	    && pBlockHeader->Data + pBlockHeader->nSize == (u8 *) pNext
+	    && (size_t) pBlockHeader->nSize + sizeof (THeapBlockHeader) + pNext->nSize
+		<= HEAP_BLOCK_MAX_SIZE)
+	{
+		pBlockHeader->nSize += sizeof (THeapBlockHeader) + pNext->nSize;
+		pNext = pNext->pNext;
+	}
+
+	// merge with the preceding free block
+	if (   pPrev != 0
+	    && pPrev->Data + pPrev->nSize == (u8 *) pBlockHeader
+	    && (size_t) pPrev->nSize + sizeof (THeapBlockHeader) + pBlockHeader->nSize
+		<= HEAP_BLOCK_MAX_SIZE)
+	{
+		pPrev->nSize += sizeof (THeapBlockHeader) + pBlockHeader->nSize;
+		pBlockHeader = pPrev;
+		pPrev = pPrevPrev;
+	}
+
+	// return the block to the unallocated region, if it is the topmost one
+	if (pBlockHeader->Data + pBlockHeader->nSize == m_pNext)
+	{
+		assert (pNext == 0);
+
+		m_pNext = (u8 *) pBlockHeader;
+		pBlockHeader->nMagic = 0;
+
+		pBlockHeader = pNext;
+	}
+	else
+	{
+		pBlockHeader->pNext = pNext;
+	}
+
+	if (pPrev != 0)
+	{
+		pPrev->pNext = pBlockHeader;
+	}
+	else
+	{
+		m_pLargeFreeList = pBlockHeader;
+	}
 }
 
 #ifdef HEAP_DEBUG
@@ -227,3 +719,235 @@ void CHeapAllocator::DumpStatus (void)
 }
 
 #endif
+
+#ifdef HEAP_TRACE
+
+void CHeapAllocator::TraceInsert (void *pBlock, uintptr nCaller)
+{
+	assert (pBlock != 0);
+	CTimer *pTimer = CTimer::Get ();
+	unsigned nTime = pTimer != 0 ? pTimer->GetUptime () : 0;
+
+	m_TraceSpinLock.Acquire ();
+
+	if (m_nTraceEntries >= HEAP_TRACE_ENTRIES-1)	// keep one entry free to end probing
+	{
+		m_nTraceDropped++;
+
+		m_TraceSpinLock.Release ();
+
+		return;
+	}
+
+	unsigned i = TraceHash ((uintptr) pBlock, HEAP_TRACE_ENTRIES-1);
+	while (m_TraceTable[i].nBlock != 0)
+	{
+		i = (i+1) & (HEAP_TRACE_ENTRIES-1);
+	}
+
+	m_TraceTable[i].nBlock = (uintptr) pBlock;
+	m_TraceTable[i].nCaller = nCaller;
+	m_TraceTable[i].nTime = nTime;
+	m_nTraceEntries++;
+
+	m_TraceSpinLock.Release ();
+}
+
+void CHeapAllocator::TraceRemove (void *pBlock)
+{
+	m_TraceSpinLock.Acquire ();
+
+	unsigned i = TraceHash ((uintptr) pBlock, HEAP_TRACE_ENTRIES-1);
+	while (m_TraceTable[i].nBlock != (uintptr) pBlock)
+	{
+		if (m_TraceTable[i].nBlock == 0)	// not traced (table was full)
+		{
+			m_TraceSpinLock.Release ();
+
+			return;
+		}
+
+		i = (i+1) & (HEAP_TRACE_ENTRIES-1);
+	}
+
+	// backward shift deletion, moves following entries of the probe sequence
+	unsigned j = i;
+	while (1)
+	{
+		j = (j+1) & (HEAP_TRACE_ENTRIES-1);
+		if (m_TraceTable[j].nBlock == 0)
+		{
+			break;
+		}
+
+		unsigned k = TraceHash (m_TraceTable[j].nBlock, HEAP_TRACE_ENTRIES-1);
+		if (((j - k) & (HEAP_TRACE_ENTRIES-1)) >= ((j - i) & (HEAP_TRACE_ENTRIES-1)))
+		{
+			m_TraceTable[i] = m_TraceTable[j];
+			i = j;
+		}
+	}
+
+	m_TraceTable[i].nBlock = 0;
+	m_nTraceEntries--;
+
+	m_TraceSpinLock.Release ();
+}
+
+unsigned CHeapAllocator::TraceHash (uintptr nValue, unsigned nMask)
+{
+	// Fibonacci hashing, the upper bits are folded down, because the lower
+	// bits are constant for aligned blocks
+	u32 nHash = (u32) nValue * 2654435761U;
+
+	return (nHash ^ (nHash >> 16)) & nMask;
+}
+
+unsigned CHeapAllocator::GetTraceSites (THeapTraceSite *pSites, unsigned nMaxSites)
+{
+	assert (pSites != 0);
+	assert (nMaxSites >= 2);
+
+	THeapTraceSite Other = {0, 0, 0, (unsigned) -1};
+
+	m_TraceSpinLock.Acquire ();
+
+	// group the live blocks by allocation site
+	memset (m_TraceSites, 0, sizeof m_TraceSites);
+	for (unsigned i = 0; i < HEAP_TRACE_ENTRIES; i++)
+	{
+		const THeapTraceEntry *pEntry = &m_TraceTable[i];
+		if (pEntry->nBlock == 0)
+		{
+			continue;
+		}
+
+		const THeapBlockHeader *pBlockHeader =
+			(THeapBlockHeader *) (pEntry->nBlock - sizeof (THeapBlockHeader));
+		assert (pBlockHeader->nMagic == HEAP_BLOCK_MAGIC);
+
+		THeapTraceSite *pSite = &Other;
+		unsigned j = TraceHash (pEntry->nCaller, HEAP_TRACE_MAX_SITES-1);
+		for (unsigned nProbe = 0; nProbe < HEAP_TRACE_MAX_SITES; nProbe++)
+		{
+			if (m_TraceSites[j].nBlocks == 0)
+			{
+				m_TraceSites[j].nCaller = pEntry->nCaller;
+				m_TraceSites[j].nOldestTime = pEntry->nTime;
+			}
+
+			if (m_TraceSites[j].nCaller == pEntry->nCaller)
+			{
+				pSite = &m_TraceSites[j];
+
+				break;
+			}
+
+			j = (j+1) & (HEAP_TRACE_MAX_SITES-1);
+		}
+
+		pSite->nBlocks++;
+		pSite->nBytes += pBlockHeader->nSize;
+		if (pEntry->nTime < pSite->nOldestTime)
+		{
+			pSite->nOldestTime = pEntry->nTime;
+		}
+	}
+
+	// select the sites with most bytes, the rest is added to Other
+	unsigned nSites = 0;
+	while (nSites < nMaxSites-1)
+	{
+		THeapTraceSite *pMax = 0;
+		for (unsigned j = 0; j < HEAP_TRACE_MAX_SITES; j++)
+		{
+			if (   m_TraceSites[j].nBlocks > 0
+			    && (pMax == 0 || m_TraceSites[j].nBytes > pMax->nBytes))
+			{
+				pMax = &m_TraceSites[j];
+			}
+		}
+
+		if (pMax == 0)
+		{
+			break;
+		}
+
+		pSites[nSites++] = *pMax;
+		pMax->nBlocks = 0;
+	}
+
+	for (unsigned j = 0; j < HEAP_TRACE_MAX_SITES; j++)
+	{
+		if (m_TraceSites[j].nBlocks > 0)
+		{
+			Other.nBlocks += m_TraceSites[j].nBlocks;
+			Other.nBytes += m_TraceSites[j].nBytes;
+			if (m_TraceSites[j].nOldestTime < Other.nOldestTime)
+			{
+				Other.nOldestTime = m_TraceSites[j].nOldestTime;
+			}
+		}
+	}
+
+	m_TraceSpinLock.Release ();
+
+	if (Other.nBlocks > 0)
+	{
+		pSites[nSites++] = Other;
+	}
+
+	return nSites;
+}
+
+void CHeapAllocator::DumpTrace (unsigned nMaxSites)
+{
+	CString Report;
+	FormatTraceReport (&Report, nMaxSites);
+
+	CLogger::Get ()->Write (m_pHeapName, LogNotice, "Allocation sites by live bytes:\n%s",
+				(const char *) Report);
+}
+
+void CHeapAllocator::FormatTraceReport (CString *pReport, unsigned nMaxSites)
+{
+	assert (pReport != 0);
+
+	THeapTraceSite *pSites = new THeapTraceSite[nMaxSites];
+	if (pSites == 0)
+	{
+		return;
+	}
+
+	unsigned nSites = GetTraceSites (pSites, nMaxSites);
+
+	CTimer *pTimer = CTimer::Get ();
+	unsigned nNow = pTimer != 0 ? pTimer->GetUptime () : 0;
+
+	CString String;
+	String.Format ("%u blocks traced, %u not traced (table full)\n"
+		       "Caller      Blocks      Bytes  Oldest\n",
+		       m_nTraceEntries, m_nTraceDropped);
+	pReport->Append (String);
+
+	for (unsigned i = 0; i < nSites; i++)
+	{
+		if (pSites[i].nCaller != 0)
+		{
+			String.Format ("%08lX", (unsigned long) pSites[i].nCaller);
+		}
+		else
+		{
+			String = "(other) ";
+		}
+		pReport->Append (String);
+
+		String.Format (" %9u %10lu  %us ago\n", pSites[i].nBlocks,
+			       (unsigned long) pSites[i].nBytes, nNow - pSites[i].nOldestTime);
+		pReport->Append (String);
+	}
+
+	delete [] pSites;
+}
+
+#endif
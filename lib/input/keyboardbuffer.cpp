@@ -18,14 +18,13 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/input/keyboardbuffer.h>
+#include <circle/util.h>
 #include <assert.h>
 
 CKeyboardBuffer *CKeyboardBuffer::s_pThis = 0;
 
 CKeyboardBuffer::CKeyboardBuffer (CUSBKeyboardDevice *pKeyboard)
-:	m_pKeyboard (pKeyboard),
-	m_nInPtr (0),
-	m_nOutPtr (0)
+:	m_pKeyboard (pKeyboard)
 {
 	assert (s_pThis == 0);
 	s_pThis = this;
@@ -46,20 +45,7 @@ int CKeyboardBuffer::Read (void *pBuffer, size_t nCount)
 	assert (pBuffer != 0);
 	char *p = (char *) pBuffer;
 
-	int nResult = 0;
-
-	m_SpinLock.Acquire ();
-
-	while (   nCount > 0
-	       && BufStat ())
-	{
-		*p++ = OutBuf ();
-
-		nCount--;
-		nResult++;
-	}
-
-	m_SpinLock.Release ();
+	int nResult = m_Buffer.DequeueBatch (p, nCount);
 
 	assert (m_pKeyboard != 0);
 	m_pKeyboard->UpdateLEDs ();
@@ -67,45 +53,12 @@ int CKeyboardBuffer::Read (void *pBuffer, size_t nCount)
 	return nResult;
 }
 
-void CKeyboardBuffer::InBuf (char chChar)
-{
-	if (((m_nInPtr+1) & KEYB_BUF_MASK) != m_nOutPtr)
-	{
-		m_Buffer[m_nInPtr] = chChar;
-
-		m_nInPtr = (m_nInPtr+1) & KEYB_BUF_MASK;
-	}
-}
-
-boolean CKeyboardBuffer::BufStat (void) const
-{
-	return m_nInPtr != m_nOutPtr ? TRUE : FALSE;
-}
-
-char CKeyboardBuffer::OutBuf (void)
-{
-	if (m_nInPtr == m_nOutPtr)
-	{
-		return '\0';
-	}
-
-	char chChar = m_Buffer[m_nOutPtr];
-
-	m_nOutPtr = (m_nOutPtr+1) & KEYB_BUF_MASK;
-
-	return chChar;
-}
-
 void CKeyboardBuffer::KeyPressedHandler (const char *pString)
 {
-	m_SpinLock.Acquire ();
-
-	while (*pString)
-	{
-		InBuf (*pString++);
-	}
+	assert (pString != 0);
 
-	m_SpinLock.Release ();
+	// characters, which do not fit, are discarded
+	m_Buffer.EnqueueBatch (pString, strlen (pString));
 }
 
 void CKeyboardBuffer::KeyPressedStub (const char *pString)
@@ -48,8 +48,6 @@ CLogger::CLogger (unsigned nLogLevel, CTimer *pTimer, boolean bOverwriteOldest)
 	m_pBuffer (0),
 	m_nInPtr (0),
 	m_nOutPtr (0),
-	m_nEventInPtr (0),
-	m_nEventOutPtr (0),
 	m_pEventNotificationHandler (0),
 	m_pPanicHandler (0)
 {
@@ -62,14 +60,10 @@ CLogger::~CLogger (void)
 {
 	s_pThis = 0;
 
-	while (m_nEventInPtr != m_nEventOutPtr)
+	TLogEvent *pEvent;
+	while (m_EventQueue.Dequeue (&pEvent))
 	{
-		delete m_pEventQueue[m_nEventOutPtr];
-
-		if (++m_nEventOutPtr == LOG_QUEUE_SIZE)
-		{
-			m_nEventOutPtr = 0;
-		}
+		delete pEvent;
 	}
 
 	delete [] m_pBuffer;
@@ -355,32 +349,12 @@ void CLogger::WriteEvent (const char *pSource, TLogSeverity Severity, const char
 		pEvent->nTimeZone = 0;
 	}
 
-	m_EventSpinLock.Acquire ();
-
-	m_pEventQueue[m_nEventInPtr] = pEvent;
-
-	if (++m_nEventInPtr == LOG_QUEUE_SIZE)
+	// drop this entry, if event queue is full
+	if (!m_EventQueue.Enqueue (pEvent))
 	{
-		m_nEventInPtr = 0;
-	}
-
-	// drop oldest entry, if event queue is full
-	TLogEvent *pDropEvent = 0;
-	if (m_nEventInPtr == m_nEventOutPtr)
-	{
-		pDropEvent = m_pEventQueue[m_nEventOutPtr];
-
-		if (++m_nEventOutPtr == LOG_QUEUE_SIZE)
-		{
-			m_nEventOutPtr = 0;
-		}
-	}
-
-	m_EventSpinLock.Release ();
+		delete pEvent;
 
-	if (pDropEvent != 0)
-	{
-		delete pDropEvent;
+		return;
 	}
 
 	if (m_pEventNotificationHandler != 0)
@@ -392,24 +366,12 @@ void CLogger::WriteEvent (const char *pSource, TLogSeverity Severity, const char
 boolean CLogger::ReadEvent (TLogSeverity *pSeverity, char *pSource, char *pMessage,
 			    time_t *pTime, unsigned *pHundredthTime, int *pTimeZone)
 {
-	m_EventSpinLock.Acquire ();
-
-	if (m_nEventInPtr == m_nEventOutPtr)
+	TLogEvent *pEvent;
+	if (!m_EventQueue.Dequeue (&pEvent))
 	{
-		m_EventSpinLock.Release ();
-
 		return FALSE;
 	}
 
-	TLogEvent *pEvent = m_pEventQueue[m_nEventOutPtr];
-
-	if (++m_nEventOutPtr == LOG_QUEUE_SIZE)
-	{
-		m_nEventOutPtr = 0;
-	}
-
-	m_EventSpinLock.Release ();
-
 	*pSeverity = pEvent->Severity;
 	strcpy (pSource, pEvent->Source);
 	strcpy (pMessage, pEvent->Message);
@@ -134,6 +134,17 @@ void CMemorySystem::InitializeSecondary (void)
 
 #endif
 
+boolean CMemorySystem::SetPageAccess (void *pPage, boolean bAccess)
+{
+	assert (s_pThis != 0);
+	if (s_pThis->m_pTranslationTable == 0)
+	{
+		return FALSE;
+	}
+
+	return s_pThis->m_pTranslationTable->SetPageAccess ((uintptr) pPage, bAccess);
+}
+
 size_t CMemorySystem::GetMemSize (void) const
 {
 	assert (s_pThis != 0);
@@ -2,7 +2,7 @@
 // checksumcalculator.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2015-2024  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -21,6 +21,20 @@
 #include <circle/util.h>
 #include <assert.h>
 
+// fold a 64-bit ones' complement sum to 32 bits with end-around carry
+static inline u32 Fold64 (u64 nSum)
+{
+	nSum = (nSum & 0xFFFFFFFFU) + (nSum >> 32);
+	nSum = (nSum & 0xFFFFFFFFU) + (nSum >> 32);
+
+	return (u32) nSum;
+}
+
+// the buffer is accessed using wider types
+typedef u16 __attribute__ ((__may_alias__)) TChecksumWord16;
+typedef u32 __attribute__ ((__may_alias__)) TChecksumWord32;
+typedef u64 __attribute__ ((__may_alias__)) TChecksumWord64;
+
 CChecksumCalculator::CChecksumCalculator (const CIPAddress &rSourceIP, int nProtocol)
 :	m_bDestAddressSet (FALSE)
 {
@@ -69,6 +83,15 @@ u16 CChecksumCalculator::Calculate (const void *pBuffer, unsigned nLength)
 	return ~FoldResult (nChecksum);
 }
 
+u16 CChecksumCalculator::CalculatePseudoHeader (unsigned nLength)
+{
+	assert (m_bDestAddressSet);
+
+	m_Header.nTCPLength = le2be16 (nLength);
+
+	return FoldResult (CalculateChunk (&m_Header, sizeof m_Header, 0));
+}
+
 u16 CChecksumCalculator::SimpleCalculate (const void *pBuffer, unsigned nLength)
 {
 	assert (pBuffer != 0);
@@ -78,37 +101,190 @@ u16 CChecksumCalculator::SimpleCalculate (const void *pBuffer, unsigned nLength)
 	return ~FoldResult (nChecksum);
 }
 
+u16 CChecksumCalculator::Update (u16 nChecksum, u16 nOldWord, u16 nNewWord)
+{
+	// HC' = ~(~HC + ~m + m') (RFC 1624, equation 3)
+	u32 nSum = (u16) ~nChecksum;
+	nSum += (u16) ~nOldWord;
+	nSum += nNewWord;
+
+	return ~FoldResult (nSum);
+}
+
+u16 CChecksumCalculator::Update (u16 nChecksum, const void *pOldField, const void *pNewField,
+				 unsigned nLength)
+{
+	const TChecksumWord16 *pOld = (const TChecksumWord16 *) pOldField;
+	const TChecksumWord16 *pNew = (const TChecksumWord16 *) pNewField;
+	assert (pOld != 0);
+	assert (pNew != 0);
+	assert (nLength > 0);
+	assert (!(nLength & 1));
+
+	u32 nSum = (u16) ~nChecksum;
+	for (; nLength > 0; nLength -= 2)
+	{
+		nSum += (u16) ~*pOld++;
+		nSum += *pNew++;
+	}
+
+	return ~FoldResult (nSum);
+}
+
 u32 CChecksumCalculator::CalculateChunk (const void *pBuffer, unsigned nLength, u32 nChecksum)
 {
-	u16 *pBuffer16 = (u16 *) pBuffer;
-	assert (pBuffer16 != 0);
+	const u8 *pBuffer8 = (const u8 *) pBuffer;
+	assert (pBuffer8 != 0);
 	assert (nLength > 0);
 
-	while (nLength >= 2)
+	u64 nSum;
+	if (!((uintptr) pBuffer8 & 1))
+	{
+		nSum = SumWords (pBuffer8, nLength);
+	}
+	else
+	{
+		// The words are shifted by one byte here. The sum of byte-swapped words is
+		// the byte-swapped sum, so the first byte is added as the high byte of a word
+		// and the bytes of the folded result are swapped afterwards.
+		nSum = (u32) *pBuffer8 << 8;
+		if (nLength > 1)
+		{
+			nSum += SumWords (pBuffer8 + 1, nLength - 1);
+		}
+
+		u16 nFolded = FoldResult (Fold64 (nSum));
+		nSum = (u16) (nFolded << 8 | nFolded >> 8);
+	}
+
+	nSum += nChecksum;
+
+	return Fold64 (nSum);
+}
+
+// Returns the ones' complement sum of the little-endian 16-bit words in the buffer (not
+// folded yet). pBuffer must be 16-bit aligned. A last odd byte is added as the low byte.
+u64 CChecksumCalculator::SumWords (const u8 *pBuffer, unsigned nLength)
+{
+	assert (!((uintptr) pBuffer & 1));
+
+	u64 nSum = 0;
+
+#if defined (__aarch64__)
+	// align to 8 bytes first
+	while (   ((uintptr) pBuffer & 7)
+	       && nLength >= 2)
+	{
+		nSum += *(const TChecksumWord16 *) pBuffer;
+		pBuffer += 2;
+		nLength -= 2;
+	}
+
+	// Add 64-bit words with carry. The ones' complement sum of 64-bit words
+	// folds to the same 16-bit result as the sum of 16-bit words.
+	const TChecksumWord64 *pBuffer64 = (const TChecksumWord64 *) pBuffer;
+	for (; nLength >= 32; nLength -= 32, pBuffer64 += 4)
+	{
+		asm ("adds %0, %0, %1\n"
+		     "adcs %0, %0, %2\n"
+		     "adcs %0, %0, %3\n"
+		     "adcs %0, %0, %4\n"
+		     "adc %0, %0, xzr\n"
+		     : "+r" (nSum)
+		     : "r" (pBuffer64[0]), "r" (pBuffer64[1]),
+		       "r" (pBuffer64[2]), "r" (pBuffer64[3])
+		     : "cc");
+	}
+
+	for (; nLength >= 8; nLength -= 8, pBuffer64++)
+	{
+		asm ("adds %0, %0, %1\n"
+		     "adc %0, %0, xzr\n"
+		     : "+r" (nSum)
+		     : "r" (*pBuffer64)
+		     : "cc");
+	}
+
+	pBuffer = (const u8 *) pBuffer64;
+
+	nSum = Fold64 (nSum);		// the remaining words cannot overflow then
+#elif defined (__ARM_NEON)
+	// The NEON unit adds pairs of 16-bit words into eight 32-bit lanes. A block
+	// is limited in size, so that the lanes cannot overflow. Only d0-d7 are used,
+	// which need not be preserved across function calls.
+	while (nLength >= 32)
+	{
+		unsigned nBlock = nLength & ~31U;
+		if (nBlock > 0x8000)
+		{
+			nBlock = 0x8000;
+		}
+		nLength -= nBlock;
+
+		u32 nLow, nHigh;
+		asm volatile ("vmov.i32 q2, #0\n"
+			      "vmov.i32 q3, #0\n"
+			      "1: vld1.16 {d0-d3}, [%[buf]]!\n"
+			      "subs %[len], %[len], #32\n"
+			      "vpadal.u16 q2, q0\n"
+			      "vpadal.u16 q3, q1\n"
+			      "bne 1b\n"
+			      "vpaddl.u32 q2, q2\n"
+			      "vpadal.u32 q2, q3\n"
+			      "vadd.i64 d4, d4, d5\n"
+			      "vmov %[low], %[high], d4\n"
+			      : [buf] "+r" (pBuffer), [len] "+r" (nBlock),
+				[low] "=r" (nLow), [high] "=r" (nHigh)
+			      :
+			      : "cc", "memory", "d0", "d1", "d2", "d3", "d4", "d5", "d6", "d7");
+
+		nSum += (u64) nHigh << 32 | nLow;
+	}
+#else
+	// add 32-bit words into a 64-bit accumulator, which cannot overflow here
+	while (   ((uintptr) pBuffer & 3)
+	       && nLength >= 2)
 	{
-		nChecksum += *pBuffer16++;
+		nSum += *(const TChecksumWord16 *) pBuffer;
+		pBuffer += 2;
 		nLength -= 2;
 	}
 
+	const TChecksumWord32 *pBuffer32 = (const TChecksumWord32 *) pBuffer;
+	for (; nLength >= 16; nLength -= 16, pBuffer32 += 4)
+	{
+		nSum += pBuffer32[0];
+		nSum += pBuffer32[1];
+		nSum += pBuffer32[2];
+		nSum += pBuffer32[3];
+	}
+
+	for (; nLength >= 4; nLength -= 4)
+	{
+		nSum += *pBuffer32++;
+	}
+
+	pBuffer = (const u8 *) pBuffer32;
+#endif
+
+	for (; nLength >= 2; nLength -= 2, pBuffer += 2)
+	{
+		nSum += *(const TChecksumWord16 *) pBuffer;
+	}
+
 	assert (nLength <= 1);
 	if (nLength != 0)
 	{
-		nChecksum += *(u8 *) pBuffer16;
+		nSum += *pBuffer;
 	}
-	
-	return nChecksum;
+
+	return nSum;
 }
 
 u16 CChecksumCalculator::FoldResult (u32 nChecksum)
 {
-	u16 nHigh = nChecksum >> 16;
-	while (nHigh != 0)
-	{
-		nChecksum &= 0xFFFF;
-		nChecksum += nHigh;
+	nChecksum = (nChecksum & 0xFFFF) + (nChecksum >> 16);
+	nChecksum = (nChecksum & 0xFFFF) + (nChecksum >> 16);
 
-		nHigh = nChecksum >> 16;
-	}
-	
 	return (u16) nChecksum;
 }
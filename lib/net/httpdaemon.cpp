@@ -4,7 +4,7 @@
 // A simple HTTP webserver
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015-2021  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2015-2024  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -35,6 +35,12 @@
 
 #define HTTPD_STACK_SIZE	TASK_STACK_SIZE
 
+#define HTTPD_MAX_HEADER_SIZE	512
+
+// content, multipart and header buffer of a worker come from one allocation
+#define HTTPD_ARENA_SIZE(content, multipart)	\
+	((content) + (multipart) + HTTPD_MAX_HEADER_SIZE + 3*ARENA_ALIGN)
+
 static const char FromHTTPDaemon[] = "httpd";
 
 unsigned CHTTPDaemon::s_nInstanceCount = 0;
@@ -47,13 +53,15 @@ CHTTPDaemon::CHTTPDaemon (CNetSubSystem *pNetSubSystem, CSocket *pSocket,
 	m_nMaxContentSize (nMaxContentSize),
 	m_nPort (nPort),
 	m_nMaxMultipartSize (nMaxMultipartSize),
+	m_Arena (pSocket != 0 ? HTTPD_ARENA_SIZE (nMaxContentSize, nMaxMultipartSize) : 0),
 	m_pContentBuffer (0)
 {
 	s_nInstanceCount++;
 
-	if (m_nMaxContentSize > 0)
+	if (   pSocket != 0
+	    && m_nMaxContentSize > 0)
 	{
-		m_pContentBuffer = new u8[m_nMaxContentSize];
+		m_pContentBuffer = m_Arena.AllocateArray<u8> (m_nMaxContentSize);
 		assert (m_pContentBuffer != 0);
 	}
 
@@ -74,8 +82,7 @@ CHTTPDaemon::~CHTTPDaemon (void)
 {
 	assert (m_pSocket == 0);
 
-	delete m_pContentBuffer;
-	m_pContentBuffer = 0;
+	m_pContentBuffer = 0;		// freed with m_Arena
 
 	m_pNetSubSystem = 0;
 
@@ -196,8 +203,7 @@ void CHTTPDaemon::Worker (void)
 		assert (nContentLength <= m_nMaxContentSize);
 		assert (pContentType != 0);
 
-		delete [] m_pMultipartBuffer;
-		m_pMultipartBuffer = 0;
+		m_pMultipartBuffer = 0;		// freed with m_Arena
 	}
 
 	if (Status != HTTPOK)
@@ -214,21 +220,22 @@ void CHTTPDaemon::Worker (void)
 		default:			pStatusMsg = "Unknown Error";			break;
 		}
 
-		CString ErrorPage;
-		ErrorPage.Format ("<!DOCTYPE html>\n"
-				  "<html>\n"
-				  "<head><title>%u %s</title></head>\n"
-				  "<body><h1>%s</h1></body>\n"
-				  "</html>\n", Status, pStatusMsg, pStatusMsg);
-
-		nContentLength = ErrorPage.GetLength ();
-		if (nContentLength > m_nMaxContentSize)
-		{
-			nContentLength = m_nMaxContentSize;
-		}
-
 		assert (m_pContentBuffer != 0);
-		memcpy (m_pContentBuffer, (const char *) ErrorPage, nContentLength);
+		char *pPage = (char *) m_pContentBuffer;
+		const char *pPageEnd = pPage + m_nMaxContentSize;
+		AppendString (&pPage, pPageEnd, "<!DOCTYPE html>\n"
+						  "<html>\n"
+						  "<head><title>");
+		AppendNumber (&pPage, pPageEnd, Status);
+		AppendString (&pPage, pPageEnd, " ");
+		AppendString (&pPage, pPageEnd, pStatusMsg);
+		AppendString (&pPage, pPageEnd, "</title></head>\n"
+						  "<body><h1>");
+		AppendString (&pPage, pPageEnd, pStatusMsg);
+		AppendString (&pPage, pPageEnd, "</h1></body>\n"
+						  "</html>\n");
+
+		nContentLength = pPage - (char *) m_pContentBuffer;
 		pContentType = "text/html";	// may has been changed by GetContent()
 	}
 
@@ -246,15 +253,26 @@ void CHTTPDaemon::Worker (void)
 	WriteAccessLog (ClientIP, m_RequestMethod, m_RequestURI, Status, nContentLength);
 
 	// send HTTP response header
-	CString Header;
-	Header.Format ("HTTP/1.1 %u %s\r\n"
-		       "Server: " SERVER "\r\n"
-		       "Content-Type: %s\r\n"
-		       "Content-Length: %u\r\n"
-		       "Connection: close\r\n"
-		       "\r\n", Status, pStatusMsg, pContentType, nContentLength);
-
-	if (m_pSocket->Send ((const char *) Header, Header.GetLength (), MSG_DONTWAIT) < 0)
+	char *pHeader = m_Arena.AllocateArray<char> (HTTPD_MAX_HEADER_SIZE);
+	assert (pHeader != 0);
+	char *pHeaderPtr = pHeader;
+	const char *pHeaderEnd = pHeader + HTTPD_MAX_HEADER_SIZE;
+	AppendString (&pHeaderPtr, pHeaderEnd, "HTTP/1.1 ");
+	AppendNumber (&pHeaderPtr, pHeaderEnd, Status);
+	AppendString (&pHeaderPtr, pHeaderEnd, " ");
+	AppendString (&pHeaderPtr, pHeaderEnd, pStatusMsg);
+	AppendString (&pHeaderPtr, pHeaderEnd, "\r\n"
+					       "Server: " SERVER "\r\n"
+					       "Content-Type: ");
+	AppendString (&pHeaderPtr, pHeaderEnd, pContentType);
+	AppendString (&pHeaderPtr, pHeaderEnd, "\r\n"
+					       "Content-Length: ");
+	AppendNumber (&pHeaderPtr, pHeaderEnd, nContentLength);
+	AppendString (&pHeaderPtr, pHeaderEnd, "\r\n"
+					       "Connection: close\r\n"
+					       "\r\n");
+
+	if (m_pSocket->Send (pHeader, pHeaderPtr - pHeader, MSG_DONTWAIT) < 0)
 	{
 		CLogger::Get ()->Write (FromHTTPDaemon, LogError, "Cannot send response header");
 
@@ -354,7 +372,8 @@ THTTPStatus CHTTPDaemon::ParseRequest (void)
 							if (m_nMultipartContentLength <= m_nMaxMultipartSize)
 							{
 								assert (m_pMultipartBuffer == 0);
-								m_pMultipartBuffer = new char[m_nMultipartContentLength];
+								m_pMultipartBuffer = m_Arena.AllocateArray<char> (
+											m_nMultipartContentLength);
 								if (m_pMultipartBuffer == 0)
 								{
 									Status = HTTPInternalServerError;
@@ -675,7 +694,6 @@ boolean CHTTPDaemon::GetMultipartFormPart (const char **ppHeader,
 	return TRUE;
 }
 
-// TODO: optimize
 void *CHTTPDaemon::Search (const void *pBuffer, unsigned nBufLen,
 			   const void *pNeedle, unsigned nNeedleLen)
 {
@@ -685,17 +703,56 @@ void *CHTTPDaemon::Search (const void *pBuffer, unsigned nBufLen,
 	}
 
 	const u8 *puchBuffer = (const u8 *) pBuffer;
+	const u8 *puchEnd = puchBuffer + nBufLen;
 	const u8 *puchNeedle = (const u8 *) pNeedle;
-	while (nNeedleLen <= nBufLen)
+	while (nNeedleLen <= (unsigned) (puchEnd - puchBuffer))
 	{
-		if (!memcmp (puchBuffer, puchNeedle, nNeedleLen))
+		// find the next candidate with the first byte of the needle
+		puchBuffer = (const u8 *) memchr (puchBuffer, puchNeedle[0],
+						  puchEnd - puchBuffer - nNeedleLen + 1);
+		if (puchBuffer == 0)
+		{
+			break;
+		}
+
+		if (!memcmp (puchBuffer+1, puchNeedle+1, nNeedleLen-1))
 		{
 			return (void *) puchBuffer;
 		}
 
 		puchBuffer++;
-		nBufLen--;
 	}
 
 	return 0;
 }
+
+void CHTTPDaemon::AppendString (char **ppDest, const char *pEnd, const char *pString)
+{
+	assert (ppDest != 0);
+	assert (pString != 0);
+
+	char *pDest = *ppDest;
+	while (   *pString != '\0'
+	       && pDest < pEnd)
+	{
+		*pDest++ = *pString++;
+	}
+
+	*ppDest = pDest;
+}
+
+void CHTTPDaemon::AppendNumber (char **ppDest, const char *pEnd, unsigned nNumber)
+{
+	char Buffer[12];
+	char *p = Buffer + sizeof Buffer;
+	*--p = '\0';
+
+	do
+	{
+		*--p = '0' + nNumber % 10;
+		nNumber /= 10;
+	}
+	while (nNumber != 0);
+
+	AppendString (ppDest, pEnd, p);
+}
@@ -111,11 +111,13 @@ void CICMPHandler::Process (void)
 		{
 			if (pICMPHeader->nCode == ICMP_CODE_ECHO)
 			{
-				// packet will be used in place to send it back
+				// packet will be used in place to send it back,
+				// only the type changes, so the checksum is updated
+				TICMPHeader OldHeader = *pICMPHeader;
 				pICMPHeader->nType     = ICMP_TYPE_ECHO_REPLY;
 				pICMPHeader->nCode     = ICMP_CODE_ECHO;
-				pICMPHeader->nChecksum = 0;
-				pICMPHeader->nChecksum = CChecksumCalculator::SimpleCalculate (Buffer, nLength);
+				pICMPHeader->nChecksum = CChecksumCalculator::Update (OldHeader.nChecksum,
+										      &OldHeader, pICMPHeader, 2);
 
 				assert (m_pNetworkLayer != 0);
 				m_pNetworkLayer->Send (SourceIP, Buffer, nLength, IPPROTO_ICMP);
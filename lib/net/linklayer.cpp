@@ -20,6 +20,7 @@
 #include <circle/net/linklayer.h>
 #include <circle/net/networklayer.h>
 #include <circle/util.h>
+#include <circle/sysconfig.h>
 #include <assert.h>
 
 struct TRawPrivateData
@@ -32,6 +33,9 @@ CLinkLayer::CLinkLayer (CNetConfig *pNetConfig, CNetDeviceLayer *pNetDevLayer)
 	m_pNetDevLayer (pNetDevLayer),
 	m_pNetworkLayer (0),
 	m_pARPHandler (0),
+	m_ARPRxQueue (NET_QUEUE_DEPTH),
+	m_IPRxQueue (NET_QUEUE_DEPTH),
+	m_RawRxQueue (NET_QUEUE_DEPTH),
 	m_nRawProtocolType (0)
 {
 	assert (m_pNetConfig != 0);
@@ -73,49 +77,65 @@ void CLinkLayer::Process (void)
 		return;
 	}
 
+	// the frames are processed in bursts, IP packets are queued with one lock acquisition
+	CNetBuffer *Buffers[NET_DEVICE_BATCH_SIZE];
+	unsigned nBuffers;
 	assert (m_pNetDevLayer != 0);
-	u8 Buffer[FRAME_BUFFER_SIZE];
-	unsigned nLength;
-	while (m_pNetDevLayer->Receive (Buffer, &nLength))
+	while ((nBuffers = m_pNetDevLayer->Receive (Buffers, NET_DEVICE_BATCH_SIZE)) != 0)
 	{
-		assert (nLength <= FRAME_BUFFER_SIZE);
-		if (nLength <= sizeof (TEthernetHeader))
-		{
-			continue;
-		}
-		TEthernetHeader *pHeader = (TEthernetHeader *) Buffer;
-
-		CMACAddress MACAddressReceiver (pHeader->MACReceiver);
-		if (    MACAddressReceiver != *pOwnMACAddress
-		    && !MACAddressReceiver.IsBroadcast ())
-		{
-			continue;
-		}
+		CNetBuffer *IPBuffers[NET_DEVICE_BATCH_SIZE];
+		unsigned nIPBuffers = 0;
 
-		nLength -= sizeof (TEthernetHeader);
-		assert (nLength > 0);
-		
-		switch (pHeader->nProtocolType)
+		for (unsigned i = 0; i < nBuffers; i++)
 		{
-		case BE (ETH_PROT_IP):
-			m_IPRxQueue.Enqueue (Buffer+sizeof (TEthernetHeader), nLength);
-			break;
+			CNetBuffer *pBuffer = Buffers[i];
+			assert (pBuffer != 0);
+			assert (pBuffer->GetLength () <= FRAME_BUFFER_SIZE);
+			TEthernetHeader *pHeader = (TEthernetHeader *) pBuffer->GetData ();
+
+			CMACAddress MACAddressReceiver (pHeader->MACReceiver);
+			if (   !pBuffer->RemoveHeader (sizeof (TEthernetHeader))
+			    || (    MACAddressReceiver != *pOwnMACAddress
+			        && !MACAddressReceiver.IsBroadcast ()))
+			{
+				pBuffer->Release ();
 
-		case BE (ETH_PROT_ARP):
-			m_ARPRxQueue.Enqueue (Buffer+sizeof (TEthernetHeader), nLength);
-			break;
+				continue;
+			}
 
-		default:
-			if (pHeader->nProtocolType == m_nRawProtocolType)
+			switch (pHeader->nProtocolType)
 			{
-				TRawPrivateData *pParam = new TRawPrivateData;
-				assert (pParam != 0);
-				memcpy (pParam->MACSender, pHeader->MACSender, MAC_ADDRESS_SIZE);
-
-				m_RawRxQueue.Enqueue (Buffer+sizeof (TEthernetHeader),
-						      nLength, pParam);
+			case BE (ETH_PROT_IP):
+				IPBuffers[nIPBuffers++] = pBuffer;
+				break;
+
+			case BE (ETH_PROT_ARP):
+				m_ARPRxQueue.EnqueueBuffer (pBuffer);
+				break;
+
+			default:
+				if (pHeader->nProtocolType == m_nRawProtocolType)
+				{
+					TRawPrivateData *pParam = new TRawPrivateData;
+					assert (pParam != 0);
+					memcpy (pParam->MACSender, pHeader->MACSender, MAC_ADDRESS_SIZE);
+
+					if (!m_RawRxQueue.EnqueueBuffer (pBuffer, pParam))
+					{
+						delete pParam;
+					}
+				}
+				else
+				{
+					pBuffer->Release ();
+				}
+				break;
 			}
-			break;
+		}
+
+		if (nIPBuffers > 0)
+		{
+			m_IPRxQueue.EnqueueBuffers (IPBuffers, nIPBuffers);
 		}
 	}
 
@@ -125,15 +145,41 @@ void CLinkLayer::Process (void)
 
 boolean CLinkLayer::Send (const CIPAddress &rReceiver, const void *pIPPacket, unsigned nLength)
 {
-	unsigned nFrameLength = sizeof (TEthernetHeader) + nLength;	// may wrap
+	if (   nLength == 0
+	    || nLength > FRAME_BUFFER_SIZE)
+	{
+		return FALSE;
+	}
+
+	assert (pIPPacket != 0);
+	CNetBuffer *pBuffer = CNetBuffer::Allocate (pIPPacket, nLength);
+	if (pBuffer == 0)
+	{
+		return FALSE;
+	}
+
+	return Send (rReceiver, pBuffer);
+}
+
+boolean CLinkLayer::Send (const CIPAddress &rReceiver, CNetBuffer *pIPPacket)
+{
+	assert (pIPPacket != 0);
+	unsigned nFrameLength = sizeof (TEthernetHeader) + pIPPacket->GetLength ();
 	if (   nFrameLength <= sizeof (TEthernetHeader)
 	    || nFrameLength > FRAME_BUFFER_SIZE)
 	{
+		pIPPacket->Release ();
+
 		return FALSE;
 	}
 
-	u8 FrameBuffer[nFrameLength];
-	TEthernetHeader *pHeader = (TEthernetHeader *) FrameBuffer;
+	TEthernetHeader *pHeader = (TEthernetHeader *) pIPPacket->AddHeader (sizeof (TEthernetHeader));
+	if (pHeader == 0)
+	{
+		pIPPacket->Release ();
+
+		return FALSE;
+	}
 
 	assert (m_pNetDevLayer != 0);
 	const CMACAddress *pOwnMACAddress = m_pNetDevLayer->GetMACAddress ();
@@ -142,10 +188,6 @@ boolean CLinkLayer::Send (const CIPAddress &rReceiver, const void *pIPPacket, un
 
 	pHeader->nProtocolType = BE (ETH_PROT_IP);
 
-	assert (pIPPacket != 0);
-	assert (nLength > 0);
-	memcpy (FrameBuffer+sizeof (TEthernetHeader), pIPPacket, nLength);
-
 	assert (m_pNetConfig != 0);
 	assert (m_pARPHandler != 0);
 	CMACAddress MACAddressReceiver;
@@ -155,14 +197,16 @@ boolean CLinkLayer::Send (const CIPAddress &rReceiver, const void *pIPPacket, un
 		MACAddressReceiver.SetBroadcast ();
 	}
 	else if (!m_pARPHandler->Resolve (rReceiver, &MACAddressReceiver,
-					  FrameBuffer, nFrameLength))
+					  pHeader, nFrameLength))
 	{
+		pIPPacket->Release ();
+
 		return TRUE;		// packet will be retransmitted by ARP handler
 	}
 
 	MACAddressReceiver.CopyTo (pHeader->MACReceiver);
 
-	m_pNetDevLayer->Send (FrameBuffer, nFrameLength);
+	m_pNetDevLayer->Send (pIPPacket);
 
 	return TRUE;
 }
@@ -176,6 +220,29 @@ boolean CLinkLayer::Receive (void *pBuffer, unsigned *pResultLength)
 	return *pResultLength != 0 ? TRUE : FALSE;
 }
 
+CNetBuffer *CLinkLayer::Receive (void)
+{
+	return m_IPRxQueue.DequeueBuffer ();
+}
+
+unsigned CLinkLayer::Receive (CNetBuffer **ppBuffers, unsigned nMaxBuffers)
+{
+	return m_IPRxQueue.DequeueBuffers (ppBuffers, nMaxBuffers);
+}
+
+unsigned CLinkLayer::GetRxDropped (void) const
+{
+	return   m_ARPRxQueue.GetDropped ()
+	       + m_IPRxQueue.GetDropped ()
+	       + m_RawRxQueue.GetDropped ();
+}
+
+unsigned CLinkLayer::GetDeviceFeatures (void) const
+{
+	assert (m_pNetDevLayer != 0);
+	return m_pNetDevLayer->GetFeatures ();
+}
+
 boolean CLinkLayer::SendRaw (const void *pFrame, unsigned nLength)
 {
 	assert (pFrame != 0);
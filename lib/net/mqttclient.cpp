@@ -49,6 +49,10 @@ const char *CMQTTClient::s_pErrorMsg[MQTTDisconnectUnknown+1] =
 
 static const char FromMQTTClient[] = "mqtt";
 
+// control packets (without payload) are built on the stack of the calling task
+#define CONTROL_PACKET_SIZE	128
+#define CONTROL_ARENA_SIZE	(CONTROL_PACKET_SIZE + ARENA_ALIGN)
+
 CMQTTClient::CMQTTClient (CNetSubSystem *pNetSubSystem, size_t nMaxPacketSize,
 			  size_t nMaxPacketsQueued, size_t nMaxTopicSize)
 :	m_pNetSubSystem (pNetSubSystem),
@@ -57,7 +61,9 @@ CMQTTClient::CMQTTClient (CNetSubSystem *pNetSubSystem, size_t nMaxPacketSize,
 	m_pTimer (CTimer::Get ()),
 	m_pSocket (0),
 	m_ConnectStatus (MQTTStatusDisconnected),
-	m_ReceivePacket (nMaxPacketSize, nMaxPacketsQueued)
+	m_ReceivePacket (nMaxPacketSize, nMaxPacketsQueued),
+	m_PacketArena (nMaxPacketSize + ARENA_ALIGN),
+	m_bPacketArenaInUse (FALSE)
 {
 	SetName (FromMQTTClient);
 
@@ -191,7 +197,8 @@ void CMQTTClient::Connect (const char *pHost, u16 usPort, const char *pClientIde
 		}
 	}
 
-	CMQTTSendPacket Packet (MQTTConnect, m_nMaxPacketSize);
+	CArena *pArena = ClaimPacketArena ();
+	CMQTTSendPacket Packet (MQTTConnect, m_nMaxPacketSize, pArena);
 	Packet.AppendString ("MQTT");
 	Packet.AppendByte (MQTT_PROTOCOL_LEVEL);
 	Packet.AppendByte (uchConnectFlags);
@@ -221,7 +228,10 @@ void CMQTTClient::Connect (const char *pHost, u16 usPort, const char *pClientIde
 		}
 	}
 
-	if (!SendPacket (&Packet))
+	boolean bOK = SendPacket (&Packet);
+	ReleasePacketArena (pArena);
+
+	if (!bOK)
 	{
 		CloseConnection (MQTTDisconnectSendFailed);
 
@@ -233,7 +243,9 @@ void CMQTTClient::Disconnect (boolean bForce)
 {
 	if (!bForce)
 	{
-		CMQTTSendPacket Packet (MQTTDisconnect);
+		u8 ArenaBuffer[CONTROL_ARENA_SIZE];
+		CArena Arena (ArenaBuffer, sizeof ArenaBuffer);
+		CMQTTSendPacket Packet (MQTTDisconnect, CONTROL_PACKET_SIZE, &Arena);
 
 		SendPacket (&Packet);
 	}
@@ -252,7 +264,7 @@ void CMQTTClient::Subscribe (const char *pTopic, u8 uchQoS)
 		m_usNextPacketIdentifier++;
 	}
 
-	CMQTTSendPacket *pPacket = new CMQTTSendPacket (MQTTSubscribe, m_nMaxPacketSize);
+	CMQTTSendPacket *pPacket = CMQTTSendPacket::Create (MQTTSubscribe, m_nMaxPacketSize);
 	assert (pPacket != 0);
 
 	pPacket->AppendWord (usPacketIdentifier);
@@ -284,7 +296,7 @@ void CMQTTClient::Unsubscribe (const char *pTopic)
 		m_usNextPacketIdentifier++;
 	}
 
-	CMQTTSendPacket *pPacket = new CMQTTSendPacket (MQTTUnsubscribe, m_nMaxPacketSize);
+	CMQTTSendPacket *pPacket = CMQTTSendPacket::Create (MQTTUnsubscribe, m_nMaxPacketSize);
 	assert (pPacket != 0);
 
 	pPacket->AppendWord (usPacketIdentifier);
@@ -323,7 +335,34 @@ void CMQTTClient::Publish (const char *pTopic, const u8 *pPayload, size_t nPaylo
 		m_usNextPacketIdentifier++;
 	}
 
-	CMQTTSendPacket *pPacket = new CMQTTSendPacket (MQTTPublish, m_nMaxPacketSize);
+	if (uchQoS == MQTT_QOS_AT_MOST_ONCE)
+	{
+		// not queued for retransmission, so build it in scratch memory
+		CArena *pArena = ClaimPacketArena ();
+		CMQTTSendPacket Packet (MQTTPublish, m_nMaxPacketSize, pArena);
+
+		Packet.SetFlags (uchFlags);
+		Packet.AppendString (pTopic);
+		Packet.AppendWord (usPacketIdentifier);
+
+		if (nPayloadLength > 0)
+		{
+			assert (pPayload != 0);
+			Packet.AppendData (pPayload, nPayloadLength);
+		}
+
+		boolean bOK = SendPacket (&Packet);
+		ReleasePacketArena (pArena);
+
+		if (!bOK)
+		{
+			CloseConnection (MQTTDisconnectSendFailed);
+		}
+
+		return;
+	}
+
+	CMQTTSendPacket *pPacket = CMQTTSendPacket::Create (MQTTPublish, m_nMaxPacketSize);
 	assert (pPacket != 0);
 
 	pPacket->SetFlags (uchFlags);
@@ -345,17 +384,10 @@ void CMQTTClient::Publish (const char *pTopic, const u8 *pPayload, size_t nPaylo
 		return;
 	}
 
-	if (uchQoS >= MQTT_QOS_AT_LEAST_ONCE)
-	{
-		pPacket->SetQoS (uchQoS);
-		pPacket->SetPacketIdentifier (usPacketIdentifier);
+	pPacket->SetQoS (uchQoS);
+	pPacket->SetPacketIdentifier (usPacketIdentifier);
 
-		InsertPacketIntoQueue (pPacket, m_pTimer->GetTicks () + MQTT_RESEND_TIMEOUT);
-	}
-	else
-	{
-		delete pPacket;
-	}
+	InsertPacketIntoQueue (pPacket, m_pTimer->GetTicks () + MQTT_RESEND_TIMEOUT);
 }
 
 void CMQTTClient::Run (void)
@@ -478,7 +510,9 @@ void CMQTTClient::Receiver (void)
 			}
 			else if (uchQoS == MQTT_QOS_AT_LEAST_ONCE)
 			{
-				CMQTTSendPacket Packet (MQTTPubAck);
+				u8 ArenaBuffer[CONTROL_ARENA_SIZE];
+				CArena Arena (ArenaBuffer, sizeof ArenaBuffer);
+				CMQTTSendPacket Packet (MQTTPubAck, CONTROL_PACKET_SIZE, &Arena);
 				Packet.AppendWord (usPacketIdentifier);
 
 				if (!SendPacket (&Packet))
@@ -492,7 +526,9 @@ void CMQTTClient::Receiver (void)
 			}
 			else if (uchQoS == MQTT_QOS_EXACTLY_ONCE)
 			{
-				CMQTTSendPacket Packet (MQTTPubRec);
+				u8 ArenaBuffer[CONTROL_ARENA_SIZE];
+				CArena Arena (ArenaBuffer, sizeof ArenaBuffer);
+				CMQTTSendPacket Packet (MQTTPubRec, CONTROL_PACKET_SIZE, &Arena);
 				Packet.AppendWord (usPacketIdentifier);
 
 				if (!SendPacket (&Packet))
@@ -542,7 +578,7 @@ void CMQTTClient::Receiver (void)
 
 			delete pPacket;
 
-			pPacket = new CMQTTSendPacket (MQTTPubRel);
+			pPacket = CMQTTSendPacket::Create (MQTTPubRel, 128);
 			assert (pPacket != 0);
 			pPacket->AppendWord (usPacketIdentifier);
 
@@ -571,7 +607,9 @@ void CMQTTClient::Receiver (void)
 				break;
 			}
 
-			CMQTTSendPacket Packet (MQTTPubComp);
+			u8 ArenaBuffer[CONTROL_ARENA_SIZE];
+			CArena Arena (ArenaBuffer, sizeof ArenaBuffer);
+			CMQTTSendPacket Packet (MQTTPubComp, CONTROL_PACKET_SIZE, &Arena);
 			Packet.AppendWord (usPacketIdentifier);
 
 			if (!SendPacket (&Packet))
@@ -702,7 +740,9 @@ void CMQTTClient::KeepAliveHandler (void)
 
 		if (m_ConnectStatus == MQTTStatusConnected)
 		{
-			CMQTTSendPacket Packet (MQTTPingReq);
+			u8 ArenaBuffer[CONTROL_ARENA_SIZE];
+			CArena Arena (ArenaBuffer, sizeof ArenaBuffer);
+			CMQTTSendPacket Packet (MQTTPingReq, CONTROL_PACKET_SIZE, &Arena);
 
 			if (!SendPacket (&Packet))
 			{
@@ -796,6 +836,33 @@ boolean CMQTTClient::SendPacket (CMQTTSendPacket *pPacket)
 	return TRUE;
 }
 
+CArena *CMQTTClient::ClaimPacketArena (void)
+{
+	// the arena is claimed across the blocking SendPacket(), meanwhile another
+	// task or a nested Publish() from OnMessage() must not use it
+	if (m_bPacketArenaInUse)
+	{
+		return 0;			// the packet is allocated from the heap
+	}
+
+	m_bPacketArenaInUse = TRUE;
+
+	return &m_PacketArena;
+}
+
+void CMQTTClient::ReleasePacketArena (CArena *pArena)
+{
+	if (pArena == 0)
+	{
+		return;
+	}
+
+	assert (pArena == &m_PacketArena);
+	assert (m_bPacketArenaInUse);
+	m_PacketArena.Reset ();
+	m_bPacketArenaInUse = FALSE;
+}
+
 void CMQTTClient::InsertPacketIntoQueue (CMQTTSendPacket *pPacket, unsigned nScheduledTime)
 {
 	assert (pPacket != 0);
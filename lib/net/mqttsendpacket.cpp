@@ -2,7 +2,7 @@
 // mqttsendpacket.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2018  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2018-2024  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -24,16 +24,28 @@
 
 #define MAX_LENGTH_FIXED_HEADER		5
 
-CMQTTSendPacket::CMQTTSendPacket (TMQTTPacketType Type, size_t nMaxPacketSize)
+CMQTTSendPacket::CMQTTSendPacket (TMQTTPacketType Type, size_t nMaxPacketSize, CArena *pArena)
 :	m_Type (Type),
 	m_nMaxPacketSize (nMaxPacketSize),
 	m_bError (FALSE),
+	m_bOwnBuffer (FALSE),
 	m_nBufPtr (MAX_LENGTH_FIXED_HEADER),
 	m_uchFlags (0),
 	m_nSendTries (MQTT_SEND_TRIES)
 {
 	assert (m_nMaxPacketSize >= 128);
-	m_pBuffer = new u8[m_nMaxPacketSize];
+	m_pBuffer = 0;
+	if (pArena != 0)
+	{
+		m_pBuffer = pArena->AllocateArray<u8> (m_nMaxPacketSize);
+	}
+
+	if (m_pBuffer == 0)		// no arena given or arena exhausted
+	{
+		m_pBuffer = new u8[m_nMaxPacketSize];
+		m_bOwnBuffer = TRUE;
+	}
+
 	if (m_pBuffer == 0)
 	{
 		m_bError = TRUE;
@@ -51,10 +63,39 @@ CMQTTSendPacket::CMQTTSendPacket (TMQTTPacketType Type, size_t nMaxPacketSize)
 
 CMQTTSendPacket::~CMQTTSendPacket (void)
 {
-	delete [] m_pBuffer;
+	if (m_bOwnBuffer)
+	{
+		delete [] m_pBuffer;
+	}
+
 	m_pBuffer = 0;
 }
 
+CMQTTSendPacket *CMQTTSendPacket::Create (TMQTTPacketType Type, size_t nMaxPacketSize)
+{
+	size_t nBlockSize = ((sizeof (CMQTTSendPacket) + ARENA_ALIGN-1) & ~(ARENA_ALIGN-1))
+			    + nMaxPacketSize;
+	void *pBlock = ::operator new (nBlockSize);
+	if (pBlock == 0)
+	{
+		return 0;
+	}
+
+	// the packet is placed at the start of the block, so that the block is
+	// freed by our operator delete, the buffer follows in the same block
+	CArena Arena (pBlock, nBlockSize);
+	CMQTTSendPacket *pPacket = Arena.New<CMQTTSendPacket> (Type, nMaxPacketSize, &Arena);
+	assert (pPacket == pBlock);
+	assert (Arena.GetFreeSpace () == 0);
+
+	return pPacket;
+}
+
+void CMQTTSendPacket::operator delete (void *pBlock)
+{
+	::operator delete (pBlock);
+}
+
 void CMQTTSendPacket::SetFlags (u8 uchFlags)
 {
 	assert (m_Type == MQTTPublish);
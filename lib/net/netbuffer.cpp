@@ -0,0 +1,215 @@
+//
+// netbuffer.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/net/netbuffer.h>
+#include <circle/atomic.h>
+#include <circle/alloc.h>
+#include <circle/new.h>
+#include <circle/util.h>
+#include <assert.h>
+
+CNetBuffer *CNetBuffer::s_pPool = 0;
+unsigned CNetBuffer::s_nPoolSize = 0;
+CNetBuffer *CNetBuffer::s_pFreeList = 0;
+unsigned CNetBuffer::s_nPoolFree = 0;
+unsigned CNetBuffer::s_nPoolMinFree = 0;
+unsigned CNetBuffer::s_nHeapAllocations = 0;
+CSpinLock CNetBuffer::s_PoolSpinLock (TASK_LEVEL);
+
+CNetBuffer::CNetBuffer (unsigned nHeadroom)
+:	m_nRefCount (1),
+	m_pData (m_Buffer + nHeadroom),
+	m_nLength (0),
+	m_bChecksumVerified (FALSE),
+	m_pNext (0),
+	m_pParam (0)
+{
+	assert (nHeadroom <= NET_BUFFER_HEADROOM);
+}
+
+CNetBuffer::~CNetBuffer (void)
+{
+	assert (m_nRefCount == 0);
+	m_pData = 0;
+}
+
+boolean CNetBuffer::InitPool (unsigned nBuffers)
+{
+	assert (s_pPool == 0);
+	assert (nBuffers > 0);
+
+	// the slots are cache-line aligned, because sizeof (CNetBuffer) is a multiple of it
+	s_pPool = (CNetBuffer *) memalign (DATA_CACHE_LINE_LENGTH_MAX,
+					   sizeof (CNetBuffer) * nBuffers);
+	if (s_pPool == 0)
+	{
+		return FALSE;
+	}
+
+	s_PoolSpinLock.Acquire ();
+
+	for (unsigned i = 0; i < nBuffers; i++)
+	{
+		s_pPool[i].m_pNext = s_pFreeList;
+		s_pFreeList = &s_pPool[i];
+	}
+
+	s_nPoolSize = nBuffers;
+	s_nPoolFree = nBuffers;
+	s_nPoolMinFree = nBuffers;
+
+	s_PoolSpinLock.Release ();
+
+	return TRUE;
+}
+
+void CNetBuffer::GetStatistics (TNetBufferStatistics *pStatistics)
+{
+	assert (pStatistics != 0);
+
+	s_PoolSpinLock.Acquire ();
+
+	pStatistics->nPoolSize = s_nPoolSize;
+	pStatistics->nPoolFree = s_nPoolFree;
+	pStatistics->nPoolMinFree = s_nPoolMinFree;
+	pStatistics->nHeapAllocations = s_nHeapAllocations;
+
+	s_PoolSpinLock.Release ();
+}
+
+CNetBuffer *CNetBuffer::Allocate (unsigned nHeadroom)
+{
+	if (s_pPool != 0)
+	{
+		s_PoolSpinLock.Acquire ();
+
+		CNetBuffer *pSlot = s_pFreeList;
+		if (pSlot != 0)
+		{
+			s_pFreeList = pSlot->m_pNext;
+
+			if (--s_nPoolFree < s_nPoolMinFree)
+			{
+				s_nPoolMinFree = s_nPoolFree;
+			}
+		}
+		else
+		{
+			s_nHeapAllocations++;
+		}
+
+		s_PoolSpinLock.Release ();
+
+		if (pSlot != 0)
+		{
+			return new (pSlot) CNetBuffer (nHeadroom);
+		}
+	}
+
+	return new CNetBuffer (nHeadroom);
+}
+
+CNetBuffer *CNetBuffer::Allocate (const void *pData, unsigned nLength, unsigned nHeadroom)
+{
+	CNetBuffer *pBuffer = Allocate (nHeadroom);
+	if (pBuffer == 0)
+	{
+		return 0;
+	}
+
+	assert (pData != 0);
+	assert (nLength <= FRAME_BUFFER_SIZE);
+	memcpy (pBuffer->m_pData, pData, nLength);
+	pBuffer->m_nLength = nLength;
+
+	return pBuffer;
+}
+
+void CNetBuffer::AddRef (void)
+{
+	assert (m_nRefCount > 0);
+	AtomicIncrement (&m_nRefCount);
+}
+
+void CNetBuffer::Release (void)
+{
+	assert (m_nRefCount > 0);
+	if (AtomicDecrement (&m_nRefCount) != 0)
+	{
+		return;
+	}
+
+	if (!IsPooled (this))
+	{
+		delete this;
+
+		return;
+	}
+
+	this->~CNetBuffer ();
+
+	s_PoolSpinLock.Acquire ();
+
+	m_pNext = s_pFreeList;
+	s_pFreeList = this;
+
+	s_nPoolFree++;
+	assert (s_nPoolFree <= s_nPoolSize);
+
+	s_PoolSpinLock.Release ();
+}
+
+void CNetBuffer::SetLength (unsigned nLength)
+{
+	assert (nLength <= m_nLength + GetTailroom ());
+	m_nLength = nLength;
+}
+
+void *CNetBuffer::AddHeader (unsigned nLength)
+{
+	if (nLength > GetHeadroom ())
+	{
+		return 0;
+	}
+
+	m_pData -= nLength;
+	m_nLength += nLength;
+
+	return m_pData;
+}
+
+boolean CNetBuffer::RemoveHeader (unsigned nLength)
+{
+	if (nLength >= m_nLength)
+	{
+		return FALSE;
+	}
+
+	m_pData += nLength;
+	m_nLength -= nLength;
+
+	return TRUE;
+}
+
+boolean CNetBuffer::IsPooled (const CNetBuffer *pBuffer)
+{
+	return    s_pPool != 0
+	       && s_pPool <= pBuffer
+	       && pBuffer < s_pPool + s_nPoolSize;
+}
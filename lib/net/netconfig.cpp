@@ -18,9 +18,11 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/net/netconfig.h>
+#include <assert.h>
 
 CNetConfig::CNetConfig (void)
-:	m_bUseDHCP (TRUE)
+:	m_SeqLock (TASK_LEVEL),
+	m_bUseDHCP (TRUE)
 {
 	Reset ();
 }
@@ -33,12 +35,16 @@ void CNetConfig::Reset (void)
 {
 	static const u8 NullAddress[] = {0, 0, 0, 0};
 
+	m_SeqLock.WriteAcquire ();
+
 	m_IPAddress.Set (NullAddress);
 	m_NetMask.Set (NullAddress);
 	m_DefaultGateway.Set (NullAddress);
 	m_DNSServer.Set (NullAddress);
 
 	UpdateBroadcastAddress ();
+
+	m_SeqLock.WriteRelease ();
 }
 
 void CNetConfig::SetDHCP (boolean bUsed)
@@ -48,50 +54,82 @@ void CNetConfig::SetDHCP (boolean bUsed)
 
 void CNetConfig::SetIPAddress (u32 nAddress)
 {
+	m_SeqLock.WriteAcquire ();
+
 	m_IPAddress.Set (nAddress);
 
 	UpdateBroadcastAddress ();
+
+	m_SeqLock.WriteRelease ();
 }
 
 void CNetConfig::SetNetMask (u32 nNetMask)
 {
+	m_SeqLock.WriteAcquire ();
+
 	m_NetMask.Set (nNetMask);
 
 	UpdateBroadcastAddress ();
+
+	m_SeqLock.WriteRelease ();
 }
 
 void CNetConfig::SetDefaultGateway (u32 nAddress)
 {
+	m_SeqLock.WriteAcquire ();
+
 	m_DefaultGateway.Set (nAddress);
+
+	m_SeqLock.WriteRelease ();
 }
 
 void CNetConfig::SetDNSServer (u32 nAddress)
 {
+	m_SeqLock.WriteAcquire ();
+
 	m_DNSServer.Set (nAddress);
+
+	m_SeqLock.WriteRelease ();
 }
 
 void CNetConfig::SetIPAddress (const u8 *pAddress)
 {
+	m_SeqLock.WriteAcquire ();
+
 	m_IPAddress.Set (pAddress);
 
 	UpdateBroadcastAddress ();
+
+	m_SeqLock.WriteRelease ();
 }
 
 void CNetConfig::SetNetMask (const u8 *pNetMask)
 {
+	m_SeqLock.WriteAcquire ();
+
 	m_NetMask.Set (pNetMask);
 
 	UpdateBroadcastAddress ();
+
+	m_SeqLock.WriteRelease ();
 }
 
 void CNetConfig::SetDefaultGateway (const u8 *pAddress)
 {
+	m_SeqLock.WriteAcquire ();
+
 	m_DefaultGateway.Set (pAddress);
+
+	m_SeqLock.WriteRelease ();
 }
 
 void CNetConfig::SetDNSServer (const u8 *pAddress)
 {
+	m_SeqLock.WriteAcquire ();
+
 	m_DNSServer.Set (pAddress);
+
+	m_SeqLock.WriteRelease ();
 }
 
 const CIPAddress *CNetConfig::GetIPAddress (void) const
@@ -124,6 +162,23 @@ const CIPAddress *CNetConfig::GetBroadcastAddress (void) const
 	return &m_BroadcastAddress;
 }
 
+void CNetConfig::GetAddresses (TNetConfigAddresses *pAddresses) const
+{
+	assert (pAddresses != 0);
+
+	unsigned nSequence;
+	do
+	{
+		nSequence = m_SeqLock.ReadBegin ();
+
+		pAddresses->IPAddress.Set (m_IPAddress);
+		pAddresses->NetMask.Set (m_NetMask);
+		pAddresses->DefaultGateway.Set (m_DefaultGateway);
+		pAddresses->BroadcastAddress.Set (m_BroadcastAddress);
+	}
+	while (m_SeqLock.ReadRetry (nSequence));
+}
+
 void CNetConfig::UpdateBroadcastAddress (void)
 {
 	u32 nIPAddress;
@@ -2,7 +2,7 @@
 // netconnection.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2015-2024  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -73,3 +73,14 @@ int CNetConnection::GetProtocol (void) const
 {
 	return m_nProtocol;
 }
+
+u16 CNetConnection::CalculateTxChecksum (const void *pPacket, unsigned nLength)
+{
+	assert (m_pNetworkLayer != 0);
+	if (m_pNetworkLayer->GetDeviceFeatures () & NET_DEVICE_FEATURE_TX_CHECKSUM)
+	{
+		return m_Checksum.CalculatePseudoHeader (nLength);
+	}
+
+	return m_Checksum.Calculate (pPacket, nLength);
+}
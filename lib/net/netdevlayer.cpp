@@ -23,6 +23,8 @@
 #include <circle/timer.h>
 #include <circle/synchronize.h>
 #include <circle/macros.h>
+#include <circle/util.h>
+#include <circle/sysconfig.h>
 #include <assert.h>
 
 const char FromNetDev[] = "netdev";
@@ -30,12 +32,26 @@ const char FromNetDev[] = "netdev";
 CNetDeviceLayer::CNetDeviceLayer (CNetConfig *pNetConfig, TNetDeviceType DeviceType)
 :	m_DeviceType (DeviceType),
 	m_pNetConfig (pNetConfig),
-	m_pDevice (0)
+	m_pDevice (0),
+	m_TxQueue (NET_QUEUE_DEPTH),
+	m_RxQueue (NET_QUEUE_DEPTH),
+	m_nTxBatchCount (0),
+	m_nRxBatchCount (0)
 {
 }
 
 CNetDeviceLayer::~CNetDeviceLayer (void)
 {
+	while (m_nTxBatchCount > 0)
+	{
+		m_pTxBatch[--m_nTxBatchCount]->Release ();
+	}
+
+	while (m_nRxBatchCount > 0)
+	{
+		m_pRxBatch[--m_nRxBatchCount]->Release ();
+	}
+
 	m_pDevice = 0;
 	m_pNetConfig = 0;
 }
@@ -101,23 +117,163 @@ void CNetDeviceLayer::Process (void)
 		new CPHYTask (m_pDevice);
 	}
 
-	DMA_BUFFER (u8, Buffer, FRAME_BUFFER_SIZE);
-	unsigned nLength;
-	while (   m_pDevice->IsSendFrameAdvisable ()
-	       && (nLength = m_TxQueue.Dequeue (Buffer)) > 0)
+	while (m_pDevice->IsSendFrameAdvisable ())
 	{
-		if (!m_pDevice->SendFrame (Buffer, nLength))
+		// frames, which could not be sent last time, are still at the start of the batch
+		m_nTxBatchCount += m_TxQueue.DequeueBuffers (m_pTxBatch + m_nTxBatchCount,
+							     NET_DEVICE_BATCH_SIZE - m_nTxBatchCount);
+		if (m_nTxBatchCount == 0)
+		{
+			break;
+		}
+
+		TNetTxFrame Frames[NET_DEVICE_BATCH_SIZE];
+		unsigned nFrames;
+		for (nFrames = 0; nFrames < m_nTxBatchCount; nFrames++)
+		{
+			CNetBuffer *pBuffer = m_pTxBatch[nFrames];
+			assert (pBuffer != 0);
+
+			// some net devices use DMA directly from the given buffer
+			if ((uintptr) pBuffer->GetData () & 3)
+			{
+				CNetBuffer *pAlignedBuffer =
+					CNetBuffer::Allocate (pBuffer->GetData (), pBuffer->GetLength (), 0);
+				if (pAlignedBuffer == 0)
+				{
+					// no buffer available, the frame is kept for the next time
+					break;
+				}
+
+				pBuffer->Release ();
+				m_pTxBatch[nFrames] = pBuffer = pAlignedBuffer;
+			}
+
+			Frames[nFrames].pBuffer = pBuffer->GetData ();
+			Frames[nFrames].nLength = pBuffer->GetLength ();
+		}
+
+		if (nFrames == 0)
+		{
+			break;
+		}
+
+		unsigned nSent = m_pDevice->SendFrames (Frames, nFrames);
+		assert (nSent <= nFrames);
+
+		// the remaining frames are kept, if the device is busy, otherwise the next one failed
+		unsigned nDone = nSent;
+		if (   nSent < nFrames
+		    && m_pDevice->IsSendFrameAdvisable ())
 		{
 			CLogger::Get ()->Write (FromNetDev, LogWarning, "Frame dropped");
 
+			nDone++;
+		}
+
+		for (unsigned i = 0; i < nDone; i++)
+		{
+			m_pTxBatch[i]->Release ();
+		}
+
+		unsigned nBatchCount = m_nTxBatchCount;
+		for (unsigned i = nDone; i < nBatchCount; i++)
+		{
+			m_pTxBatch[i - nDone] = m_pTxBatch[i];
+		}
+		m_nTxBatchCount = nBatchCount - nDone;
+
+		if (   nSent < nFrames
+		    || nFrames < nBatchCount)
+		{
 			break;
 		}
 	}
 
-	while (m_pDevice->ReceiveFrame (Buffer, &nLength))
+	while (1)
 	{
-		assert (nLength > 0);
-		m_RxQueue.Enqueue (Buffer, nLength);
+		// the frames are received into cache-aligned buffers, which are passed up the stack
+		while (m_nRxBatchCount < NET_DEVICE_BATCH_SIZE)
+		{
+			CNetBuffer *pBuffer = CNetBuffer::Allocate (0);
+			if (pBuffer == 0)
+			{
+				break;
+			}
+
+			m_pRxBatch[m_nRxBatchCount++] = pBuffer;
+		}
+
+		if (m_nRxBatchCount == 0)
+		{
+			break;
+		}
+
+		TNetRxFrame Frames[NET_DEVICE_BATCH_SIZE];
+		for (unsigned i = 0; i < m_nRxBatchCount; i++)
+		{
+			Frames[i].pBuffer = m_pRxBatch[i]->GetData ();
+			Frames[i].pParam = m_pRxBatch[i];
+		}
+
+		unsigned nFrames = m_pDevice->ReceiveFrames (Frames, m_nRxBatchCount);
+		if (nFrames == 0)
+		{
+			break;
+		}
+		assert (nFrames <= m_nRxBatchCount);
+
+		for (unsigned i = 0; i < nFrames; i++)
+		{
+			unsigned nOffset = Frames[i].nOffset;
+			unsigned nLength = Frames[i].nLength;
+			assert (nLength > 0);
+			assert (nOffset + nLength <= FRAME_BUFFER_SIZE);
+
+			// the device may have exchanged the buffer with one from its DMA ring
+			CNetBuffer *pBuffer = (CNetBuffer *) Frames[i].pParam;
+			if (pBuffer != 0)
+			{
+				assert (pBuffer->GetData () == Frames[i].pBuffer);
+				pBuffer->SetLength (nOffset + nLength);
+				pBuffer->RemoveHeader (nOffset);
+			}
+			else
+			{
+				// the frame is in a buffer of the device, our buffer has been taken
+				pBuffer = CNetBuffer::Allocate ((const u8 *) Frames[i].pBuffer + nOffset,
+								nLength, 0);
+				if (pBuffer == 0)
+				{
+					CLogger::Get ()->Write (FromNetDev, LogWarning, "Frame dropped");
+				}
+			}
+
+			if (pBuffer != 0)
+			{
+				pBuffer->SetChecksumVerified (Frames[i].bChecksumOK);
+			}
+
+			m_pRxBatch[i] = pBuffer;
+		}
+
+		// the buffers, which are on the DMA ring of the device now, are not ours any more
+		unsigned nEnqueue = 0;
+		for (unsigned i = 0; i < nFrames; i++)
+		{
+			if (m_pRxBatch[i] != 0)
+			{
+				m_pRxBatch[nEnqueue++] = m_pRxBatch[i];
+			}
+		}
+
+		m_RxQueue.EnqueueBuffers (m_pRxBatch, nEnqueue);
+
+		for (unsigned i = nFrames; i < m_nRxBatchCount; i++)
+		{
+			m_pRxBatch[i - nFrames] = m_pRxBatch[i];
+		}
+		m_nRxBatchCount -= nFrames;
 	}
 }
 
@@ -150,6 +306,48 @@ boolean CNetDeviceLayer::Receive (void *pBuffer, unsigned *pResultLength)
 	return TRUE;
 }
 
+void CNetDeviceLayer::Send (CNetBuffer *pBuffer)
+{
+	assert (pBuffer != 0);
+	m_TxQueue.EnqueueBuffer (pBuffer);
+}
+
+CNetBuffer *CNetDeviceLayer::Receive (void)
+{
+	return m_RxQueue.DequeueBuffer ();
+}
+
+unsigned CNetDeviceLayer::Receive (CNetBuffer **ppBuffers, unsigned nMaxBuffers)
+{
+	return m_RxQueue.DequeueBuffers (ppBuffers, nMaxBuffers);
+}
+
+unsigned CNetDeviceLayer::GetFeatures (void) const
+{
+	if (m_pDevice == 0)
+	{
+		return 0;
+	}
+
+	return m_pDevice->GetFeatures ();
+}
+
+unsigned CNetDeviceLayer::GetTxDropped (void) const
+{
+	return m_TxQueue.GetDropped ();
+}
+
+unsigned CNetDeviceLayer::GetRxDropped (void) const
+{
+	return m_RxQueue.GetDropped ();
+}
+
+void CNetDeviceLayer::SetRxHighWaterHandler (unsigned nHighWater,
+					     TNetQueueHighWaterHandler *pHandler, void *pParam)
+{
+	m_RxQueue.SetHighWaterHandler (nHighWater, pHandler, pParam);
+}
+
 boolean CNetDeviceLayer::IsRunning (void) const
 {
 	return m_pDevice != 0;
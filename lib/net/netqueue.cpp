@@ -18,22 +18,19 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/net/netqueue.h>
-#include <circle/netdevice.h>
 #include <circle/util.h>
 #include <assert.h>
 
-struct TNetQueueEntry
-{
-	volatile TNetQueueEntry *pPrev;
-	volatile TNetQueueEntry *pNext;
-	unsigned		 nLength;
-	unsigned char		 Buffer[FRAME_BUFFER_SIZE];
-	void			*pParam;
-};
-
-CNetQueue::CNetQueue (void)
+CNetQueue::CNetQueue (unsigned nMaxEntries)
 :	m_pFirst (0),
 	m_pLast (0),
+	m_nMaxEntries (nMaxEntries),
+	m_nCount (0),
+	m_nMaxCount (0),
+	m_nDropped (0),
+	m_nHighWater (0),
+	m_pHighWaterHandler (0),
+	m_pHighWaterParam (0),
 	m_SpinLock (TASK_LEVEL)
 {
 }
@@ -50,101 +47,278 @@ boolean CNetQueue::IsEmpty (void) const
 
 void CNetQueue::Flush (void)
 {
-	while (m_pFirst != 0)
+	CNetBuffer *pBuffer;
+	while ((pBuffer = DequeueBuffer ()) != 0)
+	{
+		pBuffer->Release ();
+	}
+}
+	
+boolean CNetQueue::Enqueue (const void *pBuffer, unsigned nLength, void *pParam)
+{
+	// drop early, before the frame is copied
+	if (   m_nMaxEntries != 0
+	    && m_nCount >= m_nMaxEntries)
 	{
 		m_SpinLock.Acquire ();
+		m_nDropped++;
+		m_SpinLock.Release ();
 
-		volatile TNetQueueEntry *pEntry = m_pFirst;
-		assert (pEntry != 0);
-
-		m_pFirst = pEntry->pNext;
-		if (m_pFirst != 0)
-		{
-			m_pFirst->pPrev = 0;
-		}
-		else
-		{
-			assert (m_pLast == pEntry);
-			m_pLast = 0;
-		}
+		return FALSE;
+	}
 
+	assert (nLength > 0);
+	assert (nLength <= FRAME_BUFFER_SIZE);
+	CNetBuffer *pNetBuffer = CNetBuffer::Allocate (pBuffer, nLength, 0);
+	if (pNetBuffer == 0)			// pool and heap are exhausted
+	{
+		m_SpinLock.Acquire ();
+		m_nDropped++;
 		m_SpinLock.Release ();
 
-		delete pEntry;
+		return FALSE;
 	}
+
+	return EnqueueBuffer (pNetBuffer, pParam);
 }
-	
-void CNetQueue::Enqueue (const void *pBuffer, unsigned nLength, void *pParam)
+
+unsigned CNetQueue::Dequeue (void *pBuffer, void **ppParam)
 {
-	TNetQueueEntry *pEntry = new TNetQueueEntry;
-	assert (pEntry != 0);
+	CNetBuffer *pNetBuffer = DequeueBuffer (ppParam);
+	if (pNetBuffer == 0)
+	{
+		return 0;
+	}
 
-	assert (nLength > 0);
-	assert (nLength <= FRAME_BUFFER_SIZE);
-	pEntry->nLength = nLength;
+	unsigned nResult = pNetBuffer->GetLength ();
+	assert (nResult > 0);
+	assert (nResult <= FRAME_BUFFER_SIZE);
 
 	assert (pBuffer != 0);
-	memcpy (pEntry->Buffer, pBuffer, nLength);
+	memcpy (pBuffer, pNetBuffer->GetData (), nResult);
+
+	pNetBuffer->Release ();
 
-	pEntry->pParam = pParam;
+	return nResult;
+}
+
+boolean CNetQueue::EnqueueBuffer (CNetBuffer *pBuffer, void *pParam)
+{
+	assert (pBuffer != 0);
+	assert (pBuffer->GetLength () > 0);
+	assert (pBuffer->m_pNext == 0);
+	pBuffer->m_pParam = pParam;
 
 	m_SpinLock.Acquire ();
 
-	pEntry->pPrev = m_pLast;
-	pEntry->pNext = 0;
+	if (   m_nMaxEntries != 0
+	    && m_nCount >= m_nMaxEntries)
+	{
+		m_nDropped++;
+
+		m_SpinLock.Release ();
+
+		pBuffer->Release ();
+
+		return FALSE;
+	}
 
 	if (m_pFirst == 0)
 	{
-		m_pFirst = pEntry;
+		m_pFirst = pBuffer;
 	}
 	else
 	{
 		assert (m_pLast != 0);
-		assert (m_pLast->pNext == 0);
-		m_pLast->pNext = pEntry;
+		assert (m_pLast->m_pNext == 0);
+		m_pLast->m_pNext = pBuffer;
+	}
+	m_pLast = pBuffer;
+
+	unsigned nCount = ++m_nCount;
+	if (nCount > m_nMaxCount)
+	{
+		m_nMaxCount = nCount;
 	}
-	m_pLast = pEntry;
+
+	TNetQueueHighWaterHandler *pHandler = m_pHighWaterHandler;
+	void *pHandlerParam = m_pHighWaterParam;
 
 	m_SpinLock.Release ();
+
+	// called without holding the spin lock, so that the handler can access the queue
+	if (   pHandler != 0
+	    && nCount == m_nHighWater)
+	{
+		(*pHandler) (this, pHandlerParam);
+	}
+
+	return TRUE;
 }
 
-unsigned CNetQueue::Dequeue (void *pBuffer, void **ppParam)
+CNetBuffer *CNetQueue::DequeueBuffer (void **ppParam)
 {
-	unsigned nResult = 0;
-	
-	if (m_pFirst != 0)
+	if (m_pFirst == 0)
 	{
-		m_SpinLock.Acquire ();
+		return 0;
+	}
 
-		volatile TNetQueueEntry *pEntry = m_pFirst;
-		assert (pEntry != 0);
+	m_SpinLock.Acquire ();
 
-		m_pFirst = pEntry->pNext;
-		if (m_pFirst != 0)
-		{
-			m_pFirst->pPrev = 0;
-		}
-		else
+	CNetBuffer *pBuffer = m_pFirst;
+	if (pBuffer != 0)
+	{
+		m_pFirst = pBuffer->m_pNext;
+		if (m_pFirst == 0)
 		{
-			assert (m_pLast == pEntry);
+			assert (m_pLast == pBuffer);
 			m_pLast = 0;
 		}
 
-		m_SpinLock.Release ();
+		pBuffer->m_pNext = 0;
+
+		assert (m_nCount > 0);
+		m_nCount--;
+	}
 
-		nResult = pEntry->nLength;
-		assert (nResult > 0);
-		assert (nResult <= FRAME_BUFFER_SIZE);
+	m_SpinLock.Release ();
 
-		memcpy (pBuffer, (const void *) pEntry->Buffer, nResult);
+	if (   pBuffer != 0
+	    && ppParam != 0)
+	{
+		*ppParam = pBuffer->m_pParam;
+	}
 
-		if (ppParam != 0)
+	return pBuffer;
+}
+
+unsigned CNetQueue::EnqueueBuffers (CNetBuffer **ppBuffers, unsigned nBuffers)
+{
+	assert (ppBuffers != 0);
+
+	m_SpinLock.Acquire ();
+
+	unsigned nOldCount = m_nCount;
+	unsigned nEnqueued = nBuffers;
+	if (   m_nMaxEntries != 0
+	    && nOldCount + nBuffers > m_nMaxEntries)
+	{
+		nEnqueued = nOldCount < m_nMaxEntries ? m_nMaxEntries - nOldCount : 0;
+		m_nDropped += nBuffers - nEnqueued;
+	}
+
+	for (unsigned i = 0; i < nEnqueued; i++)
+	{
+		CNetBuffer *pBuffer = ppBuffers[i];
+		assert (pBuffer != 0);
+		assert (pBuffer->GetLength () > 0);
+		assert (pBuffer->m_pNext == 0);
+		pBuffer->m_pParam = 0;
+
+		if (m_pFirst == 0)
+		{
+			m_pFirst = pBuffer;
+		}
+		else
 		{
-			*ppParam = pEntry->pParam;
+			assert (m_pLast != 0);
+			assert (m_pLast->m_pNext == 0);
+			m_pLast->m_pNext = pBuffer;
 		}
+		m_pLast = pBuffer;
+	}
 
-		delete pEntry;
+	unsigned nCount = nOldCount + nEnqueued;
+	m_nCount = nCount;
+	if (nCount > m_nMaxCount)
+	{
+		m_nMaxCount = nCount;
 	}
 
-	return nResult;
+	TNetQueueHighWaterHandler *pHandler = m_pHighWaterHandler;
+	void *pHandlerParam = m_pHighWaterParam;
+
+	m_SpinLock.Release ();
+
+	for (unsigned i = nEnqueued; i < nBuffers; i++)
+	{
+		assert (ppBuffers[i] != 0);
+		ppBuffers[i]->Release ();
+	}
+
+	// the high-water mark may have been crossed by more than one entry
+	if (   pHandler != 0
+	    && nOldCount < m_nHighWater
+	    && nCount >= m_nHighWater)
+	{
+		(*pHandler) (this, pHandlerParam);
+	}
+
+	return nEnqueued;
+}
+
+unsigned CNetQueue::DequeueBuffers (CNetBuffer **ppBuffers, unsigned nMaxBuffers)
+{
+	if (m_pFirst == 0)
+	{
+		return 0;
+	}
+
+	assert (ppBuffers != 0);
+
+	m_SpinLock.Acquire ();
+
+	unsigned nBuffers = 0;
+	while (   nBuffers < nMaxBuffers
+	       && m_pFirst != 0)
+	{
+		CNetBuffer *pBuffer = m_pFirst;
+		m_pFirst = pBuffer->m_pNext;
+		pBuffer->m_pNext = 0;
+
+		ppBuffers[nBuffers++] = pBuffer;
+	}
+
+	if (m_pFirst == 0)
+	{
+		m_pLast = 0;
+	}
+
+	assert (m_nCount >= nBuffers);
+	m_nCount -= nBuffers;
+
+	m_SpinLock.Release ();
+
+	return nBuffers;
+}
+
+unsigned CNetQueue::GetCount (void) const
+{
+	return m_nCount;
+}
+
+unsigned CNetQueue::GetMaxCount (void) const
+{
+	return m_nMaxCount;
+}
+
+unsigned CNetQueue::GetDropped (void) const
+{
+	return m_nDropped;
+}
+
+void CNetQueue::SetHighWaterHandler (unsigned nHighWater, TNetQueueHighWaterHandler *pHandler,
+				     void *pParam)
+{
+	assert (nHighWater > 0);
+	assert (   m_nMaxEntries == 0
+		|| nHighWater <= m_nMaxEntries);
+
+	m_SpinLock.Acquire ();
+
+	m_nHighWater = nHighWater;
+	m_pHighWaterHandler = pHandler;
+	m_pHighWaterParam = pParam;
+
+	m_SpinLock.Release ();
 }
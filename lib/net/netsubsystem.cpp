@@ -21,6 +21,7 @@
 #include <circle/net/nettask.h>
 #include <circle/net/dhcpclient.h>
 #include <circle/sched/scheduler.h>
+#include <circle/sysconfig.h>
 #include <assert.h>
 
 CNetSubSystem *CNetSubSystem::s_pThis = 0;
@@ -67,6 +68,11 @@ boolean CNetSubSystem::Initialize (boolean bWaitForActivate)
 	m_bUseDHCP = m_Config.GetIPAddress ()->IsNull ();
 	m_Config.SetDHCP (m_bUseDHCP);
 
+	if (!CNetBuffer::InitPool (NET_BUFFER_POOL_SIZE))
+	{
+		return FALSE;
+	}
+
 	if (!m_NetDevLayer.Initialize (bWaitForActivate))
 	{
 		return FALSE;
@@ -175,6 +181,18 @@ boolean CNetSubSystem::IsRunning (void) const
 	return m_pDHCPClient->IsBound ();
 }
 
+void CNetSubSystem::GetStatistics (TNetStatistics *pStatistics) const
+{
+	assert (pStatistics != 0);
+
+	CNetBuffer::GetStatistics (&pStatistics->BufferPool);
+
+	pStatistics->nTxDropped = m_NetDevLayer.GetTxDropped ();
+	pStatistics->nRxDropped = m_NetDevLayer.GetRxDropped ();
+	pStatistics->nLinkRxDropped = m_LinkLayer.GetRxDropped ();
+	pStatistics->nNetworkRxDropped = m_NetworkLayer.GetRxDropped ();
+}
+
 CNetSubSystem *CNetSubSystem::Get (void)
 {
 	assert (s_pThis != 0);
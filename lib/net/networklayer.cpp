@@ -21,12 +21,15 @@
 #include <circle/net/checksumcalculator.h>
 #include <circle/net/in.h>
 #include <circle/util.h>
+#include <circle/sysconfig.h>
 #include <assert.h>
 
 CNetworkLayer::CNetworkLayer (CNetConfig *pNetConfig, CLinkLayer *pLinkLayer)
 :	m_pNetConfig (pNetConfig),
 	m_pLinkLayer (pLinkLayer),
-	m_pICMPHandler (0)
+	m_pICMPHandler (0),
+	m_RxQueue (NET_QUEUE_DEPTH),
+	m_ICMPRxQueue (NET_QUEUE_DEPTH)
 {
 	assert (m_pNetConfig != 0);
 	assert (m_pLinkLayer != 0);
@@ -53,103 +56,152 @@ boolean CNetworkLayer::Initialize (void)
 void CNetworkLayer::Process (void)
 {
 	assert (m_pNetConfig != 0);
-	const CIPAddress *pOwnIPAddress = m_pNetConfig->GetIPAddress ();
-	assert (pOwnIPAddress != 0);
 
-	u8 Buffer[FRAME_BUFFER_SIZE];
-	unsigned nResultLength;
+	CNetBuffer *Buffers[NET_DEVICE_BATCH_SIZE];
+	unsigned nBuffers;
 	assert (m_pLinkLayer != 0);
-	while (m_pLinkLayer->Receive (Buffer, &nResultLength))
+	while ((nBuffers = m_pLinkLayer->Receive (Buffers, NET_DEVICE_BATCH_SIZE)) != 0)
 	{
-		if (nResultLength <= sizeof (TIPHeader))
+		for (unsigned i = 0; i < nBuffers; i++)
 		{
-			continue;
+			if (!PacketReceived (Buffers[i]))
+			{
+				Buffers[i]->Release ();
+			}
 		}
-		TIPHeader *pHeader = (TIPHeader *) Buffer;
+	}
 
-		unsigned nHeaderLength = pHeader->nVersionIHL & 0xF;
-		if (   nHeaderLength < IP_HEADER_LENGTH_DWORD_MIN
-		    || nHeaderLength > IP_HEADER_LENGTH_DWORD_MAX)
-		{
-			continue;
-		}
-		nHeaderLength *= 4;
-		if (nResultLength <= nHeaderLength)
-		{
-			continue;
-		}
+	assert (m_pICMPHandler != 0);
+	m_pICMPHandler->Process ();
+}
 
-		if (   CChecksumCalculator::SimpleCalculate (pHeader, nHeaderLength) != CHECKSUM_OK
-		    || (pHeader->nVersionIHL >> 4) != IP_VERSION)
-		{
-			continue;
-		}
+boolean CNetworkLayer::PacketReceived (CNetBuffer *pBuffer)
+{
+	assert (pBuffer != 0);
+	unsigned nLength = pBuffer->GetLength ();
 
-		CIPAddress IPAddressDestination (pHeader->DestinationAddress);
-		if (!pOwnIPAddress->IsNull ())
-		{
-			if (   *pOwnIPAddress != IPAddressDestination
-			    && !IPAddressDestination.IsBroadcast ()
-			    && *m_pNetConfig->GetBroadcastAddress () != IPAddressDestination)
-			{
-				continue;
-			}
-		}
-		else
-		{
-			if (!IPAddressDestination.IsBroadcast ())
-			{
-				continue;
-			}
-		}
+	if (nLength <= sizeof (TIPHeader))
+	{
+		return FALSE;
+	}
+	TIPHeader *pHeader = (TIPHeader *) pBuffer->GetData ();
 
-		if (   (pHeader->nFlagsFragmentOffset & IP_FLAGS_MF)
-		    ||    IP_FRAGMENT_OFFSET (le2be16 (pHeader->nFlagsFragmentOffset))
-		       != IP_FRAGMENT_OFFSET_FIRST)
-		{
-			continue;
-		}
-		
-		unsigned nTotalLength = le2be16 (pHeader->nTotalLength);
-		if (nResultLength < nTotalLength)
-		{
-			continue;
-		}
-		nResultLength = nTotalLength;		// ignore padding
+	unsigned nHeaderLength = pHeader->nVersionIHL & 0xF;
+	if (   nHeaderLength < IP_HEADER_LENGTH_DWORD_MIN
+	    || nHeaderLength > IP_HEADER_LENGTH_DWORD_MAX)
+	{
+		return FALSE;
+	}
+	nHeaderLength *= 4;
+	if (nLength <= nHeaderLength)
+	{
+		return FALSE;
+	}
 
-		TNetworkPrivateData *pParam = new TNetworkPrivateData;
-		assert (pParam != 0);
-		pParam->nProtocol = pHeader->nProtocol;
-		memcpy (pParam->SourceAddress, pHeader->SourceAddress, IP_ADDRESS_SIZE);
-		memcpy (pParam->DestinationAddress, pHeader->DestinationAddress, IP_ADDRESS_SIZE);
+	if ((pHeader->nVersionIHL >> 4) != IP_VERSION)
+	{
+		return FALSE;
+	}
 
-		nResultLength -= nHeaderLength;
+	// a net device with NET_DEVICE_FEATURE_RX_CHECKSUM may have verified it already
+	if (   !pBuffer->IsChecksumVerified ()
+	    && CChecksumCalculator::SimpleCalculate (pHeader, nHeaderLength) != CHECKSUM_OK)
+	{
+		return FALSE;
+	}
+
+	TNetConfigAddresses Config;
+	m_pNetConfig->GetAddresses (&Config);
 
-		if (pHeader->nProtocol == IPPROTO_ICMP)
+	CIPAddress IPAddressDestination (pHeader->DestinationAddress);
+	if (!Config.IPAddress.IsNull ())
+	{
+		if (   Config.IPAddress != IPAddressDestination
+		    && !IPAddressDestination.IsBroadcast ()
+		    && Config.BroadcastAddress != IPAddressDestination)
 		{
-			m_ICMPRxQueue.Enqueue (Buffer+nHeaderLength, nResultLength, pParam);
+			return FALSE;
 		}
-		else
+	}
+	else
+	{
+		if (!IPAddressDestination.IsBroadcast ())
 		{
-			m_RxQueue.Enqueue (Buffer+nHeaderLength, nResultLength, pParam);
+			return FALSE;
 		}
 	}
 
-	assert (m_pICMPHandler != 0);
-	m_pICMPHandler->Process ();
+	if (   (pHeader->nFlagsFragmentOffset & IP_FLAGS_MF)
+	    ||    IP_FRAGMENT_OFFSET (le2be16 (pHeader->nFlagsFragmentOffset))
+	       != IP_FRAGMENT_OFFSET_FIRST)
+	{
+		return FALSE;
+	}
+	
+	unsigned nTotalLength = le2be16 (pHeader->nTotalLength);
+	if (nLength < nTotalLength)
+	{
+		return FALSE;
+	}
+	pBuffer->SetLength (nTotalLength);		// ignore padding
+
+	if (!pBuffer->RemoveHeader (nHeaderLength))
+	{
+		return FALSE;
+	}
+
+	TNetworkPrivateData *pParam = new TNetworkPrivateData;
+	assert (pParam != 0);
+	pParam->nProtocol = pHeader->nProtocol;
+	memcpy (pParam->SourceAddress, pHeader->SourceAddress, IP_ADDRESS_SIZE);
+	memcpy (pParam->DestinationAddress, pHeader->DestinationAddress, IP_ADDRESS_SIZE);
+
+	CNetQueue *pQueue = pHeader->nProtocol == IPPROTO_ICMP ? &m_ICMPRxQueue : &m_RxQueue;
+	if (!pQueue->EnqueueBuffer (pBuffer, pParam))
+	{
+		delete pParam;		// the buffer has been released by the queue
+	}
+
+	return TRUE;
 }
 
 boolean CNetworkLayer::Send (const CIPAddress &rReceiver, const void *pPacket, unsigned nLength, int nProtocol)
 {
-	unsigned nPacketLength = sizeof (TIPHeader) + nLength;		// may wrap
+	if (   nLength == 0
+	    || nLength > FRAME_BUFFER_SIZE)
+	{
+		return FALSE;
+	}
+
+	assert (pPacket != 0);
+	CNetBuffer *pBuffer = CNetBuffer::Allocate (pPacket, nLength);
+	if (pBuffer == 0)
+	{
+		return FALSE;
+	}
+
+	return Send (rReceiver, pBuffer, nProtocol);
+}
+
+boolean CNetworkLayer::Send (const CIPAddress &rReceiver, CNetBuffer *pPacket, int nProtocol)
+{
+	assert (pPacket != 0);
+	unsigned nPacketLength = sizeof (TIPHeader) + pPacket->GetLength ();
 	if (   nPacketLength <= sizeof (TIPHeader)
 	    || nPacketLength > FRAME_BUFFER_SIZE)
 	{
+		pPacket->Release ();
+
 		return FALSE;
 	}
 
-	u8 PacketBuffer[nPacketLength];
-	TIPHeader *pHeader = (TIPHeader *) PacketBuffer;
+	TIPHeader *pHeader = (TIPHeader *) pPacket->AddHeader (sizeof (TIPHeader));
+	if (pHeader == 0)
+	{
+		pPacket->Release ();
+
+		return FALSE;
+	}
 
 	pHeader->nVersionIHL          = IP_VERSION << 4 | IP_HEADER_LENGTH_DWORD_MIN;
 	pHeader->nTypeOfService       = IP_TOS_ROUTINE;
@@ -160,45 +212,45 @@ boolean CNetworkLayer::Send (const CIPAddress &rReceiver, const void *pPacket, u
 	pHeader->nProtocol            = (u8) nProtocol;
 
 	assert (m_pNetConfig != 0);
-	const CIPAddress *pOwnIPAddress = m_pNetConfig->GetIPAddress ();
-	assert (pOwnIPAddress != 0);
+	TNetConfigAddresses Config;
+	m_pNetConfig->GetAddresses (&Config);
 
-	pOwnIPAddress->CopyTo (pHeader->SourceAddress);
+	Config.IPAddress.CopyTo (pHeader->SourceAddress);
 
 	rReceiver.CopyTo (pHeader->DestinationAddress);
 
 	pHeader->nHeaderChecksum = 0;
 	pHeader->nHeaderChecksum = CChecksumCalculator::SimpleCalculate (pHeader, sizeof (TIPHeader));
 
-	assert (pPacket != 0);
-	assert (nLength > 0);
-	memcpy (PacketBuffer+sizeof (TIPHeader), pPacket, nLength);
-
-	if (   pOwnIPAddress->IsNull ()
+	if (   Config.IPAddress.IsNull ()
 	    && !rReceiver.IsBroadcast ())
 	{
-		SendFailed (ICMP_CODE_DEST_NET_UNREACH, PacketBuffer, nPacketLength);
+		SendFailed (ICMP_CODE_DEST_NET_UNREACH, pHeader, nPacketLength);
+
+		pPacket->Release ();
 
 		return FALSE;
 	}
 
 	CIPAddress GatewayIP;
 	const CIPAddress *pNextHop = &rReceiver;
-	if (!pOwnIPAddress->OnSameNetwork (rReceiver, m_pNetConfig->GetNetMask ()))
+	if (!Config.IPAddress.OnSameNetwork (rReceiver, Config.NetMask.Get ()))
 	{
-		const u8 *pGateway = m_RouteCache.GetRoute (rReceiver.Get ());
-		if (pGateway != 0)
+		u8 Gateway[IP_ADDRESS_SIZE];
+		if (m_RouteCache.GetRoute (rReceiver.Get (), Gateway))
 		{
-			GatewayIP.Set (pGateway);
+			GatewayIP.Set (Gateway);
 
 			pNextHop = &GatewayIP;
 		}
 		else
 		{
-			pNextHop = m_pNetConfig->GetDefaultGateway ();
+			pNextHop = &Config.DefaultGateway;
 			if (pNextHop->IsNull ())
 			{
-				SendFailed (ICMP_CODE_DEST_NET_UNREACH, PacketBuffer, nPacketLength);
+				SendFailed (ICMP_CODE_DEST_NET_UNREACH, pHeader, nPacketLength);
+
+				pPacket->Release ();
 
 				return FALSE;
 			}
@@ -207,7 +259,7 @@ boolean CNetworkLayer::Send (const CIPAddress &rReceiver, const void *pPacket, u
 	
 	assert (m_pLinkLayer != 0);
 	assert (pNextHop != 0);
-	return m_pLinkLayer->Send (*pNextHop, PacketBuffer, nPacketLength);
+	return m_pLinkLayer->Send (*pNextHop, pPacket);
 }
 
 boolean CNetworkLayer::Receive (void *pBuffer, unsigned *pResultLength,
@@ -240,6 +292,43 @@ boolean CNetworkLayer::Receive (void *pBuffer, unsigned *pResultLength,
 	return TRUE;
 }
 
+CNetBuffer *CNetworkLayer::Receive (CIPAddress *pSender, CIPAddress *pReceiver, int *pProtocol)
+{
+	void *pParam;
+	CNetBuffer *pBuffer = m_RxQueue.DequeueBuffer (&pParam);
+	if (pBuffer == 0)
+	{
+		return 0;
+	}
+
+	TNetworkPrivateData *pData = (TNetworkPrivateData *) pParam;
+	assert (pData != 0);
+
+	assert (pProtocol != 0);
+	*pProtocol = pData->nProtocol;
+
+	assert (pSender != 0);
+	pSender->Set (pData->SourceAddress);
+
+	assert (pReceiver != 0);
+	pReceiver->Set (pData->DestinationAddress);
+
+	delete pData;
+
+	return pBuffer;
+}
+
+unsigned CNetworkLayer::GetRxDropped (void) const
+{
+	return m_RxQueue.GetDropped () + m_ICMPRxQueue.GetDropped ();
+}
+
+unsigned CNetworkLayer::GetDeviceFeatures (void) const
+{
+	assert (m_pLinkLayer != 0);
+	return m_pLinkLayer->GetDeviceFeatures ();
+}
+
 boolean CNetworkLayer::ReceiveNotification (TICMPNotificationType *pType,
 					    CIPAddress *pSender, CIPAddress *pReceiver,
 					    u16 *pSendPort, u16 *pReceivePort,
@@ -279,19 +368,19 @@ void CNetworkLayer::AddRoute (const u8 *pDestIP, const u8 *pGatewayIP)
 	m_RouteCache.AddRoute (pDestIP, pGatewayIP);
 }
 
-const u8 *CNetworkLayer::GetGateway (const u8 *pDestIP) const
+CIPAddress CNetworkLayer::GetGateway (const u8 *pDestIP) const
 {
-	const u8 *pGateway = m_RouteCache.GetRoute (pDestIP);
-	if (pGateway != 0)
+	u8 Gateway[IP_ADDRESS_SIZE];
+	if (m_RouteCache.GetRoute (pDestIP, Gateway))
 	{
-		return pGateway;
+		return CIPAddress (Gateway);
 	}
 
 	assert (m_pNetConfig != 0);
-	const CIPAddress *pDefaultGateway = m_pNetConfig->GetDefaultGateway ();
-	assert (pDefaultGateway != 0);
+	TNetConfigAddresses Config;
+	m_pNetConfig->GetAddresses (&Config);
 
-	return pDefaultGateway->Get ();
+	return Config.DefaultGateway;
 }
 
 void CNetworkLayer::SendFailed (unsigned nICMPCode, const void *pReturnedPacket, unsigned nLength)
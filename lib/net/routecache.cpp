@@ -29,6 +29,7 @@ struct TRouteCacheEntry
 };
 
 CRouteCache::CRouteCache (void)
+:	m_Lock (TASK_LEVEL)
 {
 }
 
@@ -39,6 +40,8 @@ CRouteCache::~CRouteCache (void)
 
 void CRouteCache::Flush (void)
 {
+	m_Lock.WriteAcquire ();
+
 	unsigned nCount = m_Cache.GetCount ();
 	while (nCount-- > 0)
 	{
@@ -46,6 +49,8 @@ void CRouteCache::Flush (void)
 
 		m_Cache.RemoveLast ();
 	}
+
+	m_Lock.WriteRelease ();
 }
 
 void CRouteCache::AddRoute (const u8 *pDestIP, const u8 *pGatewayIP)
@@ -55,6 +60,8 @@ void CRouteCache::AddRoute (const u8 *pDestIP, const u8 *pGatewayIP)
 
 	TRouteCacheEntry *pDestEntry = 0;
 
+	m_Lock.WriteAcquire ();
+
 	unsigned nCount = m_Cache.GetCount ();
 	for (unsigned i = 0; i < nCount; i++)
 	{
@@ -80,11 +87,16 @@ void CRouteCache::AddRoute (const u8 *pDestIP, const u8 *pGatewayIP)
 	}
 
 	memcpy (pDestEntry->GatewayIP, pGatewayIP, IP_ADDRESS_SIZE);
+
+	m_Lock.WriteRelease ();
 }
 
-const u8 *CRouteCache::GetRoute (const u8 *pDestIP) const
+boolean CRouteCache::GetRoute (const u8 *pDestIP, u8 *pGatewayIP) const
 {
 	assert (pDestIP != 0);
+	assert (pGatewayIP != 0);
+
+	m_Lock.ReadAcquire ();
 
 	unsigned nCount = m_Cache.GetCount ();
 	for (unsigned i = 0; i < nCount; i++)
@@ -94,9 +106,15 @@ const u8 *CRouteCache::GetRoute (const u8 *pDestIP) const
 
 		if (memcmp (pEntry->DestIP, pDestIP, IP_ADDRESS_SIZE) == 0)
 		{
-			return pEntry->GatewayIP;
+			memcpy (pGatewayIP, pEntry->GatewayIP, IP_ADDRESS_SIZE);
+
+			m_Lock.ReadRelease ();
+
+			return TRUE;
 		}
 	}
 
-	return 0;
+	m_Lock.ReadRelease ();
+
+	return FALSE;
 }
@@ -616,12 +616,15 @@ void CTCPConnection::Process (void)
 	}
 }
 
-int CTCPConnection::PacketReceived (const void	*pPacket,
-				    unsigned	 nLength,
+int CTCPConnection::PacketReceived (CNetBuffer	*pBuffer,
 				    CIPAddress	&rSenderIP,
 				    CIPAddress	&rReceiverIP,
 				    int		 nProtocol)
 {
+	assert (pBuffer != 0);
+	const void *pPacket = pBuffer->GetData ();
+	unsigned nLength = pBuffer->GetLength ();
+
 	if (nProtocol != IPPROTO_TCP)
 	{
 		return 0;
@@ -658,7 +661,8 @@ int CTCPConnection::PacketReceived (const void	*pPacket,
 		m_Checksum.SetDestinationAddress (rSenderIP);
 	}
 
-	if (m_Checksum.Calculate (pPacket, nLength) != CHECKSUM_OK)
+	if (   !pBuffer->IsChecksumVerified ()
+	    && m_Checksum.Calculate (pPacket, nLength) != CHECKSUM_OK)
 	{
 		return 0;
 	}
@@ -769,7 +773,7 @@ int CTCPConnection::PacketReceived (const void	*pPacket,
 
 			if (nDataLength > 0)
 			{
-				m_RxQueue.Enqueue ((u8 *) pPacket+nDataOffset, nDataLength);
+				QueueData (pBuffer, nDataOffset);
 			}
 
 			m_nISS = CalculateISN ();
@@ -895,7 +899,7 @@ int CTCPConnection::PacketReceived (const void	*pPacket,
 
 					if (nDataLength > 0)
 					{
-						m_RxQueue.Enqueue ((u8 *) pPacket+nDataOffset, nDataLength);
+						QueueData (pBuffer, nDataOffset);
 					}
 
 					break;
@@ -1211,7 +1215,7 @@ int CTCPConnection::PacketReceived (const void	*pPacket,
 			{
 				if (nDataLength > 0)
 				{
-					m_RxQueue.Enqueue ((u8 *) pPacket+nDataOffset, nDataLength);
+					QueueData (pBuffer, nDataOffset);
 
 					m_nRCV_NXT += nDataLength;
 
@@ -1365,9 +1369,17 @@ boolean CTCPConnection::SendSegment (unsigned nFlags, u32 nSequenceNumber, u32 n
 	
 	unsigned nPacketLength = nHeaderLength + nDataLength;		// may wrap
 	assert (nPacketLength >= nHeaderLength);
-	assert (nHeaderLength <= FRAME_BUFFER_SIZE);
+	assert (nPacketLength <= FRAME_BUFFER_SIZE);
 
-	u8 TxBuffer[FRAME_BUFFER_SIZE];
+	// the IP and Ethernet headers are added in front of the segment later
+	CNetBuffer *pBuffer = CNetBuffer::Allocate ();
+	if (pBuffer == 0)
+	{
+		return FALSE;
+	}
+	pBuffer->SetLength (nPacketLength);
+
+	u8 *TxBuffer = pBuffer->GetData ();
 	TTCPHeader *pHeader = (TTCPHeader *) TxBuffer;
 
 	pHeader->nSourcePort	 	= le2be16 (m_nOwnPort);
@@ -1395,7 +1407,7 @@ boolean CTCPConnection::SendSegment (unsigned nFlags, u32 nSequenceNumber, u32 n
 	}
 
 	pHeader->nChecksum = 0;		// must be 0 for calculation
-	pHeader->nChecksum = m_Checksum.Calculate (TxBuffer, nPacketLength);
+	pHeader->nChecksum = CalculateTxChecksum (TxBuffer, nPacketLength);
 
 #ifdef TCP_DEBUG
 	CLogger::Get ()->Write (FromTCP, LogDebug,
@@ -1413,7 +1425,18 @@ boolean CTCPConnection::SendSegment (unsigned nFlags, u32 nSequenceNumber, u32 n
 #endif
 
 	assert (m_pNetworkLayer != 0);
-	return m_pNetworkLayer->Send (m_ForeignIP, TxBuffer, nPacketLength, IPPROTO_TCP);
+	return m_pNetworkLayer->Send (m_ForeignIP, pBuffer, IPPROTO_TCP);
+}
+
+void CTCPConnection::QueueData (CNetBuffer *pSegment, unsigned nDataOffset)
+{
+	// the segment is passed to the user without copying, its header is not needed any more
+	assert (pSegment != 0);
+	if (pSegment->RemoveHeader (nDataOffset))
+	{
+		pSegment->AddRef ();
+		m_RxQueue.EnqueueBuffer (pSegment);
+	}
 }
 
 void CTCPConnection::ScanOptions (TTCPHeader *pHeader)
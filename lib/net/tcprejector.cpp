@@ -66,9 +66,13 @@ CTCPRejector::~CTCPRejector (void)
 {
 }
 
-int CTCPRejector::PacketReceived (const void *pPacket, unsigned nLength,
+int CTCPRejector::PacketReceived (CNetBuffer *pBuffer,
 				  CIPAddress &rSenderIP, CIPAddress &rReceiverIP, int nProtocol)
 {
+	assert (pBuffer != 0);
+	const void *pPacket = pBuffer->GetData ();
+	unsigned nLength = pBuffer->GetLength ();
+
 	if (nProtocol != IPPROTO_TCP)
 	{
 		return 0;
@@ -97,7 +101,8 @@ int CTCPRejector::PacketReceived (const void *pPacket, unsigned nLength,
 	m_Checksum.SetSourceAddress (*m_pNetConfig->GetIPAddress ());
 	m_Checksum.SetDestinationAddress (rSenderIP);
 
-	if (m_Checksum.Calculate (pPacket, nLength) != CHECKSUM_OK)
+	if (   !pBuffer->IsChecksumVerified ()
+	    && m_Checksum.Calculate (pPacket, nLength) != CHECKSUM_OK)
 	{
 		return 0;
 	}
@@ -179,7 +184,7 @@ boolean CTCPRejector::SendSegment (unsigned nFlags, u32 nSequenceNumber, u32 nAc
 	pHeader->nUrgentPointer		= 0;
 
 	pHeader->nChecksum = 0;		// must be 0 for calculation
-	pHeader->nChecksum = m_Checksum.Calculate (TxBuffer, nPacketLength);
+	pHeader->nChecksum = CalculateTxChecksum (TxBuffer, nPacketLength);
 
 #ifdef TCP_DEBUG
 	CLogger::Get ()->Write (FromTCP, LogDebug,
@@ -51,13 +51,12 @@ boolean CTransportLayer::Initialize (void)
 
 void CTransportLayer::Process (void)
 {
-	unsigned nResultLength;
 	CIPAddress Sender;
 	CIPAddress Receiver;
 	int nProtocol;
 	assert (m_pNetworkLayer != 0);
-	u8 Buffer[FRAME_BUFFER_SIZE];
-	while (m_pNetworkLayer->Receive (Buffer, &nResultLength, &Sender, &Receiver, &nProtocol))
+	CNetBuffer *pBuffer;
+	while ((pBuffer = m_pNetworkLayer->Receive (&Sender, &Receiver, &nProtocol)) != 0)
 	{
 		unsigned i;
 		for (i = 0; i < m_pConnection.GetCount (); i++)
@@ -68,7 +67,7 @@ void CTransportLayer::Process (void)
 			}
 
 			if (((CNetConnection *) m_pConnection[i])->PacketReceived (
-				Buffer, nResultLength, Sender, Receiver, nProtocol) != 0)
+				pBuffer, Sender, Receiver, nProtocol) != 0)
 			{
 				break;
 			}
@@ -77,9 +76,10 @@ void CTransportLayer::Process (void)
 		if (i >= m_pConnection.GetCount ())
 		{
 			// send RESET on not consumed TCP segment
-			m_TCPRejector.PacketReceived (Buffer, nResultLength,
-						      Sender, Receiver, nProtocol);
+			m_TCPRejector.PacketReceived (pBuffer, Sender, Receiver, nProtocol);
 		}
+
+		pBuffer->Release ();
 	}
 
 	TICMPNotificationType Type;
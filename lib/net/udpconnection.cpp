@@ -21,6 +21,7 @@
 #include <circle/net/in.h>
 #include <circle/macros.h>
 #include <circle/util.h>
+#include <circle/sysconfig.h>
 #include <assert.h>
 
 struct TUDPHeader
@@ -47,6 +48,7 @@ CUDPConnection::CUDPConnection (CNetConfig	*pNetConfig,
 :	CNetConnection (pNetConfig, pNetworkLayer, rForeignIP, nForeignPort, nOwnPort, IPPROTO_UDP),
 	m_bOpen (TRUE),
 	m_bActiveOpen (TRUE),
+	m_RxQueue (NET_QUEUE_DEPTH),
 	m_bBroadcastsAllowed (FALSE),
 	m_nErrno (0)
 {
@@ -58,6 +60,7 @@ CUDPConnection::CUDPConnection (CNetConfig	*pNetConfig,
 :	CNetConnection (pNetConfig, pNetworkLayer, nOwnPort, IPPROTO_UDP),
 	m_bOpen (TRUE),
 	m_bActiveOpen (FALSE),
+	m_RxQueue (NET_QUEUE_DEPTH),
 	m_bBroadcastsAllowed (FALSE),
 	m_nErrno (0)
 {
@@ -142,7 +145,7 @@ int CUDPConnection::Send (const void *pData, unsigned nLength, int nFlags)
 
 	m_Checksum.SetSourceAddress (*m_pNetConfig->GetIPAddress ());
 	m_Checksum.SetDestinationAddress (m_ForeignIP);
-	pHeader->nChecksum = m_Checksum.Calculate (PacketBuffer, nPacketLength);
+	pHeader->nChecksum = CalculateTxChecksum (PacketBuffer, nPacketLength);
 
 	assert (m_pNetworkLayer != 0);
 	boolean bOK = m_pNetworkLayer->Send (m_ForeignIP, PacketBuffer, nPacketLength, IPPROTO_UDP);
@@ -247,7 +250,7 @@ int CUDPConnection::SendTo (const void *pData, unsigned nLength, int nFlags,
 
 	m_Checksum.SetSourceAddress (*m_pNetConfig->GetIPAddress ());
 	m_Checksum.SetDestinationAddress (rForeignIP);
-	pHeader->nChecksum = m_Checksum.Calculate (PacketBuffer, nPacketLength);
+	pHeader->nChecksum = CalculateTxChecksum (PacketBuffer, nPacketLength);
 
 	assert (m_pNetworkLayer != 0);
 	boolean bOK = m_pNetworkLayer->Send (rForeignIP, PacketBuffer, nPacketLength, IPPROTO_UDP);
@@ -328,9 +331,13 @@ void CUDPConnection::Process (void)
 {
 }
 
-int CUDPConnection::PacketReceived (const void *pPacket, unsigned nLength,
+int CUDPConnection::PacketReceived (CNetBuffer *pBuffer,
 				    CIPAddress &rSenderIP, CIPAddress &rReceiverIP, int nProtocol)
 {
+	assert (pBuffer != 0);
+	const void *pPacket = pBuffer->GetData ();
+	unsigned nLength = pBuffer->GetLength ();
+
 	if (nProtocol != IPPROTO_UDP)
 	{
 		return 0;
@@ -370,7 +377,8 @@ int CUDPConnection::PacketReceived (const void *pPacket, unsigned nLength,
 		return -1;
 	}
 	
-	if (pHeader->nChecksum != UDP_CHECKSUM_NONE)
+	if (   pHeader->nChecksum != UDP_CHECKSUM_NONE
+	    && !pBuffer->IsChecksumVerified ())
 	{
 		m_Checksum.SetSourceAddress (rSenderIP);
 		m_Checksum.SetDestinationAddress (rReceiverIP);
@@ -388,15 +396,24 @@ int CUDPConnection::PacketReceived (const void *pPacket, unsigned nLength,
 		return 1;
 	}
 
-	nLength -= sizeof (TUDPHeader);
-	assert (nLength > 0);
+	// the datagram is passed to the user without copying
+	if (!pBuffer->RemoveHeader (sizeof (TUDPHeader)))
+	{
+		return -1;
+	}
 
 	TUDPPrivateData *pData = new TUDPPrivateData;
 	assert (pData != 0);
 	rSenderIP.CopyTo (pData->SourceAddress);
 	pData->nSourcePort = nSourcePort;
 
-	m_RxQueue.Enqueue ((u8 *) pPacket + sizeof (TUDPHeader), nLength, pData);
+	pBuffer->AddRef ();
+	if (!m_RxQueue.EnqueueBuffer (pBuffer, pData))
+	{
+		delete pData;		// socket receive queue is full, datagram dropped
+
+		return 1;
+	}
 
 	m_Event.Set ();
 
@@ -2,7 +2,7 @@
 // netdevice.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2020  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2014-2024  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -18,6 +18,9 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/netdevice.h>
+#include <circle/synchronize.h>
+#include <circle/util.h>
+#include <assert.h>
 
 const char *CNetDevice::s_SpeedString[NetDeviceSpeedUnknown] =
 {
@@ -33,6 +36,73 @@ unsigned CNetDevice::s_nDeviceNumber = 0;
 
 CNetDevice *CNetDevice::s_pDevice[MAX_NET_DEVICES];
 
+boolean CNetDevice::SendFrameParts (const TNetFramePart *pParts, unsigned nParts)
+{
+	DMA_BUFFER (u8, Buffer, FRAME_BUFFER_SIZE);
+	unsigned nLength = 0;
+
+	assert (pParts != 0);
+	for (unsigned i = 0; i < nParts; i++)
+	{
+		if (nLength + pParts[i].nLength > FRAME_BUFFER_SIZE)
+		{
+			return FALSE;
+		}
+
+		assert (pParts[i].pData != 0);
+		memcpy (Buffer + nLength, pParts[i].pData, pParts[i].nLength);
+		nLength += pParts[i].nLength;
+	}
+
+	return SendFrame (Buffer, nLength);
+}
+
+unsigned CNetDevice::SendFrames (const TNetTxFrame *pFrames, unsigned nFrames)
+{
+	assert (pFrames != 0);
+
+	unsigned i;
+	for (i = 0; i < nFrames; i++)
+	{
+		if (   (   i > 0
+			&& !IsSendFrameAdvisable ())
+		    || !SendFrame (pFrames[i].pBuffer, pFrames[i].nLength))
+		{
+			break;
+		}
+	}
+
+	return i;
+}
+
+unsigned CNetDevice::ReceiveFrames (TNetRxFrame *pFrames, unsigned nMaxFrames)
+{
+	assert (pFrames != 0);
+
+	unsigned i;
+	for (i = 0; i < nMaxFrames; i++)
+	{
+		if (!ReceiveFrameChecked (pFrames[i].pBuffer, &pFrames[i].nLength,
+					  &pFrames[i].bChecksumOK))
+		{
+			break;
+		}
+
+		pFrames[i].nOffset = 0;
+	}
+
+	return i;
+}
+
+boolean CNetDevice::ReceiveFrameChecked (void *pBuffer, unsigned *pResultLength,
+					 boolean *pChecksumOK)
+{
+	assert (pChecksumOK != 0);
+	*pChecksumOK = FALSE;
+
+	return ReceiveFrame (pBuffer, pResultLength);
+}
+
 void CNetDevice::AddNetDevice (void)
 {
 	if (s_nDeviceNumber < MAX_NET_DEVICES)
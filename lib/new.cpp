@@ -22,12 +22,12 @@
 
 void *operator new (size_t nSize, int nType)
 {
-	return CMemorySystem::HeapAllocate (nSize, nType);
+	return CMemorySystem::HeapAllocate (nSize, nType, HEAP_CALLER);
 }
 
 void *operator new[] (size_t nSize, int nType)
 {
-	return CMemorySystem::HeapAllocate (nSize, nType);
+	return CMemorySystem::HeapAllocate (nSize, nType, HEAP_CALLER);
 }
 
 #if STDLIB_SUPPORT != 3
@@ -44,12 +44,12 @@ void *operator new[] (size_t nSize, void *pMem)
 
 void *operator new (size_t nSize)
 {
-	return CMemorySystem::HeapAllocate (nSize, HEAP_DEFAULT_NEW);
+	return CMemorySystem::HeapAllocate (nSize, HEAP_DEFAULT_NEW, HEAP_CALLER);
 }
 
 void *operator new[] (size_t nSize)
 {
-	return CMemorySystem::HeapAllocate (nSize, HEAP_DEFAULT_NEW);
+	return CMemorySystem::HeapAllocate (nSize, HEAP_DEFAULT_NEW, HEAP_CALLER);
 }
 
 void operator delete (void *pBlock) noexcept
@@ -79,13 +79,13 @@ void operator delete[] (void *pBlock, size_t nSize) noexcept
 void *operator new (size_t nSize, std::align_val_t Align)
 {
 	assert ((size_t) Align <= HEAP_BLOCK_ALIGN);
-	return CMemorySystem::HeapAllocate (nSize, HEAP_DEFAULT_NEW);
+	return CMemorySystem::HeapAllocate (nSize, HEAP_DEFAULT_NEW, HEAP_CALLER);
 }
 
 void *operator new[] (size_t nSize, std::align_val_t Align)
 {
 	assert ((size_t) Align <= HEAP_BLOCK_ALIGN);
-	return CMemorySystem::HeapAllocate (nSize, HEAP_DEFAULT_NEW);
+	return CMemorySystem::HeapAllocate (nSize, HEAP_DEFAULT_NEW, HEAP_CALLER);
 }
 
 void operator delete (void *pBlock, std::align_val_t Align) noexcept
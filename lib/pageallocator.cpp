@@ -2,7 +2,7 @@
 // pageallocator.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2020  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2014-2024  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -24,14 +24,19 @@
 #define PAGE_MASK	(PAGE_SIZE-1)
 
 CPageAllocator::CPageAllocator (void)
-:	m_pNext (0),
-	m_pLimit (0),
-#ifdef PAGE_DEBUG
+:	m_pBase (0),
+	m_nPages (0),
+	m_nFreePages (0),
 	m_nCount (0),
 	m_nMaxCount (0),
-#endif
-	m_pFreeList (0)
+	m_nAllocations (0),
+	m_nFailedAllocations (0)
 {
+	for (unsigned i = 0; i <= PAGE_MAX_ORDER; i++)
+	{
+		m_pFreeList[i] = 0;
+		m_nFreeBlocks[i] = 0;
+	}
 }
 
 CPageAllocator::~CPageAllocator (void)
@@ -40,51 +45,105 @@ CPageAllocator::~CPageAllocator (void)
 
 void CPageAllocator::Setup (uintptr nBase, size_t nSize)
 {
-	m_pNext = (u8 *) ((nBase + PAGE_SIZE-1) & ~PAGE_MASK);
-	m_pLimit = (u8 *) ((nBase + nSize) & ~PAGE_MASK);
+	m_pBase = (u8 *) ((nBase + PAGE_SIZE-1) & ~PAGE_MASK);
+	uintptr nLimit = (nBase + nSize) & ~PAGE_MASK;
+
+	m_nPages = (nLimit - (uintptr) m_pBase) / PAGE_SIZE;
+	if (m_nPages > PAGE_MAX_PAGES)
+	{
+		m_nPages = PAGE_MAX_PAGES;
+	}
+
+	for (unsigned i = 0; i < m_nPages; i++)
+	{
+		m_uchPageState[i] = PAGE_STATE_NONE;
+	}
+
+	// split the region into the largest possible blocks
+	unsigned nPage = 0;
+	while (nPage < m_nPages)
+	{
+		unsigned nOrder = PAGE_MAX_ORDER;
+		while (   nOrder > 0
+		       && (   (nPage & ((1 << nOrder)-1)) != 0
+			   || nPage + (1 << nOrder) > m_nPages))
+		{
+			nOrder--;
+		}
+
+		InsertFree (nPage, nOrder);
+
+		nPage += 1 << nOrder;
+	}
 }
 
 size_t CPageAllocator::GetFreeSpace (void) const
 {
-	return m_pLimit - m_pNext;
+	return (size_t) m_nFreePages * PAGE_SIZE;
 }
 
 void *CPageAllocator::Allocate (void)
 {
-	assert (m_pNext != 0);
+	return AllocateBlock (0);
+}
+
+void *CPageAllocator::AllocateBlock (unsigned nOrder)
+{
+	assert (m_pBase != 0);
+
+	if (nOrder > PAGE_MAX_ORDER)
+	{
+		return 0;
+	}
 
 	m_SpinLock.Acquire ();
 
-#ifdef PAGE_DEBUG
-	if (++m_nCount > m_nMaxCount)
+	unsigned nFreeOrder;
+	for (nFreeOrder = nOrder; nFreeOrder <= PAGE_MAX_ORDER; nFreeOrder++)
 	{
-		m_nMaxCount = m_nCount;
+		if (m_pFreeList[nFreeOrder] != 0)
+		{
+			break;
+		}
 	}
-#endif
 
-	TFreePage *pFreePage;
-	if ((pFreePage = m_pFreeList) != 0)
+	if (nFreeOrder > PAGE_MAX_ORDER)
 	{
-		assert (pFreePage->nMagic == FREEPAGE_MAGIC);
-		m_pFreeList = pFreePage->pNext;
-		pFreePage->nMagic = 0;
+		m_nFailedAllocations++;
+
+		m_SpinLock.Release ();
+
+		return 0;		// TODO: system should panic here
 	}
-	else
+
+	TFreePage *pFreePage = m_pFreeList[nFreeOrder];
+	assert (pFreePage->nMagic == FREEPAGE_MAGIC);
+	unsigned nPage = ((u8 *) pFreePage - m_pBase) / PAGE_SIZE;
+
+	RemoveFree (nPage, nFreeOrder);
+
+	// split the block and return the upper halves to the free lists
+	while (nFreeOrder > nOrder)
 	{
-		pFreePage = (TFreePage *) m_pNext;
+		nFreeOrder--;
 
-		m_pNext += PAGE_SIZE;
+		InsertFree (nPage + (1 << nFreeOrder), nFreeOrder);
+	}
 
-		if (m_pNext > m_pLimit)
-		{
-			m_SpinLock.Release ();
+	m_uchPageState[nPage] = PAGE_STATE_USED | nOrder;
 
-			return 0;		// TODO: system should panic here
-		}
+	m_nCount += 1 << nOrder;
+	if (m_nCount > m_nMaxCount)
+	{
+		m_nMaxCount = m_nCount;
 	}
 
+	m_nAllocations++;
+
 	m_SpinLock.Release ();
 
+	pFreePage->nMagic = 0;
+
 	return pFreePage;
 }
 
@@ -95,27 +154,128 @@ void CPageAllocator::Free (void *pPage)
 		return;
 	}
 
-	TFreePage *pFreePage = (TFreePage *) pPage;
+	assert (((uintptr) pPage & PAGE_MASK) == 0);
+	assert ((u8 *) pPage >= m_pBase);
+	unsigned nPage = ((u8 *) pPage - m_pBase) / PAGE_SIZE;
+	assert (nPage < m_nPages);
 
 	m_SpinLock.Acquire ();
 
-	pFreePage->nMagic = FREEPAGE_MAGIC;
+	assert (m_uchPageState[nPage] & PAGE_STATE_USED);
+	unsigned nOrder = m_uchPageState[nPage] & PAGE_STATE_ORDER_MASK;
+	m_uchPageState[nPage] = PAGE_STATE_NONE;
 
-	pFreePage->pNext = m_pFreeList;
-	m_pFreeList = pFreePage;
+	assert (m_nCount >= 1U << nOrder);
+	m_nCount -= 1 << nOrder;
 
-#ifdef PAGE_DEBUG
-	m_nCount--;
-#endif
+	// merge with free buddies
+	while (nOrder < PAGE_MAX_ORDER)
+	{
+		unsigned nBuddy = nPage ^ (1 << nOrder);
+		if (   nBuddy >= m_nPages
+		    || m_uchPageState[nBuddy] != (PAGE_STATE_FREE | nOrder))
+		{
+			break;
+		}
+
+		RemoveFree (nBuddy, nOrder);
+
+		if (nBuddy < nPage)
+		{
+			nPage = nBuddy;
+		}
+
+		nOrder++;
+	}
+
+	InsertFree (nPage, nOrder);
 
 	m_SpinLock.Release ();
 }
 
+void CPageAllocator::GetStatistics (TPageStatistics *pStatistics)
+{
+	assert (pStatistics != 0);
+
+	m_SpinLock.Acquire ();
+
+	pStatistics->nRegionSize = (size_t) m_nPages * PAGE_SIZE;
+	pStatistics->nFreeSpace = (size_t) m_nFreePages * PAGE_SIZE;
+	pStatistics->nAllocatedPages = m_nCount;
+	pStatistics->nMaxAllocatedPages = m_nMaxCount;
+	pStatistics->nAllocations = m_nAllocations;
+	pStatistics->nFailedAllocations = m_nFailedAllocations;
+
+	for (unsigned i = 0; i <= PAGE_MAX_ORDER; i++)
+	{
+		pStatistics->nFreeBlocks[i] = m_nFreeBlocks[i];
+	}
+
+	m_SpinLock.Release ();
+}
+
+void CPageAllocator::InsertFree (unsigned nPage, unsigned nOrder)
+{
+	assert (nPage < m_nPages);
+	assert (nOrder <= PAGE_MAX_ORDER);
+
+	TFreePage *pFreePage = GetPage (nPage);
+
+	pFreePage->nMagic = FREEPAGE_MAGIC;
+	pFreePage->pPrev = 0;
+	pFreePage->pNext = m_pFreeList[nOrder];
+	if (pFreePage->pNext != 0)
+	{
+		pFreePage->pNext->pPrev = pFreePage;
+	}
+	m_pFreeList[nOrder] = pFreePage;
+
+	m_uchPageState[nPage] = PAGE_STATE_FREE | nOrder;
+
+	m_nFreeBlocks[nOrder]++;
+	m_nFreePages += 1 << nOrder;
+}
+
+void CPageAllocator::RemoveFree (unsigned nPage, unsigned nOrder)
+{
+	assert (m_uchPageState[nPage] == (PAGE_STATE_FREE | nOrder));
+
+	TFreePage *pFreePage = GetPage (nPage);
+	assert (pFreePage->nMagic == FREEPAGE_MAGIC);
+
+	if (pFreePage->pPrev != 0)
+	{
+		pFreePage->pPrev->pNext = pFreePage->pNext;
+	}
+	else
+	{
+		assert (m_pFreeList[nOrder] == pFreePage);
+		m_pFreeList[nOrder] = pFreePage->pNext;
+	}
+
+	if (pFreePage->pNext != 0)
+	{
+		pFreePage->pNext->pPrev = pFreePage->pPrev;
+	}
+
+	m_uchPageState[nPage] = PAGE_STATE_NONE;
+
+	assert (m_nFreeBlocks[nOrder] > 0);
+	m_nFreeBlocks[nOrder]--;
+	m_nFreePages -= 1 << nOrder;
+}
+
 #ifdef PAGE_DEBUG
 
 void CPageAllocator::DumpStatus (void)
 {
 	CLogger::Get ()->Write ("pager", LogDebug, "%u pages (max %u)", m_nCount, m_nMaxCount);
+
+	for (unsigned i = 0; i <= PAGE_MAX_ORDER; i++)
+	{
+		CLogger::Get ()->Write ("pager", LogDebug, "Order %u: %u free blocks",
+					i, m_nFreeBlocks[i]);
+	}
 }
 
 #endif
@@ -41,7 +41,7 @@ IMPLEMENT_CLASS_ALLOCATOR (TPtrListElement)
 CPtrListFIQ::CPtrListFIQ (unsigned nMaxElements)
 :	m_pFirst (0)
 {
-	INIT_PROTECTED_CLASS_ALLOCATOR (TPtrListElement, nMaxElements, FIQ_LEVEL);
+	INIT_LOCKFREE_CLASS_ALLOCATOR (TPtrListElement, nMaxElements);
 }
 
 CPtrListFIQ::~CPtrListFIQ (void)
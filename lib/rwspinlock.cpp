@@ -0,0 +1,150 @@
+//
+// rwspinlock.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/rwspinlock.h>
+
+#ifdef ARM_ALLOW_MULTI_CORE
+
+#include <circle/spinlock.h>
+#include <assert.h>
+
+CRWSpinLock::CRWSpinLock (unsigned nTargetLevel)
+:	m_nTargetLevel (nTargetLevel),
+	m_nState (0)
+{
+	assert (nTargetLevel <= FIQ_LEVEL);
+}
+
+CRWSpinLock::~CRWSpinLock (void)
+{
+	assert (m_nState == 0);
+}
+
+void CRWSpinLock::ReadAcquire (void)
+{
+	if (m_nTargetLevel >= IRQ_LEVEL)
+	{
+		EnterCritical (m_nTargetLevel);
+	}
+
+	// exclusive accesses do not work before the MMU is enabled (see CSpinLock)
+	if (!CSpinLock::s_bEnabled)
+	{
+		return;
+	}
+
+	u32 nState = __atomic_load_n (&m_nState, __ATOMIC_RELAXED);
+	while (1)
+	{
+		if (nState & (RWSPINLOCK_WRITER | RWSPINLOCK_WRITER_WAITING))
+		{
+			// a releasing writer sends an event
+			WaitForEvent ();
+
+			nState = __atomic_load_n (&m_nState, __ATOMIC_RELAXED);
+
+			continue;
+		}
+
+		assert ((nState & RWSPINLOCK_READERS_MASK) < RWSPINLOCK_READERS_MASK);
+		if (__atomic_compare_exchange_n (&m_nState, &nState, nState + 1, TRUE,
+						 __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		{
+			break;
+		}
+	}
+}
+
+void CRWSpinLock::ReadRelease (void)
+{
+	if (CSpinLock::s_bEnabled)
+	{
+		assert (m_nState & RWSPINLOCK_READERS_MASK);
+		u32 nState = __atomic_sub_fetch (&m_nState, 1, __ATOMIC_RELEASE);
+
+		if ((nState & RWSPINLOCK_READERS_MASK) == 0)
+		{
+			// wake a waiting writer
+			DataSyncBarrier ();
+			SendEvent ();
+		}
+	}
+
+	if (m_nTargetLevel >= IRQ_LEVEL)
+	{
+		LeaveCritical ();
+	}
+}
+
+void CRWSpinLock::WriteAcquire (void)
+{
+	if (m_nTargetLevel >= IRQ_LEVEL)
+	{
+		EnterCritical (m_nTargetLevel);
+	}
+
+	if (!CSpinLock::s_bEnabled)
+	{
+		return;
+	}
+
+	u32 nState = __atomic_load_n (&m_nState, __ATOMIC_RELAXED);
+	while (1)
+	{
+		if (!(nState & (RWSPINLOCK_WRITER | RWSPINLOCK_READERS_MASK)))
+		{
+			// clears RWSPINLOCK_WRITER_WAITING, another waiting writer sets it again
+			if (__atomic_compare_exchange_n (&m_nState, &nState, RWSPINLOCK_WRITER, TRUE,
+							 __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			{
+				break;
+			}
+
+			continue;
+		}
+
+		if (!(nState & RWSPINLOCK_WRITER_WAITING))
+		{
+			__atomic_fetch_or (&m_nState, RWSPINLOCK_WRITER_WAITING, __ATOMIC_RELAXED);
+		}
+
+		WaitForEvent ();
+
+		nState = __atomic_load_n (&m_nState, __ATOMIC_RELAXED);
+	}
+}
+
+void CRWSpinLock::WriteRelease (void)
+{
+	if (CSpinLock::s_bEnabled)
+	{
+		assert (m_nState & RWSPINLOCK_WRITER);
+		__atomic_store_n (&m_nState, 0, __ATOMIC_RELEASE);
+
+		DataSyncBarrier ();
+		SendEvent ();
+	}
+
+	if (m_nTargetLevel >= IRQ_LEVEL)
+	{
+		LeaveCritical ();
+	}
+}
+
+#endif
@@ -0,0 +1,322 @@
+//
+// coroutine.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/sched/coroutine.h>
+#include <circle/sched/scheduler.h>
+#include <circle/timer.h>
+#include <assert.h>
+
+#define SLEEP_HEAP_SIZE_INITIAL	32
+
+CSpinLock CCoroutine::s_SpinLock (IRQ_LEVEL);
+
+CCoroutine::CCoroutine (void)
+:	m_nResumePoint (0),
+	m_State (StateRunning),
+	m_pExecutor (0),
+	m_pNext (0),
+	m_nWakeTicks (0)
+{
+}
+
+CCoroutine::~CCoroutine (void)
+{
+	assert (m_State == StateRunning);
+	m_pExecutor = 0;
+}
+
+void CCoroutine::SuspendReady (void)
+{
+	assert (m_State == StateRunning);
+	m_State = StateYielded;
+}
+
+void CCoroutine::SuspendSleeping (unsigned nMicroSeconds)
+{
+	assert (m_State == StateRunning);
+	m_nWakeTicks = CTimer::GetClockTicks () + nMicroSeconds * (CLOCKHZ / 1000000);
+	m_State = StateSleeping;
+}
+
+boolean CCoroutine::SuspendWaiting (CSynchronizationEvent *pEvent)
+{
+	assert (pEvent != 0);
+	assert (m_State == StateRunning);
+
+	s_SpinLock.Acquire ();
+
+	// checked with the lock held, so that a concurrent Set() cannot be missed
+	if (pEvent->m_bState)
+	{
+		s_SpinLock.Release ();
+
+		return FALSE;
+	}
+
+	m_State = StateWaiting;
+	m_pNext = pEvent->m_pCoroutineList;
+	pEvent->m_pCoroutineList = this;
+
+	s_SpinLock.Release ();
+
+	return TRUE;
+}
+
+void CCoroutine::WakeWaiting (CCoroutine **ppWaitList)
+{
+	assert (ppWaitList != 0);
+
+	s_SpinLock.Acquire ();
+
+	CCoroutine *pCoroutine = *ppWaitList;
+	*ppWaitList = 0;
+
+	s_SpinLock.Release ();
+
+	while (pCoroutine != 0)
+	{
+		CCoroutine *pNext = pCoroutine->m_pNext;
+
+		assert (pCoroutine->m_State == StateWaiting);
+		assert (pCoroutine->m_pExecutor != 0);
+		pCoroutine->m_pExecutor->MakeReady (pCoroutine);
+
+		pCoroutine = pNext;
+	}
+}
+
+CCoroutineExecutor::CCoroutineExecutor (unsigned nStackSize)
+:	CTask (nStackSize),
+	m_pReadyHead (0),
+	m_pReadyTail (0),
+	m_ppSleepHeap (0),
+	m_nSleeping (0),
+	m_nSleepHeapSize (0),
+	m_nCoroutines (0)
+{
+	SetName ("coroutines");
+}
+
+CCoroutineExecutor::~CCoroutineExecutor (void)
+{
+	delete [] m_ppSleepHeap;
+	m_ppSleepHeap = 0;
+}
+
+void CCoroutineExecutor::AddCoroutine (CCoroutine *pCoroutine)
+{
+	assert (pCoroutine != 0);
+	assert (pCoroutine->m_pExecutor == 0);
+	pCoroutine->m_pExecutor = this;
+
+	CCoroutine::s_SpinLock.Acquire ();
+
+	m_nCoroutines++;
+
+	CCoroutine::s_SpinLock.Release ();
+
+	MakeReady (pCoroutine);
+}
+
+void CCoroutineExecutor::Run (void)
+{
+	while (1)
+	{
+		WakeSleeping ();
+
+		CCoroutine::s_SpinLock.Acquire ();
+
+		// the coroutines, which are ready now, run once in this round
+		CCoroutine *pList = m_pReadyHead;
+		m_pReadyHead = 0;
+		m_pReadyTail = 0;
+
+		if (pList == 0)
+		{
+			m_WakeEvent.Clear ();	// MakeReady() sets it again
+		}
+
+		CCoroutine::s_SpinLock.Release ();
+
+		if (pList == 0)
+		{
+			if (m_nSleeping > 0)
+			{
+				int nTicks = (int) (  m_ppSleepHeap[1]->m_nWakeTicks
+						    - CTimer::GetClockTicks ());
+				if (nTicks > 0)
+				{
+					m_WakeEvent.WaitWithTimeout (nTicks / (CLOCKHZ / 1000000));
+				}
+			}
+			else
+			{
+				m_WakeEvent.Wait ();
+			}
+
+			continue;
+		}
+
+		while (pList != 0)
+		{
+			CCoroutine *pCoroutine = pList;
+			pList = pCoroutine->m_pNext;
+			pCoroutine->m_pNext = 0;
+
+			assert (pCoroutine->m_State == CCoroutine::StateReady);
+			pCoroutine->m_State = CCoroutine::StateRunning;
+
+			pCoroutine->Run ();
+
+			switch (pCoroutine->m_State)
+			{
+			case CCoroutine::StateRunning:		// returned after CO_END
+				delete pCoroutine;
+
+				CCoroutine::s_SpinLock.Acquire ();
+				assert (m_nCoroutines > 0);
+				m_nCoroutines--;
+				CCoroutine::s_SpinLock.Release ();
+				break;
+
+			case CCoroutine::StateYielded:
+				MakeReady (pCoroutine);
+				break;
+
+			case CCoroutine::StateSleeping:
+				AddSleeping (pCoroutine);
+				break;
+
+			case CCoroutine::StateWaiting:		// may have been woken meanwhile
+			case CCoroutine::StateReady:
+				break;
+
+			default:
+				assert (0);
+				break;
+			}
+		}
+
+		CScheduler::Get ()->Yield ();		// let other tasks run
+	}
+}
+
+void CCoroutineExecutor::MakeReady (CCoroutine *pCoroutine)
+{
+	assert (pCoroutine != 0);
+	assert (pCoroutine->m_pExecutor == this);
+
+	CCoroutine::s_SpinLock.Acquire ();
+
+	pCoroutine->m_State = CCoroutine::StateReady;
+	pCoroutine->m_pNext = 0;
+
+	if (m_pReadyTail != 0)
+	{
+		m_pReadyTail->m_pNext = pCoroutine;
+	}
+	else
+	{
+		m_pReadyHead = pCoroutine;
+	}
+	m_pReadyTail = pCoroutine;
+
+	CCoroutine::s_SpinLock.Release ();
+
+	m_WakeEvent.Set ();
+}
+
+// the wake times are compared as signed difference, because the clock may wrap
+
+void CCoroutineExecutor::AddSleeping (CCoroutine *pCoroutine)
+{
+	assert (pCoroutine != 0);
+
+	if (m_nSleeping == m_nSleepHeapSize)
+	{
+		unsigned nNewSize =   m_nSleepHeapSize > 0
+				    ? 2 * m_nSleepHeapSize : SLEEP_HEAP_SIZE_INITIAL;
+
+		CCoroutine **ppNewHeap = new CCoroutine *[nNewSize+1];
+		assert (ppNewHeap != 0);
+
+		for (unsigned i = 1; i <= m_nSleeping; i++)
+		{
+			ppNewHeap[i] = m_ppSleepHeap[i];
+		}
+
+		delete [] m_ppSleepHeap;
+		m_ppSleepHeap = ppNewHeap;
+		m_nSleepHeapSize = nNewSize;
+	}
+
+	unsigned nIndex = ++m_nSleeping;
+	while (   nIndex > 1
+	       &&   (int) (  pCoroutine->m_nWakeTicks
+			   - m_ppSleepHeap[nIndex / 2]->m_nWakeTicks) < 0)
+	{
+		m_ppSleepHeap[nIndex] = m_ppSleepHeap[nIndex / 2];
+		nIndex /= 2;
+	}
+
+	m_ppSleepHeap[nIndex] = pCoroutine;
+}
+
+void CCoroutineExecutor::WakeSleeping (void)
+{
+	if (m_nSleeping == 0)
+	{
+		return;
+	}
+
+	unsigned nTicks = CTimer::GetClockTicks ();
+
+	while (   m_nSleeping > 0
+	       && (int) (m_ppSleepHeap[1]->m_nWakeTicks - nTicks) <= 0)
+	{
+		CCoroutine *pCoroutine = m_ppSleepHeap[1];
+
+		// move the last entry down from the top
+		CCoroutine *pLast = m_ppSleepHeap[m_nSleeping--];
+
+		unsigned nIndex = 1;
+		unsigned nChild;
+		while ((nChild = 2 * nIndex) <= m_nSleeping)
+		{
+			if (   nChild < m_nSleeping
+			    &&   (int) (  m_ppSleepHeap[nChild+1]->m_nWakeTicks
+				        - m_ppSleepHeap[nChild]->m_nWakeTicks) < 0)
+			{
+				nChild++;
+			}
+
+			if ((int) (m_ppSleepHeap[nChild]->m_nWakeTicks - pLast->m_nWakeTicks) >= 0)
+			{
+				break;
+			}
+
+			m_ppSleepHeap[nIndex] = m_ppSleepHeap[nChild];
+			nIndex = nChild;
+		}
+
+		m_ppSleepHeap[nIndex] = pLast;
+
+		MakeReady (pCoroutine);
+	}
+}
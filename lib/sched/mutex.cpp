@@ -23,50 +23,101 @@
 #include <circle/sched/mutex.h>
 #include <circle/sched/scheduler.h>
 #include <circle/sched/task.h>
-#include <circle/synchronize.h>
-#include <circle/sysconfig.h>
+#include <circle/atomic.h>
 #include <assert.h>
 
 CMutex::CMutex (void)
-:   m_pOwningTask (0),
+:   m_nState (StateFree),
+    m_pOwningTask (0),
     m_iReentrancyCount (0)
 {
+    m_WaitQueue.pHead = 0;
+    m_WaitQueue.pTail = 0;
 }
 
 CMutex::~CMutex (void)
 {
     assert(m_pOwningTask == 0);
+    assert(m_WaitQueue.pHead == 0);
 }
 
 void CMutex::Acquire (void)
 {
     CTask* pTask = CScheduler::Get()->GetCurrentTask();
 
-    while (true)
+    // only this task can have set the owner to itself, so this is not racy
+    if (m_pOwningTask == pTask)
     {
-        if (m_pOwningTask == nullptr)
-        {
-            m_pOwningTask = pTask;
-            m_iReentrancyCount = 1;
-            return;
-        }
-        else if (m_pOwningTask == pTask)
-        {
-            m_iReentrancyCount++;
-            return;
-        }
-        m_event.Wait();
+        m_iReentrancyCount++;
+        return;
     }
+
+    // fast path: the mutex is free
+    if (AtomicCompareExchange (&m_nState, StateFree, StateAcquired) != StateFree)
+    {
+        AcquireContended (pTask);
+    }
+
+    m_pOwningTask = pTask;
+    m_iReentrancyCount = 1;
 }
 
 void CMutex::Release (void)
 {
     assert(m_pOwningTask == CScheduler::Get()->GetCurrentTask());
-    m_iReentrancyCount--;
-    if (m_iReentrancyCount == 0)
+    assert(m_iReentrancyCount > 0);
+    if (--m_iReentrancyCount > 0)
     {
-        m_pOwningTask = 0;
-        m_event.Pulse();
-        CScheduler::Get()->Yield();
+        return;
     }
+
+    m_pOwningTask = 0;
+
+    // fast path: no task is waiting
+    if (AtomicCompareExchange (&m_nState, StateAcquired, StateFree) != StateAcquired)
+    {
+        ReleaseContended ();
+    }
+}
+
+void CMutex::AcquireContended (CTask *pTask)
+{
+    CScheduler *pScheduler = CScheduler::Get();
+
+    pScheduler->LockWaitQueues ();
+
+    // Mark the mutex as contended, so that Release() takes the slow path. If it has
+    // been released in between, we have got it (with a spurious contended state).
+    if (AtomicExchange (&m_nState, StateContended) != StateFree)
+    {
+        // ReleaseContended() hands the mutex over to us and wakes us up
+        pScheduler->BlockOnWaitQueue (&m_WaitQueue);
+    }
+
+    pScheduler->UnlockWaitQueues ();
+}
+
+void CMutex::ReleaseContended (void)
+{
+    CScheduler *pScheduler = CScheduler::Get();
+
+    pScheduler->LockWaitQueues ();
+
+    assert(AtomicGet (&m_nState) == StateContended);
+
+    // The mutex stays acquired for the first waiting task, so that a task, which
+    // comes in the meantime, cannot overtake it. The new owner sets m_pOwningTask.
+    if (pScheduler->WakeFromWaitQueue (&m_WaitQueue) != 0)
+    {
+        if (m_WaitQueue.pHead == 0)
+        {
+            AtomicSet (&m_nState, StateAcquired);
+        }
+    }
+    else
+    {
+        AtomicSet (&m_nState, StateFree);
+    }
+
+    pScheduler->UnlockWaitQueues ();
 }
@@ -19,29 +19,112 @@
 //
 #include <circle/sched/scheduler.h>
 #include <circle/timer.h>
+#include <circle/tracer.h>
 #include <circle/logger.h>
+#include <circle/synchronize.h>
+#include <circle/multicore.h>
 #include <circle/string.h>
 #include <circle/util.h>
 #include <assert.h>
 
 static const char FromScheduler[] = "sched";
 
+#define TABLE_SIZE_INITIAL	32		// must be a power of 2
+
 CScheduler *CScheduler::s_pThis = 0;
 
+// the physical counter is read directly for statistics, because it is faster
+static inline unsigned ReadCounter (void)
+{
+#ifdef USE_PHYSICAL_COUNTER
+#if AARCH == 32
+	u32 nCNTPCTLow, nCNTPCTHigh;
+	asm volatile ("mrrc p15, 0, %0, %1, c14" : "=r" (nCNTPCTLow), "=r" (nCNTPCTHigh));
+
+	return nCNTPCTLow;
+#else
+	u64 nCNTPCT;
+	asm volatile ("mrs %0, CNTPCT_EL0" : "=r" (nCNTPCT));
+
+	return (unsigned) nCNTPCT;
+#endif
+#else
+	return CTimer::GetClockTicks ();
+#endif
+}
+
+static inline unsigned ReadCounterFrequency (void)
+{
+#ifdef USE_PHYSICAL_COUNTER
+#if AARCH == 32
+	u32 nCNTFRQ;
+	asm volatile ("mrc p15, 0, %0, c14, c0, 0" : "=r" (nCNTFRQ));
+
+	return nCNTFRQ;
+#else
+	u64 nCNTFRQ;
+	asm volatile ("mrs %0, CNTFRQ_EL0" : "=r" (nCNTFRQ));
+
+	return (unsigned) nCNTFRQ;
+#endif
+#else
+	return CLOCKHZ;
+#endif
+}
+
+static inline unsigned ThisCore (void)
+{
+#ifdef ARM_ALLOW_MULTI_CORE
+	return CMultiCoreSupport::ThisCore ();
+#else
+	return 0;
+#endif
+}
+
 CScheduler::CScheduler (void)
-:	m_nTasks (0),
-	m_pCurrent (0),
-	m_nCurrent (0),
+:	m_pFirstTask (0),
+	m_pLastTask (0),
+	m_nTasks (0),
+	m_nTableSize (0),
+	m_ppAddressHash (0),
+	m_ppNameHash (0),
+#ifdef ARM_ALLOW_MULTI_CORE
+	m_nActiveCores (1),
+	m_nEnqueueSerial (0),
+	m_bTickHandlerRegistered (FALSE),
+#endif
+	m_ppTimedHeap (0),
+	m_nTimedTasks (0),
+	m_nNextWakeTicks (0),
+	m_pTerminatedList (0),
 	m_pTaskSwitchHandler (0),
 	m_pTaskTerminationHandler (0),
-	m_iSuspendNewTasks (0)
+	m_iSuspendNewTasks (0),
+	m_nCounterHz (ReadCounterFrequency ()),
+	m_nStatisticsStamp (ReadCounter ()),
+	m_bTraceSwitches (FALSE)
 {
 	assert (s_pThis == 0);
 	s_pThis = this;
 
-	m_pCurrent = new CTask (0);		// main task currently running
-	assert (m_pCurrent != 0);
-	m_pCurrent->SetName ("main");
+	for (unsigned nCore = 0; nCore < SCHED_CORES; nCore++)
+	{
+		m_pCurrent[nCore] = 0;
+
+		for (unsigned i = 0; i < TASK_PRIORITIES; i++)
+		{
+			m_RunQueue[nCore].pHead[i] = 0;
+			m_RunQueue[nCore].pTail[i] = 0;
+		}
+
+		m_RunQueue[nCore].nReadyMask = 0;
+
+		m_nIdleTicks[nCore] = 0;
+	}
+
+	m_pCurrent[0] = new CTask (0);		// main task currently running
+	assert (m_pCurrent[0] != 0);
+	m_pCurrent[0]->SetName ("main");
 }
 
 CScheduler::~CScheduler (void)
@@ -49,36 +132,87 @@ CScheduler::~CScheduler (void)
 	m_pTaskSwitchHandler = 0;
 	m_pTaskTerminationHandler = 0;
 
+	delete [] m_ppAddressHash;
+	m_ppAddressHash = 0;
+	delete [] m_ppNameHash;
+	m_ppNameHash = 0;
+	delete [] m_ppTimedHeap;
+	m_ppTimedHeap = 0;
+
 	s_pThis = 0;
 }
 
 void CScheduler::Yield (void)
 {
-	while ((m_nCurrent = GetNextTask ()) == MAX_TASKS)	// no task is ready
+	CheckStack (m_pCurrent[ThisCore ()]);
+
+	ReapTasks ();
+
+	m_SpinLock.Acquire ();
+
+	unsigned nCore = ThisCore ();
+	CTask *pCurrent = m_pCurrent[nCore];
+	assert (pCurrent != 0);
+	assert (pCurrent->m_bRunning);
+
+	EnqueueTask (pCurrent);		// append to its run queue, if still ready
+
+	unsigned nNow = ReadCounter ();
+
+	CTask *pNext;
+	if ((pNext = GetNextTask (nCore)) == 0)
 	{
-		assert (m_nTasks > 0);
+		// the time, while no task is ready, is not accounted to pCurrent
+		AccountSwitch (pCurrent, 0, nCore, nNow);
+
+		while ((pNext = GetNextTask (nCore)) == 0)
+		{
+			WaitForWakeUp (nCore);
+		}
+
+		unsigned nIdleEnd = ReadCounter ();
+		m_nIdleTicks[nCore] += nIdleEnd - nNow;
+		nNow = nIdleEnd;
+
+		pCurrent->m_nRunStamp = nNow;
+
+		if (pCurrent == pNext)		// has been woken up
+		{
+			AccountSwitch (pCurrent, pNext, nCore, nNow);
+		}
 	}
 
-	assert (m_nCurrent < MAX_TASKS);
-	CTask *pNext = m_pTask[m_nCurrent];
-	assert (pNext != 0);
-	if (m_pCurrent == pNext)
+	if (pCurrent == pNext)
 	{
+		m_SpinLock.Release ();
+
 		return;
 	}
-	
-	TTaskRegisters *pOldRegs = m_pCurrent->GetRegs ();
-	m_pCurrent = pNext;
-	TTaskRegisters *pNewRegs = m_pCurrent->GetRegs ();
+
+	AccountSwitch (pCurrent, pNext, nCore, nNow);
+
+	pCurrent->m_bRunning = FALSE;
+	pNext->m_bRunning = TRUE;
+	m_pCurrent[nCore] = pNext;
+
+	if (pCurrent->GetState () == TaskStateTerminated)
+	{
+		// cannot be deleted before the task switch, because we are running on its stack
+		pCurrent->m_pRunNext = m_pTerminatedList;
+		m_pTerminatedList = pCurrent;
+	}
 
 	if (m_pTaskSwitchHandler != 0)
 	{
-		(*m_pTaskSwitchHandler) (m_pCurrent);
+		(*m_pTaskSwitchHandler) (pNext);
 	}
 
-	assert (pOldRegs != 0);
-	assert (pNewRegs != 0);
-	TaskSwitch (pOldRegs, pNewRegs);
+	// m_SpinLock is held during the task switch, so that no other core can pick up
+	// pCurrent, before its registers have been saved. The next task releases it.
+	TaskSwitch (pCurrent->GetRegs (), pNext->GetRegs ());
+
+	// continues here, when this task runs again (maybe on another core)
+	FinishTaskSwitch ();
 }
 
 void CScheduler::Sleep (unsigned nSeconds)
@@ -111,10 +245,16 @@ void CScheduler::usSleep (unsigned nMicroSeconds)
 
 		unsigned nStartTicks = CTimer::Get ()->GetClockTicks ();
 
-		assert (m_pCurrent != 0);
-		assert (m_pCurrent->GetState () == TaskStateReady);
-		m_pCurrent->SetWakeTicks (nStartTicks + nTicks);
-		m_pCurrent->SetState (TaskStateSleeping);
+		m_SpinLock.Acquire ();
+
+		CTask *pCurrent = m_pCurrent[ThisCore ()];
+		assert (pCurrent != 0);
+		assert (pCurrent->GetState () == TaskStateReady);
+		pCurrent->SetWakeTicks (nStartTicks + nTicks);
+		pCurrent->SetState (TaskStateSleeping);
+		AddTimedTask (pCurrent);
+
+		m_SpinLock.Release ();
 
 		Yield ();
 	}
@@ -122,37 +262,39 @@ void CScheduler::usSleep (unsigned nMicroSeconds)
 
 CTask *CScheduler::GetCurrentTask (void)
 {
-	return m_pCurrent;
+	return m_pCurrent[ThisCore ()];
 }
 
 CTask *CScheduler::GetTask (const char *pTaskName)
 {
 	assert (pTaskName != 0);
 
-	for (unsigned i = 0; i < m_nTasks; i++)
-	{
-		CTask *pTask = m_pTask[i];
+	unsigned nHash = HashName (pTaskName);
 
-		if (   pTask != 0
-		    && strcmp (pTask->GetName (), pTaskName) == 0)
-		{
-			return pTask;
-		}
+	m_SpinLock.Acquire ();
+
+	CTask *pTask = m_ppNameHash[nHash & (m_nTableSize-1)];
+	while (   pTask != 0
+	       && (   pTask->m_nNameHash != nHash
+		   || strcmp (pTask->GetName (), pTaskName) != 0))
+	{
+		pTask = pTask->m_pNameHashNext;
 	}
 
-	return 0;
+	m_SpinLock.Release ();
+
+	return pTask;
 }
 
 boolean CScheduler::IsValidTask (CTask *pTask)
 {
-	unsigned i;
-	for (i = 0; i < m_nTasks; i++)
-	{
-		if (m_pTask[i] != 0 && m_pTask[i] == pTask)
-			return TRUE;
-	}
+	m_SpinLock.Acquire ();
 
-	return FALSE;
+	boolean bResult = IsKnownTask (pTask);
+
+	m_SpinLock.Release ();
+
+	return bResult;
 }
 
 void CScheduler::RegisterTaskSwitchHandler (TSchedulerTaskHandler *pHandler)
@@ -180,16 +322,19 @@ void CScheduler::ResumeNewTasks (void)
 	m_iSuspendNewTasks--;
 	if (m_iSuspendNewTasks == 0)
 	{
+		m_SpinLock.Acquire ();
+
 		// Resume all new tasks
-		unsigned i;
-		for (i = 0; i < m_nTasks; i++)
+		for (CTask *pTask = m_pFirstTask; pTask != 0; pTask = pTask->m_pTaskNext)
 		{
-			if (m_pTask[i] != 0 && m_pTask[i]->GetState() == TaskStateNew)
+			if (pTask->GetState() == TaskStateNew)
 			{
-				m_pTask[i]->Start();
+				pTask->SetState (TaskStateReady);
+				EnqueueTask (pTask);
 			}
 		}
 
+		m_SpinLock.Release ();
 	}
 }
 
@@ -197,17 +342,12 @@ void CScheduler::ListTasks (CDevice *pTarget)
 {
 	assert (pTarget != 0);
 
-	static const char Header[] = "#  ADDR     STAT  FL NAME\n";
+	static const char Header[] = "#  ADDR     STAT  FL PR C NAME\n";
 	pTarget->Write (Header, sizeof Header-1);
 
-	for (unsigned i = 0; i < m_nTasks; i++)
+	unsigned i = 0;
+	for (CTask *pTask = m_pFirstTask; pTask != 0; pTask = pTask->m_pTaskNext, i++)
 	{
-		CTask *pTask = m_pTask[i];
-		if (pTask == 0)
-		{
-			continue;
-		}
-
 		TTaskState State = pTask->GetState ();
 		assert (State < TaskStateUnknown);
 
@@ -216,223 +356,1170 @@ void CScheduler::ListTasks (CDevice *pTarget)
 			{"new", "ready", "block", "block", "sleep", "term"};
 
 		CString Line;
-		Line.Format ("%02u %08lX %-5s %c%c %s\n",
+		Line.Format ("%02u %08lX %-5s %c%c %2u %u %s\n",
 			     i, (uintptr) pTask,
-			     pTask == m_pCurrent ? "run" : StateNames[State],
+			     pTask->m_bRunning ? "run" : StateNames[State],
 			     pTask->IsSuspended () ? 'S' : ' ',
 			     State == TaskStateBlockedWithTimeout ? 'T' : ' ',
+			     pTask->GetPriority (),
+			     pTask->m_nCore,
 			     pTask->GetName ());
 
 		pTarget->Write (Line, Line.GetLength ());
 	}
 }
 
-void CScheduler::AddTask (CTask *pTask)
+boolean CScheduler::GetTaskStatistics (CTask *pTask, TTaskStatistics *pStatistics)
 {
-	assert (pTask != 0);
+	assert (pStatistics != 0);
 
-	if (m_iSuspendNewTasks)
-	{
-		pTask->SetState(TaskStateNew);
-	}
+	m_SpinLock.Acquire ();
 
-	unsigned i;
-	for (i = 0; i < m_nTasks; i++)
+	if (!IsKnownTask (pTask))
 	{
-		if (m_pTask[i] == 0)
-		{
-			m_pTask[i] = pTask;
+		m_SpinLock.Release ();
 
-			return;
-		}
+		return FALSE;
 	}
 
-	if (m_nTasks >= MAX_TASKS)
+	u64 nRunTicks = pTask->m_nRunTicks;
+	if (pTask->m_bRunning)
 	{
-		CLogger::Get ()->Write (FromScheduler, LogPanic, "System limit of tasks exceeded");
+		nRunTicks += ReadCounter () - pTask->m_nRunStamp;	// current slice
 	}
 
-	m_pTask[m_nTasks++] = pTask;
+	pStatistics->nRunTime = nRunTicks * 1000000 / m_nCounterHz;
+	pStatistics->nSwitches = pTask->m_nSwitches;
+	pStatistics->nMaxSlice = CounterToMicroSeconds (pTask->m_nMaxSliceTicks);
+	pStatistics->nAvgLatency =   pTask->m_nSwitches > 0
+				   ? CounterToMicroSeconds (pTask->m_nLatencyTicks / pTask->m_nSwitches)
+				   : 0;
+	pStatistics->nMaxLatency = CounterToMicroSeconds (pTask->m_nMaxLatencyTicks);
+
+	m_SpinLock.Release ();
+
+	return TRUE;
 }
 
-void CScheduler::RemoveTask (CTask *pTask)
+void CScheduler::ResetStatistics (void)
 {
-	for (unsigned i = 0; i < m_nTasks; i++)
-	{
-		if (m_pTask[i] == pTask)
-		{
-			m_pTask[i] = 0;
+	m_SpinLock.Acquire ();
 
-			if (i == m_nTasks-1)
-			{
-				m_nTasks--;
-			}
+	unsigned nNow = ReadCounter ();
+
+	for (CTask *pTask = m_pFirstTask; pTask != 0; pTask = pTask->m_pTaskNext)
+	{
+		pTask->m_nRunTicks = 0;
+		pTask->m_nLatencyTicks = 0;
+		pTask->m_nSwitches = 0;
+		pTask->m_nMaxSliceTicks = 0;
+		pTask->m_nMaxLatencyTicks = 0;
 
-			return;
+		if (pTask->m_bRunning)
+		{
+			pTask->m_nRunStamp = nNow;
 		}
 	}
 
-	assert (0);
+	for (unsigned nCore = 0; nCore < SCHED_CORES; nCore++)
+	{
+		m_nIdleTicks[nCore] = 0;
+	}
+
+	m_nStatisticsStamp = nNow;
+
+	m_SpinLock.Release ();
 }
 
-boolean CScheduler::BlockTask (CTask **ppWaitListHead, unsigned nMicroSeconds)
+void CScheduler::ListTaskStatistics (CDevice *pTarget, boolean bReset)
 {
-	assert (ppWaitListHead != 0);
-	assert (m_pCurrent->m_pWaitListNext == 0);
-	assert (m_pCurrent != 0);
-	assert (m_pCurrent->GetState () == TaskStateReady);
+	assert (pTarget != 0);
+
+	// the listing is generated with the lock held and written afterwards
+	CString Listing;
+	Listing.Append ("NAME             CPU%   RUN ms SWITCHES MAXSLICE AVGLAT MAXLAT (us)\n");
 
 	m_SpinLock.Acquire ();
 
-	// Add current task to waiting task list
-	m_pCurrent->m_pWaitListNext = *ppWaitListHead;
-	*ppWaitListHead = m_pCurrent;
+	unsigned nNow = ReadCounter ();
+	u64 nPeriodTicks = nNow - m_nStatisticsStamp;
+	if (nPeriodTicks == 0)
+	{
+		nPeriodTicks = 1;
+	}
 
-	if (nMicroSeconds == 0)
+	for (CTask *pTask = m_pFirstTask; pTask != 0; pTask = pTask->m_pTaskNext)
 	{
-		m_pCurrent->SetState (TaskStateBlocked);
+		u64 nRunTicks = pTask->m_nRunTicks;
+		if (pTask->m_bRunning)
+		{
+			nRunTicks += nNow - pTask->m_nRunStamp;
+		}
+
+		unsigned nPermille = (unsigned) (nRunTicks * 1000 / nPeriodTicks);
+
+		CString Line;
+		Line.Format ("%-16s %3u.%u %8u %8u %8u %6u %6u\n",
+			     pTask->GetName (), nPermille / 10, nPermille % 10,
+			     (unsigned) (nRunTicks * 1000 / m_nCounterHz),
+			     pTask->m_nSwitches,
+			     CounterToMicroSeconds (pTask->m_nMaxSliceTicks),
+			       pTask->m_nSwitches > 0
+			     ? CounterToMicroSeconds (pTask->m_nLatencyTicks / pTask->m_nSwitches) : 0,
+			     CounterToMicroSeconds (pTask->m_nMaxLatencyTicks));
+		Listing.Append (Line);
 	}
-	else
+
+	for (unsigned nCore = 0; nCore < SCHED_CORES; nCore++)
 	{
-		unsigned nTicks = nMicroSeconds * (CLOCKHZ / 1000000);
-		unsigned nStartTicks = CTimer::Get ()->GetClockTicks ();
+		unsigned nPermille = (unsigned) (m_nIdleTicks[nCore] * 1000 / nPeriodTicks);
 
-		m_pCurrent->SetWakeTicks (nStartTicks + nTicks);
-		m_pCurrent->SetState (TaskStateBlockedWithTimeout);
+		CString Line;
+		Line.Format ("idle%-12u %3u.%u %8u\n", nCore, nPermille / 10, nPermille % 10,
+			     (unsigned) (m_nIdleTicks[nCore] * 1000 / m_nCounterHz));
+		Listing.Append (Line);
 	}
-	
+
 	m_SpinLock.Release ();
 
-	Yield ();
+	pTarget->Write (Listing, Listing.GetLength ());
+
+	if (bReset)
+	{
+		ResetStatistics ();
+	}
+}
+
+void CScheduler::EnableSwitchTracing (boolean bEnable)
+{
+	m_bTraceSwitches = bEnable;
+}
+
+#ifdef ARM_ALLOW_MULTI_CORE
+
+void CScheduler::RunOnThisCore (void)
+{
+	unsigned nCore = ThisCore ();
+	assert (0 < nCore && nCore < CORES);
+	assert (m_pCurrent[nCore] == 0);
+
+	CTask *pTask = new CTask (0);		// represents the initial context of this core
+	assert (pTask != 0);
+
+	CString Name;
+	Name.Format ("core%u", nCore);
+	pTask->SetName (Name);
 
 	m_SpinLock.Acquire ();
 
-	// Remove this task from the wait list in case was woken by timeout and
-	// not by the event signalling (in which case the list will already be 
-	// cleared and the following is a no-op)
-	CTask* pPrev = 0;
-	CTask* p = *ppWaitListHead;
-	while (p)
+	// it is never ready again, so that this core only runs other tasks from now on
+	pTask->SetState (TaskStateBlocked);
+	m_pCurrent[nCore] = pTask;
+
+	m_nActiveCores |= 1U << nCore;
+
+	boolean bRegisterTickHandler = !m_bTickHandlerRegistered;
+	m_bTickHandlerRegistered = TRUE;
+
+	m_SpinLock.Release ();
+
+	if (bRegisterTickHandler)
 	{
-		if (p == m_pCurrent)
-		{
-			if (pPrev)
-				pPrev->m_pWaitListNext = p->m_pWaitListNext;
-			else
-				*ppWaitListHead = p->m_pWaitListNext;
-		}
-		pPrev = p;
-		p = p->m_pWaitListNext;
+		CTimer::Get ()->RegisterPeriodicHandler (TimerTickHandler);
 	}
-	m_pCurrent->m_pWaitListNext = nullptr;
 
-	m_SpinLock.Release ();
+	Yield ();
 
-	// GetWakeTicks Will be zero if timeout expired, non-zero if event signalled
-	return m_pCurrent->GetWakeTicks() == 0;		
+	assert (0);
 }
 
-void CScheduler::WakeTasks (CTask **ppWaitListHead)
+#endif
+
+void CScheduler::AddTask (CTask *pTask)
 {
-	assert (ppWaitListHead != 0);
+	assert (pTask != 0);
+
+	if (m_iSuspendNewTasks)
+	{
+		pTask->SetState(TaskStateNew);
+	}
 
 	m_SpinLock.Acquire ();
 
-	CTask *pTask = *ppWaitListHead;
-	*ppWaitListHead = 0;
+	if (m_nTasks == m_nTableSize)
+	{
+		GrowTables ();
+	}
 
-	while (pTask)
+	pTask->m_pTaskPrev = m_pLastTask;
+	pTask->m_pTaskNext = 0;
+	if (m_pLastTask != 0)
 	{
-#ifdef NDEBUG
-		if (   pTask == 0
-		    ||    (pTask->GetState () != TaskStateBlocked
-		       && pTask->GetState () != TaskStateBlockedWithTimeout))
-		{
-			CLogger::Get ()->Write (FromScheduler, LogPanic, "Tried to wake non-blocked task");
-		}
-#else
-		assert (pTask != 0);
-		assert (   pTask->GetState () == TaskStateBlocked
-		        || pTask->GetState () == TaskStateBlockedWithTimeout);
-#endif
+		m_pLastTask->m_pTaskNext = pTask;
+	}
+	else
+	{
+		m_pFirstTask = pTask;
+	}
+	m_pLastTask = pTask;
 
-		pTask->SetState (TaskStateReady);
+	m_nTasks++;
 
-		CTask* pNext = pTask->m_pWaitListNext;
-		pTask->m_pWaitListNext = 0;
-		pTask = pNext;
+	AddToHash (pTask);
+
+	if (pTask->m_nStackSize == 0)		// initial context of a core is running already
+	{
+		pTask->SetState (TaskStateReady);
+		pTask->m_nCore = ThisCore ();
+		pTask->m_bRunning = TRUE;
+		pTask->m_nRunStamp = ReadCounter ();
+	}
+	else
+	{
+		EnqueueTask (pTask);
 	}
 
 	m_SpinLock.Release ();
 }
 
-unsigned CScheduler::GetNextTask (void)
+void CScheduler::SetTaskName (CTask *pTask, const char *pName)
 {
-	unsigned nTask = m_nCurrent < MAX_TASKS ? m_nCurrent : 0;
+	assert (pTask != 0);
+	assert (pName != 0);
 
-	unsigned nTicks = CTimer::Get ()->GetClockTicks ();
+	m_SpinLock.Acquire ();
 
-	for (unsigned i = 1; i <= m_nTasks; i++)
-	{
-		if (++nTask >= m_nTasks)
-		{
-			nTask = 0;
-		}
+	RemoveFromHash (pTask);
 
-		CTask *pTask = m_pTask[nTask];
-		if (pTask == 0)
-		{
-			continue;
-		}
+	pTask->m_Name = pName;
 
-		if (pTask->IsSuspended ())
-		{
-			continue;
-		}
+	AddToHash (pTask);
 
-		switch (pTask->GetState ())
-		{
-		case TaskStateReady:
-			return nTask;
+	m_SpinLock.Release ();
+}
 
-		case TaskStateBlocked:
-		case TaskStateNew:
-			continue;
+void CScheduler::RemoveTask (CTask *pTask)
+{
+	m_SpinLock.Acquire ();
 
-		case TaskStateBlockedWithTimeout:
-			if ((int) (pTask->GetWakeTicks () - nTicks) > 0)
-			{
-				continue;
-			}
-			pTask->SetState (TaskStateReady);
-			pTask->SetWakeTicks(0);		// Use as flag that timeout expired
-			return nTask;
+	assert (IsKnownTask (pTask));
 
+	RemoveFromHash (pTask);
 
-		case TaskStateSleeping:
-			if ((int) (pTask->GetWakeTicks () - nTicks) > 0)
-			{
-				continue;
-			}
-			pTask->SetState (TaskStateReady);
-			return nTask;
+	if (pTask->m_pTaskPrev != 0)
+	{
+		pTask->m_pTaskPrev->m_pTaskNext = pTask->m_pTaskNext;
+	}
+	else
+	{
+		m_pFirstTask = pTask->m_pTaskNext;
+	}
 
-		case TaskStateTerminated:
-			if (m_pTaskTerminationHandler != 0)
-			{
-				(*m_pTaskTerminationHandler) (pTask);
-			}
-			RemoveTask (pTask);
-			delete pTask;
-			return MAX_TASKS;
+	if (pTask->m_pTaskNext != 0)
+	{
+		pTask->m_pTaskNext->m_pTaskPrev = pTask->m_pTaskPrev;
+	}
+	else
+	{
+		m_pLastTask = pTask->m_pTaskPrev;
+	}
 
-		default:
-			assert (0);
-			break;
+	pTask->m_pTaskPrev = 0;
+	pTask->m_pTaskNext = 0;
+
+	assert (m_nTasks > 0);
+	m_nTasks--;
+
+	m_SpinLock.Release ();
+}
+
+boolean CScheduler::IsKnownTask (CTask *pTask)
+{
+	// pTask may be any pointer, so it must not be dereferenced, before it has been found
+	for (CTask *pEntry = m_ppAddressHash[HashAddress (pTask) & (m_nTableSize-1)];
+	     pEntry != 0; pEntry = pEntry->m_pAddressHashNext)
+	{
+		if (pEntry == pTask)
+		{
+			return TRUE;
 		}
 	}
 
-	return MAX_TASKS;
+	return FALSE;
+}
+
+void CScheduler::AddToHash (CTask *pTask)
+{
+	assert (pTask != 0);
+	assert (m_nTableSize > 0);
+
+	CTask **ppBucket = &m_ppAddressHash[HashAddress (pTask) & (m_nTableSize-1)];
+	pTask->m_pAddressHashNext = *ppBucket;
+	*ppBucket = pTask;
+
+	pTask->m_nNameHash = HashName (pTask->GetName ());
+	ppBucket = &m_ppNameHash[pTask->m_nNameHash & (m_nTableSize-1)];
+	pTask->m_pNameHashNext = *ppBucket;
+	*ppBucket = pTask;
+}
+
+void CScheduler::RemoveFromHash (CTask *pTask)
+{
+	assert (pTask != 0);
+
+	CTask **ppEntry = &m_ppAddressHash[HashAddress (pTask) & (m_nTableSize-1)];
+	while (*ppEntry != pTask)
+	{
+		assert (*ppEntry != 0);
+		ppEntry = &(*ppEntry)->m_pAddressHashNext;
+	}
+	*ppEntry = pTask->m_pAddressHashNext;
+
+	ppEntry = &m_ppNameHash[pTask->m_nNameHash & (m_nTableSize-1)];
+	while (*ppEntry != pTask)
+	{
+		assert (*ppEntry != 0);
+		ppEntry = &(*ppEntry)->m_pNameHashNext;
+	}
+	*ppEntry = pTask->m_pNameHashNext;
+
+	pTask->m_pAddressHashNext = 0;
+	pTask->m_pNameHashNext = 0;
+}
+
+void CScheduler::GrowTables (void)
+{
+	assert (m_nTasks == m_nTableSize);
+
+	unsigned nNewSize = m_nTableSize > 0 ? 2 * m_nTableSize : TABLE_SIZE_INITIAL;
+
+	CTask **ppTimedHeap = new CTask *[nNewSize+1];
+	delete [] m_ppAddressHash;
+	m_ppAddressHash = new CTask *[nNewSize];
+	delete [] m_ppNameHash;
+	m_ppNameHash = new CTask *[nNewSize];
+	if (   ppTimedHeap == 0
+	    || m_ppAddressHash == 0
+	    || m_ppNameHash == 0)
+	{
+		m_SpinLock.Release ();
+
+		CLogger::Get ()->Write (FromScheduler, LogPanic, "Cannot grow task table");
+	}
+
+	// the timeout heap must hold all tasks, so that AddTimedTask() never has to allocate
+	for (unsigned i = 1; i <= m_nTimedTasks; i++)
+	{
+		ppTimedHeap[i] = m_ppTimedHeap[i];
+	}
+	delete [] m_ppTimedHeap;
+	m_ppTimedHeap = ppTimedHeap;
+
+	m_nTableSize = nNewSize;
+
+	for (unsigned i = 0; i < m_nTableSize; i++)
+	{
+		m_ppAddressHash[i] = 0;
+		m_ppNameHash[i] = 0;
+	}
+
+	for (CTask *pTask = m_pFirstTask; pTask != 0; pTask = pTask->m_pTaskNext)
+	{
+		AddToHash (pTask);
+	}
+}
+
+unsigned CScheduler::HashName (const char *pName)
+{
+	assert (pName != 0);
+
+	u32 nHash = 2166136261U;		// FNV-1a
+	while (*pName != '\0')
+	{
+		nHash ^= (u8) *pName++;
+		nHash *= 16777619U;
+	}
+
+	return nHash;
+}
+
+unsigned CScheduler::HashAddress (const CTask *pTask)
+{
+	uintptr nAddress = (uintptr) pTask;
+
+	return (unsigned) ((nAddress ^ (nAddress >> 12)) >> 4);	// objects are 16-byte aligned
+}
+
+void CScheduler::ReapTasks (void)
+{
+	if (m_pTerminatedList == 0)
+	{
+		return;
+	}
+
+	m_SpinLock.Acquire ();
+
+	// tasks, which are waited for in WaitForTermination(), stay in the list
+	CTask *pList = 0;
+	for (CTask **ppTask = &m_pTerminatedList; *ppTask != 0;)
+	{
+		CTask *pTask = *ppTask;
+		if (pTask->m_nTerminationWaiters > 0)
+		{
+			ppTask = &pTask->m_pRunNext;
+
+			continue;
+		}
+
+		*ppTask = pTask->m_pRunNext;
+
+		pTask->m_pRunNext = pList;
+		pList = pTask;
+	}
+
+	m_SpinLock.Release ();
+
+	while (pList != 0)
+	{
+		CTask *pTask = pList;
+		assert (!pTask->m_bRunning);
+		assert (pTask->GetState () == TaskStateTerminated);
+		pList = pTask->m_pRunNext;
+
+		if (m_pTaskTerminationHandler != 0)
+		{
+			(*m_pTaskTerminationHandler) (pTask);
+		}
+
+		RemoveTask (pTask);
+		delete pTask;
+	}
+}
+
+void CScheduler::CheckStack (CTask *pTask)
+{
+	assert (pTask != 0);
+
+	// the main task and the initial tasks of the cores do not have a stack of their own
+	if (   pTask->m_pStack != 0
+	    && !CTaskStackPool::IsIntact (pTask->m_pStack))
+	{
+		CLogger::Get ()->Write (FromScheduler, LogPanic, "Stack overflow in task %s",
+					pTask->GetName ());
+	}
+}
+
+void CScheduler::AccountSwitch (CTask *pCurrent, CTask *pNext, unsigned nCore, unsigned nNow)
+{
+	assert (pCurrent != 0);
+
+	unsigned nSlice = nNow - pCurrent->m_nRunStamp;
+	pCurrent->m_nRunTicks += nSlice;
+	if (nSlice > pCurrent->m_nMaxSliceTicks)
+	{
+		pCurrent->m_nMaxSliceTicks = nSlice;
+	}
+	pCurrent->m_nRunStamp = nNow;
+
+	if (pNext == 0)
+	{
+		return;
+	}
+
+	unsigned nLatency = nNow - pNext->m_nReadyStamp;
+	pNext->m_nLatencyTicks += nLatency;
+	if (nLatency > pNext->m_nMaxLatencyTicks)
+	{
+		pNext->m_nMaxLatencyTicks = nLatency;
+	}
+	pNext->m_nSwitches++;
+	pNext->m_nRunStamp = nNow;
+
+	if (m_bTraceSwitches)
+	{
+		CTracer *pTracer = CTracer::Get ();
+		if (pTracer != 0)
+		{
+			pTracer->Event (TRACER_EVENT_TASK_SWITCH, (unsigned) (uintptr) pCurrent,
+					(unsigned) (uintptr) pNext, nCore,
+					CounterToMicroSeconds (nLatency));
+		}
+	}
+}
+
+unsigned CScheduler::CounterToMicroSeconds (u64 nTicks) const
+{
+	assert (m_nCounterHz != 0);
+
+	return (unsigned) (nTicks * 1000000 / m_nCounterHz);
+}
+
+void CScheduler::FinishTaskSwitch (void)
+{
+	m_SpinLock.Release ();
+}
+
+boolean CScheduler::AddTerminationWaiter (CTask *pTask)
+{
+	m_SpinLock.Acquire ();
+
+	boolean bValid = IsKnownTask (pTask);
+	if (bValid)
+	{
+		pTask->m_nTerminationWaiters++;
+	}
+
+	m_SpinLock.Release ();
+
+	return bValid;
+}
+
+void CScheduler::RemoveTerminationWaiter (CTask *pTask)
+{
+	assert (pTask != 0);
+
+	m_SpinLock.Acquire ();
+
+	assert (pTask->m_nTerminationWaiters > 0);
+	pTask->m_nTerminationWaiters--;
+
+	m_SpinLock.Release ();
+}
+
+void CScheduler::StartTask (CTask *pTask)
+{
+	assert (pTask != 0);
+
+	m_SpinLock.Acquire ();
+
+	if (pTask->m_State == TaskStateNew)
+	{
+		pTask->m_State = TaskStateReady;
+	}
+	else
+	{
+		assert (pTask->m_bSuspended);
+		pTask->m_bSuspended = FALSE;
+	}
+
+	EnqueueTask (pTask);
+
+	m_SpinLock.Release ();
+}
+
+void CScheduler::SuspendTask (CTask *pTask)
+{
+	assert (pTask != 0);
+
+	m_SpinLock.Acquire ();
+
+	assert (pTask->m_State != TaskStateNew);
+	assert (!pTask->m_bSuspended);
+	pTask->m_bSuspended = TRUE;
+
+	DequeueTask (pTask);
+
+	m_SpinLock.Release ();
+}
+
+void CScheduler::SetTaskPriority (CTask *pTask, unsigned nPriority)
+{
+	assert (pTask != 0);
+	assert (nPriority < TASK_PRIORITIES);
+
+	m_SpinLock.Acquire ();
+
+	boolean bQueued = pTask->m_bQueued;
+	DequeueTask (pTask);
+
+	pTask->m_nPriority = nPriority;
+
+	if (bQueued)
+	{
+		unsigned nReadyStamp = pTask->m_nReadyStamp;
+		EnqueueTask (pTask);
+		pTask->m_nReadyStamp = nReadyStamp;	// it is still waiting since then
+	}
+
+	m_SpinLock.Release ();
+}
+
+void CScheduler::SetTaskAffinity (CTask *pTask, u32 nAffinity)
+{
+	assert (pTask != 0);
+	assert (nAffinity != 0);
+
+	m_SpinLock.Acquire ();
+
+	boolean bQueued = pTask->m_bQueued;
+	DequeueTask (pTask);
+
+	pTask->m_nAffinity = nAffinity;
+
+	if (bQueued)
+	{
+		unsigned nReadyStamp = pTask->m_nReadyStamp;
+		EnqueueTask (pTask);		// may move to the run queue of another core
+		pTask->m_nReadyStamp = nReadyStamp;
+	}
+
+	m_SpinLock.Release ();
+}
+
+boolean CScheduler::BlockTask (CTask **ppWaitListHead, unsigned nMicroSeconds,
+			       const volatile boolean *pCondition)
+{
+	assert (ppWaitListHead != 0);
+	assert (pCondition != 0);
+
+	m_SpinLock.Acquire ();
+
+	CTask *pCurrent = m_pCurrent[ThisCore ()];
+	assert (pCurrent != 0);
+	assert (pCurrent->m_pWaitListNext == 0);
+	assert (pCurrent->GetState () == TaskStateReady);
+
+	// The condition may have been set by another core or an interrupt handler
+	// after the caller checked it. It cannot change unnoticed from now on,
+	// because waking the tasks in the wait list requires m_SpinLock.
+	if (*pCondition)
+	{
+		m_SpinLock.Release ();
+
+		return FALSE;
+	}
+
+	// Add current task to waiting task list
+	pCurrent->m_pWaitListNext = *ppWaitListHead;
+	*ppWaitListHead = pCurrent;
+
+	if (nMicroSeconds == 0)
+	{
+		pCurrent->SetState (TaskStateBlocked);
+	}
+	else
+	{
+		unsigned nTicks = nMicroSeconds * (CLOCKHZ / 1000000);
+		unsigned nStartTicks = CTimer::Get ()->GetClockTicks ();
+
+		pCurrent->SetWakeTicks (nStartTicks + nTicks);
+		pCurrent->SetState (TaskStateBlockedWithTimeout);
+		AddTimedTask (pCurrent);
+	}
+
+	m_SpinLock.Release ();
+
+	Yield ();
+
+	m_SpinLock.Acquire ();
+
+	// Remove this task from the wait list in case was woken by timeout and
+	// not by the event signalling (in which case the list will already be
+	// cleared and the following is a no-op)
+	CTask* pPrev = 0;
+	CTask* p = *ppWaitListHead;
+	while (p)
+	{
+		if (p == pCurrent)
+		{
+			if (pPrev)
+				pPrev->m_pWaitListNext = p->m_pWaitListNext;
+			else
+				*ppWaitListHead = p->m_pWaitListNext;
+		}
+		pPrev = p;
+		p = p->m_pWaitListNext;
+	}
+	pCurrent->m_pWaitListNext = nullptr;
+
+	m_SpinLock.Release ();
+
+	// GetWakeTicks Will be zero if timeout expired, non-zero if event signalled
+	return pCurrent->GetWakeTicks() == 0;
+}
+
+void CScheduler::WakeTasks (CTask **ppWaitListHead)
+{
+	assert (ppWaitListHead != 0);
+
+	m_SpinLock.Acquire ();
+
+	CTask *pTask = *ppWaitListHead;
+	*ppWaitListHead = 0;
+
+	while (pTask)
+	{
+#ifdef NDEBUG
+		if (   pTask == 0
+		    ||    (pTask->GetState () != TaskStateBlocked
+		       && pTask->GetState () != TaskStateBlockedWithTimeout))
+		{
+			CLogger::Get ()->Write (FromScheduler, LogPanic, "Tried to wake non-blocked task");
+		}
+#else
+		assert (pTask != 0);
+		assert (   pTask->GetState () == TaskStateBlocked
+		        || pTask->GetState () == TaskStateBlockedWithTimeout);
+#endif
+
+		if (pTask->GetState () == TaskStateBlockedWithTimeout)
+		{
+			RemoveTimedTask (pTask);
+		}
+
+		pTask->SetState (TaskStateReady);
+		EnqueueTask (pTask);
+
+		CTask* pNext = pTask->m_pWaitListNext;
+		pTask->m_pWaitListNext = 0;
+		pTask = pNext;
+	}
+
+	m_SpinLock.Release ();
+}
+
+void CScheduler::LockWaitQueues (void)
+{
+	m_SpinLock.Acquire ();
+}
+
+void CScheduler::UnlockWaitQueues (void)
+{
+	m_SpinLock.Release ();
+}
+
+void CScheduler::BlockOnWaitQueue (TTaskWaitQueue *pQueue)
+{
+	assert (pQueue != 0);
+
+	CTask *pCurrent = m_pCurrent[ThisCore ()];
+	assert (pCurrent != 0);
+	assert (pCurrent->m_pWaitListNext == 0);
+	assert (pCurrent->GetState () == TaskStateReady);
+
+	// append to the tail, so that the tasks get the resource in FIFO order
+	if (pQueue->pTail != 0)
+	{
+		pQueue->pTail->m_pWaitListNext = pCurrent;
+	}
+	else
+	{
+		pQueue->pHead = pCurrent;
+	}
+
+	pQueue->pTail = pCurrent;
+
+	pCurrent->SetState (TaskStateBlocked);
+
+	m_SpinLock.Release ();
+
+	// a running task is not taken over by another core, even if it has been woken
+	// in between, so that it is safe to release the lock before the task switch
+	Yield ();
+
+	m_SpinLock.Acquire ();
+}
+
+CTask *CScheduler::WakeFromWaitQueue (TTaskWaitQueue *pQueue)
+{
+	assert (pQueue != 0);
+
+	CTask *pTask = pQueue->pHead;
+	if (pTask == 0)
+	{
+		return 0;
+	}
+
+	pQueue->pHead = pTask->m_pWaitListNext;
+	if (pQueue->pHead == 0)
+	{
+		pQueue->pTail = 0;
+	}
+
+	pTask->m_pWaitListNext = 0;
+
+	assert (pTask->GetState () == TaskStateBlocked);
+	pTask->SetState (TaskStateReady);
+	EnqueueTask (pTask);
+
+	return pTask;
+}
+
+CTask *CScheduler::GetNextTask (unsigned nCore)
+{
+	WakeTimedTasks ();
+
+	// highest priority with a ready task on this core
+	TRunQueue *pQueue = &m_RunQueue[nCore];
+	int nPriority = pQueue->nReadyMask != 0 ? 31 - __builtin_clz (pQueue->nReadyMask) : -1;
+	CTask *pTask = nPriority >= 0 ? pQueue->pHead[nPriority] : 0;
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	// take over a ready task with a higher priority from another core
+	if (m_nActiveCores != 1)
+	{
+		for (unsigned i = 1; i < CORES; i++)
+		{
+			CTask *pOther = FindTaskToSteal ((nCore + i) & (CORES-1), nCore, nPriority);
+			if (pOther != 0)
+			{
+				pTask = pOther;
+				nPriority = pOther->m_nPriority;
+			}
+		}
+	}
+#endif
+
+	if (pTask == 0)
+	{
+		return 0;
+	}
+
+	DequeueTask (pTask);
+	pTask->m_nCore = nCore;
+
+	return pTask;
+}
+
+#ifdef ARM_ALLOW_MULTI_CORE
+
+// returns the first task with the highest priority above nAbovePriority in the run queues
+// of nFromCore, which is allowed to run on nToCore
+CTask *CScheduler::FindTaskToSteal (unsigned nFromCore, unsigned nToCore, int nAbovePriority)
+{
+	TRunQueue *pQueue = &m_RunQueue[nFromCore];
+
+	u32 nMask = pQueue->nReadyMask;
+	if (nAbovePriority >= 0)
+	{
+		nMask &= ~((2U << nAbovePriority) - 1);		// 2U << 31 wraps to 0
+	}
+
+	while (nMask != 0)
+	{
+		unsigned nPriority = 31 - __builtin_clz (nMask);
+
+		for (CTask *pTask = pQueue->pHead[nPriority]; pTask != 0; pTask = pTask->m_pRunNext)
+		{
+			// a running task is queued on its own core only, while it idles in Yield()
+			if (   !pTask->m_bRunning
+			    && (pTask->m_nAffinity & TASK_AFFINITY_CORE (nToCore)))
+			{
+				return pTask;
+			}
+		}
+
+		nMask &= ~(1U << nPriority);
+	}
+
+	return 0;
+}
+
+#endif
+
+// allows interrupt handlers (and other cores) to wake a task and sleeps until an
+// interrupt (or event) occurs, if the next timeout is not due before the next timer tick
+void CScheduler::WaitForWakeUp (unsigned nCore)
+{
+#ifndef ARM_ALLOW_MULTI_CORE
+	boolean bWait = TRUE;
+	if (m_nTimedTasks > 0)
+	{
+		int nTicksLeft =   m_ppTimedHeap[1]->GetWakeTicks ()
+				 - CTimer::Get ()->GetClockTicks ();
+
+		bWait = nTicksLeft > (int) (CLOCKHZ / HZ);
+	}
+
+	m_SpinLock.Release ();
+
+	if (bWait)
+	{
+		// WFI returns on a pending IRQ even with IRQs disabled, so that
+		// a task, which is woken in between, cannot be missed here
+		EnterCritical (IRQ_LEVEL);
+
+		if (m_RunQueue[nCore].nReadyMask == 0)
+		{
+			WaitForInterrupt ();
+		}
+
+		LeaveCritical ();
+	}
+#else
+	unsigned nSerial = m_nEnqueueSerial;
+
+	m_SpinLock.Release ();
+
+	// EnqueueTask() sends an event, after it has incremented m_nEnqueueSerial. This
+	// terminates WFE, even if it happens before WFE is executed. Only core 0 receives
+	// the timer tick, which sends an event, when a timeout has expired. Core 0 polls
+	// the clock for a timeout, which expires before the next tick.
+	while (m_nEnqueueSerial == nSerial)
+	{
+		if (m_nTimedTasks > 0)
+		{
+			int nTicksLeft = m_nNextWakeTicks - CTimer::Get ()->GetClockTicks ();
+			if (nTicksLeft <= 0)
+			{
+				break;
+			}
+
+			if (   nCore == 0
+			    && nTicksLeft <= (int) (CLOCKHZ / HZ))
+			{
+				continue;
+			}
+		}
+
+		WaitForEvent ();
+	}
+#endif
+
+	m_SpinLock.Acquire ();
+}
+
+#ifdef ARM_ALLOW_MULTI_CORE
+
+// wakes the cores from WFE in WaitForWakeUp(), when a timeout has expired, the
+// timed tasks are woken by the first core, which calls GetNextTask() afterwards
+void CScheduler::TimerTickHandler (void)
+{
+	CScheduler *pThis = s_pThis;
+	if (   pThis != 0
+	    && pThis->m_nTimedTasks > 0
+	    && (int) (pThis->m_nNextWakeTicks - CTimer::Get ()->GetClockTicks ()) <= 0)
+	{
+		DataSyncBarrier ();
+		SendEvent ();
+	}
+}
+
+#endif
+
+void CScheduler::EnqueueTask (CTask *pTask)
+{
+	assert (pTask != 0);
+
+	if (   pTask->m_bQueued
+	    || pTask->m_bSuspended
+	    || pTask->GetState () != TaskStateReady)
+	{
+		return;
+	}
+
+	unsigned nCore = pTask->m_nCore;
+#ifdef ARM_ALLOW_MULTI_CORE
+	// a running task must stay on its core, it moves on its next Yield()
+	if (!pTask->m_bRunning)
+	{
+		u32 nCores = pTask->m_nAffinity & m_nActiveCores;
+		if (!(nCores & TASK_AFFINITY_CORE (nCore)))
+		{
+			nCore = nCores != 0 ? __builtin_ctz (nCores) : 0;
+		}
+	}
+#endif
+	assert (nCore < SCHED_CORES);
+	pTask->m_nCore = nCore;
+
+	TRunQueue *pQueue = &m_RunQueue[nCore];
+	unsigned nPriority = pTask->m_nPriority;
+	assert (nPriority < TASK_PRIORITIES);
+
+	pTask->m_pRunNext = 0;
+	pTask->m_pRunPrev = pQueue->pTail[nPriority];
+
+	if (pQueue->pTail[nPriority] != 0)
+	{
+		pQueue->pTail[nPriority]->m_pRunNext = pTask;
+	}
+	else
+	{
+		pQueue->pHead[nPriority] = pTask;
+	}
+
+	pQueue->pTail[nPriority] = pTask;
+
+	pQueue->nReadyMask |= 1U << nPriority;
+	pTask->m_bQueued = TRUE;
+
+	pTask->m_nReadyStamp = ReadCounter ();
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	m_nEnqueueSerial++;
+
+	DataSyncBarrier ();
+	SendEvent ();
+#endif
+}
+
+void CScheduler::DequeueTask (CTask *pTask)
+{
+	assert (pTask != 0);
+
+	if (!pTask->m_bQueued)
+	{
+		return;
+	}
+
+	TRunQueue *pQueue = &m_RunQueue[pTask->m_nCore];
+	unsigned nPriority = pTask->m_nPriority;
+	assert (nPriority < TASK_PRIORITIES);
+
+	if (pTask->m_pRunPrev != 0)
+	{
+		pTask->m_pRunPrev->m_pRunNext = pTask->m_pRunNext;
+	}
+	else
+	{
+		assert (pQueue->pHead[nPriority] == pTask);
+		pQueue->pHead[nPriority] = pTask->m_pRunNext;
+	}
+
+	if (pTask->m_pRunNext != 0)
+	{
+		pTask->m_pRunNext->m_pRunPrev = pTask->m_pRunPrev;
+	}
+	else
+	{
+		assert (pQueue->pTail[nPriority] == pTask);
+		pQueue->pTail[nPriority] = pTask->m_pRunPrev;
+	}
+
+	if (pQueue->pHead[nPriority] == 0)
+	{
+		pQueue->nReadyMask &= ~(1U << nPriority);
+	}
+
+	pTask->m_pRunPrev = 0;
+	pTask->m_pRunNext = 0;
+	pTask->m_bQueued = FALSE;
+}
+
+void CScheduler::AddTimedTask (CTask *pTask)
+{
+	assert (pTask != 0);
+	assert (pTask->m_nTimedIndex == 0);
+
+	assert (m_nTimedTasks < m_nTableSize);
+	SetTimedTask (++m_nTimedTasks, pTask);
+
+	SiftUpTimedTask (m_nTimedTasks);
+}
+
+void CScheduler::RemoveTimedTask (CTask *pTask)
+{
+	assert (pTask != 0);
+
+	unsigned nIndex = pTask->m_nTimedIndex;
+	assert (0 < nIndex && nIndex <= m_nTimedTasks);
+	assert (m_ppTimedHeap[nIndex] == pTask);
+
+	CTask *pLast = m_ppTimedHeap[m_nTimedTasks--];
+	if (pLast != pTask)
+	{
+		// move last entry into the gap, it may have to go in either direction
+		SetTimedTask (nIndex, pLast);
+
+		SiftUpTimedTask (nIndex);
+		SiftDownTimedTask (pLast->m_nTimedIndex);
+	}
+
+	pTask->m_nTimedIndex = 0;
+}
+
+void CScheduler::WakeTimedTasks (void)
+{
+	if (m_nTimedTasks == 0)
+	{
+		return;
+	}
+
+	unsigned nTicks = CTimer::Get ()->GetClockTicks ();
+
+	while (m_nTimedTasks > 0)
+	{
+		CTask *pTask = m_ppTimedHeap[1];
+		if ((int) (pTask->GetWakeTicks () - nTicks) > 0)
+		{
+			break;
+		}
+
+		RemoveTimedTask (pTask);
+
+		if (pTask->GetState () == TaskStateBlockedWithTimeout)
+		{
+			pTask->SetWakeTicks (0);	// Use as flag that timeout expired
+		}
+		else
+		{
+			assert (pTask->GetState () == TaskStateSleeping);
+		}
+
+		pTask->SetState (TaskStateReady);
+		EnqueueTask (pTask);
+	}
+}
+
+void CScheduler::SetTimedTask (unsigned nIndex, CTask *pTask)
+{
+	assert (pTask != 0);
+
+	m_ppTimedHeap[nIndex] = pTask;
+	pTask->m_nTimedIndex = nIndex;
+
+	if (nIndex == 1)
+	{
+		m_nNextWakeTicks = pTask->GetWakeTicks ();
+	}
+}
+
+// the wake times are compared as signed difference, because the clock may wrap
+
+void CScheduler::SiftUpTimedTask (unsigned nIndex)
+{
+	CTask *pTask = m_ppTimedHeap[nIndex];
+
+	while (nIndex > 1)
+	{
+		CTask *pParent = m_ppTimedHeap[nIndex / 2];
+		if ((int) (pTask->GetWakeTicks () - pParent->GetWakeTicks ()) >= 0)
+		{
+			break;
+		}
+
+		SetTimedTask (nIndex, pParent);
+		nIndex /= 2;
+	}
+
+	SetTimedTask (nIndex, pTask);
+}
+
+void CScheduler::SiftDownTimedTask (unsigned nIndex)
+{
+	CTask *pTask = m_ppTimedHeap[nIndex];
+
+	unsigned nChild;
+	while ((nChild = 2 * nIndex) <= m_nTimedTasks)
+	{
+		if (   nChild < m_nTimedTasks
+		    &&   (int) (  m_ppTimedHeap[nChild+1]->GetWakeTicks ()
+			        - m_ppTimedHeap[nChild]->GetWakeTicks ()) < 0)
+		{
+			nChild++;		// right child is earlier
+		}
+
+		if ((int) (m_ppTimedHeap[nChild]->GetWakeTicks () - pTask->GetWakeTicks ()) >= 0)
+		{
+			break;
+		}
+
+		SetTimedTask (nIndex, m_ppTimedHeap[nChild]);
+		nIndex = nChild;
+	}
+
+	SetTimedTask (nIndex, pTask);
 }
 
 CScheduler *CScheduler::Get (void)
@@ -18,68 +18,97 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/sched/semaphore.h>
+#include <circle/sched/scheduler.h>
 #include <circle/atomic.h>
 #include <assert.h>
 
 CSemaphore::CSemaphore (unsigned nInitialCount)
 :	m_nCount (nInitialCount),
-	m_Event (TRUE)
+	m_nWakeups (0)
 {
 	assert (m_nCount > 0);
+
+	m_WaitQueue.pHead = 0;
+	m_WaitQueue.pTail = 0;
 }
 
 CSemaphore::~CSemaphore (void)
 {
 	assert (m_nCount > 0);
+	assert (m_WaitQueue.pHead == 0);
 }
 
 unsigned CSemaphore::GetState (void) const
 {
-	return AtomicGet (&m_nCount);
+	int nCount = AtomicGet (&m_nCount);
+
+	return nCount > 0 ? nCount : 0;
 }
 
 void CSemaphore::Down (void)
 {
-	while (AtomicGet (&m_nCount) == 0)
+	// fast path: the count was > 0
+	if (AtomicDecrement (&m_nCount) < 0)
 	{
-		m_Event.Wait ();
+		DownContended ();
 	}
+}
 
-	if (AtomicDecrement (&m_nCount) == 0)
+void CSemaphore::Up (void)
+{
+	// fast path: no task is waiting
+	if (AtomicIncrement (&m_nCount) <= 0)
 	{
-		assert (m_Event.GetState ());
-		m_Event.Clear ();
+		UpContended ();
 	}
 }
 
-void CSemaphore::Up (void)
+boolean CSemaphore::TryDown (void)
+{
+	int nCount = AtomicGet (&m_nCount);
+	while (nCount > 0)
+	{
+		int nPrevCount = AtomicCompareExchange (&m_nCount, nCount, nCount-1);
+		if (nPrevCount == nCount)
+		{
+			return TRUE;
+		}
+
+		nCount = nPrevCount;
+	}
+
+	return FALSE;
+}
+
+void CSemaphore::DownContended (void)
 {
-	if (AtomicIncrement (&m_nCount) == 1)
+	CScheduler *pScheduler = CScheduler::Get ();
+
+	pScheduler->LockWaitQueues ();
+
+	// Up() may have found no waiting task, because it came before we got the lock
+	if (m_nWakeups > 0)
 	{
-		assert (!m_Event.GetState ());
-		m_Event.Set ();
+		m_nWakeups--;
 	}
-#if NDEBUG
 	else
 	{
-		assert (m_Event.GetState ());
+		pScheduler->BlockOnWaitQueue (&m_WaitQueue);
 	}
-#endif
 
+	pScheduler->UnlockWaitQueues ();
 }
 
-boolean CSemaphore::TryDown (void)
+void CSemaphore::UpContended (void)
 {
-	if (AtomicGet (&m_nCount) == 0)
-	{
-		return FALSE;
-	}
+	CScheduler *pScheduler = CScheduler::Get ();
+
+	pScheduler->LockWaitQueues ();
 
-	if (AtomicDecrement (&m_nCount) == 0)
+	if (pScheduler->WakeFromWaitQueue (&m_WaitQueue) == 0)
 	{
-		assert (m_Event.GetState ());
-		m_Event.Clear ();
+		m_nWakeups++;
 	}
 
-	return TRUE;
+	pScheduler->UnlockWaitQueues ();
 }
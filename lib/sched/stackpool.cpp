@@ -0,0 +1,204 @@
+//
+// stackpool.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/sched/stackpool.h>
+#include <circle/memory.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#if AARCH == 64 && defined (TASK_STACK_GUARD)
+	#define USE_GUARD_PAGE
+#endif
+
+CTaskStackPool::CTaskStackPool (void)
+:	m_SpinLock (TASK_LEVEL)
+{
+	for (unsigned i = 0; i <= TASK_STACK_MAX_ORDER; i++)
+	{
+		m_pFreeList[i] = 0;
+	}
+}
+
+CTaskStackPool::~CTaskStackPool (void)
+{
+	for (unsigned i = 0; i <= TASK_STACK_MAX_ORDER; i++)
+	{
+		while (m_pFreeList[i] != 0)
+		{
+			TTaskStack *pStack = m_pFreeList[i];
+			m_pFreeList[i] = pStack->pNext;
+
+			DeleteStack (pStack);
+		}
+	}
+}
+
+TTaskStack *CTaskStackPool::Allocate (unsigned nSize)
+{
+	// bigger stacks are not pooled, but are allocated from the heap each time
+	if (nSize > 1U << TASK_STACK_MAX_ORDER)
+	{
+		TTaskStack *pStack = NewStack ((nSize + 15) & ~15U);
+		if (pStack != 0)
+		{
+			memset (pStack->pStack, TASK_STACK_FILL, pStack->nSize);
+		}
+
+		return pStack;
+	}
+
+	unsigned nOrder = GetOrder (nSize);
+
+	m_SpinLock.Acquire ();
+
+	TTaskStack *pStack = m_pFreeList[nOrder];
+	if (pStack != 0)
+	{
+		m_pFreeList[nOrder] = pStack->pNext;
+	}
+
+	m_SpinLock.Release ();
+
+	if (pStack == 0)
+	{
+		pStack = NewStack (1U << nOrder);
+		if (pStack == 0)
+		{
+			return 0;
+		}
+	}
+
+	pStack->pNext = 0;
+
+	memset (pStack->pStack, TASK_STACK_FILL, pStack->nSize);
+
+	return pStack;
+}
+
+void CTaskStackPool::Free (TTaskStack *pStack)
+{
+	assert (pStack != 0);
+
+	if (pStack->nSize > 1U << TASK_STACK_MAX_ORDER)
+	{
+		DeleteStack (pStack);
+
+		return;
+	}
+
+	unsigned nOrder = GetOrder (pStack->nSize);
+
+	m_SpinLock.Acquire ();
+
+	pStack->pNext = m_pFreeList[nOrder];
+	m_pFreeList[nOrder] = pStack;
+
+	m_SpinLock.Release ();
+}
+
+unsigned CTaskStackPool::GetHighWater (const TTaskStack *pStack)
+{
+	assert (pStack != 0);
+
+	// the stack grows down, so the unused part is at the bottom
+	const u32 *pWord = (const u32 *) pStack->pStack;
+	const u32 *pEnd = (const u32 *) (pStack->pStack + pStack->nSize);
+	while (   pWord < pEnd
+	       && *pWord == TASK_STACK_FILL * 0x01010101U)
+	{
+		pWord++;
+	}
+
+	const u8 *pByte = (const u8 *) pWord;
+	while (   pByte < pStack->pStack + pStack->nSize
+	       && *pByte == TASK_STACK_FILL)
+	{
+		pByte++;
+	}
+
+	return pStack->pStack + pStack->nSize - pByte;
+}
+
+unsigned CTaskStackPool::GetOrder (unsigned nSize)
+{
+	assert (nSize <= 1U << TASK_STACK_MAX_ORDER);
+
+	unsigned nOrder = TASK_STACK_MIN_ORDER;
+	while ((1U << nOrder) < nSize)
+	{
+		nOrder++;
+	}
+
+	return nOrder;
+}
+
+TTaskStack *CTaskStackPool::NewStack (unsigned nSize)
+{
+	TTaskStack *pStack = new TTaskStack;
+	if (pStack == 0)
+	{
+		return 0;
+	}
+
+	pStack->nSize = nSize;
+	pStack->bGuard = FALSE;
+	pStack->pNext = 0;
+
+#ifdef USE_GUARD_PAGE
+	// the guard page and the stack must fit, wherever the block starts
+	pStack->pBlock = new u8[(size_t) nSize + 2*PAGE_SIZE];
+	if (pStack->pBlock == 0)
+	{
+		delete pStack;
+
+		return 0;
+	}
+
+	u8 *pGuard = (u8 *) (((uintptr) pStack->pBlock + PAGE_SIZE-1) & ~(PAGE_SIZE-1));
+	pStack->pStack = pGuard + PAGE_SIZE;
+	pStack->bGuard = CMemorySystem::SetPageAccess (pGuard, FALSE);
+#else
+	pStack->pBlock = new u8[nSize];
+	if (pStack->pBlock == 0)
+	{
+		delete pStack;
+
+		return 0;
+	}
+
+	pStack->pStack = pStack->pBlock;
+#endif
+
+	return pStack;
+}
+
+void CTaskStackPool::DeleteStack (TTaskStack *pStack)
+{
+	assert (pStack != 0);
+
+#ifdef USE_GUARD_PAGE
+	if (pStack->bGuard)
+	{
+		CMemorySystem::SetPageAccess (pStack->pStack - PAGE_SIZE, TRUE);
+	}
+#endif
+
+	delete [] pStack->pBlock;
+	delete pStack;
+}
@@ -20,19 +20,22 @@
 #include <circle/sched/synchronizationevent.h>
 #include <circle/sched/scheduler.h>
 #include <circle/sched/task.h>
+#include <circle/sched/coroutine.h>
 #include <circle/synchronize.h>
 #include <circle/sysconfig.h>
 #include <assert.h>
 
 CSynchronizationEvent::CSynchronizationEvent (boolean bState)
 :	m_bState (bState),
-	m_pWaitListHead (0)
+	m_pWaitListHead (0),
+	m_pCoroutineList (0)
 {
 }
 
 CSynchronizationEvent::~CSynchronizationEvent (void)
 {
 	assert (m_pWaitListHead == 0);
+	assert (m_pCoroutineList == 0);
 }
 
 boolean CSynchronizationEvent::GetState (void)
@@ -60,28 +63,17 @@ void CSynchronizationEvent::Set (void)
 #endif
 
 		CScheduler::Get ()->WakeTasks (&m_pWaitListHead);
-	}
-}
-
-// Wakes all waiting tasks and immediately resets the event again
-void CSynchronizationEvent::Pulse (void)
-{
-	// Cheaper and same effect as Set() + Clear()
-	m_bState = FALSE;
 
-#ifdef ARM_ALLOW_MULTI_CORE
-	DataSyncBarrier ();
-#endif
-
-	CScheduler::Get ()->WakeTasks (&m_pWaitListHead);
+		// the list is not checked for 0 here, because it must be read with the lock held
+		CCoroutine::WakeWaiting (&m_pCoroutineList);
+	}
 }
 
-
 void CSynchronizationEvent::Wait (void)
 {
 	if (!m_bState)
 	{
-		CScheduler::Get ()->BlockTask (&m_pWaitListHead, 0);
+		CScheduler::Get ()->BlockTask (&m_pWaitListHead, 0, &m_bState);
 	}
 }
 
@@ -93,6 +85,6 @@ boolean CSynchronizationEvent::WaitWithTimeout (unsigned nMicroSeconds)
 	}
 	else
 	{
-		return CScheduler::Get ()->BlockTask (&m_pWaitListHead, nMicroSeconds);
+		return CScheduler::Get ()->BlockTask (&m_pWaitListHead, nMicroSeconds, &m_bState);
 	}
 }
@@ -25,9 +25,30 @@
 CTask::CTask (unsigned nStackSize, boolean bCreateSuspended)
 :	m_State (bCreateSuspended ? TaskStateNew : TaskStateReady),
 	m_bSuspended (FALSE),
+	m_nPriority (TASK_PRIORITY_DEFAULT),
+	m_nAffinity (TASK_AFFINITY_CORE (0)),
+	m_nCore (0),
+	m_bRunning (FALSE),
+	m_bQueued (FALSE),
+	m_pRunPrev (0),
+	m_pRunNext (0),
+	m_nTimedIndex (0),
 	m_nStackSize (nStackSize),
 	m_pStack (0),
-	m_pWaitListNext (0)
+	m_pWaitListNext (0),
+	m_nTerminationWaiters (0),
+	m_pTaskPrev (0),
+	m_pTaskNext (0),
+	m_pAddressHashNext (0),
+	m_pNameHashNext (0),
+	m_nNameHash (0),
+	m_nRunTicks (0),
+	m_nLatencyTicks (0),
+	m_nSwitches (0),
+	m_nMaxSliceTicks (0),
+	m_nMaxLatencyTicks (0),
+	m_nRunStamp (0),
+	m_nReadyStamp (0)
 {
 	for (unsigned i = 0; i < TASK_USER_DATA_SLOTS; i++)
 	{
@@ -42,8 +63,9 @@ CTask::CTask (unsigned nStackSize, boolean bCreateSuspended)
 #else
 		assert ((m_nStackSize & 15) == 0);
 #endif
-		m_pStack = new u8[m_nStackSize];
+		m_pStack = CScheduler::Get ()->m_StackPool.Allocate (m_nStackSize);
 		assert (m_pStack != 0);
+		m_nStackSize = m_pStack->nSize;
 
 		InitializeRegs ();
 	}
@@ -58,28 +80,21 @@ CTask::~CTask (void)
 	assert (m_State == TaskStateTerminated);
 	m_State = TaskStateUnknown;
 
-	delete [] m_pStack;
-	m_pStack = 0;
+	if (m_pStack != 0)
+	{
+		CScheduler::Get ()->m_StackPool.Free (m_pStack);
+		m_pStack = 0;
+	}
 }
 
 void CTask::Start (void)
 {
-	if (m_State == TaskStateNew)
-	{
-		m_State = TaskStateReady;
-	}
-	else
-	{
-		assert (m_bSuspended);
-		m_bSuspended = FALSE;
-	}
+	CScheduler::Get ()->StartTask (this);
 }
 
 void CTask::Suspend (void)
 {
-	assert (m_State != TaskStateNew);
-	assert (!m_bSuspended);
-	m_bSuspended = TRUE;
+	CScheduler::Get ()->SuspendTask (this);
 }
 
 void CTask::Run (void)		// dummy method which is never called
@@ -100,18 +115,41 @@ void CTask::WaitForTermination (void)
 {
 	// Before accessing any of our member variables
 	// make sure this task object hasn't been deleted by 
-	// checking it's still registered with the scheduler
-	if (!CScheduler::Get()->IsValidTask (this))
+	// checking it's still registered with the scheduler.
+	// It will not be deleted, while we are waiting.
+	if (!CScheduler::Get ()->AddTerminationWaiter (this))
 	{
 		return;
 	}
 
 	m_Event.Wait ();
+
+	CScheduler::Get ()->RemoveTerminationWaiter (this);
+}
+
+void CTask::SetPriority (unsigned nPriority)
+{
+	CScheduler::Get ()->SetTaskPriority (this, nPriority);
+}
+
+void CTask::SetAffinity (u32 nAffinity)
+{
+	CScheduler::Get ()->SetTaskAffinity (this, nAffinity);
 }
 
 void CTask::SetName (const char *pName)
 {
-	m_Name = pName;
+	CScheduler::Get ()->SetTaskName (this, pName);	// updates the name index too
+}
+
+unsigned CTask::GetStackHighWater (void) const
+{
+	if (m_pStack == 0)
+	{
+		return 0;
+	}
+
+	return CTaskStackPool::GetHighWater (m_pStack);
 }
 
 const char *CTask::GetName (void) const
@@ -138,7 +176,7 @@ void CTask::InitializeRegs (void)
 	m_Regs.r0 = (u32) this;		// pParam for TaskEntry()
 
 	assert (m_pStack != 0);
-	m_Regs.sp = (u32) m_pStack + m_nStackSize;
+	m_Regs.sp = (u32) m_pStack->pStack + m_nStackSize;
 
 	m_Regs.lr = (u32) &TaskEntry;
 
@@ -157,7 +195,7 @@ void CTask::InitializeRegs (void)
 	m_Regs.x0 = (u64) this;		// pParam for TaskEntry()
 
 	assert (m_pStack != 0);
-	m_Regs.sp = (u64) m_pStack + m_nStackSize;
+	m_Regs.sp = (u64) m_pStack->pStack + m_nStackSize;
 
 	m_Regs.x30 = (u64) &TaskEntry;
 
@@ -173,6 +211,8 @@ void CTask::TaskEntry (void *pParam)
 	CTask *pThis = (CTask *) pParam;
 	assert (pThis != 0);
 
+	CScheduler::Get ()->FinishTaskSwitch ();
+
 	pThis->Run ();
 
 	pThis->m_State = TaskStateTerminated;
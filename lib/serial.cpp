@@ -23,6 +23,7 @@
 #include <circle/memio.h>
 #include <circle/machineinfo.h>
 #include <circle/synchronize.h>
+#include <circle/atomic.h>
 #include <assert.h>
 
 #ifndef USE_RPI_STUB_AT
@@ -155,8 +156,6 @@ CSerialDevice::CSerialDevice (CInterruptSystem *pInterruptSystem, boolean bUseFI
 	m_nDevice (nDevice),
 	m_nBaseAddress (0),
 	m_bValid (FALSE),
-	m_nRxInPtr (0),
-	m_nRxOutPtr (0),
 	m_nRxStatus (0),
 	m_nTxInPtr (0),
 	m_nTxOutPtr (0),
@@ -454,31 +453,12 @@ int CSerialDevice::Read (void *pBuffer, size_t nCount)
 
 	if (m_pInterruptSystem != 0)
 	{
-		m_SpinLock.Acquire ();
-
-		if (m_nRxStatus < 0)
+		// the receive buffer is lock-free, the interrupt handler is the only producer
+		nResult = AtomicExchange (&m_nRxStatus, 0);
+		if (nResult == 0)
 		{
-			nResult = m_nRxStatus;
-			m_nRxStatus = 0;
-		}
-		else
-		{
-			while (nCount > 0)
-			{
-				if (m_nRxInPtr == m_nRxOutPtr)
-				{
-					break;
-				}
-
-				*pChar++ = m_RxBuffer[m_nRxOutPtr++];
-				m_nRxOutPtr &= SERIAL_BUF_MASK;
-
-				nCount--;
-				nResult++;
-			}
+			nResult = m_RxBuffer.DequeueBatch (pChar, nCount);
 		}
-
-		m_SpinLock.Release ();
 	}
 	else
 	{
@@ -581,21 +561,7 @@ unsigned CSerialDevice::AvailableForRead (void)
 	assert (m_bValid);
 	assert (m_pInterruptSystem != 0);
 
-	m_SpinLock.Acquire ();
-
-	unsigned nResult;
-	if (m_nRxInPtr < m_nRxOutPtr)
-	{
-		nResult = SERIAL_BUF_SIZE+m_nRxInPtr-m_nRxOutPtr;
-	}
-	else
-	{
-		nResult = m_nRxInPtr-m_nRxOutPtr;
-	}
-
-	m_SpinLock.Release ();
-
-	return nResult;
+	return m_RxBuffer.GetCount ();
 }
 
 int CSerialDevice::Peek (void)
@@ -603,17 +569,9 @@ int CSerialDevice::Peek (void)
 	assert (m_bValid);
 	assert (m_pInterruptSystem != 0);
 
-	m_SpinLock.Acquire ();
+	const u8 *pChar = m_RxBuffer.Peek ();
 
-	int nResult = -1;
-	if (m_nRxInPtr != m_nRxOutPtr)
-	{
-		nResult = m_RxBuffer[m_nRxOutPtr];
-	}
-
-	m_SpinLock.Release ();
-
-	return nResult;
+	return pChar != 0 ? *pChar : -1;
 }
 
 void CSerialDevice::Flush (void)
@@ -669,8 +627,6 @@ void CSerialDevice::InterruptHandler (void)
 {
 	boolean bMagicReceived = FALSE;
 
-	m_SpinLock.Acquire ();
-
 	PeripheralEntry ();
 
 	// acknowledge pending interrupts
@@ -681,31 +637,19 @@ void CSerialDevice::InterruptHandler (void)
 		u32 nDR = read32 (ARM_UART_DR);
 		if (nDR & DR_BE_MASK)
 		{
-			if (m_nRxStatus == 0)
-			{
-				m_nRxStatus = -SERIAL_ERROR_BREAK;
-			}
+			SetRxStatus (-SERIAL_ERROR_BREAK);
 		}
 		else if (nDR & DR_OE_MASK)
 		{
-			if (m_nRxStatus == 0)
-			{
-				m_nRxStatus = -SERIAL_ERROR_OVERRUN;
-			}
+			SetRxStatus (-SERIAL_ERROR_OVERRUN);
 		}
 		else if (nDR & DR_FE_MASK)
 		{
-			if (m_nRxStatus == 0)
-			{
-				m_nRxStatus = -SERIAL_ERROR_FRAMING;
-			}
+			SetRxStatus (-SERIAL_ERROR_FRAMING);
 		}
 		else if (nDR & DR_PE_MASK)
 		{
-			if (m_nRxStatus == 0)
-			{
-				m_nRxStatus = -SERIAL_ERROR_PARITY;
-			}
+			SetRxStatus (-SERIAL_ERROR_PARITY);
 		}
 
 		if (m_pMagic != 0)
@@ -723,20 +667,15 @@ void CSerialDevice::InterruptHandler (void)
 			}
 		}
 
-		if (((m_nRxInPtr+1) & SERIAL_BUF_MASK) != m_nRxOutPtr)
+		if (!m_RxBuffer.Enqueue (nDR & 0xFF))
 		{
-			m_RxBuffer[m_nRxInPtr++] = nDR & 0xFF;
-			m_nRxInPtr &= SERIAL_BUF_MASK;
-		}
-		else
-		{
-			if (m_nRxStatus == 0)
-			{
-				m_nRxStatus = -SERIAL_ERROR_OVERRUN;
-			}
+			SetRxStatus (-SERIAL_ERROR_OVERRUN);
 		}
 	}
 
+	// the transmit buffer is drained by Write() too, so it is still protected
+	m_SpinLock.Acquire ();
+
 	while (!(read32 (ARM_UART_FR) & FR_TXFF_MASK))
 	{
 		if (m_nTxInPtr != m_nTxOutPtr)
@@ -762,6 +701,11 @@ void CSerialDevice::InterruptHandler (void)
 	}
 }
 
+void CSerialDevice::SetRxStatus (int nStatus)
+{
+	AtomicCompareExchange (&m_nRxStatus, 0, nStatus);
+}
+
 void CSerialDevice::InterruptStub (void *pParam)
 {
 	DataMemBarrier ();
@@ -165,19 +165,18 @@ int CString::Compare (const char *pString) const
 
 int CString::Find (char chChar) const
 {
-	int nPos = 0;
-
-	for (char *p = m_pBuffer; *p; p++)
+	if (chChar == '\0')
 	{
-		if (*p == chChar)
-		{
-			return nPos;
-		}
+		return -1;
+	}
 
-		nPos++;
+	const char *p = strchr (m_pBuffer, chChar);
+	if (p == 0)
+	{
+		return -1;
 	}
 
-	return -1;
+	return p - m_pBuffer;
 }
 
 int CString::Replace (const char *pOld, const char *pNew)
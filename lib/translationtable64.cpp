@@ -92,6 +92,36 @@ uintptr CTranslationTable::GetBaseAddress (void) const
 	return (uintptr) m_pTable;
 }
 
+boolean CTranslationTable::SetPageAccess (uintptr nAddress, boolean bAccess)
+{
+	assert (m_pTable != 0);
+	assert (!(nAddress & (ARMV8MMU_LEVEL3_PAGE_SIZE-1)));
+
+	unsigned nEntry = nAddress / ARMV8MMU_LEVEL2_BLOCK_SIZE;
+	if (   nEntry >= LEVEL2_TABLE_ENTRIES
+	    || m_pTable[nEntry].Table.Value11 != 3)
+	{
+		return FALSE;
+	}
+
+	TARMV8MMU_LEVEL3_DESCRIPTOR *pTable =
+		(TARMV8MMU_LEVEL3_DESCRIPTOR *) ARMV8MMUL2TABLEPTR ((u64) m_pTable[nEntry].Table.TableAddress);
+
+	unsigned nPage = (nAddress % ARMV8MMU_LEVEL2_BLOCK_SIZE) / ARMV8MMU_LEVEL3_PAGE_SIZE;
+
+	// an invalid descriptor causes a translation fault on each access
+	pTable[nPage].Page.Value11 = bAccess ? 3 : 0;
+
+	DataSyncBarrier ();
+
+	// invalidate the TLB entry of this page on all cores
+	asm volatile ("tlbi vaae1is, %0" : : "r" (nAddress >> 12) : "memory");
+	DataSyncBarrier ();
+	InstructionSyncBarrier ();
+
+	return TRUE;
+}
+
 TARMV8MMU_LEVEL3_DESCRIPTOR *CTranslationTable::CreateLevel3Table (uintptr nBaseAddress)
 {
 	TARMV8MMU_LEVEL3_DESCRIPTOR *pTable = (TARMV8MMU_LEVEL3_DESCRIPTOR *) palloc ();
@@ -7,7 +7,7 @@
 //	Licensed under GPLv2
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2018-2020  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2018-2024  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -41,6 +41,11 @@
 #define RX_HEADER_SIZE			(4 + 4 + 2)
 #define TX_HEADER_SIZE			(4 + 4)
 
+#define RX_BUFFER_SIZE			DEFAULT_BURST_CAP_SIZE	// multiple frames per transfer
+#define RX_ALIGNMENT			4
+#define TX_BATCH_SIZE			(8 * 1024)		// max. size of a TX transfer
+#define TX_ALIGNMENT			4
+
 #define MAX_RX_FRAME_SIZE		(2*6 + 2 + 1500 + 4)
 
 // USB vendor requests
@@ -220,24 +225,48 @@
 	#define MAF_LO_ADDR_MASK		0xFFFFFFFF
 
 // TX command A
+#define TX_CMD_A_IPE			0x04000000
+#define TX_CMD_A_TPE			0x02000000
 #define TX_CMD_A_FCS			0x00400000
 #define TX_CMD_A_LEN_MASK		0x000FFFFF
 
 // RX command A
+#define RX_CMD_A_ICE			0x80000000
+#define RX_CMD_A_TCE			0x40000000
+#define RX_CMD_A_IPV			0x20000000
+#define RX_CMD_A_PID_MASK		0x18000000
+	#define RX_CMD_A_PID_TCP_IP		0x08000000
+	#define RX_CMD_A_PID_UDP_IP		0x10000000
 #define RX_CMD_A_RED			0x00400000
+#define RX_CMD_A_ICSM			0x00004000
 #define RX_CMD_A_LEN_MASK		0x00003FFF
 
+// Ethernet frame offsets
+#define FRAME_ETHER_TYPE		12
+#define FRAME_IP_PROTOCOL		(14 + 9)
+#define FRAME_IP_MIN_LENGTH		(14 + 20)
+
 static const char FromLAN7800[] = "lan7800";
 
 CLAN7800Device::CLAN7800Device (CUSBFunction *pFunction)
 :	CUSBFunction (pFunction),
 	m_pEndpointBulkIn (0),
-	m_pEndpointBulkOut (0)
+	m_pEndpointBulkOut (0),
+	m_pRxBuffer (0),
+	m_nRxOffset (0),
+	m_nRxLength (0),
+	m_pTxBuffer (0)
 {
 }
 
 CLAN7800Device::~CLAN7800Device (void)
 {
+	delete [] m_pTxBuffer;
+	m_pTxBuffer = 0;
+
+	delete [] m_pRxBuffer;
+	m_pRxBuffer = 0;
+
 	delete m_pEndpointBulkOut;
 	m_pEndpointBulkOut = 0;
 
@@ -301,6 +330,12 @@ boolean CLAN7800Device::Configure (void)
 		return FALSE;
 	}
 
+	// the buffers are cache-aligned, because they are used for DMA
+	m_pRxBuffer = new u8[RX_BUFFER_SIZE];
+	m_pTxBuffer = new u8[TX_BATCH_SIZE];
+	assert (m_pRxBuffer != 0);
+	assert (m_pTxBuffer != 0);
+
 	// check chip ID
 
 	u32 nValue;
@@ -337,8 +372,8 @@ boolean CLAN7800Device::Configure (void)
 		return FALSE;
 	}
 
-	// enable the LEDs and SEF mode
-	if (!ReadWriteReg (HW_CFG, HW_CFG_LED0_EN | HW_CFG_LED1_EN, ~HW_CFG_MEF))
+	// enable the LEDs and MEF mode (multiple frames per bulk transfer)
+	if (!ReadWriteReg (HW_CFG, HW_CFG_LED0_EN | HW_CFG_LED1_EN | HW_CFG_MEF))
 	{
 		return FALSE;
 	}
@@ -370,8 +405,9 @@ boolean CLAN7800Device::Configure (void)
 		return FALSE;
 	}
 
-	// init receive filtering engine
-	if (!ReadWriteReg (RFE_CTL, RFE_CTL_BCAST_EN | RFE_CTL_DA_PERFECT))
+	// init receive filtering engine, verify IP and TCP/UDP checksums
+	if (!ReadWriteReg (RFE_CTL,   RFE_CTL_BCAST_EN | RFE_CTL_DA_PERFECT
+				    | RFE_CTL_TCPUDP_COE | RFE_CTL_IP_COE))
 	{
 		return FALSE;
 	}
@@ -424,67 +460,237 @@ const CMACAddress *CLAN7800Device::GetMACAddress (void) const
 	return &m_MACAddress;
 }
 
+u32 CLAN7800Device::GetTxCommandA (const u8 *pFrame, unsigned nLength)
+{
+	u32 nCommand = (nLength & TX_CMD_A_LEN_MASK) | TX_CMD_A_FCS;
+
+	// let the device complete the checksums of IPv4 TCP/UDP frames (see GetFeatures())
+	assert (pFrame != 0);
+	if (   nLength >= FRAME_IP_MIN_LENGTH
+	    && pFrame[FRAME_ETHER_TYPE] == 0x08
+	    && pFrame[FRAME_ETHER_TYPE+1] == 0x00
+	    && (   pFrame[FRAME_IP_PROTOCOL] == 6		// TCP
+	        || pFrame[FRAME_IP_PROTOCOL] == 17))		// UDP
+	{
+		nCommand |= TX_CMD_A_IPE | TX_CMD_A_TPE;
+	}
+
+	return nCommand;
+}
+
+unsigned CLAN7800Device::GetFeatures (void)
+{
+	return   NET_DEVICE_FEATURE_RX_CHECKSUM
+	       | NET_DEVICE_FEATURE_TX_CHECKSUM
+	       | NET_DEVICE_FEATURE_SCATTER_GATHER;
+}
+
 boolean CLAN7800Device::SendFrame (const void *pBuffer, unsigned nLength)
 {
-	if (nLength > FRAME_BUFFER_SIZE)
+	TNetTxFrame Frame = {pBuffer, nLength};
+
+	return SendFrames (&Frame, 1) == 1;
+}
+
+unsigned CLAN7800Device::SendFrames (const TNetTxFrame *pFrames, unsigned nFrames)
+{
+	assert (pFrames != 0);
+	assert (m_pTxBuffer != 0);
+
+	// multiple frames are sent with one bulk transfer, each with its own TX command
+	unsigned nSent = 0;
+	while (nSent < nFrames)
 	{
-		return FALSE;
+		unsigned nOffset = 0;
+		unsigned i;
+		for (i = nSent; i < nFrames; i++)
+		{
+			unsigned nLength = pFrames[i].nLength;
+			if (nLength > FRAME_BUFFER_SIZE)
+			{
+				break;
+			}
+
+			unsigned nFrameOffset = (nOffset + TX_ALIGNMENT-1) & ~(TX_ALIGNMENT-1);
+			if (nFrameOffset + TX_HEADER_SIZE + nLength > TX_BATCH_SIZE)
+			{
+				break;
+			}
+
+			u8 *pFrame = m_pTxBuffer + nFrameOffset + TX_HEADER_SIZE;
+			assert (pFrames[i].pBuffer != 0);
+			memcpy (pFrame, pFrames[i].pBuffer, nLength);
+
+			u32 *pTxHeader = (u32 *) (m_pTxBuffer + nFrameOffset);
+			pTxHeader[0] = GetTxCommandA (pFrame, nLength);
+			pTxHeader[1] = 0;
+
+			nOffset = nFrameOffset + TX_HEADER_SIZE + nLength;
+		}
+
+		if (i == nSent)				// frame is too long
+		{
+			break;
+		}
+
+		assert (m_pEndpointBulkOut != 0);
+		if (GetHost ()->Transfer (m_pEndpointBulkOut, m_pTxBuffer, nOffset) < 0)
+		{
+			break;
+		}
+
+		nSent = i;
 	}
 
+	return nSent;
+}
+
+boolean CLAN7800Device::SendFrameParts (const TNetFramePart *pParts, unsigned nParts)
+{
 	DMA_BUFFER (u8, TxBuffer, FRAME_BUFFER_SIZE+TX_HEADER_SIZE);
-	assert (pBuffer != 0);
-	memcpy (TxBuffer+TX_HEADER_SIZE, pBuffer, nLength);
+	u8 *pFrame = TxBuffer+TX_HEADER_SIZE;
+	unsigned nLength = 0;
+
+	assert (pParts != 0);
+	for (unsigned i = 0; i < nParts; i++)
+	{
+		if (nLength + pParts[i].nLength > FRAME_BUFFER_SIZE)
+		{
+			return FALSE;
+		}
+
+		assert (pParts[i].pData != 0);
+		memcpy (pFrame + nLength, pParts[i].pData, pParts[i].nLength);
+		nLength += pParts[i].nLength;
+	}
 
 	u32 *pTxHeader = (u32 *) TxBuffer;
-	pTxHeader[0] = (nLength & TX_CMD_A_LEN_MASK) | TX_CMD_A_FCS;
+	pTxHeader[0] = GetTxCommandA (pFrame, nLength);
 	pTxHeader[1] = 0;
-	
+
 	assert (m_pEndpointBulkOut != 0);
 	return GetHost ()->Transfer (m_pEndpointBulkOut, TxBuffer, nLength+TX_HEADER_SIZE) >= 0;
 }
 
 boolean CLAN7800Device::ReceiveFrame (void *pBuffer, unsigned *pResultLength)
 {
-	assert (m_pEndpointBulkIn != 0);
-	assert (pBuffer != 0);
-	CUSBRequest URB (m_pEndpointBulkIn, pBuffer, FRAME_BUFFER_SIZE);
+	boolean bChecksumOK;
 
-	if (!GetHost ()->SubmitBlockingRequest (&URB))
-	{
-		return FALSE;
-	}
+	return ReceiveFrameChecked (pBuffer, pResultLength, &bChecksumOK);
+}
+
+boolean CLAN7800Device::ReceiveFrameChecked (void *pBuffer, unsigned *pResultLength,
+					     boolean *pChecksumOK)
+{
+	TNetRxFrame Frame;
+	Frame.pBuffer = pBuffer;
+	Frame.pParam = 0;
 
-	u32 nResultLength = URB.GetResultLength ();
-	if (nResultLength < RX_HEADER_SIZE)
+	if (ReceiveFrames (&Frame, 1) == 0)
 	{
 		return FALSE;
 	}
 
-	u32 nRxStatus = *(u32 *) pBuffer;	// RX command A
-	if (nRxStatus & RX_CMD_A_RED)
-	{
-		CLogger::Get ()->Write (FromLAN7800, LogWarning, "RX error (status 0x%X)", nRxStatus);
+	assert (pResultLength != 0);
+	*pResultLength = Frame.nLength;
 
-		return FALSE;
-	}
-	
-	u32 nFrameLength = nRxStatus & RX_CMD_A_LEN_MASK;
-	assert (nFrameLength == nResultLength-RX_HEADER_SIZE);
-	assert (nFrameLength > 4);
-	if (nFrameLength <= 4)
+	assert (pChecksumOK != 0);
+	*pChecksumOK = Frame.bChecksumOK;
+
+	return TRUE;
+}
+
+unsigned CLAN7800Device::ReceiveFrames (TNetRxFrame *pFrames, unsigned nMaxFrames)
+{
+	assert (pFrames != 0);
+	assert (m_pRxBuffer != 0);
+
+	unsigned nFrames = 0;
+	while (nFrames < nMaxFrames)
 	{
-		return FALSE;
-	}
-	nFrameLength -= 4;	// ignore FCS
+		// a bulk transfer may contain multiple frames (MEF mode), which are returned first
+		if (m_nRxOffset >= m_nRxLength)
+		{
+			if (nFrames > 0)
+			{
+				break;
+			}
 
-	//CLogger::Get ()->Write (FromLAN7800, LogDebug, "Frame received (status 0x%X)", nRxStatus);
+			assert (m_pEndpointBulkIn != 0);
+			CUSBRequest URB (m_pEndpointBulkIn, m_pRxBuffer, RX_BUFFER_SIZE);
 
-	memcpy (pBuffer, (u8 *) pBuffer + RX_HEADER_SIZE, nFrameLength); // overwrite RX command A..C
+			if (!GetHost ()->SubmitBlockingRequest (&URB))
+			{
+				break;
+			}
 
-	assert (pResultLength != 0);
-	*pResultLength = nFrameLength;
-	
-	return TRUE;
+			m_nRxOffset = 0;
+			m_nRxLength = URB.GetResultLength ();
+			if (m_nRxLength == 0)
+			{
+				break;
+			}
+
+			continue;
+		}
+
+		u8 *pRxHeader = m_pRxBuffer + m_nRxOffset;
+		unsigned nRemaining = m_nRxLength - m_nRxOffset;
+		if (nRemaining < RX_HEADER_SIZE)
+		{
+			m_nRxOffset = m_nRxLength;
+
+			continue;
+		}
+
+		u32 nRxStatus = *(u32 *) pRxHeader;	// RX command A
+		u32 nFrameLength = nRxStatus & RX_CMD_A_LEN_MASK;
+		if (nFrameLength > nRemaining-RX_HEADER_SIZE)
+		{
+			CLogger::Get ()->Write (FromLAN7800, LogWarning,
+						"Invalid RX frame length (%u)", nFrameLength);
+
+			m_nRxOffset = m_nRxLength;
+
+			continue;
+		}
+
+		// the next RX command A is 32-bit aligned
+		m_nRxOffset += RX_HEADER_SIZE + nFrameLength;
+		m_nRxOffset = (m_nRxOffset + RX_ALIGNMENT-1) & ~(RX_ALIGNMENT-1);
+
+		if (nRxStatus & RX_CMD_A_RED)
+		{
+			CLogger::Get ()->Write (FromLAN7800, LogWarning, "RX error (status 0x%X)", nRxStatus);
+
+			continue;
+		}
+
+		if (   nFrameLength <= 4
+		    || nFrameLength-4 > FRAME_BUFFER_SIZE)
+		{
+			continue;
+		}
+		nFrameLength -= 4;	// ignore FCS
+
+		//CLogger::Get ()->Write (FromLAN7800, LogDebug, "Frame received (status 0x%X)", nRxStatus);
+
+		assert (pFrames[nFrames].pBuffer != 0);
+		memcpy (pFrames[nFrames].pBuffer, pRxHeader + RX_HEADER_SIZE, nFrameLength);
+		pFrames[nFrames].nOffset = 0;
+		pFrames[nFrames].nLength = nFrameLength;
+
+		// the checksum status is valid for IPv4 TCP/UDP frames only
+		u32 nProtocol = nRxStatus & RX_CMD_A_PID_MASK;
+		pFrames[nFrames].bChecksumOK =    (   nProtocol == RX_CMD_A_PID_TCP_IP
+						   || nProtocol == RX_CMD_A_PID_UDP_IP)
+					       && !(nRxStatus & (  RX_CMD_A_IPV | RX_CMD_A_ICSM
+								 | RX_CMD_A_ICE | RX_CMD_A_TCE));
+
+		nFrames++;
+	}
+
+	return nFrames;
 }
 
 boolean CLAN7800Device::IsLinkUp (void)
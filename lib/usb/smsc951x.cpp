@@ -9,7 +9,7 @@
 // See the file lib/usb/README for details!
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2020  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2014-2024  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -35,6 +35,12 @@
 #include <circle/debug.h>
 #include <assert.h>
 
+// Sizes
+#define HS_USB_PKT_SIZE			512
+
+#define RX_BUFFER_SIZE			(16 * 1024 + 5 * HS_USB_PKT_SIZE)	// burst cap
+#define DEFAULT_BULK_IN_DELAY		0x2000
+
 // USB vendor requests
 #define WRITE_REGISTER			0xA0
 #define READ_REGISTER			0xA1
@@ -47,6 +53,9 @@
 	#define TX_CFG_ON			0x00000004
 #define HW_CFG				0x14
 	#define HW_CFG_BIR			0x00001000
+	#define HW_CFG_RXDOFF			0x00000600
+	#define HW_CFG_MEF			0x00000020
+	#define HW_CFG_BCE			0x00000002
 #define RX_FIFO_INF			0x18
 #define PM_CTRL				0x20
 #define LED_GPIO_CFG			0x24
@@ -129,12 +138,18 @@ static const char FromSMSC951x[] = "smsc951x";
 CSMSC951xDevice::CSMSC951xDevice (CUSBFunction *pFunction)
 :	CUSBFunction (pFunction),
 	m_pEndpointBulkIn (0),
-	m_pEndpointBulkOut (0)
+	m_pEndpointBulkOut (0),
+	m_pRxBuffer (0),
+	m_nRxOffset (0),
+	m_nRxLength (0)
 {
 }
 
 CSMSC951xDevice::~CSMSC951xDevice (void)
 {
+	delete [] m_pRxBuffer;
+	m_pRxBuffer = 0;
+
 	delete m_pEndpointBulkOut;
 	m_pEndpointBulkOut = 0;
 
@@ -228,6 +243,21 @@ boolean CSMSC951xDevice::Configure (void)
 		return FALSE;
 	}
 
+	// receive multiple frames per bulk transfer (MEF) up to the burst cap
+	m_pRxBuffer = new u8[RX_BUFFER_SIZE];		// cache-aligned for DMA
+	assert (m_pRxBuffer != 0);
+
+	u32 nHWConfig;
+	if (   !WriteReg (BURST_CAP, RX_BUFFER_SIZE / HS_USB_PKT_SIZE)
+	    || !WriteReg (BULK_IN_DLY, DEFAULT_BULK_IN_DELAY)
+	    || !ReadReg (HW_CFG, &nHWConfig)
+	    || !WriteReg (HW_CFG, (nHWConfig & ~HW_CFG_RXDOFF) | HW_CFG_MEF | HW_CFG_BCE))
+	{
+		CLogger::Get ()->Write (FromSMSC951x, LogError, "Cannot set burst mode");
+
+		return FALSE;
+	}
+
 	if (   !WriteReg (LED_GPIO_CFG,   LED_GPIO_CFG_SPD_LED
 					| LED_GPIO_CFG_LNK_LED
 					| LED_GPIO_CFG_FDX_LED)
@@ -273,46 +303,108 @@ boolean CSMSC951xDevice::SendFrame (const void *pBuffer, unsigned nLength)
 
 boolean CSMSC951xDevice::ReceiveFrame (void *pBuffer, unsigned *pResultLength)
 {
-	assert (m_pEndpointBulkIn != 0);
-	assert (pBuffer != 0);
-	CUSBRequest URB (m_pEndpointBulkIn, pBuffer, FRAME_BUFFER_SIZE);
+	TNetRxFrame Frame;
+	Frame.pBuffer = pBuffer;
+	Frame.pParam = 0;
 
-	if (!GetHost ()->SubmitBlockingRequest (&URB))
+	if (ReceiveFrames (&Frame, 1) == 0)
 	{
 		return FALSE;
 	}
 
-	u32 nResultLength = URB.GetResultLength ();
-	if (nResultLength < 4)				// should not happen with HW_CFG_BIR set
-	{
-		return FALSE;
-	}
+	assert (pResultLength != 0);
+	*pResultLength = Frame.nLength;
 
-	u32 nRxStatus = *(u32 *) pBuffer;
-	if (nRxStatus & RX_STS_ERROR)
-	{
-		CLogger::Get ()->Write (FromSMSC951x, LogWarning, "RX error (status 0x%X)", nRxStatus);
+	return TRUE;
+}
 
-		return FALSE;
-	}
-	
-	u32 nFrameLength = RX_STS_FRAMELEN (nRxStatus);
-	assert (nFrameLength == nResultLength-4);
-	assert (nFrameLength > 4);
-	if (nFrameLength <= 4)
+unsigned CSMSC951xDevice::ReceiveFrames (TNetRxFrame *pFrames, unsigned nMaxFrames)
+{
+	assert (pFrames != 0);
+	assert (m_pRxBuffer != 0);
+
+	unsigned nFrames = 0;
+	while (nFrames < nMaxFrames)
 	{
-		return FALSE;
-	}
-	nFrameLength -= 4;	// ignore CRC
+		// a bulk transfer may contain multiple frames (MEF mode), which are returned first
+		if (m_nRxOffset >= m_nRxLength)
+		{
+			if (nFrames > 0)
+			{
+				break;
+			}
 
-	//CLogger::Get ()->Write (FromSMSC951x, LogDebug, "Frame received (status 0x%X)", nRxStatus);
+			assert (m_pEndpointBulkIn != 0);
+			CUSBRequest URB (m_pEndpointBulkIn, m_pRxBuffer, RX_BUFFER_SIZE);
 
-	memcpy (pBuffer, (u8 *) pBuffer + 4, nFrameLength);	// overwrite RX status
+			if (!GetHost ()->SubmitBlockingRequest (&URB))
+			{
+				break;
+			}
 
-	assert (pResultLength != 0);
-	*pResultLength = nFrameLength;
-	
-	return TRUE;
+			m_nRxOffset = 0;
+			m_nRxLength = URB.GetResultLength ();
+			if (m_nRxLength < 4)			// should not happen with HW_CFG_BIR set
+			{
+				m_nRxLength = 0;
+
+				break;
+			}
+
+			continue;
+		}
+
+		u8 *pRxStatus = m_pRxBuffer + m_nRxOffset;
+		unsigned nRemaining = m_nRxLength - m_nRxOffset;
+		if (nRemaining < 4)
+		{
+			m_nRxOffset = m_nRxLength;
+
+			continue;
+		}
+
+		u32 nRxStatus = *(u32 *) pRxStatus;
+		u32 nFrameLength = RX_STS_FRAMELEN (nRxStatus);
+		if (nFrameLength > nRemaining-4)
+		{
+			CLogger::Get ()->Write (FromSMSC951x, LogWarning,
+						"Invalid RX frame length (%u)", nFrameLength);
+
+			m_nRxOffset = m_nRxLength;
+
+			continue;
+		}
+
+		// the next RX status is 32-bit aligned
+		m_nRxOffset += 4 + nFrameLength;
+		m_nRxOffset = (m_nRxOffset + 3) & ~3;
+
+		if (nRxStatus & RX_STS_ERROR)
+		{
+			CLogger::Get ()->Write (FromSMSC951x, LogWarning, "RX error (status 0x%X)", nRxStatus);
+
+			continue;
+		}
+
+		if (   nFrameLength <= 4
+		    || nFrameLength-4 > FRAME_BUFFER_SIZE)
+		{
+			continue;
+		}
+		nFrameLength -= 4;	// ignore CRC
+
+		//CLogger::Get ()->Write (FromSMSC951x, LogDebug, "Frame received (status 0x%X)", nRxStatus);
+
+		assert (pFrames[nFrames].pBuffer != 0);
+		memcpy (pFrames[nFrames].pBuffer, pRxStatus + 4, nFrameLength);
+		pFrames[nFrames].nOffset = 0;
+		pFrames[nFrames].nLength = nFrameLength;
+		pFrames[nFrames].bChecksumOK = FALSE;
+
+		nFrames++;
+	}
+
+	return nFrames;
 }
 
 boolean CSMSC951xDevice::IsLinkUp (void)
@@ -94,7 +94,7 @@ CXHCIDevice::~CXHCIDevice (void)
 boolean CXHCIDevice::Initialize (boolean bScanDevices)
 {
 	// init class-specific allocators in USB library
-	INIT_PROTECTED_CLASS_ALLOCATOR (CUSBRequest, XHCI_CONFIG_MAX_REQUESTS, IRQ_LEVEL);
+	INIT_LOCKFREE_CLASS_ALLOCATOR (CUSBRequest, XHCI_CONFIG_MAX_REQUESTS);
 
 #ifdef USE_XHCI_INTERNAL
 	if (CMachineInfo::Get ()->GetMachineModel () != MachineModel4B)
@@ -2,7 +2,7 @@
 // util.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2021  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2014-2024  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -19,100 +19,106 @@
 //
 #include <circle/util.h>
 
-void *memmove (void *pDest, const void *pSrc, size_t nLength)
-{
-	char *pchDest = (char *) pDest;
-	const char *pchSrc = (const char *) pSrc;
+#if STDLIB_SUPPORT <= 1
 
-	if (   pchSrc < pchDest
-	    && pchDest < pchSrc + nLength)
-	{
-		pchSrc += nLength;
-		pchDest += nLength;
+// The string functions process a machine word at once, where possible.
+// Only aligned words are read, which never cross a page boundary, so
+// that no memory behind the terminating null character is accessed,
+// which is not mapped. Bytes in front of the string are masked out.
 
-		while (nLength--)
-		{
-			*--pchDest = *--pchSrc;
-		}
+typedef uintptr __attribute__ ((__may_alias__)) TWord;
 
-		return pDest;
-	}
+#define WORD_SIZE	sizeof (TWord)
+#define WORD_ONES	((TWord) -1 / 0xFF)		// 0x0101...01
+#define WORD_HIGHS	(WORD_ONES * 0x80)		// 0x8080...80
 
-	return memcpy (pDest, pSrc, nLength);
+// returns a non-zero mask, if one of the bytes in nWord is zero,
+// the least significant marked byte is the first zero byte (little endian)
+static inline TWord ZeroBytes (TWord nWord)
+{
+	return (nWord - WORD_ONES) & ~nWord & WORD_HIGHS;
 }
 
-#if STDLIB_SUPPORT <= 1
+static inline unsigned FirstMarkedByte (TWord nMask)
+{
+	return __builtin_ctzll (nMask) / 8;
+}
 
-int memcmp (const void *pBuffer1, const void *pBuffer2, size_t nLength)
+// returns a mask with the nCount least significant bytes set to 0xFF
+static inline TWord LowBytes (unsigned nCount)
 {
-	const unsigned char *p1 = (const unsigned char *) pBuffer1;
-	const unsigned char *p2 = (const unsigned char *) pBuffer2;
-	
-	while (nLength-- > 0)
-	{
-		if (*p1 > *p2)
-		{
-			return 1;
-		}
-		else if (*p1 < *p2)
-		{
-			return -1;
-		}
+	return nCount == 0 ? 0 : ((TWord) 1 << (nCount * 8)) - 1;
+}
 
-		p1++;
-		p2++;
-	}
+static inline boolean IsWordAligned (const void *p)
+{
+	return ((uintptr) p & (WORD_SIZE-1)) == 0;
+}
 
-	return 0;
+static inline boolean IsMutuallyAligned (const void *p1, const void *p2)
+{
+	return (((uintptr) p1 ^ (uintptr) p2) & (WORD_SIZE-1)) == 0;
 }
 
 size_t strlen (const char *pString)
 {
-	size_t nResult = 0;
+	unsigned nOffset = (uintptr) pString & (WORD_SIZE-1);
+	const TWord *pWord = (const TWord *) (pString - nOffset);
 
-	while (*pString++)
+	TWord nMask = ZeroBytes (*pWord | LowBytes (nOffset));
+	while (!nMask)
 	{
-		nResult++;
+		nMask = ZeroBytes (*++pWord);
 	}
 
-	return nResult;
+	return (const char *) pWord + FirstMarkedByte (nMask) - pString;
 }
 
 int strcmp (const char *pString1, const char *pString2)
 {
-	while (   *pString1 != '\0'
-	       && *pString2 != '\0')
+	const unsigned char *p1 = (const unsigned char *) pString1;
+	const unsigned char *p2 = (const unsigned char *) pString2;
+
+	if (IsMutuallyAligned (p1, p2))
 	{
-		if (*pString1 > *pString2)
+		for (; !IsWordAligned (p1); p1++, p2++)
 		{
-			return 1;
+			if (   *p1 != *p2
+			    || *p1 == '\0')
+			{
+				return *p1 - *p2;
+			}
 		}
-		else if (*pString1 < *pString2)
+
+		const TWord *pWord1 = (const TWord *) p1;
+		const TWord *pWord2 = (const TWord *) p2;
+		while (   *pWord1 == *pWord2
+		       && !ZeroBytes (*pWord1))
 		{
-			return -1;
+			pWord1++;
+			pWord2++;
 		}
 
-		pString1++;
-		pString2++;
+		// the difference or the end is in this word
+		p1 = (const unsigned char *) pWord1;
+		p2 = (const unsigned char *) pWord2;
 	}
 
-	if (*pString1 > *pString2)
-	{
-		return 1;
-	}
-	else if (*pString1 < *pString2)
+	while (   *p1 == *p2
+	       && *p1 != '\0')
 	{
-		return -1;
+		p1++;
+		p2++;
 	}
 
-	return 0;
+	return *p1 - *p2;
 }
 
-static int toupper (int c)
+static int tolower (int c)
 {
-	if ('a' <= c && c <= 'z')
+	if ('A' <= c && c <= 'Z')
 	{
-		c -= 'a' - 'A';
+		c += 'a' - 'A';
 	}
 
 	return c;
@@ -120,70 +126,52 @@ static int toupper (int c)
 
 int strcasecmp (const char *pString1, const char *pString2)
 {
-	int nChar1, nChar2;
+	const unsigned char *p1 = (const unsigned char *) pString1;
+	const unsigned char *p2 = (const unsigned char *) pString2;
 
-	while (   (nChar1 = toupper (*pString1)) != '\0'
-	       && (nChar2 = toupper (*pString2)) != '\0')
+	boolean bMutuallyAligned = IsMutuallyAligned (p1, p2);
+
+	while (1)
 	{
-		if (nChar1 > nChar2)
+		// skip words, which are exactly equal
+		if (   bMutuallyAligned
+		    && IsWordAligned (p1))
 		{
-			return 1;
+			const TWord *pWord1 = (const TWord *) p1;
+			const TWord *pWord2 = (const TWord *) p2;
+			while (   *pWord1 == *pWord2
+			       && !ZeroBytes (*pWord1))
+			{
+				pWord1++;
+				pWord2++;
+			}
+
+			p1 = (const unsigned char *) pWord1;
+			p2 = (const unsigned char *) pWord2;
 		}
-		else if (nChar1 < nChar2)
+
+		int nChar1 = tolower (*p1++);
+		int nChar2 = tolower (*p2++);
+		if (   nChar1 != nChar2
+		    || nChar1 == '\0')
 		{
-			return -1;
+			return nChar1 - nChar2;
 		}
-
-		pString1++;
-		pString2++;
-	}
-
-	nChar2 = toupper (*pString2);
-
-	if (nChar1 > nChar2)
-	{
-		return 1;
 	}
-	else if (nChar1 < nChar2)
-	{
-		return -1;
-	}
-
-	return 0;
 }
 
 int strncmp (const char *pString1, const char *pString2, size_t nMaxLen)
 {
-	while (   nMaxLen > 0
-	       && *pString1 != '\0'
-	       && *pString2 != '\0')
+	const unsigned char *p1 = (const unsigned char *) pString1;
+	const unsigned char *p2 = (const unsigned char *) pString2;
+
+	for (; nMaxLen > 0; nMaxLen--, p1++, p2++)
 	{
-		if (*pString1 > *pString2)
-		{
-			return 1;
-		}
-		else if (*pString1 < *pString2)
+		if (   *p1 != *p2
+		    || *p1 == '\0')
 		{
-			return -1;
+			return *p1 - *p2;
 		}
-
-		nMaxLen--;
-		pString1++;
-		pString2++;
-	}
-
-	if (nMaxLen == 0)
-	{
-		return 0;
-	}
-
-	if (*pString1 > *pString2)
-	{
-		return 1;
-	}
-	else if (*pString1 < *pString2)
-	{
-		return -1;
 	}
 
 	return 0;
@@ -191,40 +179,18 @@ int strncmp (const char *pString1, const char *pString2, size_t nMaxLen)
 
 int strncasecmp (const char *pString1, const char *pString2, size_t nMaxLen)
 {
-	int nChar1, nChar2;
+	const unsigned char *p1 = (const unsigned char *) pString1;
+	const unsigned char *p2 = (const unsigned char *) pString2;
 
-	while (   nMaxLen > 0
-	       && (nChar1 = toupper (*pString1)) != '\0'
-	       && (nChar2 = toupper (*pString2)) != '\0')
+	for (; nMaxLen > 0; nMaxLen--, p1++, p2++)
 	{
-		if (nChar1 > nChar2)
+		int nChar1 = tolower (*p1);
+		int nChar2 = tolower (*p2);
+		if (   nChar1 != nChar2
+		    || nChar1 == '\0')
 		{
-			return 1;
+			return nChar1 - nChar2;
 		}
-		else if (nChar1 < nChar2)
-		{
-			return -1;
-		}
-
-		nMaxLen--;
-		pString1++;
-		pString2++;
-	}
-
-	nChar2 = toupper (*pString2);
-
-	if (nMaxLen == 0)
-	{
-		return 0;
-	}
-
-	if (nChar1 > nChar2)
-	{
-		return 1;
-	}
-	else if (nChar1 < nChar2)
-	{
-		return -1;
 	}
 
 	return 0;
@@ -232,14 +198,7 @@ int strncasecmp (const char *pString1, const char *pString2, size_t nMaxLen)
 
 char *strcpy (char *pDest, const char *pSrc)
 {
-	char *p = pDest;
-
-	while (*pSrc)
-	{
-		*p++ = *pSrc++;
-	}
-
-	*p = '\0';
+	memcpy (pDest, pSrc, strlen (pSrc) + 1);
 
 	return pDest;
 }
@@ -269,33 +228,61 @@ char *strncpy (char *pDest, const char *pSrc, size_t nMaxLen)
 
 char *strcat (char *pDest, const char *pSrc)
 {
-	char *p = pDest;
+	strcpy (pDest + strlen (pDest), pSrc);
 
-	while (*p)
-	{
-		p++;
-	}
+	return pDest;
+}
+
+char *strchr (const char *pString, int chChar)
+{
+	TWord nPattern = (u8) chChar * WORD_ONES;
 
-	while (*pSrc)
+	unsigned nOffset = (uintptr) pString & (WORD_SIZE-1);
+	const TWord *pWord = (const TWord *) (pString - nOffset);
+
+	// search for the null character and chChar at once
+	TWord nLow = LowBytes (nOffset);
+	TWord nWord = *pWord;
+	TWord nMask = ZeroBytes (nWord | nLow) | ZeroBytes ((nWord ^ nPattern) | nLow);
+	while (!nMask)
 	{
-		*p++ = *pSrc++;
+		nWord = *++pWord;
+		nMask = ZeroBytes (nWord) | ZeroBytes (nWord ^ nPattern);
 	}
 
-	*p = '\0';
+	const char *pFound = (const char *) pWord + FirstMarkedByte (nMask);
 
-	return pDest;
+	return *pFound == (char) chChar ? (char *) pFound : 0;
 }
 
-char *strchr (const char *pString, int chChar)
+void *memchr (const void *pBuffer, int nValue, size_t nLength)
 {
-	while (*pString)
+	const u8 *p = (const u8 *) pBuffer;
+	u8 uchValue = (u8) nValue;
+
+	for (; nLength > 0 && !IsWordAligned (p); nLength--, p++)
 	{
-		if (*pString == chChar)
+		if (*p == uchValue)
 		{
-			return (char *) pString;
+			return (void *) p;
 		}
+	}
 
-		pString++;
+	TWord nPattern = uchValue * WORD_ONES;
+	for (; nLength >= WORD_SIZE; nLength -= WORD_SIZE, p += WORD_SIZE)
+	{
+		if (ZeroBytes (*(const TWord *) p ^ nPattern))
+		{
+			break;
+		}
+	}
+
+	for (; nLength > 0; nLength--, p++)
+	{
+		if (*p == uchValue)
+		{
+			return (void *) p;
+		}
 	}
 
 	return 0;
@@ -303,33 +290,17 @@ char *strchr (const char *pString, int chChar)
 
 char *strstr (const char *pString, const char *pNeedle)
 {
-	if (!*pString)
+	size_t nNeedleLen = strlen (pNeedle);
+	if (nNeedleLen == 0)
 	{
-		if (*pNeedle)
-		{
-			return 0;
-		}
-
 		return (char *) pString;
 	}
 
-	while (*pString)
+	while ((pString = strchr (pString, pNeedle[0])) != 0)
 	{
-		size_t i = 0;
-
-		while (1)
+		if (strncmp (pString, pNeedle, nNeedleLen) == 0)
 		{
-			if (!pNeedle[i])
-			{
-				return (char *) pString;
-			}
-
-			if (pNeedle[i] != pString[i])
-			{
-				break;
-			}
-
-			i++;
+			return (char *) pString;
 		}
 
 		pString++;
@@ -359,7 +330,8 @@ char *strtok_r (char *pString, const char *pDelim, char **ppSavePtr)
 		return 0;
 	}
 
-	while (strchr (pDelim, *pString) != 0)
+	while (   *pString != '\0'
+	       && strchr (pDelim, *pString) != 0)
 	{
 		pString++;
 	}
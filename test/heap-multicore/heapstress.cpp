@@ -0,0 +1,123 @@
+//
+// heapstress.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "heapstress.h"
+#include <circle/logger.h>
+#include <circle/timer.h>
+#include <circle/alloc.h>
+#include <assert.h>
+
+#define TEST_SECONDS	10
+#define SLOTS		64		// per core
+#define BLOCK_SIZE_MAX	512		// small blocks only
+
+static const char FromHeapStress[] = "heapstress";
+
+CHeapStress::CHeapStress (CMemorySystem *pMemorySystem)
+#ifdef ARM_ALLOW_MULTI_CORE
+:	CMultiCoreSupport (pMemorySystem)
+#endif
+{
+	for (unsigned i = 0; i < CORES; i++)
+	{
+		m_nOperations[i] = 0;
+		m_bDone[i] = FALSE;
+	}
+}
+
+CHeapStress::~CHeapStress (void)
+{
+}
+
+void CHeapStress::Run (unsigned nCore)
+{
+	assert (nCore < CORES);
+
+	void *pBlock[SLOTS];
+	for (unsigned i = 0; i < SLOTS; i++)
+	{
+		pBlock[i] = 0;
+	}
+
+	u32 nRandom = 0x12345678 + nCore;
+	u64 nOperations = 0;
+
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+	while (CTimer::GetClockTicks () - nStartTicks < TEST_SECONDS * CLOCKHZ)
+	{
+		for (unsigned i = 0; i < 1000; i++)
+		{
+			// xorshift32
+			nRandom ^= nRandom << 13;
+			nRandom ^= nRandom >> 17;
+			nRandom ^= nRandom << 5;
+
+			unsigned nSlot = nRandom % SLOTS;
+			if (pBlock[nSlot] != 0)
+			{
+				free (pBlock[nSlot]);
+				pBlock[nSlot] = 0;
+			}
+			else
+			{
+				pBlock[nSlot] = malloc ((nRandom >> 8) % BLOCK_SIZE_MAX + 1);
+				assert (pBlock[nSlot] != 0);
+			}
+		}
+
+		nOperations += 1000;
+	}
+
+	for (unsigned i = 0; i < SLOTS; i++)
+	{
+		free (pBlock[i]);
+	}
+
+	m_nOperations[nCore] = nOperations;
+	m_bDone[nCore] = TRUE;
+}
+
+void CHeapStress::ShowResults (void)
+{
+	u64 nTotal = 0;
+
+	for (unsigned nCore = 0; nCore < CORES; nCore++)
+	{
+#ifdef ARM_ALLOW_MULTI_CORE
+		while (!m_bDone[nCore])
+		{
+			// wait for secondary core
+		}
+#else
+		if (nCore > 0)
+		{
+			break;
+		}
+#endif
+
+		unsigned nOpsPerSec = (unsigned) (m_nOperations[nCore] / TEST_SECONDS);
+		CLogger::Get ()->Write (FromHeapStress, LogNotice, "Core %u: %u ops/sec",
+					nCore, nOpsPerSec);
+
+		nTotal += m_nOperations[nCore];
+	}
+
+	CLogger::Get ()->Write (FromHeapStress, LogNotice, "Total: %u ops/sec",
+				(unsigned) (nTotal / TEST_SECONDS));
+}
@@ -0,0 +1,50 @@
+//
+// heapstress.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _heapstress_h
+#define _heapstress_h
+
+#include <circle/multicore.h>
+#include <circle/memory.h>
+#include <circle/memorymap.h>
+#include <circle/types.h>
+
+class CHeapStress
+#ifdef ARM_ALLOW_MULTI_CORE
+	: public CMultiCoreSupport
+#endif
+{
+public:
+	CHeapStress (CMemorySystem *pMemorySystem);
+	~CHeapStress (void);
+
+#ifndef ARM_ALLOW_MULTI_CORE
+	boolean Initialize (void)	{ return TRUE; }
+#endif
+
+	void Run (unsigned nCore);
+
+	void ShowResults (void);	// call on core 0 after Run() has returned
+
+private:
+	volatile u64 m_nOperations[CORES];
+	volatile boolean m_bDone[CORES];
+};
+
+#endif
@@ -0,0 +1,161 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <circle/alloc.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#define SLOTS			256
+#define CYCLES			4000000
+#define REPORT_CYCLES		250000
+
+#define SMALL_SIZE_MAX		2048		// most allocations are small
+#define LARGE_SIZE_MAX		0x200000	// larger than the largest bucket
+#define LARGE_PERCENT		5
+
+static const char FromKernel[] = "kernel";
+
+CKernel::CKernel (void)
+:	m_pMemory (CMemorySystem::Get ()),
+	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer),
+	m_nRandomSeed (0x12345678)
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Serial.Initialize (115200);
+	}
+
+	if (bOK)
+	{
+		CDevice *pTarget = m_DeviceNameService.GetDevice (m_Options.GetLogDevice (), FALSE);
+		if (pTarget == 0)
+		{
+			pTarget = &m_Screen;
+		}
+
+		bOK = m_Logger.Initialize (pTarget);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
+
+	void *pBlock[SLOTS];
+	size_t nBlockSize[SLOTS];
+	memset (pBlock, 0, sizeof pBlock);
+
+	size_t nStartFree = m_pMemory->GetHeapFreeSpace (HEAP_DEFAULT_MALLOC);
+	m_Logger.Write (FromKernel, LogNotice, "Free space at start: %lu KB", nStartFree / 1024);
+
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+
+	for (unsigned nCycle = 1; nCycle <= CYCLES; nCycle++)
+	{
+		unsigned nSlot = Random () % SLOTS;
+		if (pBlock[nSlot] != 0)
+		{
+			// check, that nobody has overwritten the block
+			assert (*(u8 *) pBlock[nSlot] == (u8) nSlot);
+			assert (((u8 *) pBlock[nSlot])[nBlockSize[nSlot]-1] == (u8) nSlot);
+
+			free (pBlock[nSlot]);
+			pBlock[nSlot] = 0;
+		}
+		else
+		{
+			size_t nSize =   Random () % 100 < LARGE_PERCENT
+				       ? Random () % LARGE_SIZE_MAX + 1
+				       : Random () % SMALL_SIZE_MAX + 1;
+
+			pBlock[nSlot] = malloc (nSize);
+			if (pBlock[nSlot] == 0)
+			{
+				m_Logger.Write (FromKernel, LogPanic, "Out of memory after %u cycles",
+						nCycle);
+			}
+
+			nBlockSize[nSlot] = nSize;
+			*(u8 *) pBlock[nSlot] = (u8) nSlot;
+			((u8 *) pBlock[nSlot])[nSize-1] = (u8) nSlot;
+		}
+
+		if (nCycle % REPORT_CYCLES == 0)
+		{
+			m_Logger.Write (FromKernel, LogNotice, "%u cycles: %lu KB free",
+					nCycle, m_pMemory->GetHeapFreeSpace (HEAP_DEFAULT_MALLOC) / 1024);
+		}
+	}
+
+	unsigned nTicks = CTimer::GetClockTicks () - nStartTicks;
+
+	for (unsigned i = 0; i < SLOTS; i++)
+	{
+		free (pBlock[i]);
+	}
+
+	m_Logger.Write (FromKernel, LogNotice, "%u cycles in %u ms (%u ns per cycle)",
+			CYCLES, nTicks / 1000, (unsigned) ((u64) nTicks * 1000 / CYCLES));
+
+	m_Logger.Write (FromKernel, LogNotice, "Free space at end: %lu KB",
+			m_pMemory->GetHeapFreeSpace (HEAP_DEFAULT_MALLOC) / 1024);
+
+	return ShutdownHalt;
+}
+
+unsigned CKernel::Random (void)
+{
+	// xorshift32
+	m_nRandomSeed ^= m_nRandomSeed << 13;
+	m_nRandomSeed ^= m_nRandomSeed >> 17;
+	m_nRandomSeed ^= m_nRandomSeed << 5;
+
+	return m_nRandomSeed;
+}
@@ -0,0 +1,217 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <circle/alloc.h>
+#include <circle/string.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#ifndef HEAP_TRACE
+	#error Circle must be built with HEAP_TRACE defined for this test!
+#endif
+
+#define DRIVE			"SD:"
+#define FILENAME		"/heaptrace.txt"
+
+#define SLOTS			256
+#define RUN_SECONDS		60
+#define REPORT_SECONDS		10
+#define REPORT_SITES		10
+
+static const char FromKernel[] = "kernel";
+
+// the allocation sites must not be inlined to be distinguishable
+static void __attribute__ ((noinline)) *AllocateBuffer (size_t nSize)
+{
+	return malloc (nSize);
+}
+
+static void __attribute__ ((noinline)) *AllocateLeakingBuffer (size_t nSize)
+{
+	return malloc (nSize);
+}
+
+static void __attribute__ ((noinline)) *AllocateLeakingString (const char *pString)
+{
+	return new CString (pString);
+}
+
+CKernel::CKernel (void)
+:	m_pMemory (CMemorySystem::Get ()),
+	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer),
+	m_EMMC (&m_Interrupt, &m_Timer, &m_ActLED),
+	m_nRandomSeed (0x12345678)
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Serial.Initialize (115200);
+	}
+
+	if (bOK)
+	{
+		CDevice *pTarget = m_DeviceNameService.GetDevice (m_Options.GetLogDevice (), FALSE);
+		if (pTarget == 0)
+		{
+			pTarget = &m_Screen;
+		}
+
+		bOK = m_Logger.Initialize (pTarget);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_EMMC.Initialize ();
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
+
+	void *pBlock[SLOTS];
+	memset (pBlock, 0, sizeof pBlock);
+
+	unsigned nStartTime = m_Timer.GetUptime ();
+	unsigned nLastReport = nStartTime;
+	unsigned nLeaked = 0;
+
+	while (m_Timer.GetUptime () - nStartTime < RUN_SECONDS)
+	{
+		unsigned nSlot = Random () % SLOTS;
+		if (pBlock[nSlot] != 0)
+		{
+			free (pBlock[nSlot]);
+			pBlock[nSlot] = 0;
+		}
+		else
+		{
+			pBlock[nSlot] = AllocateBuffer (Random () % 4096 + 1);
+			assert (pBlock[nSlot] != 0);
+		}
+
+		// leak a block every now and then
+		unsigned nRandom = Random () % 10000;
+		if (nRandom == 0)
+		{
+			AllocateLeakingBuffer (Random () % 1024 + 1);
+			nLeaked++;
+		}
+		else if (nRandom == 1)
+		{
+			AllocateLeakingString ("This string is never deleted");
+			nLeaked++;
+		}
+
+		if (m_Timer.GetUptime () - nLastReport >= REPORT_SECONDS)
+		{
+			nLastReport = m_Timer.GetUptime ();
+
+			m_Logger.Write (FromKernel, LogNotice, "%u blocks leaked", nLeaked);
+
+			CMemorySystem::DumpHeapTrace (REPORT_SITES);
+		}
+	}
+
+	for (unsigned i = 0; i < SLOTS; i++)
+	{
+		free (pBlock[i]);
+	}
+
+	WriteReport ();
+
+	return ShutdownHalt;
+}
+
+void CKernel::WriteReport (void)
+{
+	FRESULT Result = f_mount (&m_FileSystem, DRIVE, 1);
+	if (Result != FR_OK)
+	{
+		m_Logger.Write (FromKernel, LogError, "Mount error (%u)", Result);
+
+		return;
+	}
+
+	CString Report;
+	CMemorySystem::GetHeapTraceReport (&Report, HEAP_DEFAULT_MALLOC, REPORT_SITES);
+
+	FIL File;
+	Result = f_open (&File, DRIVE FILENAME, FA_WRITE | FA_CREATE_ALWAYS);
+	if (Result != FR_OK)
+	{
+		m_Logger.Write (FromKernel, LogError, "Cannot create file (%u)", Result);
+
+		f_mount (0, DRIVE, 0);
+
+		return;
+	}
+
+	unsigned nBytesWritten;
+	if (   f_write (&File, (const char *) Report, Report.GetLength (), &nBytesWritten) != FR_OK
+	    || nBytesWritten != Report.GetLength ())
+	{
+		m_Logger.Write (FromKernel, LogError, "Write error");
+	}
+
+	f_close (&File);
+	f_mount (0, DRIVE, 0);
+
+	m_Logger.Write (FromKernel, LogNotice, "Report written to " DRIVE FILENAME);
+}
+
+unsigned CKernel::Random (void)
+{
+	// xorshift32
+	m_nRandomSeed ^= m_nRandomSeed << 13;
+	m_nRandomSeed ^= m_nRandomSeed >> 17;
+	m_nRandomSeed ^= m_nRandomSeed << 5;
+
+	return m_nRandomSeed;
+}
@@ -0,0 +1,429 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <circle/util.h>
+
+#define MIN_SIZE		16
+#define MAX_SIZE		0x100000		// 1 MiB
+#define BYTES_PER_SIZE		0x1000000		// 16 MiB are processed per size
+
+#define BUFFER_SIZE		(MAX_SIZE + 64)		// space for offsets
+
+#define CHECK_MAX_LENGTH	300
+#define CHECK_MAX_OFFSET	16
+
+enum TFunction
+{
+	FunctionMemcpy,
+	FunctionMemcpyUnaligned,
+	FunctionMemset,
+	FunctionMemmove,
+	FunctionMemcmp,
+	FunctionUnknown
+};
+
+static const char *s_pFunctionName[FunctionUnknown] =
+{
+	"memcpy",
+	"memcpy+1",
+	"memset",
+	"memmove",
+	"memcmp"
+};
+
+static const char FromKernel[] = "kernel";
+
+CKernel::CKernel (void)
+:	m_pMemory (CMemorySystem::Get ()),
+	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer),
+	m_pBuffer1 (0),
+	m_pBuffer2 (0),
+	m_nRandomSeed (0x12345678)
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+	delete [] m_pBuffer1;
+	delete [] m_pBuffer2;
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Serial.Initialize (115200);
+	}
+
+	if (bOK)
+	{
+		CDevice *pTarget = m_DeviceNameService.GetDevice (m_Options.GetLogDevice (), FALSE);
+		if (pTarget == 0)
+		{
+			pTarget = &m_Screen;
+		}
+
+		bOK = m_Logger.Initialize (pTarget);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
+
+	m_pBuffer1 = new u8[BUFFER_SIZE];
+	m_pBuffer2 = new u8[BUFFER_SIZE];
+	if (   m_pBuffer1 == 0
+	    || m_pBuffer2 == 0)
+	{
+		m_Logger.Write (FromKernel, LogPanic, "Cannot allocate buffers");
+	}
+
+	if (   !CheckFunctions ()
+	    || !CheckOverlappingMove ())
+	{
+		return ShutdownHalt;
+	}
+
+	m_Logger.Write (FromKernel, LogNotice, "Functions are working properly");
+
+	CString Header;
+	Header.Format ("%8s", "Size");
+	for (unsigned nFunction = 0; nFunction < FunctionUnknown; nFunction++)
+	{
+		CString Column;
+		Column.Format ("%10s", s_pFunctionName[nFunction]);
+		Header.Append (Column);
+	}
+
+	m_Logger.Write (FromKernel, LogNotice, "Throughput in MB/s:");
+	m_Logger.Write (FromKernel, LogNotice, "%s", (const char *) Header);
+
+	for (size_t nSize = MIN_SIZE; nSize <= MAX_SIZE; nSize <<= 1)
+	{
+		CString Line;
+		if (nSize < 1024)
+		{
+			Line.Format ("%6lu B", (unsigned long) nSize);
+		}
+		else
+		{
+			Line.Format ("%5lu KB", (unsigned long) nSize / 1024);
+		}
+
+		for (unsigned nFunction = 0; nFunction < FunctionUnknown; nFunction++)
+		{
+			CString Column;
+			Column.Format ("%10u", Benchmark (nFunction, nSize));
+			Line.Append (Column);
+		}
+
+		m_Logger.Write (FromKernel, LogNotice, "%s", (const char *) Line);
+	}
+
+	return ShutdownHalt;
+}
+
+// compares the results of the library functions with simple byte loops
+// for all combinations of short lengths and misalignments
+boolean CKernel::CheckFunctions (void)
+{
+	static const size_t Lengths[] = {1024, 4096 + 37, 65536 + 15};
+
+	for (size_t nLength = 0; nLength < CHECK_MAX_LENGTH + sizeof Lengths / sizeof Lengths[0];
+	     nLength++)
+	{
+		size_t nLen =   nLength < CHECK_MAX_LENGTH
+			      ? nLength : Lengths[nLength - CHECK_MAX_LENGTH];
+
+		for (unsigned nDestOffset = 0; nDestOffset < CHECK_MAX_OFFSET; nDestOffset++)
+		{
+			for (unsigned nSrcOffset = 0; nSrcOffset < CHECK_MAX_OFFSET; nSrcOffset++)
+			{
+				for (unsigned i = 0; i < nLen + 3*CHECK_MAX_OFFSET; i++)
+				{
+					m_pBuffer1[i] = (u8) Random ();
+					m_pBuffer2[i] = (u8) Random ();
+				}
+
+				// memcpy()
+				u8 *pDest = m_pBuffer2 + CHECK_MAX_OFFSET + nDestOffset;
+				const u8 *pSrc = m_pBuffer1 + nSrcOffset;
+				u8 uchBefore = pDest[-1];
+				u8 uchBehind = pDest[nLen];
+				if (   memcpy (pDest, pSrc, nLen) != pDest
+				    || pDest[-1] != uchBefore
+				    || pDest[nLen] != uchBehind)
+				{
+					m_Logger.Write (FromKernel, LogError, "memcpy: Bounds (%lu/%u/%u)",
+							(unsigned long) nLen, nDestOffset, nSrcOffset);
+
+					return FALSE;
+				}
+
+				for (unsigned i = 0; i < nLen; i++)
+				{
+					if (pDest[i] != pSrc[i])
+					{
+						m_Logger.Write (FromKernel, LogError,
+								"memcpy: Data (%lu/%u/%u)",
+								(unsigned long) nLen, nDestOffset, nSrcOffset);
+
+						return FALSE;
+					}
+				}
+
+				// memcmp()
+				if (memcmp (pDest, pSrc, nLen) != 0)
+				{
+					m_Logger.Write (FromKernel, LogError, "memcmp: Equal (%lu/%u/%u)",
+							(unsigned long) nLen, nDestOffset, nSrcOffset);
+
+					return FALSE;
+				}
+
+				if (nLen > 0)
+				{
+					unsigned nPos = Random () % nLen;
+					pDest[nPos] = pSrc[nPos] ^ (1 << (Random () % 8));
+					int nExpected = pDest[nPos] < pSrc[nPos] ? -1 : 1;
+					int nResult = memcmp (pDest, pSrc, nLen);
+					if (   (nExpected < 0 && nResult >= 0)
+					    || (nExpected > 0 && nResult <= 0))
+					{
+						m_Logger.Write (FromKernel, LogError,
+								"memcmp: Differ (%lu/%u/%u)",
+								(unsigned long) nLen, nDestOffset, nSrcOffset);
+
+						return FALSE;
+					}
+				}
+
+				// memset()
+				u8 uchValue = (u8) Random ();
+				if (   memset (pDest, uchValue, nLen) != pDest
+				    || pDest[-1] != uchBefore
+				    || pDest[nLen] != uchBehind)
+				{
+					m_Logger.Write (FromKernel, LogError, "memset: Bounds (%lu/%u)",
+							(unsigned long) nLen, nDestOffset);
+
+					return FALSE;
+				}
+
+				for (unsigned i = 0; i < nLen; i++)
+				{
+					if (pDest[i] != uchValue)
+					{
+						m_Logger.Write (FromKernel, LogError, "memset: Data (%lu/%u)",
+								(unsigned long) nLen, nDestOffset);
+
+						return FALSE;
+					}
+				}
+
+				// memmove() in both directions within one buffer
+				for (unsigned i = 0; i < nLen + 2*CHECK_MAX_OFFSET; i++)
+				{
+					m_pBuffer1[i] = (u8) i;
+				}
+
+				u8 *pFrom = m_pBuffer1 + nSrcOffset;
+				u8 *pTo = m_pBuffer1 + nDestOffset;
+				if (memmove (pTo, pFrom, nLen) != pTo)
+				{
+					m_Logger.Write (FromKernel, LogError, "memmove: Return (%lu/%u/%u)",
+							(unsigned long) nLen, nDestOffset, nSrcOffset);
+
+					return FALSE;
+				}
+
+				for (unsigned i = 0; i < nLen; i++)
+				{
+					if (pTo[i] != (u8) (nSrcOffset + i))
+					{
+						m_Logger.Write (FromKernel, LogError,
+								"memmove: Data (%lu/%u/%u)",
+								(unsigned long) nLen, nDestOffset, nSrcOffset);
+
+						return FALSE;
+					}
+				}
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+// checks memmove() backwards with overlapping, mutually aligned buffers, where the
+// alignment of the destination end leaves less than a block, and that the bytes
+// around the destination are not modified
+boolean CKernel::CheckOverlappingMove (void)
+{
+	for (size_t nLen = 1; nLen <= 2*64 + 3; nLen++)
+	{
+		for (unsigned nDistance = 1; nDistance <= 8; nDistance++)
+		{
+			for (unsigned nEndOffset = 0; nEndOffset < CHECK_MAX_OFFSET; nEndOffset++)
+			{
+				size_t nTotal = nLen + 4*CHECK_MAX_OFFSET;
+				for (unsigned i = 0; i < nTotal; i++)
+				{
+					m_pBuffer1[i] = (u8) i;
+				}
+
+				// the end of the destination is at an offset of nEndOffset
+				// from a 16 byte boundary
+				u8 *pTo = m_pBuffer1 + 2*CHECK_MAX_OFFSET + nLen + nEndOffset;
+				pTo -= ((uintptr) pTo & (CHECK_MAX_OFFSET-1)) + nLen;
+				pTo += nEndOffset;
+				u8 *pFrom = pTo - nDistance;
+				unsigned nFrom = pFrom - m_pBuffer1;
+				unsigned nTo = pTo - m_pBuffer1;
+
+				if (memmove (pTo, pFrom, nLen) != pTo)
+				{
+					m_Logger.Write (FromKernel, LogError, "memmove: Overlap (%lu/%u/%u)",
+							(unsigned long) nLen, nDistance, nEndOffset);
+
+					return FALSE;
+				}
+
+				for (unsigned i = 0; i < nTotal; i++)
+				{
+					u8 uchExpected =   i >= nTo && i < nTo + nLen
+							 ? (u8) (nFrom + i - nTo) : (u8) i;
+					if (m_pBuffer1[i] != uchExpected)
+					{
+						m_Logger.Write (FromKernel, LogError,
+								"memmove: Overlap data (%lu/%u/%u)",
+								(unsigned long) nLen, nDistance, nEndOffset);
+
+						return FALSE;
+					}
+				}
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+// returns the throughput in MB/s
+unsigned CKernel::Benchmark (unsigned nFunction, size_t nSize)
+{
+	unsigned nIterations = BYTES_PER_SIZE / nSize;
+
+	memset (m_pBuffer1, 0x55, nSize + 1);
+	memset (m_pBuffer2, 0x55, nSize + 1);
+
+	int nResult = 0;
+
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+
+	switch (nFunction)
+	{
+	case FunctionMemcpy:
+		for (unsigned i = 0; i < nIterations; i++)
+		{
+			memcpy (m_pBuffer2, m_pBuffer1, nSize);
+		}
+		break;
+
+	case FunctionMemcpyUnaligned:
+		for (unsigned i = 0; i < nIterations; i++)
+		{
+			memcpy (m_pBuffer2, m_pBuffer1 + 1, nSize);
+		}
+		break;
+
+	case FunctionMemset:
+		for (unsigned i = 0; i < nIterations; i++)
+		{
+			memset (m_pBuffer2, i, nSize);
+		}
+		break;
+
+	case FunctionMemmove:		// overlapping, copies backwards
+		for (unsigned i = 0; i < nIterations; i++)
+		{
+			memmove (m_pBuffer1 + 16, m_pBuffer1, nSize);
+		}
+		break;
+
+	case FunctionMemcmp:
+		for (unsigned i = 0; i < nIterations; i++)
+		{
+			nResult |= memcmp (m_pBuffer2, m_pBuffer1, nSize);
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	unsigned nTicks = CTimer::GetClockTicks () - nStartTicks;
+
+	if (nResult != 0)
+	{
+		m_Logger.Write (FromKernel, LogWarning, "memcmp: Unexpected result");
+	}
+
+	if (nTicks == 0)
+	{
+		nTicks = 1;
+	}
+
+	// bytes per microsecond equals MB/s
+	return (unsigned) ((u64) nIterations * nSize / nTicks);
+}
+
+unsigned CKernel::Random (void)
+{
+	// xorshift32
+	m_nRandomSeed ^= m_nRandomSeed << 13;
+	m_nRandomSeed ^= m_nRandomSeed >> 17;
+	m_nRandomSeed ^= m_nRandomSeed << 5;
+
+	return m_nRandomSeed;
+}
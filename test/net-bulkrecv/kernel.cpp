@@ -0,0 +1,175 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <circle/net/in.h>
+#include <circle/net/ipaddress.h>
+#include <circle/string.h>
+#include <assert.h>
+
+#define RECEIVE_PORT	5001
+
+static const char FromKernel[] = "kernel";
+
+CKernel::CKernel (void)
+:	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer),
+	m_USBHCI (&m_Interrupt, &m_Timer)
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Serial.Initialize (115200);
+	}
+
+	if (bOK)
+	{
+		CDevice *pTarget = m_DeviceNameService.GetDevice (m_Options.GetLogDevice (), FALSE);
+		if (pTarget == 0)
+		{
+			pTarget = &m_Screen;
+		}
+
+		bOK = m_Logger.Initialize (pTarget);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_USBHCI.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Net.Initialize ();
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
+
+	CSocket Socket (&m_Net, IPPROTO_TCP);
+	if (Socket.Bind (RECEIVE_PORT) < 0)
+	{
+		m_Logger.Write (FromKernel, LogPanic, "Cannot bind to port %u", RECEIVE_PORT);
+	}
+
+	if (Socket.Listen () < 0)
+	{
+		m_Logger.Write (FromKernel, LogPanic, "Cannot listen on port %u", RECEIVE_PORT);
+	}
+
+	CString IPString;
+	m_Net.GetConfig ()->GetIPAddress ()->Format (&IPString);
+	m_Logger.Write (FromKernel, LogNotice, "Listening on %s:%u",
+			(const char *) IPString, RECEIVE_PORT);
+
+	while (1)
+	{
+		CIPAddress ForeignIP;
+		u16 nForeignPort;
+		CSocket *pConnection = Socket.Accept (&ForeignIP, &nForeignPort);
+		if (pConnection == 0)
+		{
+			m_Logger.Write (FromKernel, LogWarning, "Cannot accept connection");
+
+			continue;
+		}
+
+		ForeignIP.Format (&IPString);
+		m_Logger.Write (FromKernel, LogNotice, "Incoming connection from %s:%u",
+				(const char *) IPString, (unsigned) nForeignPort);
+
+		Receive (pConnection);
+
+		delete pConnection;
+	}
+
+	return ShutdownHalt;
+}
+
+void CKernel::Receive (CSocket *pConnection)
+{
+	assert (pConnection != 0);
+
+	u8 Buffer[FRAME_BUFFER_SIZE];
+
+	u64 nTotalBytes = 0;
+	unsigned nIntervalBytes = 0;
+
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+	unsigned nIntervalStart = nStartTicks;
+
+	int nResult;
+	while ((nResult = pConnection->Receive (Buffer, sizeof Buffer, 0)) > 0)
+	{
+		nTotalBytes += nResult;
+		nIntervalBytes += nResult;
+
+		unsigned nTicks = CTimer::GetClockTicks ();
+		if (nTicks - nIntervalStart >= CLOCKHZ)
+		{
+			unsigned nMicros = nTicks - nIntervalStart;
+
+			m_Logger.Write (FromKernel, LogNotice, "%u KByte/s",
+					(unsigned) ((u64) nIntervalBytes * CLOCKHZ / 1024 / nMicros));
+
+			nIntervalBytes = 0;
+			nIntervalStart = nTicks;
+		}
+	}
+
+	unsigned nMicros = CTimer::GetClockTicks () - nStartTicks;
+	if (nMicros == 0)
+	{
+		nMicros = 1;
+	}
+
+	m_Logger.Write (FromKernel, LogNotice, "%u KByte received in %u ms (%u KByte/s)",
+			(unsigned) (nTotalBytes / 1024), nMicros / 1000,
+			(unsigned) (nTotalBytes * CLOCKHZ / 1024 / nMicros));
+}
@@ -0,0 +1,279 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <circle/net/checksumcalculator.h>
+#include <circle/net/ipaddress.h>
+#include <circle/net/in.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#define MAX_SHORT_LENGTH	300
+#define MAX_LENGTH		100000		// more than three NEON blocks
+#define MAX_OFFSET		16
+
+#define BUFFER_SIZE		(MAX_LENGTH + MAX_OFFSET)
+
+#define NEON_BLOCK_SIZE		0x8000		// see CChecksumCalculator::SumWords()
+
+#define RANDOM_TESTS		2000
+#define MAX_FAILURES_SHOWN	20
+
+enum TPattern
+{
+	PatternRandom,
+	PatternOnes,		// maximum number of carries
+	PatternZero,
+	PatternUnknown
+};
+
+static const char FromKernel[] = "kernel";
+
+CKernel::CKernel (void)
+:	m_pMemory (CMemorySystem::Get ()),
+	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer),
+	m_pBuffer (0),
+	m_nTests (0),
+	m_nFailures (0),
+	m_nRandomSeed (0x12345678)
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+	delete [] m_pBuffer;
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Serial.Initialize (115200);
+	}
+
+	if (bOK)
+	{
+		CDevice *pTarget = m_DeviceNameService.GetDevice (m_Options.GetLogDevice (), FALSE);
+		if (pTarget == 0)
+		{
+			pTarget = &m_Screen;
+		}
+
+		bOK = m_Logger.Initialize (pTarget);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
+
+#if defined (__aarch64__)
+	m_Logger.Write (FromKernel, LogNotice, "Testing 64-bit additions with carry");
+#elif defined (__ARM_NEON)
+	m_Logger.Write (FromKernel, LogNotice, "Testing NEON pairwise additions");
+#else
+	m_Logger.Write (FromKernel, LogNotice, "Testing portable 32-bit additions");
+#endif
+
+	m_pBuffer = new u8[BUFFER_SIZE];
+	if (m_pBuffer == 0)
+	{
+		m_Logger.Write (FromKernel, LogPanic, "Cannot allocate buffer");
+	}
+
+	TestVectors ();
+	TestLengths ();
+	TestRandom ();
+	TestPseudoHeader ();
+
+	m_Logger.Write (FromKernel, m_nFailures == 0 ? LogNotice : LogError,
+			"%u tests, %u failures", m_nTests, m_nFailures);
+
+	return ShutdownHalt;
+}
+
+void CKernel::TestVectors (void)
+{
+	// example from RFC 1071, section 3
+	static const u8 RFC1071[] = {0x00, 0x01, 0xF2, 0x03, 0xF4, 0xF5, 0xF6, 0xF7};
+	for (unsigned nOffset = 0; nOffset < 2; nOffset++)
+	{
+		memcpy (m_pBuffer + nOffset, RFC1071, sizeof RFC1071);
+
+		u16 nChecksum = CChecksumCalculator::SimpleCalculate (m_pBuffer + nOffset,
+								      sizeof RFC1071);
+		Check (le2be16 (nChecksum) == (u16) ~0xDDF2, "RFC 1071 example",
+		       sizeof RFC1071, nOffset);
+	}
+}
+
+// all short lengths and lengths around the block boundaries of the optimized code paths
+void CKernel::TestLengths (void)
+{
+	for (unsigned nPattern = 0; nPattern < PatternUnknown; nPattern++)
+	{
+		for (unsigned nOffset = 0; nOffset < MAX_OFFSET; nOffset++)
+		{
+			for (unsigned nLength = 1; nLength <= MAX_SHORT_LENGTH; nLength++)
+			{
+				CheckSimple (nLength, nOffset, nPattern);
+			}
+		}
+
+		for (unsigned nBlocks = 1; nBlocks <= 3; nBlocks++)
+		{
+			for (unsigned nOffset = 0; nOffset < 4; nOffset++)
+			{
+				for (unsigned nLength = nBlocks * NEON_BLOCK_SIZE - 4;
+				     nLength <= nBlocks * NEON_BLOCK_SIZE + 36; nLength++)
+				{
+					CheckSimple (nLength, nOffset, nPattern);
+				}
+			}
+		}
+
+		for (unsigned nOffset = 0; nOffset < 2; nOffset++)
+		{
+			CheckSimple (MAX_LENGTH, nOffset, nPattern);
+		}
+	}
+}
+
+void CKernel::TestRandom (void)
+{
+	for (unsigned i = 0; i < RANDOM_TESTS; i++)
+	{
+		// every second test with a length above a NEON block
+		unsigned nLength =   i & 1
+				   ? NEON_BLOCK_SIZE + 1 + Random () % (MAX_LENGTH - NEON_BLOCK_SIZE)
+				   : 1 + Random () % NEON_BLOCK_SIZE;
+
+		CheckSimple (nLength, Random () % MAX_OFFSET, i % 8 == 7 ? PatternOnes : PatternRandom);
+	}
+}
+
+void CKernel::TestPseudoHeader (void)
+{
+	static const u8 Source[] = {192, 168, 0, 1};
+	static const u8 Dest[] = {10, 0, 2, 15};
+	CIPAddress SourceIP (Source);
+	CIPAddress DestIP (Dest);
+
+	CChecksumCalculator Calculator (SourceIP, DestIP, IPPROTO_TCP);
+
+	for (unsigned i = 0; i < RANDOM_TESTS / 10; i++)
+	{
+		unsigned nLength = 1 + Random () % MAX_LENGTH;
+		unsigned nOffset = Random () % MAX_OFFSET;
+
+		u8 *pData = m_pBuffer + nOffset;
+		Fill (pData, nLength, PatternRandom);
+
+		u32 nSum =   (Source[0] << 8 | Source[1]) + (Source[2] << 8 | Source[3])
+			   + (Dest[0] << 8 | Dest[1]) + (Dest[2] << 8 | Dest[3])
+			   + IPPROTO_TCP + nLength;
+
+		Check (   le2be16 (Calculator.Calculate (pData, nLength))
+		       == Reference (pData, nLength, nSum), "Calculate", nLength, nOffset);
+	}
+}
+
+void CKernel::CheckSimple (unsigned nLength, unsigned nOffset, unsigned nPattern)
+{
+	assert (nLength + nOffset <= BUFFER_SIZE);
+	u8 *pData = m_pBuffer + nOffset;
+	Fill (pData, nLength, nPattern);
+
+	Check (   le2be16 (CChecksumCalculator::SimpleCalculate (pData, nLength))
+	       == Reference (pData, nLength), "SimpleCalculate", nLength, nOffset);
+}
+
+void CKernel::Check (boolean bOK, const char *pTest, unsigned nLength, unsigned nOffset)
+{
+	m_nTests++;
+
+	if (   !bOK
+	    && ++m_nFailures <= MAX_FAILURES_SHOWN)
+	{
+		m_Logger.Write (FromKernel, LogError, "%s failed (length %u, offset %u)",
+				pTest, nLength, nOffset);
+	}
+}
+
+void CKernel::Fill (u8 *pBuffer, unsigned nLength, unsigned nPattern)
+{
+	for (unsigned i = 0; i < nLength; i++)
+	{
+		switch (nPattern)
+		{
+		case PatternRandom:	pBuffer[i] = Random ();		break;
+		case PatternOnes:	pBuffer[i] = 0xFF;		break;
+		default:		pBuffer[i] = 0;			break;
+		}
+	}
+}
+
+// straightforward implementation of RFC 1071, returns checksum in host byte order
+u16 CKernel::Reference (const u8 *pBuffer, unsigned nLength, u32 nSum)
+{
+	for (unsigned i = 0; i < nLength; i += 2)
+	{
+		nSum += (u32) pBuffer[i] << 8;
+		if (i+1 < nLength)
+		{
+			nSum += pBuffer[i+1];
+		}
+
+		nSum = (nSum & 0xFFFF) + (nSum >> 16);
+	}
+
+	return ~nSum & 0xFFFF;
+}
+
+unsigned CKernel::Random (void)
+{
+	// xorshift32
+	m_nRandomSeed ^= m_nRandomSeed << 13;
+	m_nRandomSeed ^= m_nRandomSeed >> 17;
+	m_nRandomSeed ^= m_nRandomSeed << 5;
+
+	return m_nRandomSeed;
+}
@@ -0,0 +1,247 @@
+//
+// checksumtest.cpp
+//
+// Checks the Internet checksum calculation on a Linux host
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/net/checksumcalculator.h>
+#include <circle/net/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAX_LENGTH	2100
+#define MAX_OFFSET	16
+#define LARGE_LENGTH	100000		// more than one NEON block
+
+static u8 s_Buffer[LARGE_LENGTH + MAX_OFFSET];
+
+static unsigned s_nSeed = 1;
+static unsigned long s_nTests = 0;
+static unsigned long s_nFailures = 0;
+
+extern "C" void assertion_failed (const char *pExpr, const char *pFile, unsigned nLine)
+{
+	fprintf (stderr, "Assertion failed: %s (%s:%u)\n", pExpr, pFile, nLine);
+
+	abort ();
+}
+
+static unsigned Random (void)
+{
+	// xorshift32
+	s_nSeed ^= s_nSeed << 13;
+	s_nSeed ^= s_nSeed >> 17;
+	s_nSeed ^= s_nSeed << 5;
+
+	return s_nSeed;
+}
+
+static void Check (boolean bOK, const char *pTest, unsigned nLength, unsigned nOffset)
+{
+	s_nTests++;
+
+	if (   !bOK
+	    && ++s_nFailures <= 20)
+	{
+		fprintf (stderr, "%s failed (length %u, offset %u)\n", pTest, nLength, nOffset);
+	}
+}
+
+// straightforward implementation of RFC 1071, returns checksum in host byte order
+static u16 Reference (const u8 *pBuffer, unsigned nLength, u32 nSum = 0)
+{
+	for (unsigned i = 0; i < nLength; i += 2)
+	{
+		nSum += (u32) pBuffer[i] << 8;
+		if (i+1 < nLength)
+		{
+			nSum += pBuffer[i+1];
+		}
+
+		nSum = (nSum & 0xFFFF) + (nSum >> 16);
+	}
+
+	return ~nSum & 0xFFFF;
+}
+
+// the checksum is returned by Circle in the byte order as stored in memory
+static u16 ToHost (u16 nChecksum)
+{
+	return nChecksum >> 8 | (nChecksum & 0xFF) << 8;
+}
+
+static void Fill (u8 *pBuffer, unsigned nLength, unsigned nPattern)
+{
+	for (unsigned i = 0; i < nLength; i++)
+	{
+		switch (nPattern)
+		{
+		case 0:	pBuffer[i] = Random ();		break;
+		case 1:	pBuffer[i] = 0xFF;		break;	// maximum number of carries
+		default: pBuffer[i] = 0;		break;
+		}
+	}
+}
+
+static void TestVectors (void)
+{
+	// example from RFC 1071, section 3
+	static const u8 RFC1071[] = {0x00, 0x01, 0xF2, 0x03, 0xF4, 0xF5, 0xF6, 0xF7};
+	Check (   ToHost (CChecksumCalculator::SimpleCalculate (RFC1071, sizeof RFC1071))
+	       == (u16) ~0xDDF2, "RFC 1071 example", sizeof RFC1071, 0);
+
+	// IPv4 header with checksum 0xB861
+	static const u8 IPHeader[] = {0x45, 0x00, 0x00, 0x73, 0x00, 0x00, 0x40, 0x00,
+				      0x40, 0x11, 0xB8, 0x61, 0xC0, 0xA8, 0x00, 0x01,
+				      0xC0, 0xA8, 0x00, 0xC7};
+	Check (   CChecksumCalculator::SimpleCalculate (IPHeader, sizeof IPHeader)
+	       == CHECKSUM_OK, "IP header verification", sizeof IPHeader, 0);
+
+	u8 Header[sizeof IPHeader];
+	for (unsigned i = 0; i < sizeof Header; i++)
+	{
+		Header[i] = i == 10 || i == 11 ? 0 : IPHeader[i];
+	}
+	Check (   ToHost (CChecksumCalculator::SimpleCalculate (Header, sizeof Header))
+	       == 0xB861, "IP header calculation", sizeof Header, 0);
+}
+
+static void TestSimple (void)
+{
+	for (unsigned nPattern = 0; nPattern <= 2; nPattern++)
+	{
+		for (unsigned nOffset = 0; nOffset < MAX_OFFSET; nOffset++)
+		{
+			for (unsigned nLength = 1; nLength <= MAX_LENGTH; nLength++)
+			{
+				u8 *pData = s_Buffer + nOffset;
+				Fill (pData, nLength, nPattern);
+
+				Check (   ToHost (CChecksumCalculator::SimpleCalculate (pData, nLength))
+				       == Reference (pData, nLength), "SimpleCalculate", nLength, nOffset);
+			}
+		}
+
+		for (unsigned nOffset = 0; nOffset < 2; nOffset++)
+		{
+			u8 *pData = s_Buffer + nOffset;
+			Fill (pData, LARGE_LENGTH, nPattern);
+
+			Check (   ToHost (CChecksumCalculator::SimpleCalculate (pData, LARGE_LENGTH))
+			       == Reference (pData, LARGE_LENGTH), "SimpleCalculate (large)",
+			       LARGE_LENGTH, nOffset);
+		}
+	}
+}
+
+static void TestPseudoHeader (void)
+{
+	static const u8 Source[] = {192, 168, 0, 1};
+	static const u8 Dest[] = {10, 0, 2, 15};
+	CIPAddress SourceIP (Source);
+	CIPAddress DestIP (Dest);
+
+	CChecksumCalculator Calculator (SourceIP, DestIP, IPPROTO_TCP);
+
+	for (unsigned nOffset = 0; nOffset < 4; nOffset++)
+	{
+		for (unsigned nLength = 1; nLength <= MAX_LENGTH; nLength += 7)
+		{
+			u8 *pData = s_Buffer + nOffset;
+			Fill (pData, nLength, 0);
+
+			u32 nSum =   (Source[0] << 8 | Source[1]) + (Source[2] << 8 | Source[3])
+				   + (Dest[0] << 8 | Dest[1]) + (Dest[2] << 8 | Dest[3])
+				   + IPPROTO_TCP + nLength;
+
+			Check (   ToHost (Calculator.Calculate (pData, nLength))
+			       == Reference (pData, nLength, nSum), "Calculate", nLength, nOffset);
+
+			// checksum offload: the device completes the sum of the pseudo header
+			if (nLength >= 8)
+			{
+				u16 *pChecksum = (u16 *) (pData + 6);		// UDP
+				*pChecksum = 0;
+				u16 nChecksum = Calculator.Calculate (pData, nLength);
+
+				*pChecksum = Calculator.CalculatePseudoHeader (nLength);
+				Check (   CChecksumCalculator::SimpleCalculate (pData, nLength)
+				       == nChecksum, "CalculatePseudoHeader", nLength, nOffset);
+			}
+		}
+	}
+}
+
+static void TestUpdate (void)
+{
+	for (unsigned i = 0; i < 10000; i++)
+	{
+		// packet with the checksum at offset 2 (e.g. ICMP)
+		unsigned nLength = 8 + Random () % 1000;
+		u8 *pPacket = s_Buffer;
+		Fill (pPacket, nLength, i % 3 == 1 ? 1 : 0);
+
+		u16 *pChecksum = (u16 *) (pPacket + 2);
+		*pChecksum = 0;
+		*pChecksum = CChecksumCalculator::SimpleCalculate (pPacket, nLength);
+
+		// modify a 16-bit word
+		unsigned nWord = 2 + Random () % (nLength / 2 - 2);
+		u16 *pWord = (u16 *) pPacket + nWord;
+		u16 nOldWord = *pWord;
+		*pWord = Random ();
+		*pChecksum = CChecksumCalculator::Update (*pChecksum, nOldWord, *pWord);
+
+		Check (   CChecksumCalculator::SimpleCalculate (pPacket, nLength) == CHECKSUM_OK,
+		       "Update (word)", nLength, nWord * 2);
+
+		// modify a 32-bit field (e.g. an IP address)
+		unsigned nField = 4 + 2 * (Random () % ((nLength - 8) / 2 + 1));
+		u8 OldField[4];
+		for (unsigned j = 0; j < 4; j++)
+		{
+			OldField[j] = pPacket[nField + j];
+			pPacket[nField + j] = Random ();
+		}
+		*pChecksum = CChecksumCalculator::Update (*pChecksum, OldField, pPacket + nField, 4);
+
+		Check (   CChecksumCalculator::SimpleCalculate (pPacket, nLength) == CHECKSUM_OK,
+		       "Update (field)", nLength, nField);
+	}
+}
+
+int main (int argc, char **argv)
+{
+	if (argc > 1)
+	{
+		s_nSeed = strtoul (argv[1], 0, 0);
+		if (s_nSeed == 0)
+		{
+			s_nSeed = 1;
+		}
+	}
+
+	TestVectors ();
+	TestSimple ();
+	TestPseudoHeader ();
+	TestUpdate ();
+
+	printf ("%lu tests, %lu failures\n", s_nTests, s_nFailures);
+
+	return s_nFailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
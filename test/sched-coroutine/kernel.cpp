@@ -0,0 +1,170 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <circle/sched/coroutine.h>
+#include <circle/sched/synchronizationevent.h>
+#include <circle/memory.h>
+#include <assert.h>
+
+#define FLOWS			2000
+#define REQUESTS		10		// per flow
+#define SLEEP_US		1000		// after each request
+
+static const char FromKernel[] = "kernel";
+
+class CFlowCoroutine : public CCoroutine	// simulates an I/O flow
+{
+public:
+	CFlowCoroutine (unsigned nNumber, volatile unsigned *pCompleted)
+	:	m_nNumber (nNumber),
+		m_pCompleted (pCompleted),
+		m_nRequest (0)
+	{
+	}
+
+	void Run (void)
+	{
+		CO_BEGIN;
+
+		for (m_nRequest = 0; m_nRequest < REQUESTS; m_nRequest++)
+		{
+			// start a request, which completes in interrupt context (e.g. DMA)
+			m_Completion.Clear ();
+			CTimer::Get ()->StartKernelTimer (1 + m_nNumber % 5,
+							  CompletionHandler, &m_Completion);
+
+			CO_AWAIT (&m_Completion);
+
+			(*m_pCompleted)++;	// all coroutines run on the same task
+
+			CO_SLEEP (SLEEP_US);
+		}
+
+		CO_END;
+	}
+
+private:
+	static void CompletionHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext)
+	{
+		CSynchronizationEvent *pEvent = (CSynchronizationEvent *) pParam;
+		assert (pEvent != 0);
+
+		pEvent->Set ();		// wakes the coroutine
+	}
+
+private:
+	unsigned m_nNumber;
+	volatile unsigned *m_pCompleted;
+
+	unsigned m_nRequest;
+	CSynchronizationEvent m_Completion;
+};
+
+CKernel::CKernel (void)
+:	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer)
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Serial.Initialize (115200);
+	}
+
+	if (bOK)
+	{
+		CDevice *pTarget = m_DeviceNameService.GetDevice (m_Options.GetLogDevice (), FALSE);
+		if (pTarget == 0)
+		{
+			pTarget = &m_Screen;
+		}
+
+		bOK = m_Logger.Initialize (pTarget);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
+
+	size_t nFreeBefore = CMemorySystem::Get ()->GetHeapFreeSpace (HEAP_ANY);
+
+	CCoroutineExecutor *pExecutor = new CCoroutineExecutor;
+	assert (pExecutor != 0);
+
+	volatile unsigned nCompleted = 0;
+	for (unsigned i = 0; i < FLOWS; i++)
+	{
+		CCoroutine *pCoroutine = new CFlowCoroutine (i, &nCompleted);
+		assert (pCoroutine != 0);
+
+		pExecutor->AddCoroutine (pCoroutine);
+	}
+
+	size_t nFreeAfter = CMemorySystem::Get ()->GetHeapFreeSpace (HEAP_ANY);
+
+	m_Logger.Write (FromKernel, LogNotice,
+			"%u coroutines and one task use %lu KByte (%u tasks: %u KByte stacks)",
+			FLOWS, (unsigned long) (nFreeBefore - nFreeAfter) / 1024,
+			FLOWS, FLOWS * TASK_STACK_SIZE / 1024);
+
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+
+	while (pExecutor->GetCoroutineCount () > 0)
+	{
+		m_Scheduler.MsSleep (10);
+	}
+
+	unsigned nMs = (CTimer::GetClockTicks () - nStartTicks) / (CLOCKHZ / 1000);
+
+	m_Logger.Write (FromKernel, nCompleted == FLOWS * REQUESTS ? LogNotice : LogError,
+			"%u of %u requests completed in %u ms", nCompleted, FLOWS * REQUESTS, nMs);
+
+	m_Logger.Write (FromKernel, LogNotice, "Test finished");
+
+	return ShutdownHalt;
+}
@@ -0,0 +1,230 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <circle/sched/task.h>
+#include <assert.h>
+
+#define LOAD_TASKS		8
+#define LOAD_BUSY_US		500		// busy time of a load task before Yield()
+
+#define SAMPLES			500
+#define TIMER_PERIOD_MS		10
+
+static const char FromKernel[] = "kernel";
+
+struct TLatency			// in microseconds
+{
+	unsigned	nMin;
+	unsigned	nMax;
+	u64		nSum;
+};
+
+class CLoadTask : public CTask
+{
+public:
+	CLoadTask (volatile boolean *pStop)
+	:	m_pStop (pStop)
+	{
+	}
+
+	void Run (void)
+	{
+		while (!*m_pStop)
+		{
+			unsigned nStartTicks = CTimer::GetClockTicks ();
+			while (CTimer::GetClockTicks () - nStartTicks < LOAD_BUSY_US)
+			{
+				// simulate bulk work
+			}
+
+			CScheduler::Get ()->Yield ();
+		}
+	}
+
+private:
+	volatile boolean *m_pStop;
+};
+
+class CLatencyTask : public CTask
+{
+public:
+	CLatencyTask (CSynchronizationEvent *pEvent, volatile unsigned *pSetTicks,
+		      TLatency *pResult, unsigned nPriority)
+	:	m_pEvent (pEvent),
+		m_pSetTicks (pSetTicks),
+		m_pResult (pResult)
+	{
+		m_pResult->nMin = (unsigned) -1;
+		m_pResult->nMax = 0;
+		m_pResult->nSum = 0;
+
+		SetPriority (nPriority);
+	}
+
+	void Run (void)
+	{
+		for (unsigned i = 0; i < SAMPLES; i++)
+		{
+			m_pEvent->Wait ();
+
+			unsigned nLatency = CTimer::GetClockTicks () - *m_pSetTicks;
+
+			m_pEvent->Clear ();
+
+			if (nLatency < m_pResult->nMin)
+			{
+				m_pResult->nMin = nLatency;
+			}
+
+			if (nLatency > m_pResult->nMax)
+			{
+				m_pResult->nMax = nLatency;
+			}
+
+			m_pResult->nSum += nLatency;
+		}
+	}
+
+private:
+	CSynchronizationEvent *m_pEvent;
+	volatile unsigned *m_pSetTicks;
+
+	TLatency *m_pResult;		// the task object is gone, when the result is evaluated
+};
+
+CKernel::CKernel (void)
+:	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer),
+	m_nSetTicks (0),
+	m_bTimerActive (FALSE)
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Serial.Initialize (115200);
+	}
+
+	if (bOK)
+	{
+		CDevice *pTarget = m_DeviceNameService.GetDevice (m_Options.GetLogDevice (), FALSE);
+		if (pTarget == 0)
+		{
+			pTarget = &m_Screen;
+		}
+
+		bOK = m_Logger.Initialize (pTarget);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
+
+	volatile boolean bStop = FALSE;
+	CTask *pLoadTask[LOAD_TASKS];
+	for (unsigned i = 0; i < LOAD_TASKS; i++)
+	{
+		pLoadTask[i] = new CLoadTask (&bStop);
+		assert (pLoadTask[i] != 0);
+	}
+
+	m_Logger.Write (FromKernel, LogNotice, "%u load tasks, %u us busy before Yield()",
+			LOAD_TASKS, LOAD_BUSY_US);
+
+	Measure (TASK_PRIORITY_DEFAULT);
+	Measure (TASK_PRIORITY_HIGHEST);
+
+	bStop = TRUE;
+	for (unsigned i = 0; i < LOAD_TASKS; i++)
+	{
+		pLoadTask[i]->WaitForTermination ();
+	}
+
+	m_Logger.Write (FromKernel, LogNotice, "Test finished");
+
+	return ShutdownHalt;
+}
+
+void CKernel::Measure (unsigned nPriority)
+{
+	m_Event.Clear ();
+
+	TLatency Result;
+	CTask *pTask = new CLatencyTask (&m_Event, &m_nSetTicks, &Result, nPriority);
+	assert (pTask != 0);
+
+	m_bTimerActive = TRUE;
+	m_Timer.StartKernelTimer (MSEC2HZ (TIMER_PERIOD_MS), TimerHandler, this);
+
+	pTask->WaitForTermination ();
+
+	m_bTimerActive = FALSE;
+
+	m_Logger.Write (FromKernel, LogNotice,
+			"Priority %2u: latency min %u us, avg %u us, max %u us (%u samples)",
+			nPriority, Result.nMin, (unsigned) (Result.nSum / SAMPLES), Result.nMax,
+			SAMPLES);
+
+	m_Scheduler.MsSleep (2 * TIMER_PERIOD_MS);	// let the timer expire
+}
+
+void CKernel::TimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext)
+{
+	CKernel *pThis = (CKernel *) pParam;
+	assert (pThis != 0);
+
+	if (!pThis->m_bTimerActive)
+	{
+		return;
+	}
+
+	pThis->m_nSetTicks = CTimer::GetClockTicks ();
+	pThis->m_Event.Set ();
+
+	pThis->m_Timer.StartKernelTimer (MSEC2HZ (TIMER_PERIOD_MS), TimerHandler, pThis);
+}
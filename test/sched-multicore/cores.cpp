@@ -0,0 +1,42 @@
+//
+// cores.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "cores.h"
+#include <circle/sched/scheduler.h>
+#include <assert.h>
+
+#ifdef ARM_ALLOW_MULTI_CORE
+
+CSchedulerCores::CSchedulerCores (CMemorySystem *pMemorySystem)
+:	CMultiCoreSupport (pMemorySystem)
+{
+}
+
+CSchedulerCores::~CSchedulerCores (void)
+{
+}
+
+void CSchedulerCores::Run (unsigned nCore)
+{
+	assert (nCore > 0);		// core 0 continues in CKernel::Run()
+
+	CScheduler::Get ()->RunOnThisCore ();
+}
+
+#endif
@@ -0,0 +1,273 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <circle/sched/task.h>
+#include <circle/sched/mutex.h>
+#include <circle/memory.h>
+#include <circle/atomic.h>
+#include <assert.h>
+
+#define TASKS			8
+#define NUMBERS_PER_TASK	40000
+#define NUMBERS_PER_CHUNK	1000		// Yield() after each chunk
+
+#define MUTEX_ROUNDS		10000
+
+static const char FromKernel[] = "kernel";
+
+static unsigned ThisCore (void)
+{
+#ifdef ARM_ALLOW_MULTI_CORE
+	return CMultiCoreSupport::ThisCore ();
+#else
+	return 0;
+#endif
+}
+
+class CPrimeTask : public CTask		// counts the prime numbers in a range
+{
+public:
+	CPrimeTask (unsigned nFrom, unsigned nTo, u32 nAffinity, volatile int *pChunks)
+	:	m_nFrom (nFrom),
+		m_nTo (nTo),
+		m_pChunks (pChunks),
+		m_nPrimes (0)
+	{
+		SetAffinity (nAffinity);
+	}
+
+	void Run (void)
+	{
+		for (unsigned n = m_nFrom; n < m_nTo; n++)
+		{
+			if (IsPrime (n))
+			{
+				m_nPrimes++;
+			}
+
+			if ((n - m_nFrom) % NUMBERS_PER_CHUNK == NUMBERS_PER_CHUNK-1)
+			{
+				AtomicIncrement (&m_pChunks[ThisCore ()]);
+
+				CScheduler::Get ()->Yield ();
+			}
+		}
+	}
+
+private:
+	static boolean IsPrime (unsigned n)
+	{
+		if (n < 2)
+		{
+			return FALSE;
+		}
+
+		for (unsigned i = 2; i * i <= n; i++)
+		{
+			if (n % i == 0)
+			{
+				return FALSE;
+			}
+		}
+
+		return TRUE;
+	}
+
+private:
+	unsigned m_nFrom;
+	unsigned m_nTo;
+	volatile int *m_pChunks;
+	unsigned m_nPrimes;
+};
+
+class CCounterTask : public CTask	// increments a shared counter, protected by a mutex
+{
+public:
+	CCounterTask (CMutex *pMutex, volatile unsigned *pCounter)
+	:	m_pMutex (pMutex),
+		m_pCounter (pCounter)
+	{
+		SetAffinity (TASK_AFFINITY_ALL);
+	}
+
+	void Run (void)
+	{
+		for (unsigned i = 0; i < MUTEX_ROUNDS; i++)
+		{
+			m_pMutex->Acquire ();
+
+			unsigned nValue = *m_pCounter;
+			if (i % 16 == 0)
+			{
+				CScheduler::Get ()->Yield ();	// let others run into the mutex
+			}
+			*m_pCounter = nValue + 1;
+
+			m_pMutex->Release ();
+		}
+	}
+
+private:
+	CMutex *m_pMutex;
+	volatile unsigned *m_pCounter;
+};
+
+CKernel::CKernel (void)
+:	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer)
+#ifdef ARM_ALLOW_MULTI_CORE
+	, m_Cores (CMemorySystem::Get ())
+#endif
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Serial.Initialize (115200);
+	}
+
+	if (bOK)
+	{
+		CDevice *pTarget = m_DeviceNameService.GetDevice (m_Options.GetLogDevice (), FALSE);
+		if (pTarget == 0)
+		{
+			pTarget = &m_Screen;
+		}
+
+		bOK = m_Logger.Initialize (pTarget);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	if (bOK)
+	{
+		bOK = m_Cores.Initialize ();	// secondary cores start running tasks
+	}
+#endif
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
+
+	unsigned nSingleMs = Compute (TASK_AFFINITY_CORE (0));
+	unsigned nAllMs = Compute (TASK_AFFINITY_ALL);
+
+	m_Logger.Write (FromKernel, LogNotice, "Speed-up with all cores: %u.%02u",
+			nSingleMs / nAllMs, nSingleMs * 100 / nAllMs % 100);
+
+	if (CheckMutex ())
+	{
+		m_Logger.Write (FromKernel, LogNotice, "Test finished");
+	}
+
+	return ShutdownHalt;
+}
+
+unsigned CKernel::Compute (u32 nAffinity)
+{
+	for (unsigned i = 0; i < CORES; i++)
+	{
+		m_nChunks[i] = 0;
+	}
+
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+
+	CTask *pTask[TASKS];
+	for (unsigned i = 0; i < TASKS; i++)
+	{
+		pTask[i] = new CPrimeTask (i * NUMBERS_PER_TASK, (i+1) * NUMBERS_PER_TASK,
+					   nAffinity, m_nChunks);
+		assert (pTask[i] != 0);
+	}
+
+	for (unsigned i = 0; i < TASKS; i++)
+	{
+		pTask[i]->WaitForTermination ();
+	}
+
+	unsigned nMs = (CTimer::GetClockTicks () - nStartTicks) / (CLOCKHZ / 1000);
+	if (nMs == 0)
+	{
+		nMs = 1;
+	}
+
+	m_Logger.Write (FromKernel, LogNotice,
+			"Affinity 0x%X: %u ms, chunks per core %d %d %d %d",
+			nAffinity, nMs, m_nChunks[0], m_nChunks[1], m_nChunks[2], m_nChunks[3]);
+
+	return nMs;
+}
+
+boolean CKernel::CheckMutex (void)
+{
+	CMutex Mutex;
+	volatile unsigned nCounter = 0;
+
+	CTask *pTask[TASKS];
+	for (unsigned i = 0; i < TASKS; i++)
+	{
+		pTask[i] = new CCounterTask (&Mutex, &nCounter);
+		assert (pTask[i] != 0);
+	}
+
+	for (unsigned i = 0; i < TASKS; i++)
+	{
+		pTask[i]->WaitForTermination ();
+	}
+
+	if (nCounter != TASKS * MUTEX_ROUNDS)
+	{
+		m_Logger.Write (FromKernel, LogError, "Mutex: counter is %u (expected %u)",
+				nCounter, TASKS * MUTEX_ROUNDS);
+
+		return FALSE;
+	}
+
+	m_Logger.Write (FromKernel, LogNotice, "Mutex: counter is correct");
+
+	return TRUE;
+}
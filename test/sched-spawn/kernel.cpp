@@ -0,0 +1,178 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <circle/sched/task.h>
+#include <circle/string.h>
+#include <assert.h>
+
+#define SPAWN_STACK_SIZE	0x4000
+#define LOOKUPS			1000
+
+static const char FromKernel[] = "kernel";
+
+class CShortTask : public CTask		// terminates immediately
+{
+public:
+	CShortTask (unsigned nNumber, volatile unsigned *pLiveTasks)
+	:	CTask (SPAWN_STACK_SIZE),
+		m_pLiveTasks (pLiveTasks)
+	{
+		CString Name;
+		Name.Format ("short%u", nNumber);
+		SetName (Name);
+
+		(*m_pLiveTasks)++;
+	}
+
+	~CShortTask (void)
+	{
+		(*m_pLiveTasks)--;
+	}
+
+	void Run (void)
+	{
+	}
+
+private:
+	volatile unsigned *m_pLiveTasks;
+};
+
+CKernel::CKernel (void)
+:	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer),
+	m_nLiveTasks (0)
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Serial.Initialize (115200);
+	}
+
+	if (bOK)
+	{
+		CDevice *pTarget = m_DeviceNameService.GetDevice (m_Options.GetLogDevice (), FALSE);
+		if (pTarget == 0)
+		{
+			pTarget = &m_Screen;
+		}
+
+		bOK = m_Logger.Initialize (pTarget);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
+
+	Spawn (100);
+	Spawn (1000);
+	Spawn (4000);
+
+	m_Logger.Write (FromKernel, LogNotice, "Test finished");
+
+	return ShutdownHalt;
+}
+
+void CKernel::Spawn (unsigned nTasks)
+{
+	assert (nTasks > 0);
+
+	// the new tasks do not run before we call Yield()
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+
+	for (unsigned i = 0; i < nTasks; i++)
+	{
+		CTask *pTask = new CShortTask (i, &m_nLiveTasks);
+		if (pTask == 0)
+		{
+			m_Logger.Write (FromKernel, LogPanic, "Cannot create task %u", i);
+		}
+	}
+
+	unsigned nCreateTicks = CTimer::GetClockTicks () - nStartTicks;
+
+	// look up names, which are spread over the table
+	CString *pNames = new CString[LOOKUPS];
+	assert (pNames != 0);
+	for (unsigned i = 0; i < LOOKUPS; i++)
+	{
+		pNames[i].Format ("short%u", i * 7919 % nTasks);
+	}
+
+	nStartTicks = CTimer::GetClockTicks ();
+
+	for (unsigned i = 0; i < LOOKUPS; i++)
+	{
+		if (m_Scheduler.GetTask (pNames[i]) == 0)
+		{
+			m_Logger.Write (FromKernel, LogPanic, "Task %s not found",
+					(const char *) pNames[i]);
+		}
+	}
+
+	unsigned nLookupTicks = CTimer::GetClockTicks () - nStartTicks;
+
+	delete [] pNames;
+
+	// the tasks run and terminate, and are deleted in the next Yield()
+	nStartTicks = CTimer::GetClockTicks ();
+
+	while (m_nLiveTasks > 0)
+	{
+		m_Scheduler.Yield ();
+	}
+
+	unsigned nReapTicks = CTimer::GetClockTicks () - nStartTicks;
+
+	m_Logger.Write (FromKernel, LogNotice,
+			"%4u tasks: create %u ns, lookup %u ns, run and reap %u ns (per task)",
+			nTasks,
+			nCreateTicks * (1000000000U / CLOCKHZ) / nTasks,
+			nLookupTicks * (1000000000U / CLOCKHZ) / LOOKUPS,
+			nReapTicks * (1000000000U / CLOCKHZ) / nTasks);
+}
@@ -0,0 +1,197 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <circle/sched/task.h>
+#include <circle/memory.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#define FRAME_BYTES		64		// local array in each recursion
+#define REUSE_TASKS		1000
+
+#define OVERFLOW_STACK_SIZE	0x1000
+
+static const char FromKernel[] = "kernel";
+
+class CRecursionTask : public CTask	// uses its stack by recursion
+{
+public:
+	CRecursionTask (unsigned nDepth, unsigned *pHighWater,
+			unsigned nStackSize = TASK_STACK_SIZE)
+	:	CTask (nStackSize),
+		m_nDepth (nDepth),
+		m_pHighWater (pHighWater)
+	{
+	}
+
+	void Run (void)
+	{
+		Recurse (m_nDepth);
+
+		// the task object is deleted after termination, so save the result before
+		if (m_pHighWater != 0)
+		{
+			*m_pHighWater = GetStackHighWater ();
+		}
+	}
+
+private:
+	unsigned Recurse (unsigned nDepth)
+	{
+		volatile u8 Frame[FRAME_BYTES];
+		memset ((void *) Frame, nDepth, sizeof Frame);
+
+		if (nDepth == 0)
+		{
+			CScheduler::Get ()->Yield ();	// stack overflow is detected here
+
+			return Frame[0];
+		}
+
+		return Recurse (nDepth-1) + Frame[FRAME_BYTES-1];
+	}
+
+private:
+	unsigned m_nDepth;
+	unsigned *m_pHighWater;
+};
+
+CKernel::CKernel (void)
+:	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer)
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Serial.Initialize (115200);
+	}
+
+	if (bOK)
+	{
+		CDevice *pTarget = m_DeviceNameService.GetDevice (m_Options.GetLogDevice (), FALSE);
+		if (pTarget == 0)
+		{
+			pTarget = &m_Screen;
+		}
+
+		bOK = m_Logger.Initialize (pTarget);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
+
+	for (unsigned nDepth = 10; nDepth <= 160; nDepth *= 2)
+	{
+		m_Logger.Write (FromKernel, LogNotice, "Recursion depth %3u: %5u of %u stack bytes used",
+				nDepth, MeasureStack (nDepth), TASK_STACK_SIZE);
+	}
+
+	CheckReuse ();
+
+	Overflow ();
+
+	return ShutdownHalt;
+}
+
+unsigned CKernel::MeasureStack (unsigned nDepth)
+{
+	unsigned nHighWater = 0;
+
+	CTask *pTask = new CRecursionTask (nDepth, &nHighWater);
+	assert (pTask != 0);
+
+	pTask->WaitForTermination ();
+
+	return nHighWater;
+}
+
+void CKernel::CheckReuse (void)
+{
+	size_t nFreeBefore = 0;
+
+	for (unsigned i = 0; i < REUSE_TASKS; i++)
+	{
+		// a terminated task is deleted in the next Yield() after WaitForTermination(),
+		// so that the first two tasks may need a new stack, which is reused afterwards
+		if (i == 2)
+		{
+			nFreeBefore = CMemorySystem::Get ()->GetHeapFreeSpace (HEAP_ANY);
+		}
+
+		CTask *pTask = new CRecursionTask (10, 0);
+		assert (pTask != 0);
+
+		pTask->WaitForTermination ();
+	}
+
+	m_Scheduler.Yield ();
+
+	size_t nFreeAfter = CMemorySystem::Get ()->GetHeapFreeSpace (HEAP_ANY);
+
+	m_Logger.Write (FromKernel, nFreeAfter == nFreeBefore ? LogNotice : LogError,
+			"%u tasks: heap free space %lu before, %lu after",
+			REUSE_TASKS, (unsigned long) nFreeBefore, (unsigned long) nFreeAfter);
+}
+
+void CKernel::Overflow (void)
+{
+	m_Logger.Write (FromKernel, LogNotice, "Overflowing a stack of %u bytes now",
+			OVERFLOW_STACK_SIZE);
+
+	m_Scheduler.MsSleep (100);		// let the message be displayed
+
+	CTask *pTask = new CRecursionTask (OVERFLOW_STACK_SIZE / FRAME_BYTES, 0,
+					   OVERFLOW_STACK_SIZE);
+	assert (pTask != 0);
+
+	pTask->WaitForTermination ();
+
+	m_Logger.Write (FromKernel, LogError, "Stack overflow has not been detected");
+}
@@ -0,0 +1,169 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <circle/sched/task.h>
+#include <assert.h>
+
+#define PERIODS			5		// statistics periods of one second
+#define TRACE_DEPTH		50		// task switch events
+#define TRACE_MS		20
+
+static const char FromKernel[] = "kernel";
+
+class CLoadTask : public CTask		// busy for nBusyUs, then sleeping for nSleepMs
+{
+public:
+	CLoadTask (const char *pName, unsigned nBusyUs, unsigned nSleepMs, volatile boolean *pStop)
+	:	m_nBusyUs (nBusyUs),
+		m_nSleepMs (nSleepMs),
+		m_pStop (pStop)
+	{
+		SetName (pName);
+	}
+
+	void Run (void)
+	{
+		while (!*m_pStop)
+		{
+			unsigned nStartTicks = CTimer::GetClockTicks ();
+			while (CTimer::GetClockTicks () - nStartTicks < m_nBusyUs)
+			{
+				// simulate work
+			}
+
+			if (m_nSleepMs > 0)
+			{
+				CScheduler::Get ()->MsSleep (m_nSleepMs);
+			}
+			else
+			{
+				CScheduler::Get ()->Yield ();
+			}
+		}
+	}
+
+private:
+	unsigned m_nBusyUs;
+	unsigned m_nSleepMs;
+	volatile boolean *m_pStop;
+};
+
+CKernel::CKernel (void)
+:	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer),
+	m_Tracer (TRACE_DEPTH, TRUE),
+	m_pTarget (0)
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Serial.Initialize (115200);
+	}
+
+	if (bOK)
+	{
+		m_pTarget = m_DeviceNameService.GetDevice (m_Options.GetLogDevice (), FALSE);
+		if (m_pTarget == 0)
+		{
+			m_pTarget = &m_Screen;
+		}
+
+		bOK = m_Logger.Initialize (m_pTarget);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
+
+	volatile boolean bStop = FALSE;
+	CTask *pTask[] =
+	{
+		new CLoadTask ("load10", 1000, 9, &bStop),	// about 10% CPU
+		new CLoadTask ("load30", 3000, 7, &bStop),	// about 30% CPU
+		new CLoadTask ("bulk1", 500, 0, &bStop),	// the rest is shared
+		new CLoadTask ("bulk2", 2000, 0, &bStop)
+	};
+
+	Monitor ();
+
+	bStop = TRUE;
+	for (unsigned i = 0; i < sizeof pTask / sizeof pTask[0]; i++)
+	{
+		assert (pTask[i] != 0);
+		pTask[i]->WaitForTermination ();
+	}
+
+	m_Logger.Write (FromKernel, LogNotice, "Test finished");
+
+	return ShutdownHalt;
+}
+
+void CKernel::Monitor (void)
+{
+	m_Scheduler.ResetStatistics ();
+
+	for (unsigned i = 1; i <= PERIODS; i++)
+	{
+		m_Scheduler.Sleep (1);
+
+		m_Logger.Write (FromKernel, LogNotice, "Period %u", i);
+
+		m_Scheduler.ListTaskStatistics (m_pTarget, TRUE);
+	}
+
+	m_Logger.Write (FromKernel, LogNotice, "Tracing task switches for %u ms", TRACE_MS);
+
+	m_Tracer.Start ();
+	m_Scheduler.EnableSwitchTracing ();
+
+	m_Scheduler.MsSleep (TRACE_MS);
+
+	m_Scheduler.EnableSwitchTracing (FALSE);
+	m_Tracer.Dump ();
+}
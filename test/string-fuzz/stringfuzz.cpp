@@ -0,0 +1,277 @@
+//
+// stringfuzz.cpp
+//
+// Checks the Circle string functions against the GNU C library on a Linux host
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+extern "C"
+{
+	size_t circle_strlen (const char *pString);
+	int circle_strcmp (const char *pString1, const char *pString2);
+	int circle_strcasecmp (const char *pString1, const char *pString2);
+	int circle_strncmp (const char *pString1, const char *pString2, size_t nMaxLen);
+	int circle_strncasecmp (const char *pString1, const char *pString2, size_t nMaxLen);
+	char *circle_strcpy (char *pDest, const char *pSrc);
+	char *circle_strcat (char *pDest, const char *pSrc);
+	char *circle_strchr (const char *pString, int chChar);
+	void *circle_memchr (const void *pBuffer, int nValue, size_t nLength);
+	char *circle_strstr (const char *pString, const char *pNeedle);
+}
+
+#define MAX_LENGTH	300
+#define AREA_PAGES	4
+
+// small alphabet to get many matches, includes characters between 'Z' and 'a'
+static const char Alphabet[] = "aAbBzZ_[`{@\x80\xE4\xC4\xFF";
+
+static unsigned s_nSeed;
+static unsigned long s_nFailures = 0;
+
+static unsigned Random (void)
+{
+	// xorshift32
+	s_nSeed ^= s_nSeed << 13;
+	s_nSeed ^= s_nSeed >> 17;
+	s_nSeed ^= s_nSeed << 5;
+
+	return s_nSeed;
+}
+
+static int Sign (int nValue)
+{
+	return nValue < 0 ? -1 : (nValue > 0 ? 1 : 0);
+}
+
+static void Fail (unsigned long nIteration, const char *pFunction, const char *pString1,
+		  const char *pString2)
+{
+	if (++s_nFailures <= 20)
+	{
+		fprintf (stderr, "Iteration %lu: %s failed (\"%s\", \"%s\")\n",
+			 nIteration, pFunction, pString1, pString2 != 0 ? pString2 : "");
+	}
+}
+
+class CArea		// memory area followed by an inaccessible guard page
+{
+public:
+	CArea (void)
+	{
+		m_nPageSize = sysconf (_SC_PAGESIZE);
+		m_nSize = AREA_PAGES * m_nPageSize;
+
+		m_pBase = (char *) mmap (0, m_nSize + m_nPageSize, PROT_READ | PROT_WRITE,
+					 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (   m_pBase == MAP_FAILED
+		    || mprotect (m_pBase + m_nSize, m_nPageSize, PROT_NONE) != 0)
+		{
+			perror ("mmap");
+			exit (1);
+		}
+	}
+
+	~CArea (void)
+	{
+		munmap (m_pBase, m_nSize + m_nPageSize);
+	}
+
+	// returns a random string with nLength characters, which ends directly
+	// in front of the guard page or at a random address with nLength+1 bytes space
+	char *GetString (size_t nLength, bool bAtEnd)
+	{
+		char *pString =   bAtEnd
+				? m_pBase + m_nSize - nLength - 1
+				: m_pBase + Random () % (m_nSize - 2*MAX_LENGTH - 2);
+
+		for (size_t i = 0; i < nLength; i++)
+		{
+			if (Random () % 4 != 0)
+			{
+				pString[i] = Alphabet[Random () % (sizeof Alphabet - 1)];
+			}
+			else
+			{
+				pString[i] = (char) (Random () % 255 + 1);
+			}
+		}
+
+		pString[nLength] = '\0';
+
+		return pString;
+	}
+
+	// returns a writeable buffer, which does not overlap with the string
+	char *GetBuffer (size_t nSize)
+	{
+		return m_pBase + m_nSize - nSize;
+	}
+
+private:
+	char *m_pBase;
+	size_t m_nSize;
+	size_t m_nPageSize;
+};
+
+int main (int argc, char **argv)
+{
+	unsigned long nIterations = argc >= 2 ? strtoul (argv[1], 0, 0) : 1000000;
+	s_nSeed = argc >= 3 ? strtoul (argv[2], 0, 0) : 0x12345678;
+	if (s_nSeed == 0)
+	{
+		s_nSeed = 1;
+	}
+
+	CArea Area1, Area2, Area3;
+
+	for (unsigned long n = 0; n < nIterations; n++)
+	{
+		size_t nLength1 = Random () % MAX_LENGTH;
+		char *pString1 = Area1.GetString (nLength1, Random () % 2);
+
+		// second string is often a (case changed) copy of the first one
+		size_t nLength2;
+		char *pString2;
+		switch (Random () % 4)
+		{
+		case 0:
+		case 1:
+			nLength2 = Random () % 2 ? nLength1 : Random () % (nLength1 + 1);
+			pString2 = Area2.GetString (nLength2, Random () % 2);
+			memcpy (pString2, pString1, nLength2);
+			if (nLength2 > 0 && Random () % 2)
+			{
+				size_t nPos = Random () % nLength2;
+				pString2[nPos] ^= Random () % 2 ? 0x20 : Random () % 256;
+				if (pString2[nPos] == '\0')
+				{
+					pString2[nPos] = 'x';
+				}
+			}
+			break;
+
+		default:
+			nLength2 = Random () % MAX_LENGTH;
+			pString2 = Area2.GetString (nLength2, Random () % 2);
+			break;
+		}
+
+		if (circle_strlen (pString1) != strlen (pString1))
+		{
+			Fail (n, "strlen", pString1, 0);
+		}
+
+		if (Sign (circle_strcmp (pString1, pString2)) != Sign (strcmp (pString1, pString2)))
+		{
+			Fail (n, "strcmp", pString1, pString2);
+		}
+
+		if (   Sign (circle_strcasecmp (pString1, pString2))
+		    != Sign (strcasecmp (pString1, pString2)))
+		{
+			Fail (n, "strcasecmp", pString1, pString2);
+		}
+
+		size_t nMaxLen = Random () % (MAX_LENGTH + 10);
+		if (   Sign (circle_strncmp (pString1, pString2, nMaxLen))
+		    != Sign (strncmp (pString1, pString2, nMaxLen)))
+		{
+			Fail (n, "strncmp", pString1, pString2);
+		}
+
+		if (   Sign (circle_strncasecmp (pString1, pString2, nMaxLen))
+		    != Sign (strncasecmp (pString1, pString2, nMaxLen)))
+		{
+			Fail (n, "strncasecmp", pString1, pString2);
+		}
+
+		int chChar;
+		switch (Random () % 4)
+		{
+		case 0:		chChar = 0;						break;
+		case 1:		chChar = nLength1 > 0 ? pString1[Random () % nLength1] : 'a';	break;
+		case 2:		chChar = (signed char) Alphabet[Random () % (sizeof Alphabet - 1)];	break;
+		default:	chChar = Random () % 256;				break;
+		}
+
+		if (circle_strchr (pString1, chChar) != strchr (pString1, chChar))
+		{
+			Fail (n, "strchr", pString1, 0);
+		}
+
+		size_t nMemLength = Random () % (nLength1 + 1);
+		if (   circle_memchr (pString1, chChar, nMemLength)
+		    != memchr (pString1, chChar, nMemLength))
+		{
+			Fail (n, "memchr", pString1, 0);
+		}
+
+		// needle is often a short substring of the haystack
+		const char *pNeedle = pString2;
+		if (Random () % 2 && nLength1 > 0)
+		{
+			size_t nPos = Random () % nLength1;
+			size_t nLen = Random () % 8;
+			if (nLen > nLength1 - nPos)
+			{
+				nLen = nLength1 - nPos;
+			}
+
+			char *pSub = Area3.GetString (nLen, Random () % 2);
+			memcpy (pSub, pString1 + nPos, nLen);
+			pNeedle = pSub;
+		}
+
+		if (circle_strstr (pString1, pNeedle) != strstr (pString1, pNeedle))
+		{
+			Fail (n, "strstr", pString1, pNeedle);
+		}
+
+		// strcpy() and strcat() into a buffer at a random alignment
+		char *pBuffer = Area3.GetBuffer (2*MAX_LENGTH + 2 + Random () % 16);
+		if (   circle_strcpy (pBuffer, pString1) != pBuffer
+		    || strcmp (pBuffer, pString1) != 0)
+		{
+			Fail (n, "strcpy", pString1, 0);
+		}
+
+		if (   circle_strcat (pBuffer, pString2) != pBuffer
+		    || strncmp (pBuffer, pString1, nLength1) != 0
+		    || strcmp (pBuffer + nLength1, pString2) != 0)
+		{
+			Fail (n, "strcat", pString1, pString2);
+		}
+	}
+
+	if (s_nFailures > 0)
+	{
+		printf ("%lu failures in %lu iterations\n", s_nFailures, nIterations);
+
+		return 1;
+	}
+
+	printf ("%lu iterations passed\n", nIterations);
+
+	return 0;
+}
@@ -21,6 +21,9 @@
 #include <circle/string.h>
 #include <assert.h>
 
+#define BENCH_ITERATIONS	100000		// lock/unlock pairs without contention
+#define BENCH_CONTENDED_ITER	2000		// lock/unlock pairs per contending task
+
 static const char FromKernel[] = "kernel";
 
 CKernel::CKernel (void)
@@ -145,6 +148,42 @@ public:
 	CMutex* m_pMutex;
 };
 
+class CContenderTask : public CTask
+{
+public:
+	CContenderTask(CMutex* pMutex, CSemaphore* pSemaphore, volatile unsigned* pCounter)
+	{
+		m_pMutex = pMutex;
+		m_pSemaphore = pSemaphore;
+		m_pCounter = pCounter;
+	}
+
+	virtual void Run() override
+	{
+		for (unsigned i=0; i<BENCH_CONTENDED_ITER; i++)
+		{
+			if (m_pMutex)
+				m_pMutex->Acquire();
+			else
+				m_pSemaphore->Down();
+
+			(*m_pCounter)++;
+
+			// All other tasks run into the locked mutex/semaphore now
+			CScheduler::Get()->Yield();
+
+			if (m_pMutex)
+				m_pMutex->Release();
+			else
+				m_pSemaphore->Up();
+		}
+	}
+
+	CMutex* m_pMutex;
+	CSemaphore* m_pSemaphore;
+	volatile unsigned* m_pCounter;
+};
+
 TShutdownMode CKernel::Run (void)
 {
 	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
@@ -190,12 +229,76 @@ TShutdownMode CKernel::Run (void)
 	m_Logger.Write (FromKernel, LogNotice, "Final counter: %i (should be 50)", counter);
 	assert(counter == 50);
 
+	// Example 4 - Contention benchmark
+	m_Logger.Write (FromKernel, LogNotice, "\n\n### Example 4 - Contention Benchmark ###");
+	BenchmarkUncontended();
+	for (unsigned nTasks = 2; nTasks <= 8; nTasks *= 2)
+	{
+		BenchmarkContended(nTasks, FALSE);
+		BenchmarkContended(nTasks, TRUE);
+	}
 
 	m_Logger.Write (FromKernel, LogNotice, "Finished!");
 	CScheduler::Get()->MsSleep(1000);
 	return ShutdownHalt;
 }
 
+void CKernel::BenchmarkUncontended (void)
+{
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+	for (unsigned i = 0; i < BENCH_ITERATIONS; i++)
+	{
+		m_Mutex.Acquire ();
+		m_Mutex.Release ();
+	}
+	unsigned nMutexTicks = CTimer::GetClockTicks () - nStartTicks;
+
+	nStartTicks = CTimer::GetClockTicks ();
+	for (unsigned i = 0; i < BENCH_ITERATIONS; i++)
+	{
+		m_Semaphore.Down ();
+		m_Semaphore.Up ();
+	}
+	unsigned nSemaphoreTicks = CTimer::GetClockTicks () - nStartTicks;
+
+	// one tick is one microsecond
+	m_Logger.Write (FromKernel, LogNotice, "Uncontended: mutex %u ns, semaphore %u ns per lock/unlock",
+			(unsigned) ((u64) nMutexTicks * 1000 / BENCH_ITERATIONS),
+			(unsigned) ((u64) nSemaphoreTicks * 1000 / BENCH_ITERATIONS));
+}
+
+void CKernel::BenchmarkContended (unsigned nTasks, boolean bSemaphore)
+{
+	assert (nTasks <= 8);
+	CTask *pTask[8];
+
+	volatile unsigned nCounter = 0;
+
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+
+	for (unsigned i = 0; i < nTasks; i++)
+	{
+		pTask[i] = new CContenderTask (bSemaphore ? 0 : &m_Mutex,
+					       bSemaphore ? &m_Semaphore : 0, &nCounter);
+		assert (pTask[i] != 0);
+	}
+
+	for (unsigned i = 0; i < nTasks; i++)
+	{
+		pTask[i]->WaitForTermination ();
+	}
+
+	unsigned nTicks = CTimer::GetClockTicks () - nStartTicks;
+
+	unsigned nPairs = nTasks * BENCH_CONTENDED_ITER;
+	assert (nCounter == nPairs);
+
+	// includes the task switches, which are required to hand over the lock
+	m_Logger.Write (FromKernel, LogNotice, "%u contending tasks: %s %u ns per lock/unlock",
+			nTasks, bSemaphore ? "semaphore" : "mutex",
+			(unsigned) ((u64) nTicks * 1000 / nPairs));
+}
+
 void CKernel::TimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext)
 {
 	CKernel *pThis = (CKernel *) pParam;
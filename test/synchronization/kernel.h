@@ -32,6 +32,7 @@
 #include <circle/sched/scheduler.h>
 #include <circle/sched/synchronizationevent.h>
 #include <circle/sched/mutex.h>
+#include <circle/sched/semaphore.h>
 #include <circle/types.h>
 
 enum TShutdownMode
@@ -52,6 +53,9 @@ public:
 	TShutdownMode Run (void);
 	
 private:
+	void BenchmarkUncontended (void);
+	void BenchmarkContended (unsigned nTasks, boolean bSemaphore);
+
 	static void TimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext);
 
 private:
@@ -69,6 +73,7 @@ private:
 	CScheduler		m_Scheduler;
 	CSynchronizationEvent	m_Event;
 	CMutex			m_Mutex;
+	CSemaphore		m_Semaphore;
 };
 
 #endif